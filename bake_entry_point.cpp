@@ -0,0 +1,52 @@
+#include "src/platform.h"
+#include "model/baked_model.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+static void print_usage()
+{
+    std::cout << "usage: discovery_bake <input.gltf/.glb> <output" BAKED_MODEL_EXTENSION "> [--compress] [--bc7] [--threads N]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        print_usage();
+        return 1;
+    }
+
+    std::string input = argv[1];
+    std::string output = argv[2];
+    bake_options options = {};
+    for (int i = 3; i < argc; i++) {
+        if (std::strcmp(argv[i], "--compress") == 0) {
+            options.compress_textures = true;
+        } else if (std::strcmp(argv[i], "--bc7") == 0) {
+            options.compress_textures = true;
+            options.prefer_bc7 = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.thread_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (!is_baked_model_path(output)) {
+        std::cout << "output should use the " BAKED_MODEL_EXTENSION " extension so the runtime picks the baked loader" << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    try {
+        bake_gltf_model(input, output, options);
+    } catch (const std::exception& e) {
+        std::cout << "bake failed: " << e.what() << std::endl;
+        return 1;
+    }
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "baked " << input << " -> " << output << " in " << ms << "ms" << std::endl;
+    return 0;
+}
@@ -0,0 +1,476 @@
+#include "src/platform.h"
+#include "src/transform.h"
+#include "src/basic_command_buffer.h"
+#include "model/gltf_model.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+/*
+ * cpu micro benchmarks for the loader, transform and scene walking paths. everything runs on
+ * synthetic data generated from a fixed seed, no gpu or model files are needed. results are
+ * printed as json (or a table with --text) so runs can be compared by a script
+ */
+
+struct bench_options {
+    std::string filter;             // only benchmarks whose name contains this
+    double min_time_s = 0.25;       // per benchmark, after calibration
+    bool text = false;
+};
+
+struct bench_result {
+    std::string name;
+    uint64_t iterations = 0;
+    double ns_per_iteration = 0.0;      // median of the samples
+    double min_ns_per_iteration = 0.0;
+    uint64_t items_per_iteration = 0;
+    uint64_t bytes_per_iteration = 0;
+};
+
+// results the optimiser has to keep, benchmarks fold what they compute into it
+static volatile float bench_sink = 0.0f;
+
+template <typename F>
+static void run_bench(const bench_options& options, std::vector<bench_result>& results, const char* name,
+                      uint64_t items, uint64_t bytes, F&& body)
+{
+    if (!options.filter.empty() && std::strstr(name, options.filter.c_str()) == nullptr) {
+        return;
+    }
+    auto time_batch = [&](uint64_t batch) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; i++) {
+            body();
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // batches of at least a millisecond keep the clock's resolution out of the samples
+    uint64_t batch = 1;
+    while (time_batch(batch) < 1e6 && batch < (1ull << 30)) {
+        batch *= 2;
+    }
+
+    std::vector<double> samples;
+    double total_ns = 0.0;
+    while (total_ns < options.min_time_s * 1e9 || samples.size() < 5) {
+        double ns = time_batch(batch);
+        total_ns += ns;
+        samples.push_back(ns / static_cast<double>(batch));
+    }
+    std::sort(samples.begin(), samples.end());
+
+    bench_result result;
+    result.name = name;
+    result.iterations = samples.size() * batch;
+    result.ns_per_iteration = samples[samples.size() / 2];
+    result.min_ns_per_iteration = samples.front();
+    result.items_per_iteration = items;
+    result.bytes_per_iteration = bytes;
+    results.push_back(result);
+}
+
+static double per_second(uint64_t count, double ns)
+{
+    return (ns > 0.0) ? static_cast<double>(count) * 1e9 / ns : 0.0;
+}
+
+static void print_json(const std::vector<bench_result>& results)
+{
+    std::printf("{\"benchmarks\":[\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& r = results[i];
+        std::printf("{\"name\":\"%s\",\"iterations\":%llu,\"ns_per_iteration\":%.3f,\"min_ns_per_iteration\":%.3f,"
+                    "\"items_per_second\":%.1f,\"bytes_per_second\":%.1f}%s\n",
+                    r.name.c_str(), static_cast<unsigned long long>(r.iterations), r.ns_per_iteration, r.min_ns_per_iteration,
+                    per_second(r.items_per_iteration, r.ns_per_iteration), per_second(r.bytes_per_iteration, r.ns_per_iteration),
+                    (i + 1 < results.size()) ? "," : "");
+    }
+    std::printf("]}\n");
+}
+
+static void print_text(const std::vector<bench_result>& results)
+{
+    std::printf("%-44s %14s %14s %14s %12s\n", "benchmark", "ns/iter", "min ns/iter", "items/s", "MiB/s");
+    for (auto& r : results) {
+        std::printf("%-44s %14.1f %14.1f %14.4g %12.1f\n", r.name.c_str(), r.ns_per_iteration, r.min_ns_per_iteration,
+                    per_second(r.items_per_iteration, r.ns_per_iteration),
+                    per_second(r.bytes_per_iteration, r.ns_per_iteration) / (1024.0 * 1024.0));
+    }
+}
+
+
+/* synthetic data, xorshift so every run generates the same */
+
+static uint32_t next_random(uint32_t& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float random_float(uint32_t& state, float lo, float hi)
+{
+    return lo + (hi - lo) * static_cast<float>(next_random(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// a gltf_document whose accessors all read one in memory buffer
+struct synthetic_model {
+    gltf_document document;
+    std::vector<unsigned char> bytes;
+};
+
+// count random elements in a new buffer view, floats in [-1, 1]. stride 0 packs them tightly
+static int add_accessor(synthetic_model& m, uint32_t& rng, int component_type, int type, bool normalized, size_t count, size_t stride = 0)
+{
+    int components = tinygltf::GetNumComponentsInType(type);
+    int component_size = tinygltf::GetComponentSizeInBytes(component_type);
+    size_t element_size = static_cast<size_t>(components * component_size);
+    size_t element_stride = (stride != 0) ? stride : element_size;
+
+    size_t offset = (m.bytes.size() + 3) & ~static_cast<size_t>(3);
+    size_t byte_length = (count - 1) * element_stride + element_size;
+    m.bytes.resize(offset + byte_length);
+    for (size_t i = 0; i < count; i++) {
+        unsigned char* element = m.bytes.data() + offset + i * element_stride;
+        for (int c = 0; c < components; c++) {
+            if (component_type == TINYGLTF_COMPONENT_TYPE_FLOAT) {
+                float value = random_float(rng, -1.0f, 1.0f);
+                std::memcpy(element + c * component_size, &value, sizeof(value));
+            } else {
+                uint32_t value = next_random(rng);
+                std::memcpy(element + c * component_size, &value, static_cast<size_t>(component_size));
+            }
+        }
+    }
+
+    tinygltf::BufferView view;
+    view.buffer = 0;
+    view.byteOffset = offset;
+    view.byteLength = byte_length;
+    view.byteStride = stride;
+    m.document.model.bufferViews.push_back(view);
+
+    tinygltf::Accessor accessor;
+    accessor.bufferView = static_cast<int>(m.document.model.bufferViews.size() - 1);
+    accessor.componentType = component_type;
+    accessor.type = type;
+    accessor.count = count;
+    accessor.normalized = normalized;
+    accessor.minValues.assign(static_cast<size_t>(components), -1.0);
+    accessor.maxValues.assign(static_cast<size_t>(components), 1.0);
+    m.document.model.accessors.push_back(accessor);
+    return static_cast<int>(m.document.model.accessors.size() - 1);
+}
+
+// float attributes, or the 8 and 16 bit layouts KHR_mesh_quantization allows padded to 4 byte strides
+static tinygltf::Primitive add_primitive(synthetic_model& m, uint32_t& rng, size_t vertex_count, bool quantized)
+{
+    tinygltf::Primitive prim;
+    prim.mode = TINYGLTF_MODE_TRIANGLES;
+    prim.material = 0;
+    if (quantized) {
+        prim.attributes["POSITION"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_VEC3, true, vertex_count, 8);
+        prim.attributes["NORMAL"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_BYTE, TINYGLTF_TYPE_VEC3, true, vertex_count, 4);
+        prim.attributes["TANGENT"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_BYTE, TINYGLTF_TYPE_VEC4, true, vertex_count);
+        prim.attributes["TEXCOORD_0"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_VEC2, true, vertex_count);
+    } else {
+        prim.attributes["POSITION"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, false, vertex_count);
+        prim.attributes["NORMAL"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, false, vertex_count);
+        prim.attributes["TANGENT"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4, false, vertex_count);
+        prim.attributes["TEXCOORD_0"] = add_accessor(m, rng, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, false, vertex_count);
+    }
+    return prim;
+}
+
+static tinygltf::Primitive add_indexed_primitive(synthetic_model& m, uint32_t& rng, size_t index_count, int component_type)
+{
+    tinygltf::Primitive prim;
+    prim.mode = TINYGLTF_MODE_TRIANGLES;
+    prim.indices = add_accessor(m, rng, component_type, TINYGLTF_TYPE_SCALAR, false, index_count);
+    return prim;
+}
+
+// once every accessor is added, the buffer doesn't move anymore
+static void finish_model(synthetic_model& m)
+{
+    m.document.model.buffers.resize(1);
+    m.document.model.materials.resize(1);
+    m.document.buffers = {{m.bytes.data(), m.bytes.size()}};
+}
+
+static std::vector<transform> make_transforms(uint32_t& rng, size_t count)
+{
+    std::vector<transform> transforms(count);
+    for (auto& t : transforms) {
+        t.position = {random_float(rng, -100.0f, 100.0f), random_float(rng, -100.0f, 100.0f), random_float(rng, -100.0f, 100.0f)};
+        t.rotation = {random_float(rng, -180.0f, 180.0f), random_float(rng, -180.0f, 180.0f), random_float(rng, -180.0f, 180.0f)};
+        t.scale = {random_float(rng, 0.5f, 2.0f), random_float(rng, 0.5f, 2.0f), random_float(rng, 0.5f, 2.0f)};
+    }
+    return transforms;
+}
+
+// a tree with branching children per node, every leaf draws one of mesh_count meshes
+static scene_table make_scene(uint32_t& rng, uint32_t depth, uint32_t branching, uint32_t mesh_count)
+{
+    scene_table scene;
+    std::vector<std::pair<uint32_t, uint32_t>> level = {{0, 0}};    // node, depth
+    scene.nodes.emplace_back();
+    scene.roots.push_back(0);
+    for (size_t i = 0; i < level.size(); i++) {
+        uint32_t node = level[i].first;
+        if (level[i].second == depth) {
+            scene.nodes[node].mesh = static_cast<int32_t>(next_random(rng) % mesh_count);
+            continue;
+        }
+        scene.nodes[node].first_child = static_cast<uint32_t>(scene.children.size());
+        scene.nodes[node].child_count = branching;
+        for (uint32_t c = 0; c < branching; c++) {
+            uint32_t child = static_cast<uint32_t>(scene.nodes.size());
+            scene.nodes.emplace_back();
+            scene.nodes[child].local_transform = get_model_matrix(make_transforms(rng, 1)[0]);
+            scene.children.push_back(child);
+            level.push_back({child, level[i].second + 1});
+        }
+    }
+    return scene;
+}
+
+static std::vector<mesh_data> make_meshes(uint32_t& rng, size_t count)
+{
+    std::vector<mesh_data> meshes(count);
+    for (auto& mesh : meshes) {
+        mesh.primitive_data.resize(1);
+        glm::vec3 center(random_float(rng, -10.0f, 10.0f), random_float(rng, -10.0f, 10.0f), random_float(rng, -10.0f, 10.0f));
+        glm::vec3 extent(random_float(rng, 0.1f, 5.0f), random_float(rng, 0.1f, 5.0f), random_float(rng, 0.1f, 5.0f));
+        mesh.primitive_data[0].prim_bounds.min = center - extent;
+        mesh.primitive_data[0].prim_bounds.max = center + extent;
+    }
+    return meshes;
+}
+
+
+/* the scene walk of triangle_cmd::rec_fill_command_buffer_model, without the uniform buffers */
+
+struct scene_walk {
+    const scene_table* scene;
+    const std::vector<mesh_data>* meshes;
+    glm::mat4 view;
+    glm::mat4 proj;
+    std::vector<glm::mat4> node_transforms;
+    std::vector<const prim_data*> draws;
+};
+
+static void walk_scene(scene_walk& walk, uint32_t node_index, glm::mat4 transform)
+{
+    const auto& current_node = walk.scene->nodes[node_index];
+    transform = transform * current_node.local_transform;
+
+    if (current_node.mesh >= 0) {
+        walk.node_transforms[node_index] = transform;
+        const auto& primitive_data = (*walk.meshes)[current_node.mesh].primitive_data.front();
+        glm::mat4 model_view = walk.view * transform;
+        if (!is_outside_frustum(walk.proj * model_view, primitive_data.prim_bounds)) {
+            walk.draws.push_back(&primitive_data);
+        }
+    }
+
+    for (uint32_t c = 0; c < current_node.child_count; c++) {
+        walk_scene(walk, walk.scene->children[current_node.first_child + c], transform);
+    }
+}
+
+
+static void print_usage()
+{
+    std::cout << "usage: discovery_bench [--filter substring] [--min-time seconds] [--text]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_options options;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            options.min_time_s = std::max(0.01, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--text") == 0) {
+            options.text = true;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::vector<bench_result> results;
+    uint32_t rng = 0x9e3779b9u;
+
+    /* load_prim, vertex attributes decoded into the interleaved vertex layout */
+    {
+        const size_t vertex_count = 65536;
+        synthetic_model m;
+        auto float_prim = add_primitive(m, rng, vertex_count, false);
+        auto quantized_prim = add_primitive(m, rng, vertex_count, true);
+        finish_model(m);
+        std::vector<vertex> output(vertex_count);
+
+        run_bench(options, results, "load_prim/convert_vertices/float", vertex_count, vertex_count * sizeof(vertex), [&]{
+            convert_prim_vertices(m.document, float_prim, output.data(), 0, vertex_count);
+            bench_sink = bench_sink + output.back().position.x;
+        });
+        run_bench(options, results, "load_prim/convert_vertices/quantized", vertex_count, vertex_count * sizeof(vertex), [&]{
+            convert_prim_vertices(m.document, quantized_prim, output.data(), 0, vertex_count);
+            bench_sink = bench_sink + output.back().position.x;
+        });
+        run_bench(options, results, "load_prim/prim_bounds", 1, 0, [&]{
+            bench_sink = bench_sink + get_prim_bounds(m.document, quantized_prim).max.x;
+        });
+    }
+
+    /* load_prim, indices widened to what the index buffer takes */
+    {
+        const size_t index_count = 3 * 65536;
+        synthetic_model m;
+        auto u8_prim = add_indexed_primitive(m, rng, index_count, TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE);
+        auto u16_prim = add_indexed_primitive(m, rng, index_count, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT);
+        auto u32_prim = add_indexed_primitive(m, rng, index_count, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT);
+        finish_model(m);
+        std::vector<uint32_t> output(index_count);
+
+        auto bench_indices = [&](const char* name, const tinygltf::Primitive& prim) {
+            VkIndexType type = get_prim_index_type(m.document, prim);
+            size_t bytes = index_count * ((type == VK_INDEX_TYPE_UINT32) ? 4 : 2);
+            run_bench(options, results, name, index_count, bytes, [&]{
+                convert_prim_indices(m.document, prim, type, output.data());
+                bench_sink = bench_sink + static_cast<float>(output[0]);
+            });
+        };
+        bench_indices("load_prim/convert_indices/u8_to_u16", u8_prim);
+        bench_indices("load_prim/convert_indices/u16", u16_prim);
+        bench_indices("load_prim/convert_indices/u32", u32_prim);
+    }
+
+    /* transforms, a batch per iteration so the loop overhead doesn't dominate */
+    {
+        const size_t count = 1024;
+        auto transforms = make_transforms(rng, count);
+        std::vector<glm::mat4> matrices(count);
+        for (size_t i = 0; i < count; i++) {
+            matrices[i] = get_model_matrix(transforms[i]);
+        }
+
+        run_bench(options, results, "transform/get_model_matrix", count, 0, [&]{
+            float sum = 0.0f;
+            for (auto& t : transforms) {
+                sum += get_model_matrix(t)[3][0];
+            }
+            bench_sink = bench_sink + sum;
+        });
+        run_bench(options, results, "transform/get_view_matrix", count, 0, [&]{
+            float sum = 0.0f;
+            for (auto& t : transforms) {
+                sum += get_view_matrix(t)[3][0];
+            }
+            bench_sink = bench_sink + sum;
+        });
+        run_bench(options, results, "transform/decompose_model", count, 0, [&]{
+            float sum = 0.0f;
+            glm::vec3 scale, translation;
+            glm::quat orientation;
+            for (auto& mat : matrices) {
+                decompose_model(mat, scale, orientation, translation);
+                sum += scale.x + orientation.w + translation.x;
+            }
+            bench_sink = bench_sink + sum;
+        });
+        run_bench(options, results, "transform/local_translate_model", count, 0, [&]{
+            float sum = 0.0f;
+            for (auto mat : matrices) {
+                local_translate_model(mat, {1.0f, 2.0f, 3.0f});
+                sum += mat[3][0];
+            }
+            bench_sink = bench_sink + sum;
+        });
+        run_bench(options, results, "transform/local_rotate_model", count, 0, [&]{
+            float sum = 0.0f;
+            for (auto mat : matrices) {
+                local_rotate_model(mat, {0.1f, 0.2f, 0.3f});
+                sum += mat[0][0];
+            }
+            bench_sink = bench_sink + sum;
+        });
+        run_bench(options, results, "transform/expensive_scale_mat4", count, 0, [&]{
+            float sum = 0.0f;
+            for (auto mat : matrices) {
+                expensive_scale_mat4(mat, {2.0f, 2.0f, 2.0f});
+                sum += mat[0][0];
+            }
+            bench_sink = bench_sink + sum;
+        });
+        run_bench(options, results, "transform/local_vectors", count, 0, [&]{
+            float sum = 0.0f;
+            for (auto& mat : matrices) {
+                sum += get_local_up_vector(mat).y + get_local_forward_vector(mat).z + get_local_right_vector(mat).x;
+            }
+            bench_sink = bench_sink + sum;
+        });
+    }
+
+    /* scene walking and bounds */
+    {
+        const uint32_t mesh_count = 1024;
+        auto meshes = make_meshes(rng, mesh_count);
+        auto scene = make_scene(rng, 6, 4, mesh_count);
+
+        scene_walk walk;
+        walk.scene = &scene;
+        walk.meshes = &meshes;
+        walk.view = glm::lookAt(glm::vec3(0.0f, 50.0f, 200.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        walk.proj = glm::perspective(45.0f, 16.0f / 9.0f, 0.1f, 10000.0f);
+        walk.node_transforms.resize(scene.nodes.size());
+
+        run_bench(options, results, "scene/walk_and_cull", scene.nodes.size(), 0, [&]{
+            walk.draws.clear();
+            for (auto n : scene.roots) {
+                walk_scene(walk, n, glm::mat4(1.0f));
+            }
+            bench_sink = bench_sink + static_cast<float>(walk.draws.size());
+        });
+        run_bench(options, results, "scene/get_mesh_bounds", mesh_count, 0, [&]{
+            bench_sink = bench_sink + get_mesh_bounds(meshes).max.x;
+        });
+    }
+
+    /* file reading, from a file written next to the executable */
+    {
+        const size_t file_size = 4 * 1024 * 1024;
+        std::string path = to_absolute_path("discovery_bench_file.tmp");
+        {
+            std::string contents(file_size, ' ');
+            for (size_t i = 0; i < file_size; i++) {
+                contents[i] = static_cast<char>('a' + next_random(rng) % 26);
+            }
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        }
+        run_bench(options, results, "platform/read_string_from_file", 1, file_size, [&]{
+            bench_sink = bench_sink + static_cast<float>(read_string_from_file(path).size());
+        });
+        std::remove(path.c_str());
+    }
+
+    if (options.text) {
+        print_text(results);
+    } else {
+        print_json(results);
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "src/vulkan/vulkan_base.h"
+#include "src/vulkan/vulkan_capture_format.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/*
+ * replays the frame in a capture written with --capture by discovery or discovery_headless. the
+ * null backend only decodes the packets, so it measures the capture and the replayer themselves
+ * and runs without a gpu, the device backend re-issues them on a headless device. pipelines are
+ * rebuilt from the shaders in res/, so run it from next to discovery
+ */
+
+static void print_usage()
+{
+    std::cout << "usage: discovery_replay <capture" CAPTURE_EXTENSION "> [--backend null/device] [--iterations N]\n"
+                 "prints json" << std::endl;
+}
+
+static void write_times(const char* name, std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+    std::cout << ",\"" << name << "\":{\"median\":" << (times.empty() ? 0.0 : times[times.size() / 2])
+              << ",\"min\":" << (times.empty() ? 0.0 : times.front()) << "}";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+
+    std::string capture_path = argv[1];
+    capture_backend backend = capture_backend::NONE;
+    uint32_t iterations = 10;
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "null") {
+                backend = capture_backend::NONE;
+            } else if (name == "device") {
+                backend = capture_backend::DEVICE;
+            } else {
+                print_usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    capture_replay_stats stats;
+    try {
+        stats = replay_capture(capture_path, backend, iterations);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "{\"width\":" << stats.width << ",\"height\":" << stats.height << ",\"byte_size\":" << stats.byte_size
+              << ",\"backend\":\"" << (backend == capture_backend::DEVICE ? "device" : "null") << "\""
+              << ",\"iterations\":" << iterations << ",\"prologue_objects\":" << stats.prologue_objects
+              << ",\"frame_objects\":" << stats.frame_objects << ",\"commands\":" << stats.commands
+              << ",\"draws\":" << stats.draws << ",\"dispatches\":" << stats.dispatches << ",\"barriers\":" << stats.barriers
+              << ",\"pipeline_binds\":" << stats.pipeline_binds << ",\"redundant_pipeline_binds\":" << stats.redundant_pipeline_binds
+              << ",\"descriptor_set_binds\":" << stats.descriptor_set_binds
+              << ",\"redundant_descriptor_set_binds\":" << stats.redundant_descriptor_set_binds
+              << ",\"descriptor_writes\":" << stats.descriptor_writes << ",\"submits\":" << stats.submits
+              << ",\"skipped\":" << stats.skipped << ",\"load_ms\":" << stats.load_ms << ",\"setup_ms\":" << stats.setup_ms;
+    write_times("replay_ms", stats.replay_ms);
+    write_times("submit_ms", stats.submit_ms);
+    write_times("wait_ms", stats.wait_ms);
+    std::cout << "}" << std::endl;
+    return 0;
+}
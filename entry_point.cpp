@@ -8,10 +8,15 @@
 #include "src/vulkan/vulkan_base.h"
 #include "src/basic_pipeline.h"
 #include "src/basic_command_buffer.h"
+#include "src/camera_path.h"
+#include "src/cpu_profiler.h"
+#include "src/dynamic_resolution.h"
 #include "src/platform.h"
 #include "src/transform.h"
 #include "model/gltf_model.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 
 void perform_camera_control(GLFWwindow* window, entt::registry& Registry, entt::entity Camera)
@@ -55,6 +60,60 @@ T lerpValue(T start, T end, float t) {
     return (start + (t * (end - start)));
 }
 
+// true on the frame a key goes down
+bool key_pressed(GLFWwindow* window, int key, bool& was_down)
+{
+    bool down = glfwGetKey(window, key) == GLFW_PRESS;
+    bool pressed = down && !was_down;
+    was_down = down;
+    return pressed;
+}
+
+// fxaa and taa draw the scene single sampled, otherwise the requested msaa as far as the device allows.
+// taa wins over fxaa
+void set_anti_aliasing(vulkan_data& vkdata, triangle_cmd& cmd, VkSampleCountFlagBits msaa_samples, bool fxaa, bool taa)
+{
+    if ((fxaa || taa) && (vkdata.swap_chain_data.image_usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0) {
+        std::cerr << "fxaa and taa need to blit to the swapchain, which this surface doesn't support" << std::endl;
+        fxaa = false;
+        taa = false;
+    }
+    cmd.use_taa = taa;
+    cmd.use_fxaa = fxaa && !taa;
+    vkdata.msaa_samples = (fxaa || taa) ? VK_SAMPLE_COUNT_1_BIT : clamp_msaa_samples(vkdata, msaa_samples);
+}
+
+void print_gpu_profile(const gpu_profiler& profiler)
+{
+    std::cout << "gpu:";
+    for (auto& region : profiler.get_region_stats()) {
+        std::cout << " " << region.name << " " << region.average_ms << "ms";
+    }
+    std::cout << std::endl;
+}
+
+void print_cpu_profile()
+{
+    auto frame = cpu_profile_get_frame_stats();
+    std::cout << "cpu: frame p50 " << frame.timing.p50_ms << "ms p95 " << frame.timing.p95_ms
+              << "ms p99 " << frame.timing.p99_ms << "ms max " << frame.timing.max_ms << "ms\n";
+    // the slowest few scopes are enough to see where a spike came from
+    auto scopes = cpu_profile_get_scope_stats();
+    for (size_t i = 0; i < std::min<size_t>(scopes.size(), 8); i++) {
+        std::cout << "  " << scopes[i].name << " p50 " << scopes[i].p50_ms << "ms p99 " << scopes[i].p99_ms
+                  << "ms max " << scopes[i].max_ms << "ms x" << scopes[i].count << "\n";
+    }
+    std::cout << std::flush;
+}
+
+std::string get_anti_aliasing_name(vulkan_data& vkdata, const triangle_cmd& cmd)
+{
+    if (cmd.use_taa) {
+        return "taa";
+    }
+    return cmd.use_fxaa ? "fxaa" : std::to_string(static_cast<int>(vkdata.msaa_samples)) + "x msaa";
+}
+
 int main(int argc, char** argv)
 {
     glfwInit();
@@ -62,8 +121,24 @@ int main(int argc, char** argv)
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     GLFWwindow* window = glfwCreateWindow(800, 600, "Vulkan window", nullptr, nullptr);
     
+    // a capture has to see every object from the start, so it exists before the device does
+    vulkan_capture capture;
+    std::string capture_path;
+    uint64_t capture_frame = 100;
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::string(argv[i]) == "--capture") {
+            capture_path = argv[i + 1];
+        } else if (std::string(argv[i]) == "--capture-frame") {
+            capture_frame = static_cast<uint64_t>(std::max(1, std::atoi(argv[i + 1])));
+        }
+    }
+
     vulkan_data vkdata;
     try{
+        if (!capture_path.empty()) {
+            capture.initialise(capture_path, capture_frame);
+            vkdata.capture = &capture;
+        }
         initialise_vulkan(&vkdata, window);
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -85,16 +160,153 @@ int main(int argc, char** argv)
     // std::vector<uint32_t> qindex_data = {0, 1, 2, 2, 3, 0,
     //                                      4, 5, 6, 6, 7, 4};
 
-    basic_pipeline pipeline;
-    pipeline.initialise(vkdata, vkdata.render_pass);
-
     gltf_model gmodel;
+    triangle_cmd cmd;
     // gmodel.initialise("res/models/pony/scene.gltf");
     gmodel.initialise("res/models/viking/scene.gltf");
     //gmodel.initialise("res/models/car.gltf");
+    VkSampleCountFlagBits msaa_samples = vkdata.msaa_samples;
+    bool fxaa = false;
+    bool taa = false;
+    bool gpu_profile = false;
+    std::string gpu_trace_path;
+    bool cpu_profile = false;
+    std::string cpu_trace_path;
+    dynamic_resolution resolution;
+    std::string record_camera_path;
+    std::string replay_camera_path;
+    double replay_step = 1.0 / 60.0;
+    std::string frame_csv_path;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--stream-textures") {
+            gmodel.stream_textures = true;
+        } else if (std::string(argv[i]) == "--compress-textures") {
+            // block compressed on the first run and cached under res/cache/textures/
+            gmodel.compress_textures = true;
+        } else if (std::string(argv[i]) == "--bc7") {
+            // bc7 instead of bc1/bc3, normal maps stay bc5
+            gmodel.compress_textures = true;
+            gmodel.prefer_bc7 = true;
+        } else if (std::string(argv[i]) == "--depth-prepass") {
+            cmd.depth_prepass = true;
+        } else if (std::string(argv[i]) == "--msaa" && i + 1 < argc) {
+            // 1, 2, 4 or 8, rounded down to what the device supports
+            msaa_samples = static_cast<VkSampleCountFlagBits>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::string(argv[i]) == "--fxaa") {
+            fxaa = true;
+        } else if (std::string(argv[i]) == "--taa") {
+            taa = true;
+        } else if (std::string(argv[i]) == "--render-scale" && i + 1 < argc) {
+            // fixed scale for taa, 0.5 to 0.67 keeps close to native quality
+            cmd.render_scale = std::clamp(static_cast<float>(std::atof(argv[++i])), 0.25f, 1.0f);
+        } else if (std::string(argv[i]) == "--gpu-profile") {
+            // per pass averages every couple of seconds
+            gpu_profile = true;
+        } else if (std::string(argv[i]) == "--gpu-trace" && i + 1 < argc) {
+            // chrome://tracing json of every pass, written on exit
+            gpu_trace_path = argv[++i];
+        } else if (std::string(argv[i]) == "--cpu-profile") {
+            // frame time percentiles and the slowest scopes every couple of seconds
+            cpu_profile = true;
+        } else if (std::string(argv[i]) == "--cpu-trace" && i + 1 < argc) {
+            // chrome://tracing json of the latest cpu scopes, written on exit
+            cpu_trace_path = argv[++i];
+        } else if (std::string(argv[i]) == "--dynamic-resolution") {
+            cmd.dynamic_resolution = true;
+        } else if (std::string(argv[i]) == "--target-fps" && i + 1 < argc) {
+            resolution.target_ms = 1000.0 / std::max(1, std::atoi(argv[++i]));
+        } else if (std::string(argv[i]) == "--record-camera" && i + 1 < argc) {
+            // the camera of every frame, written on exit
+            record_camera_path = argv[++i];
+        } else if (std::string(argv[i]) == "--replay-camera" && i + 1 < argc) {
+            // drives the camera from a recording instead of input and exits at its end
+            replay_camera_path = argv[++i];
+        } else if (std::string(argv[i]) == "--replay-step" && i + 1 < argc) {
+            // seconds of the recording per frame
+            replay_step = std::max(1e-4, std::atof(argv[++i]));
+        } else if (std::string(argv[i]) == "--frame-csv" && i + 1 < argc) {
+            // cpu and gpu time of every frame, written on exit
+            frame_csv_path = argv[++i];
+        } else if ((std::string(argv[i]) == "--capture" || std::string(argv[i]) == "--capture-frame") && i + 1 < argc) {
+            // the vulkan calls of one frame for discovery_replay, read before initialise_vulkan
+            i++;
+        }
+    }
+
+    camera_path replay;
+    if (!replay_camera_path.empty()) {
+        try {
+            replay = read_camera_path(replay_camera_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    camera_path recording;
+
+    set_anti_aliasing(vkdata, cmd, msaa_samples, fxaa, taa);
+    if ((cpu_profile || !cpu_trace_path.empty()) && !cpu_profile_enabled()) {
+        std::cerr << "built without DISCOVERY_CPU_PROFILING, there are no cpu timings" << std::endl;
+    }
+
+    cmd.add_passes(vkdata, *vkdata.graph);
+    vkdata.graph->compile(vkdata);
+
+    /* pipelines compile on the registry's workers while the model loads, the first frame waits for any still compiling */
+    basic_pipeline pipeline;
+    pipeline.after_depth_prepass = cmd.depth_prepass;
+    pipeline.motion_vectors = cmd.use_taa;
+    pipeline.compile_async = true;
+
+    // after a pre-pass the forward pipeline only shades fragments at the pre-pass depth, until it is
+    // ready primitives are drawn with the plain depth tested pipeline, which passes there too
+    basic_pipeline fallback_pipeline;
+    if (cmd.depth_prepass) {
+        fallback_pipeline.motion_vectors = cmd.use_taa;
+        fallback_pipeline.compile_async = true;
+        fallback_pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.forward_pass));
+        pipeline.fallback = &fallback_pipeline;
+        cmd.fallback_pipeline = &fallback_pipeline;
+    }
+    pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.forward_pass));
+
+    depth_prepass_pipeline depth_pipeline;
+    depth_pipeline.compile_async = true;
+    if (cmd.depth_prepass) {
+        depth_pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.depth_prepass_pass));
+        cmd.depth_pipeline = &depth_pipeline;
+    }
+
+    fxaa_pipeline fxaa_compute;
+    fxaa_compute.initialise(vkdata);
+    cmd.fxaa = &fxaa_compute;
+
+    taa_pipeline taa_compute;
+    taa_compute.initialise(vkdata);
+    cmd.taa = &taa_compute;
+
+    gpu_frame_timer frame_timer;
+    frame_timer.initialise(vkdata);
+    cmd.frame_timer = &frame_timer;
+    if (cmd.dynamic_resolution && !frame_timer.is_supported()) {
+        std::cerr << "the graphics queue has no timestamps, dynamic resolution stays at full scale" << std::endl;
+    }
+
+    gpu_profiler profiler;
+    if (gpu_profile || !gpu_trace_path.empty()) {
+        profiler.initialise(vkdata);
+        profiler.trace = !gpu_trace_path.empty();
+        cmd.profiler = &profiler;
+        if (!profiler.is_supported()) {
+            std::cerr << "the graphics queue has no timestamps, nothing will be profiled" << std::endl;
+        }
+    }
+    double profile_print_time = glfwGetTime();
+    double cpu_profile_print_time = glfwGetTime();
+
     gmodel.load_model(vkdata);
+    pipeline.warm_up(vkdata, gmodel);
 
-    triangle_cmd cmd;
     cmd.model = &gmodel;
     cmd.pipeline = &pipeline;
     cmd.initialise(vkdata);
@@ -112,9 +324,51 @@ int main(int argc, char** argv)
  
     double desiredCameraZoom = -1.0 * (double)std::max({gmodel_bounds.max.x - gmodel_bounds.min.x, gmodel_bounds.max.y - gmodel_bounds.min.y, gmodel_bounds.max.z - gmodel_bounds.min.z});
     
+    bool msaa_key_down = false, fxaa_key_down = false, taa_key_down = false;
     double timeLastFrame = glfwGetTime();
+    double startTime = timeLastFrame;
+    uint64_t frameIndex = 0;
+    std::vector<replay_frame_time> frame_times;
     while(!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        CPU_PROFILE_FRAME();
+        double frameStart = glfwGetTime();
+        // replays step through the recording at a fixed rate whatever the frame rate
+        double replayTime = static_cast<double>(frameIndex) * replay_step;
+        if (!replay.frames.empty() && replayTime > get_camera_path_duration(replay)) {
+            break;
+        }
+        {
+            CPU_PROFILE_SCOPE("poll_events");
+            glfwPollEvents();
+        }
+
+        /* anti-aliasing, m cycles the msaa sample count, n toggles fxaa and t toggles taa */
+        bool cycle_msaa = key_pressed(window, GLFW_KEY_M, msaa_key_down);
+        bool toggle_fxaa = key_pressed(window, GLFW_KEY_N, fxaa_key_down);
+        bool toggle_taa = key_pressed(window, GLFW_KEY_T, taa_key_down);
+        if (cycle_msaa || toggle_fxaa || toggle_taa) {
+            if (cycle_msaa) {
+                // skip counts the device rounds down to the current one
+                auto current = (fxaa || taa) ? VK_SAMPLE_COUNT_1_BIT : vkdata.msaa_samples;
+                msaa_samples = (current >= VK_SAMPLE_COUNT_8_BIT) ? VK_SAMPLE_COUNT_1_BIT : static_cast<VkSampleCountFlagBits>(current << 1);
+                if (clamp_msaa_samples(vkdata, msaa_samples) == current) {
+                    msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+                }
+                fxaa = false;
+                taa = false;
+            } else if (toggle_fxaa) {
+                fxaa = !fxaa;
+                taa = false;
+            } else {
+                taa = !taa;
+                fxaa = false;
+            }
+            set_anti_aliasing(vkdata, cmd, msaa_samples, fxaa, taa);
+            fxaa = cmd.use_fxaa;
+            taa = cmd.use_taa;
+            cmd.rebuild_passes(vkdata);
+            std::cout << "anti-aliasing: " << get_anti_aliasing_name(vkdata, cmd) << std::endl;
+        }
 
         /* do time stuff */
         double deltaTime;
@@ -124,11 +378,6 @@ int main(int argc, char** argv)
             timeLastFrame = t;
         }
 
-        /* redo projection in case window size changed */
-        int h,w;
-        glfwGetWindowSize(window, &w, &h);
-        cmd.frame_ubo.proj = glm::perspective(45.0, ((double)w / (double)h), 0.1, 10000.0);
-        
         /* input for camera control */
         if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_2)) {
             if (glfwGetInputMode(window, GLFW_CURSOR) != GLFW_CURSOR_DISABLED) {
@@ -177,29 +426,124 @@ int main(int argc, char** argv)
         cameraZoom = lerpValue(cameraZoom, desiredCameraZoom, deltaTime * 5.0);
         cameraPos = lerpValue(cameraPos, desiredCameraPos, deltaTime * 20.0);
 
-        /* update camera's view matrix */
-        glm::mat4 v = glm::translate(glm::mat4(1.0), {0.0, 0.0, cameraZoom});
-        v = glm::rotate(v, cameraRot.y, {1, 0, 0});
-        v = glm::rotate(v, cameraRot.x, {0, 1, 0});
-        v = glm::rotate(v, glm::radians(180.0f), {0, 0, 1}); // flip y
-        v = glm::translate(v, -cameraPos);
+        camera_state camera;
+        camera.position = cameraPos;
+        camera.rotation = {cameraRot.x, cameraRot.y};
+        camera.zoom = cameraZoom;
+        if (!replay.frames.empty()) {
+            // input still moves the live camera, it just isn't shown
+            camera = sample_camera_path(replay, replayTime);
+        }
+        if (!record_camera_path.empty()) {
+            recording.frames.push_back({glfwGetTime() - startTime, camera});
+        }
+
+        /* update camera's view matrix, and projection in case window size changed */
+        int h,w;
+        glfwGetWindowSize(window, &w, &h);
+        recording.width = static_cast<uint32_t>(w);
+        recording.height = static_cast<uint32_t>(h);
+        cmd.frame_ubo.proj = get_camera_projection(camera, ((double)w / (double)h));
+        glm::mat4 v = get_camera_view(camera);
         cmd.frame_ubo.view = v;
         
         cmd.frame_ubo.cameraPos = glm::vec4(v[3].x, v[3].y, v[3].z, 1.0) * v;
-        cmd.frame_ubo.currTime = glfwGetTime();
+        cmd.frame_ubo.currTime = replay.frames.empty() ? glfwGetTime() : replayTime;
+
+        /* swap in streamed texture levels requested while recording the last frame */
+        if (gmodel.stream_textures) {
+            CPU_PROFILE_SCOPE("stream_textures");
+            gmodel.streamer().update(vkdata);
+        }
+
+        /* scale the scene to how long the gpu took on the last frames it finished */
+        bool gpu_time_read = frame_timer.update(vkdata);
+        if (gpu_time_read && cmd.dynamic_resolution) {
+            resolution.update(frame_timer.get_last_time_ms());
+            cmd.render_scale = resolution.get_scale();
+        }
+        // the time read back is of a frame that has already finished, a line per frame is pushed below
+        uint64_t gpu_frames_ago = vkdata.frame_number - frame_timer.get_last_frame();
+        if (gpu_time_read && !frame_csv_path.empty() && frame_times.size() >= gpu_frames_ago) {
+            frame_times[frame_times.size() - gpu_frames_ago].gpu_ms = frame_timer.get_last_time_ms();
+        }
+
+        if (cmd.profiler != nullptr) {
+            profiler.update(vkdata);
+            if (gpu_profile && glfwGetTime() - profile_print_time > 2.0) {
+                print_gpu_profile(profiler);
+                profile_print_time = glfwGetTime();
+            }
+        }
+
+        if (cpu_profile && glfwGetTime() - cpu_profile_print_time > 2.0) {
+            print_cpu_profile();
+            cpu_profile_print_time = glfwGetTime();
+        }
 
         /* remake command buffers for this frame */
-        cmd.reterminate(vkdata);
-        cmd.reinitialise(vkdata); // @TODO: make it only update what is necessary
+        {
+            CPU_PROFILE_SCOPE("record");
+            cmd.reterminate(vkdata);
+            cmd.reinitialise(vkdata); // @TODO: make it only update what is necessary
+        }
 
         /* frame submission */
         submit_command_buffers_graphics(vkdata, cmd.cmd_buffers());
+        // present can block on vsync, which isn't cpu work
+        double cpu_ms = (glfwGetTime() - frameStart) * 1000.0;
         present_frame(vkdata);
+        if (vkdata.capture != nullptr && capture.is_done()) {
+            std::cout << "wrote capture " << capture_path << ", " << capture.get_byte_size() << " bytes" << std::endl;
+            vkdata.capture = nullptr;
+        }
+        if (!frame_csv_path.empty()) {
+            double time = replay.frames.empty() ? frameStart - startTime : replayTime;
+            frame_times.push_back({time, cpu_ms});
+        }
+        frameIndex++;
+    }
+
+    if (!record_camera_path.empty()) {
+        try {
+            write_camera_path(record_camera_path, recording);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    if (!frame_csv_path.empty()) {
+        try {
+            write_frame_times_csv(frame_csv_path, frame_times);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
     }
 
     gmodel.terminate(vkdata);
     cmd.terminate(vkdata);
     pipeline.terminate(vkdata);
+    fxaa_compute.terminate(vkdata);
+    taa_compute.terminate(vkdata);
+    frame_timer.terminate(vkdata);
+    if (!gpu_trace_path.empty()) {
+        try {
+            profiler.write_chrome_trace(gpu_trace_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    profiler.terminate(vkdata);
+    if (!cpu_trace_path.empty()) {
+        try {
+            cpu_profile_write_chrome_trace(cpu_trace_path);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    if (cmd.depth_prepass) {
+        fallback_pipeline.terminate(vkdata);
+        depth_pipeline.terminate(vkdata);
+    }
     terminate_vulkan(vkdata);
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -0,0 +1,102 @@
+#include "src/platform.h"
+#include "model/gltf_document.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+/*
+ * compares the streaming glTF loader against tinygltf's LoadASCIIFromFile/LoadBinaryFromFile.
+ * peak memory is per process, so for a clean comparison run once with each --loader.
+ * without --loader the sax loader runs first so its peak is reported before tinygltf raises it.
+ */
+
+static bool load_image_data_as_is(tinygltf::Image* image, const int, std::string*, std::string*, int, int,
+                                  const unsigned char* bytes, int size, void*)
+{
+    image->as_is = true;
+    image->image.assign(bytes, bytes + size);
+    return true;
+}
+
+static bool load_sax(const std::string& path, size_t* node_count, std::string* err)
+{
+    gltf_document document;
+    std::string warn;
+    if (!load_gltf_document(path, &document, err, &warn)) {
+        return false;
+    }
+    *node_count = document.scene.nodes.size();
+    close_gltf_document(document);
+    return true;
+}
+
+static bool load_tinygltf(const std::string& path, size_t* node_count, std::string* err)
+{
+    tinygltf::TinyGLTF loader;
+    tinygltf::Model model;
+    std::string warn;
+    loader.SetImageLoader(load_image_data_as_is, nullptr);
+    bool ok = (path.size() > 4 && path.compare(path.size() - 4, 4, ".glb") == 0)
+            ? loader.LoadBinaryFromFile(&model, err, &warn, path)
+            : loader.LoadASCIIFromFile(&model, err, &warn, path);
+    if (!ok) {
+        return false;
+    }
+    // include flattening so both loaders end with the same scene table
+    *node_count = build_scene_table(model).nodes.size();
+    return true;
+}
+
+static bool run(const char* name, bool (*load)(const std::string&, size_t*, std::string*), const std::string& path, int iterations)
+{
+    double total_ms = 0.0, min_ms = 1e30;
+    size_t node_count = 0;
+    for (int i = 0; i < iterations; i++) {
+        std::string err;
+        auto start = std::chrono::steady_clock::now();
+        if (!load(path, &node_count, &err)) {
+            std::cout << name << " failed: " << err << std::endl;
+            return false;
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        total_ms += ms;
+        min_ms = std::min(min_ms, ms);
+    }
+    std::cout << name << ": " << node_count << " nodes, min " << min_ms << "ms, avg " << (total_ms / iterations)
+              << "ms, peak rss " << (get_peak_memory_usage() / (1024.0 * 1024.0)) << "MiB" << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::cout << "usage: discovery_gltf_bench <model.gltf/.glb> [--loader sax|tinygltf] [--iterations N]" << std::endl;
+        return 1;
+    }
+
+    std::string path = argv[1];
+    std::string loader = "";
+    int iterations = 5;
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "--loader") == 0 && i + 1 < argc) {
+            loader = argv[++i];
+        } else if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            iterations = std::max(1, std::atoi(argv[++i]));
+        } else {
+            std::cout << "unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "baseline rss " << (get_peak_memory_usage() / (1024.0 * 1024.0)) << "MiB" << std::endl;
+    bool ok = true;
+    if (loader.empty() || loader == "sax") {
+        ok = run("sax", load_sax, path, iterations) && ok;
+    }
+    if (loader.empty() || loader == "tinygltf") {
+        ok = run("tinygltf", load_tinygltf, path, iterations) && ok;
+    }
+    return ok ? 0 : 1;
+}
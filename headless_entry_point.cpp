@@ -0,0 +1,297 @@
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "src/vulkan/vulkan_base.h"
+#include "src/vulkan/vulkan_null.h"
+#include "src/basic_pipeline.h"
+#include "src/basic_command_buffer.h"
+#include "src/camera_path.h"
+#include "src/platform.h"
+#include "model/gltf_model.h"
+#include <include/stb_image_write.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+/*
+ * renders a fixed number of frames of a model without a window, e.g. on ci hosts with only a
+ * software icd. the camera orbits the model once over the run, or replays a camera path recorded
+ * by the viewer, so every run draws the same frames. the frame times are reported at the end and
+ * can be written out as csv, and frames can be written out as pngs. built with DISCOVERY_NULL_VULKAN
+ * nothing reaches a gpu, the frame times are the engine's cpu overhead alone and the vulkan calls
+ * per frame are reported too
+ */
+
+static void print_usage()
+{
+    std::cout << "usage: discovery_headless <model.gltf/.glb/.dbake> [--frames N] [--size WxH] [--msaa N] [--depth-prepass]"
+                 " [--output dir] [--output-every N] [--camera path] [--step seconds] [--csv path] [--capture path] [--capture-frame N]\n"
+                 "the model path is relative to the executable, like res/models/viking/scene.gltf.\n"
+                 "--camera replays a path recorded with discovery --record-camera, by default over its whole length"
+                 " at the size it was recorded at.\n"
+                 "--capture writes the vulkan calls of frame N (100 by default) for discovery_replay" << std::endl;
+}
+
+static double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t i = std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5));
+    return sorted[i];
+}
+
+static void print_times(const char* name, std::vector<double> times_ms)
+{
+    if (times_ms.empty()) {
+        std::cout << name << ": no samples" << std::endl;
+        return;
+    }
+    double total = 0.0;
+    for (double t : times_ms) {
+        total += t;
+    }
+    std::sort(times_ms.begin(), times_ms.end());
+    std::cout << name << ": avg " << (total / times_ms.size()) << "ms, p50 " << percentile(times_ms, 0.50)
+              << "ms, p95 " << percentile(times_ms, 0.95) << "ms, p99 " << percentile(times_ms, 0.99)
+              << "ms, max " << times_ms.back() << "ms over " << times_ms.size() << " frames" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+
+    std::string model_path = argv[1];
+    uint32_t frame_count = 300;
+    uint32_t width = 1280, height = 720;
+    auto msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+    bool depth_prepass = false;
+    std::string output_dir;
+    uint32_t output_every = 1;
+    std::string camera_file;
+    double step = 1.0 / 60.0;
+    std::string csv_path;
+    std::string capture_path;
+    uint64_t capture_frame = 100;
+    bool has_frames = false, has_size = false;
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frame_count = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+            has_frames = true;
+        } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+                print_usage();
+                return 1;
+            }
+            has_size = true;
+        } else if (std::strcmp(argv[i], "--msaa") == 0 && i + 1 < argc) {
+            msaa_samples = static_cast<VkSampleCountFlagBits>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--depth-prepass") == 0) {
+            depth_prepass = true;
+        } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--output-every") == 0 && i + 1 < argc) {
+            output_every = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--camera") == 0 && i + 1 < argc) {
+            camera_file = argv[++i];
+        } else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            step = std::max(1e-4, std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--capture-frame") == 0 && i + 1 < argc) {
+            capture_frame = static_cast<uint64_t>(std::max(1, std::atoi(argv[++i])));
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    camera_path replay;
+    if (!camera_file.empty()) {
+        try {
+            replay = read_camera_path(camera_file);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!has_frames) {
+            frame_count = static_cast<uint32_t>(get_camera_path_duration(replay) / step) + 1;
+        }
+        if (!has_size && replay.width != 0 && replay.height != 0) {
+            width = replay.width;
+            height = replay.height;
+        }
+    }
+
+    // the capture is written out once the frame after it is presented
+    if (!capture_path.empty() && frame_count <= capture_frame) {
+        frame_count = static_cast<uint32_t>(capture_frame + 1);
+    }
+
+    vulkan_data vkdata;
+    vulkan_capture capture;
+    try {
+        if (!capture_path.empty()) {
+            capture.initialise(capture_path, capture_frame);
+            vkdata.capture = &capture;
+        }
+        initialise_vulkan_headless(&vkdata, width, height);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    vkdata.msaa_samples = clamp_msaa_samples(vkdata, msaa_samples);
+
+    gltf_model gmodel;
+    gmodel.initialise(model_path);
+    if (!gmodel.is_valid()) {
+        std::cerr << "failed to open " << model_path << std::endl;
+        terminate_vulkan(vkdata);
+        return EXIT_FAILURE;
+    }
+
+    triangle_cmd cmd;
+    cmd.depth_prepass = depth_prepass;
+    cmd.add_passes(vkdata, *vkdata.graph);
+    vkdata.graph->compile(vkdata);
+
+    /* pipelines compile on the registry's workers while the model loads, the first frame waits for any still compiling */
+    basic_pipeline pipeline;
+    pipeline.after_depth_prepass = cmd.depth_prepass;
+    pipeline.compile_async = true;
+
+    // after a pre-pass the forward pipeline only shades fragments at the pre-pass depth, until it is
+    // ready primitives are drawn with the plain depth tested pipeline, which passes there too
+    basic_pipeline fallback_pipeline;
+    if (cmd.depth_prepass) {
+        fallback_pipeline.compile_async = true;
+        fallback_pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.forward_pass));
+        pipeline.fallback = &fallback_pipeline;
+        cmd.fallback_pipeline = &fallback_pipeline;
+    }
+    pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.forward_pass));
+
+    depth_prepass_pipeline depth_pipeline;
+    depth_pipeline.compile_async = true;
+    if (cmd.depth_prepass) {
+        depth_pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.depth_prepass_pass));
+        cmd.depth_pipeline = &depth_pipeline;
+    }
+
+    gpu_frame_timer frame_timer;
+    frame_timer.initialise(vkdata);
+    cmd.frame_timer = &frame_timer;
+
+    gmodel.load_model(vkdata);
+    pipeline.warm_up(vkdata, gmodel);
+    std::cout << "loaded " << model_path << " in " << gmodel.load_stats().total_ms << "ms" << std::endl;
+
+    cmd.model = &gmodel;
+    cmd.pipeline = &pipeline;
+    cmd.initialise(vkdata);
+
+    /* one orbit around the model, framed like the viewer frames it on startup */
+    auto bounds = gmodel.get_model_bounds();
+    camera_state orbit;
+    orbit.zoom = -1.0 * (double)std::max({bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z});
+    orbit.rotation.y = -0.3f;
+
+    std::vector<double> cpu_times_ms, gpu_times_ms;
+    std::vector<replay_frame_time> frame_times;
+    std::vector<uint8_t> pixels;
+    null_vulkan_reset_calls();
+    for (uint32_t frame = 0; frame < frame_count; frame++) {
+        auto frame_start = std::chrono::steady_clock::now();
+
+        // a fixed step keeps runs identical, as if at 60fps by default
+        double time = static_cast<double>(frame) * step;
+        camera_state camera = orbit;
+        if (replay.frames.empty()) {
+            camera.rotation.x = glm::two_pi<float>() * static_cast<float>(frame) / static_cast<float>(frame_count);
+        } else {
+            camera = sample_camera_path(replay, time);
+        }
+        glm::mat4 v = get_camera_view(camera);
+        cmd.frame_ubo.proj = get_camera_projection(camera, (double)width / (double)height);
+        cmd.frame_ubo.view = v;
+        cmd.frame_ubo.cameraPos = glm::vec4(v[3].x, v[3].y, v[3].z, 1.0) * v;
+        cmd.frame_ubo.currTime = static_cast<float>(time);
+
+        if (frame_timer.update(vkdata)) {
+            gpu_times_ms.push_back(frame_timer.get_last_time_ms());
+            // of a frame that has already finished
+            uint64_t frames_ago = vkdata.frame_number - frame_timer.get_last_frame();
+            if (frame >= frames_ago) {
+                frame_times[frame - frames_ago].gpu_ms = frame_timer.get_last_time_ms();
+            }
+        }
+
+        cmd.reterminate(vkdata);
+        cmd.reinitialise(vkdata);
+        submit_command_buffers_graphics(vkdata, cmd.cmd_buffers());
+
+        // read back outside the timed part of the frame, it waits for the gpu to go idle
+        double cpu_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+        if (!output_dir.empty() && frame % output_every == 0) {
+            read_headless_frame(vkdata, pixels);
+            char name[32];
+            std::snprintf(name, sizeof(name), "/frame_%05u.png", frame);
+            if (stbi_write_png((output_dir + name).c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels.data(), static_cast<int>(width * 4)) == 0) {
+                std::cerr << "failed to write " << output_dir << name << std::endl;
+            }
+        }
+        auto present_start = std::chrono::steady_clock::now();
+        present_frame(vkdata);
+        cpu_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - present_start).count();
+        cpu_times_ms.push_back(cpu_ms);
+        frame_times.push_back({time, cpu_ms});
+        if (vkdata.capture != nullptr && capture.is_done()) {
+            std::cout << "wrote capture " << capture_path << ", " << capture.get_byte_size() << " bytes" << std::endl;
+            vkdata.capture = nullptr;
+        }
+    }
+    auto frame_calls = null_vulkan_get_calls();
+    vkDeviceWaitIdle(vkdata.logical_device);
+
+    if (!csv_path.empty()) {
+        try {
+            write_frame_times_csv(csv_path, frame_times);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    print_times("cpu frame", cpu_times_ms);
+    if (frame_timer.is_supported()) {
+        print_times("gpu frame", gpu_times_ms);
+    } else {
+        std::cout << "gpu frame: the graphics queue has no timestamps" << std::endl;
+    }
+    if (null_vulkan_enabled()) {
+        std::cout << "null vulkan, nothing was rendered. calls per frame:" << std::endl;
+        for (auto& call : frame_calls) {
+            std::cout << "  " << call.name << ": " << static_cast<double>(call.calls) / frame_count << std::endl;
+        }
+    }
+
+    gmodel.terminate(vkdata);
+    cmd.terminate(vkdata);
+    pipeline.terminate(vkdata);
+    frame_timer.terminate(vkdata);
+    if (cmd.depth_prepass) {
+        fallback_pipeline.terminate(vkdata);
+        depth_pipeline.terminate(vkdata);
+    }
+    terminate_vulkan(vkdata);
+    return 0;
+}
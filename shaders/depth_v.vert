@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 inPosition;
+
+layout(set = 0, binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+    vec3 cameraPos;
+    float currTime;
+} ubo;
+
+layout(set = 1, binding = 0) uniform ModelData {
+    mat4 transform;
+} model;
+
+// must match vertex_v.vert bit for bit
+invariant gl_Position;
+
+void main() {
+    gl_Position = (ubo.proj * ubo.view * model.transform) * vec4(inPosition, 1.0);
+}
@@ -6,6 +6,8 @@ struct VS_OUT {
     vec2 texCoord;
     mat3 TBN;
     float currTime;
+    vec4 currClip;      // unjittered, for motion vectors
+    vec4 prevClip;
 };
 layout(location = 0) in VS_OUT fs_in;
 
@@ -13,6 +15,14 @@ layout(set = 2, binding = 0) uniform sampler2D colorTex;
 layout(set = 3, binding = 0) uniform sampler2D normTex;
 
 layout(location = 0) out vec4 outColor;
+// uv offset to where this surface was last frame, dropped unless the pass has a motion attachment
+layout(location = 1) out vec2 outMotion;
+
+// material permutation, set per pipeline through specialization constants (see basic_pipeline::permutation)
+layout(constant_id = 0) const bool HAS_NORMAL_MAP = true;
+layout(constant_id = 1) const bool HAS_VERTEX_COLOR = false;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+layout(constant_id = 3) const float ALPHA_CUTOFF = 0.5;
 
 void main() {
     vec3 lightColor = vec3(1.0);
@@ -20,16 +30,32 @@ void main() {
 
     float ambientStrength = 0.0;
 
-    vec3 normal = texture(normTex, fs_in.texCoord).rgb;
-    normal = (2.0 * normal) - 1.0;
-
-    normal = normalize(fs_in.TBN * normal);
+    outColor = texture(colorTex, fs_in.texCoord);
+    if (ALPHA_TEST && outColor.a < ALPHA_CUTOFF) {
+        discard;
+    }
+    if (HAS_VERTEX_COLOR) {
+        outColor.rgb *= fs_in.color;
+    }
+
+    vec3 normal;
+    if (HAS_NORMAL_MAP) {
+        // only rg is used so BC5 compressed normal maps work, z is reconstructed
+        normal.xy = (2.0 * texture(normTex, fs_in.texCoord).rg) - 1.0;
+        normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
+        normal = normalize(fs_in.TBN * normal);
+    } else {
+        normal = normalize(fs_in.TBN[2]);
+    }
 
     vec3 diffuse = max(dot(normal, lightDir), ambientStrength) * lightColor;
 
     vec3 lightResult = diffuse;
-    outColor = texture(colorTex, fs_in.texCoord);
     outColor = vec4(lightResult, 1.0) * outColor;
+
+    vec2 currNdc = fs_in.currClip.xy / fs_in.currClip.w;
+    vec2 prevNdc = fs_in.prevClip.xy / fs_in.prevClip.w;
+    outMotion = (prevNdc - currNdc) * 0.5;
     // outColor = mix(vec4(fs_in.TBN[0].xyz, 1.0), vec4(fs_in.TBN[1].xyz, 1.0), 0.5);
     // outColor = vec4(normalize(texture(normTex, fs_in.texCoord).rgb), 1.0);
 }
@@ -12,18 +12,26 @@ struct VS_OUT {
     vec2 texCoord;
     mat3 TBN;
     float currTime;
+    vec4 currClip;      // unjittered, for motion vectors
+    vec4 prevClip;
 };
 layout(location = 0) out VS_OUT vs_out;
 
+// must match depth_v.vert bit for bit, the depth pre-pass is tested with EQUAL
+invariant gl_Position;
+
 layout(set = 0, binding = 0) uniform UniformBufferObject {
     mat4 view;
     mat4 proj;
     vec3 cameraPos;
     float currTime;
+    mat4 prevViewProj;
+    vec2 jitter;
 } ubo;
 
 layout(set = 1, binding = 0) uniform ModelData {
     mat4 transform;
+    mat4 prevTransform;
 } model;
 
 void main() {
@@ -39,4 +47,9 @@ void main() {
     vs_out.TBN = mat3(T, B, N);
 
     vs_out.currTime = ubo.currTime;
+
+    // proj is offset by the jitter, taking it back out keeps still surfaces at zero motion
+    vs_out.currClip = gl_Position;
+    vs_out.currClip.xy -= ubo.jitter * gl_Position.w;
+    vs_out.prevClip = (ubo.prevViewProj * model.prevTransform) * vec4(inPosition, 1.0);
 }
@@ -1,9 +1,12 @@
 #include "basic_command_buffer.h"
+#include "cpu_profiler.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
 #include <array>
+#include <cmath>
 
 VkCommandBufferLevel triangle_cmd::get_buffer_level() const {
     return VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -22,10 +25,97 @@ void triangle_cmd::virtual_terminate(vulkan_data& vkdata)
     for (auto& buf : this->sampler_buffers) {
         buf.terminate(vkdata);
     }
+    for (auto& retired : this->retired_samplers) {
+        retired.buffer.terminate(vkdata);
+    }
+    this->retired_samplers.clear();
+    this->terminate_post_descriptors(vkdata);
+}
+
+bool is_outside_frustum(const glm::mat4& model_view_proj, const bounds& b)
+{
+    if (b.min.x > b.max.x || b.min.y > b.max.y || b.min.z > b.max.z) {
+        return false;
+    }
+    std::array<int, 6> outside{};
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner((i & 1) ? b.max.x : b.min.x, (i & 2) ? b.max.y : b.min.y, (i & 4) ? b.max.z : b.min.z);
+        glm::vec4 clip = model_view_proj * glm::vec4(corner, 1.0f);
+        outside[0] += (clip.x < -clip.w);
+        outside[1] += (clip.x > clip.w);
+        outside[2] += (clip.y < -clip.w);
+        outside[3] += (clip.y > clip.w);
+        outside[4] += (clip.z < -clip.w);  // conservative for both depth conventions
+        outside[5] += (clip.z > clip.w);
+    }
+    for (int count : outside) {
+        if (count == 8) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// radical inverse of index in base, low discrepancy sub pixel offsets for taa
+static float halton(uint32_t index, uint32_t base)
+{
+    float result = 0.0f;
+    float fraction = 1.0f;
+    while (index > 0) {
+        fraction /= static_cast<float>(base);
+        result += fraction * static_cast<float>(index % base);
+        index /= base;
+    }
+    return result;
+}
+
+// how much uv space one pixel covers at the nearest point of the primitive's bounding sphere
+static float get_uv_per_pixel(const glm::mat4& model_view, const glm::mat4& proj, const bounds& b, float uv_density, float viewport_height)
+{
+    glm::vec3 center = (b.min + b.max) * 0.5f;
+    float radius = glm::length(b.max - b.min) * 0.5f;
+    float scale = std::max({glm::length(glm::vec3(model_view[0])), glm::length(glm::vec3(model_view[1])), glm::length(glm::vec3(model_view[2]))});
+
+    glm::vec3 view_center = glm::vec3(model_view * glm::vec4(center, 1.0f));
+    float distance = std::max(glm::length(view_center) - radius * scale, 1e-3f);
+    float pixels_per_unit = viewport_height * 0.5f * std::abs(proj[1][1]) / distance;
+
+    // without a measured density assume the texture is stretched once across the bounds
+    float units_per_uv = ((uv_density > 0.0f) ? uv_density : 2.0f * radius) * scale;
+    return 1.0f / std::max(units_per_uv * pixels_per_unit, 1e-6f);
+}
+
+int triangle_cmd::get_sampler_index(vulkan_data& vkdata, int image_index, size_t set)
+{
+    uint32_t generation;
+    const auto& image = this->model->get_image(image_index, &generation);
+
+    int sampler;
+    auto it = this->sampler_tex_map.find(image_index);
+    if (it == this->sampler_tex_map.end()) {
+        // tex does not yet exist as descriptor, create it
+        sampler = static_cast<int>(this->sampler_buffers.size());
+        this->sampler_tex_map.emplace(image_index, sampler_slot{sampler, generation});
+        this->sampler_buffers.push_back({});
+    } else if (it->second.generation != generation) {
+        // streaming swapped the image, frames in flight may still use the old view
+        sampler = it->second.sampler;
+        this->retired_samplers.push_back({this->sampler_buffers[sampler], vkdata.frame_number});
+        this->sampler_buffers[sampler] = {};
+        it->second.generation = generation;
+    } else {
+        return it->second.sampler;
+    }
+
+    this->sampler_buffers[sampler].image_view().initialise(vkdata, image);
+    this->sampler_buffers[sampler].sampler().initialise(vkdata);
+    this->sampler_buffers[sampler].initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(set));
+    return sampler;
 }
 
 void triangle_cmd::fill_command_buffer(vulkan_data& vkdata, size_t index)
 {
+    CPU_PROFILE_SCOPE("fill_command_buffer");
     // ready model uniform buffers for this frame
     if (index == this->m_uniform_buffers.size()) {
         this->m_uniform_buffers.emplace_back();
@@ -38,7 +128,32 @@ void triangle_cmd::fill_command_buffer(vulkan_data& vkdata, size_t index)
         this->m_uniform_buffers.resize(index+1);
     }
 
-    // fill vp uniform buffers
+    this->advance_frame_history(vkdata);
+
+    // the scene's passes draw to the scaled render area, the rest of their targets is left alone
+    this->render_extent = vkdata.swap_chain_data.extent;
+    if (this->dynamic_resolution || this->use_taa) {
+        float scale = std::clamp(this->render_scale, 0.0f, 1.0f);
+        this->render_extent.width = std::max(1u, static_cast<uint32_t>(this->render_extent.width * scale));
+        this->render_extent.height = std::max(1u, static_cast<uint32_t>(this->render_extent.height * scale));
+    }
+    vkdata.graph->set_render_area(this->forward_pass, this->render_extent);
+    if (this->depth_prepass) {
+        vkdata.graph->set_render_area(this->depth_prepass_pass, this->render_extent);
+    }
+
+    // taa draws every frame offset by a different fraction of a pixel. the further the scene is
+    // scaled down the more offsets it takes for every output pixel to get samples near it
+    this->jitter = glm::vec2(0.0f);
+    if (this->use_taa) {
+        float scale = static_cast<float>(this->render_extent.width) / static_cast<float>(vkdata.swap_chain_data.extent.width);
+        uint32_t phases = std::clamp(static_cast<uint32_t>(std::ceil(8.0f / (scale * scale))), 8u, 64u);
+        uint32_t i = (this->jitter_index % phases) + 1;
+        this->jitter = glm::vec2(halton(i, 2) - 0.5f, halton(i, 3) - 0.5f);
+    }
+    glm::vec2 jitter_ndc = 2.0f * this->jitter / glm::vec2(this->render_extent.width, this->render_extent.height);
+
+    // fill vp uniform buffers, culling keeps using the unjittered frame_ubo
     if (index == this->vp_uniform_buffers.size()) {
         this->vp_uniform_buffers.emplace_back();
         this->vp_uniform_buffers[index].initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(0));
@@ -46,9 +161,24 @@ void triangle_cmd::fill_command_buffer(vulkan_data& vkdata, size_t index)
         throw std::runtime_error("...");
     }
 
-    this->vp_uniform_buffers[index].data() = this->frame_ubo;
+    auto& vp = this->vp_uniform_buffers[index].data();
+    vp = this->frame_ubo;
+    vp.proj = glm::translate(glm::mat4(1.0f), glm::vec3(jitter_ndc, 0.0f)) * this->frame_ubo.proj;
+    vp.prevViewProj = this->prev_view_proj;
+    vp.jitter = jitter_ndc;
     this->vp_uniform_buffers[index].update_buffer(vkdata);
 
+    // release sampler buffers no frame in flight can still use
+    for (size_t i = 0; i < this->retired_samplers.size();) {
+        if (vkdata.frame_number >= this->retired_samplers[i].frame + MAX_FRAMES_IN_FLIGHT + 1) {
+            this->retired_samplers[i].buffer.terminate(vkdata);
+            this->retired_samplers[i] = this->retired_samplers.back();
+            this->retired_samplers.pop_back();
+        } else {
+            i++;
+        }
+    }
+
     // fill color buffers
     if (this->sampler_buffers.empty()) {
         this->sampler_buffers.push_back({}); // fill in default texs
@@ -62,131 +192,544 @@ void triangle_cmd::fill_command_buffer(vulkan_data& vkdata, size_t index)
         this->sampler_buffers.back().initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(3));
     }
 
-    // fill command buffer
-    std::array<VkClearValue, 2> clearValues{};
-    clearValues[0].color = {0.11f, 0.12f, 0.15f, 1.0f};
-    clearValues[1].depthStencil = {1.0f, 0};
+    this->update_post_descriptors(vkdata);
+    if (this->use_taa) {
+        auto& params = this->taa_params.data();
+        params.jitter = this->jitter;
+        params.renderSize = glm::vec2(this->render_extent.width, this->render_extent.height);
+        params.historyValid = (this->has_prev_frame && vkdata.graph->has_history(vkdata)) ? 1.0f : 0.0f;
+        this->taa_params.update_buffer(vkdata);
+    }
+
+    // gather what is visible, then the graph begins each pass and calls back to record it
+    this->draws.clear();
+    {
+        // timed here rather than per node, a scope per recursive call would flood the ring
+        CPU_PROFILE_SCOPE("rec_fill_command_buffer_model");
+        for (auto n : this->model->scene().roots) {
+            this->rec_fill_command_buffer_model(vkdata, index, n, glm::mat4(1.0f));
+        }
+    }
+    if (this->frame_timer != nullptr) {
+        this->frame_timer->begin(vkdata, cmd_buffer());
+    }
+    uint32_t frame_region = UINT32_MAX;
+    if (this->profiler != nullptr) {
+        this->profiler->begin_frame(vkdata, cmd_buffer());
+        frame_region = this->profiler->begin_region(vkdata, cmd_buffer(), "frame");
+    }
+    vkdata.graph->execute(vkdata, cmd_buffer(), static_cast<uint32_t>(index), this->profiler);
+    if (this->profiler != nullptr) {
+        this->profiler->end_region(vkdata, cmd_buffer(), frame_region);
+    }
+    if (this->frame_timer != nullptr) {
+        this->frame_timer->end(vkdata, cmd_buffer());
+    }
+}
 
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = vkdata.render_pass;
-    renderPassInfo.framebuffer = frame_buffer(vkdata);
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = vkdata.swap_chain_data.extent;
-    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-    renderPassInfo.pClearValues = clearValues.data();
+// the pipelines take viewport and scissor as dynamic state
+static void set_viewport(vulkan_data& vkdata, VkCommandBuffer cmd, VkExtent2D extent)
+{
+    VkViewport viewport = {};
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    CAPTURED(vkdata.capture, vkCmdSetViewport, cmd, 0, 1, &viewport);
 
-    vkCmdBeginRenderPass(cmd_buffer(), &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkRect2D scissor = {};
+    scissor.extent = extent;
+    CAPTURED(vkdata.capture, vkCmdSetScissor, cmd, 0, 1, &scissor);
+}
 
-    int scene_to_load = this->model->model().defaultScene;
-    for (auto n : this->model->model().scenes[scene_to_load].nodes) {
-        this->rec_fill_command_buffer_model(vkdata, index, this->model->model().nodes[n], glm::mat4(1.0f));
+// once per frame, every swapchain image's command buffer is recorded with the same history
+void triangle_cmd::advance_frame_history(vulkan_data& vkdata)
+{
+    if (this->history_frame == vkdata.frame_number) {
+        return;
     }
+    this->has_prev_frame = (this->history_frame != UINT64_MAX);
+    this->history_frame = vkdata.frame_number;
+    this->jitter_index++;
 
-    vkCmdEndRenderPass(cmd_buffer());
+    // without a last frame nothing has moved
+    glm::mat4 view_proj = this->frame_ubo.proj * this->frame_ubo.view;
+    this->prev_view_proj = this->has_prev_frame ? this->view_proj : view_proj;
+    this->view_proj = view_proj;
+    std::swap(this->node_transforms, this->prev_node_transforms);
+    this->node_transforms.assign(this->model->scene().nodes.size(), glm::mat4(1.0f));
 }
 
-void triangle_cmd::rec_fill_command_buffer_model(vulkan_data &vkdata, const size_t &index, const tinygltf::Node &current_node, glm::mat4 transform) {
-    // modify to combine this nodes transform with parent's transform
-    glm::mat4 this_transform = glm::mat4(1.0f);
-    if (!current_node.matrix.empty()) {
-        this_transform = glm::make_mat4x4(current_node.matrix.data());
-    } else {
-        if (!current_node.translation.empty()) {
-            this_transform = glm::translate(this_transform, glm::vec3(glm::make_vec3(current_node.translation.data())));
+void triangle_cmd::add_passes(vulkan_data& vkdata, render_graph& graph)
+{
+    if ((this->use_fxaa || this->use_taa) && vkdata.msaa_samples != VK_SAMPLE_COUNT_1_BIT) {
+        throw std::logic_error("fxaa and taa work on a single sampled scene, msaa_samples has to be 1!");
+    }
+    if (this->use_fxaa && this->use_taa) {
+        throw std::logic_error("taa already anti-aliases, it can't be combined with fxaa!");
+    }
+    bool resolve = vkdata.msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+    // the single sampled scene, drawn or resolved into. straight into the backbuffer unless something follows
+    render_graph_resource scene = graph.get_backbuffer();
+    if (this->dynamic_resolution || this->use_fxaa || this->use_taa) {
+        render_graph_image_desc scene_desc;
+        scene_desc.format = vkdata.swap_chain_data.image_format;
+        scene = graph.create_image("scene_color", scene_desc);
+    }
+    render_graph_resource color = scene;
+    if (resolve) {
+        render_graph_image_desc color_desc;
+        color_desc.format = vkdata.swap_chain_data.image_format;
+        color_desc.samples = vkdata.msaa_samples;
+        color = graph.create_image("scene_color_msaa", color_desc);
+    }
+
+    render_graph_image_desc depth_desc;
+    depth_desc.format = find_depth_format(vkdata);
+    depth_desc.samples = vkdata.msaa_samples;
+    auto depth = graph.create_image("scene_depth", depth_desc);
+
+    VkClearValue clear_color = {};
+    clear_color.color = {0.11f, 0.12f, 0.15f, 1.0f};
+    VkClearValue clear_depth = {};
+    clear_depth.depthStencil = {1.0f, 0};
+
+    if (this->depth_prepass) {
+        this->depth_prepass_pass = graph.add_pass("depth_prepass", render_graph_pass_type::GRAPHICS,
+                                                  [this](vulkan_data& data, const render_graph_context& context) {
+            this->record_depth_prepass(data, context);
+        });
+        graph.write(this->depth_prepass_pass, depth, render_graph_usage::DEPTH_ATTACHMENT);
+        graph.clear(this->depth_prepass_pass, depth, clear_depth);
+    }
+
+    this->forward_pass = graph.add_pass("forward", render_graph_pass_type::GRAPHICS,
+                                        [this](vulkan_data& data, const render_graph_context& context) {
+        this->record_forward_pass(data, context);
+    });
+
+    graph.write(this->forward_pass, color, render_graph_usage::COLOR_ATTACHMENT);
+    graph.clear(this->forward_pass, color, clear_color);
+    render_graph_resource motion = UINT32_MAX;
+    if (this->use_taa) {
+        // the second color attachment, cleared to no motion where nothing is drawn
+        render_graph_image_desc motion_desc;
+        motion_desc.format = VK_FORMAT_R16G16_SFLOAT;
+        motion = graph.create_image("motion_vectors", motion_desc);
+        graph.write(this->forward_pass, motion, render_graph_usage::COLOR_ATTACHMENT);
+        graph.clear(this->forward_pass, motion, VkClearValue{});
+    }
+    // still written after a pre-pass, alpha tested primitives aren't in it
+    graph.write(this->forward_pass, depth, render_graph_usage::DEPTH_ATTACHMENT);
+    if (!this->depth_prepass) {
+        graph.clear(this->forward_pass, depth, clear_depth);
+    }
+    if (resolve) {
+        graph.write(this->forward_pass, scene, render_graph_usage::RESOLVE_ATTACHMENT);
+    }
+
+    if (this->use_taa) {
+        // upscales and anti-aliases at once, the output is kept as next frame's history
+        render_graph_image_desc taa_desc;
+        taa_desc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        this->taa_scene = scene;
+        this->taa_motion = motion;
+        this->taa_output = graph.create_image("taa_output", taa_desc);
+        taa_desc.persistent = true;
+        this->taa_history = graph.create_image("taa_history", taa_desc);
+
+        auto taa_pass = graph.add_pass("taa", render_graph_pass_type::COMPUTE,
+                                       [this](vulkan_data& data, const render_graph_context& context) {
+            this->record_taa_pass(data, context);
+        });
+        graph.read(taa_pass, scene, render_graph_usage::SAMPLED);
+        graph.read(taa_pass, motion, render_graph_usage::SAMPLED);
+        graph.read(taa_pass, this->taa_history, render_graph_usage::SAMPLED);
+        graph.write(taa_pass, this->taa_output, render_graph_usage::STORAGE_WRITE);
+
+        auto resolve_pass = graph.add_pass("taa_resolve", render_graph_pass_type::TRANSFER,
+                                           [this](vulkan_data& data, const render_graph_context& context) {
+            this->record_taa_resolve(data, context);
+        });
+        graph.read(resolve_pass, this->taa_output, render_graph_usage::TRANSFER_SRC);
+        graph.write(resolve_pass, this->taa_history, render_graph_usage::TRANSFER_DST);
+        graph.write(resolve_pass, graph.get_backbuffer(), render_graph_usage::TRANSFER_DST);
+        return;
+    }
+
+    // full resolution from here on
+    render_graph_resource output = scene;
+    if (this->dynamic_resolution) {
+        render_graph_resource upscaled = graph.get_backbuffer();
+        if (this->use_fxaa) {
+            render_graph_image_desc upscaled_desc;
+            upscaled_desc.format = vkdata.swap_chain_data.image_format;
+            upscaled = graph.create_image("upscaled_color", upscaled_desc);
         }
-        if (!current_node.rotation.empty()) {
-            glm::quat q = glm::make_quat(current_node.rotation.data());
-            this_transform = this_transform * glm::mat4(q);
+        this->upscale_source = scene;
+        this->upscale_target = upscaled;
+
+        auto upscale_pass = graph.add_pass("upscale", render_graph_pass_type::TRANSFER,
+                                           [this](vulkan_data& data, const render_graph_context& context) {
+            this->record_upscale(data, context);
+        });
+        graph.read(upscale_pass, scene, render_graph_usage::TRANSFER_SRC);
+        graph.write(upscale_pass, upscaled, render_graph_usage::TRANSFER_DST);
+        output = upscaled;
+    }
+
+    if (this->use_fxaa) {
+        // rgba16f storage is always supported unlike storage on the swapchain images, so it is blitted
+        // over. the result is still linear and 8 bits would band before the blit encodes it
+        render_graph_image_desc aa_desc;
+        aa_desc.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        this->fxaa_source = output;
+        this->fxaa_target = graph.create_image("aa_color", aa_desc);
+
+        auto fxaa_pass = graph.add_pass("fxaa", render_graph_pass_type::COMPUTE,
+                                        [this](vulkan_data& data, const render_graph_context& context) {
+            this->record_fxaa_pass(data, context);
+        });
+        graph.read(fxaa_pass, this->fxaa_source, render_graph_usage::SAMPLED);
+        graph.write(fxaa_pass, this->fxaa_target, render_graph_usage::STORAGE_WRITE);
+
+        auto blit_pass = graph.add_pass("present_blit", render_graph_pass_type::TRANSFER,
+                                        [this](vulkan_data& data, const render_graph_context& context) {
+            this->record_present_blit(data, context);
+        });
+        graph.read(blit_pass, this->fxaa_target, render_graph_usage::TRANSFER_SRC);
+        graph.write(blit_pass, graph.get_backbuffer(), render_graph_usage::TRANSFER_DST);
+    }
+}
+
+void triangle_cmd::rebuild_passes(vulkan_data& vkdata)
+{
+    vkDeviceWaitIdle(vkdata.logical_device);
+
+    this->pipeline->reterminate(vkdata);
+    if (this->fallback_pipeline != nullptr) {
+        this->fallback_pipeline->reterminate(vkdata);
+    }
+    if (this->depth_pipeline != nullptr) {
+        this->depth_pipeline->reterminate(vkdata);
+    }
+    for (VkRenderPass render_pass : vkdata.graph->get_render_passes()) {
+        vkdata.pipelines->release_render_pass(vkdata, render_pass);
+    }
+    this->terminate_post_descriptors(vkdata);
+    vkdata.graph->terminate(vkdata);
+
+    this->add_passes(vkdata, *vkdata.graph);
+    vkdata.graph->compile(vkdata);
+
+    // sample counts and depth state come from vkdata and the flags when the pipelines are described
+    this->pipeline->after_depth_prepass = this->depth_prepass;
+    this->pipeline->motion_vectors = this->use_taa;
+    if (this->fallback_pipeline != nullptr) {
+        this->fallback_pipeline->motion_vectors = this->use_taa;
+        this->fallback_pipeline->reinitialise(vkdata, vkdata.graph->get_render_pass(this->forward_pass));
+    }
+    this->pipeline->reinitialise(vkdata, vkdata.graph->get_render_pass(this->forward_pass));
+    if (this->depth_prepass) {
+        if (this->depth_pipeline == nullptr) {
+            throw std::logic_error("depth pre-pass enabled without a depth pipeline!");
         }
-        if (!current_node.scale.empty()) {
-            this_transform = glm::scale(this_transform, glm::vec3(glm::make_vec3(current_node.scale.data())));
+        this->depth_pipeline->reinitialise(vkdata, vkdata.graph->get_render_pass(this->depth_prepass_pass));
+    }
+}
+
+void triangle_cmd::record_depth_prepass(vulkan_data& vkdata, const render_graph_context& context)
+{
+    if (this->depth_pipeline == nullptr) {
+        throw std::logic_error("depth pre-pass recorded without a depth pipeline!");
+    }
+    VkPipeline vk_pipeline = this->depth_pipeline->get_pipeline(vkdata);
+    CAPTURED(vkdata.capture, vkCmdBindPipeline, context.cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
+    set_viewport(vkdata, context.cmd, context.extent);
+
+    size_t index = context.image_index;
+    for (auto& draw : this->draws) {
+        // discarded fragments can't be known from positions alone
+        if (draw.primitive->alpha_cutoff >= 0.0f) {
+            continue;
         }
+
+        std::array<VkDescriptorSet, 2> descriptor_sets = {
+            this->vp_uniform_buffers[index].get_descriptor_set(index),
+            this->m_uniform_buffers[index][draw.m_buffer].get_descriptor_set(index)
+        };
+        CAPTURED(vkdata.capture, vkCmdBindDescriptorSets, context.cmd,
+                 VK_PIPELINE_BIND_POINT_GRAPHICS,
+                 this->depth_pipeline->get_pipeline_layout(),
+                 0, static_cast<uint32_t>(descriptor_sets.size()),
+                 descriptor_sets.data(),
+                 0, nullptr);
+        this->record_draw(vkdata, *draw.primitive);
     }
-    transform = transform * this_transform;
+}
+
+void triangle_cmd::record_forward_pass(vulkan_data& vkdata, const render_graph_context& context)
+{
+    set_viewport(vkdata, context.cmd, context.extent);
+    for (auto& draw : this->draws) {
+        this->record_primitive(vkdata, context.image_index, draw);
+    }
+}
+
+void triangle_cmd::add_post_input(vulkan_data& vkdata, render_graph_resource resource, VkDescriptorSetLayout layout)
+{
+    auto& input = this->post_inputs.emplace_back();
+    input.set_image_view(vkdata.graph->get_image_view(resource));
+    input.sampler().initialise(vkdata, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    input.initialise(vkdata, 0, layout);
+}
+
+void triangle_cmd::add_post_output(vulkan_data& vkdata, render_graph_resource resource, VkDescriptorSetLayout layout)
+{
+    auto& output = this->post_outputs.emplace_back();
+    output.set_image_view(vkdata.graph->get_image_view(resource));
+    output.initialise(vkdata, 0, layout);
+}
+
+void triangle_cmd::update_post_descriptors(vulkan_data& vkdata)
+{
+    if ((!this->use_fxaa && !this->use_taa) || this->post_generation == vkdata.graph->get_generation()) {
+        return;
+    }
+    if (this->use_fxaa && this->fxaa == nullptr) {
+        throw std::logic_error("fxaa enabled without an fxaa pipeline!");
+    }
+    if (this->use_taa && this->taa == nullptr) {
+        throw std::logic_error("taa enabled without a taa pipeline!");
+    }
+
+    // a new generation means the graph was recompiled after the device went idle, nothing uses the old images
+    this->terminate_post_descriptors(vkdata);
+    if (this->use_fxaa) {
+        this->add_post_input(vkdata, this->fxaa_source, this->fxaa->get_descriptor_set_layout(0));
+        this->add_post_output(vkdata, this->fxaa_target, this->fxaa->get_descriptor_set_layout(1));
+    }
+    if (this->use_taa) {
+        this->taa_params.initialise(vkdata, 0, this->taa->get_descriptor_set_layout(0));
+        this->taa_params_ready = true;
+        this->add_post_input(vkdata, this->taa_scene, this->taa->get_descriptor_set_layout(1));
+        this->add_post_input(vkdata, this->taa_motion, this->taa->get_descriptor_set_layout(2));
+        this->add_post_input(vkdata, this->taa_history, this->taa->get_descriptor_set_layout(3));
+        this->add_post_output(vkdata, this->taa_output, this->taa->get_descriptor_set_layout(4));
+    }
+    this->post_generation = vkdata.graph->get_generation();
+}
+
+void triangle_cmd::terminate_post_descriptors(vulkan_data& vkdata)
+{
+    if (this->post_generation == UINT32_MAX) {
+        return;
+    }
+    for (auto& input : this->post_inputs) {
+        input.terminate(vkdata);
+    }
+    for (auto& output : this->post_outputs) {
+        output.terminate(vkdata);
+    }
+    this->post_inputs.clear();
+    this->post_outputs.clear();
+    if (this->taa_params_ready) {
+        this->taa_params.terminate(vkdata);
+        this->taa_params_ready = false;
+    }
+    this->post_generation = UINT32_MAX;
+}
+
+void triangle_cmd::record_fxaa_pass(vulkan_data& vkdata, const render_graph_context& context)
+{
+    size_t index = context.image_index;
+    std::vector<VkDescriptorSet> descriptor_sets = {
+        this->post_inputs[0].get_descriptor_set(index),
+        this->post_outputs[0].get_descriptor_set(index)
+    };
+
+    // the graph records the barriers around the pass, the shader bounds checks against the image size
+    VkExtent2D extent = vkdata.swap_chain_data.extent;
+    dispatch_batch batch;
+    batch.begin(context.cmd, vkdata.capture);
+    batch.dispatch(*this->fxaa, descriptor_sets, (extent.width + 7) / 8, (extent.height + 7) / 8, 1, {
+        read_image_access(vkdata.graph->get_image(this->fxaa_source)),
+        write_image_access(vkdata.graph->get_image(this->fxaa_target))
+    });
+    batch.end();
+}
+
+void triangle_cmd::record_taa_pass(vulkan_data& vkdata, const render_graph_context& context)
+{
+    size_t index = context.image_index;
+    std::vector<VkDescriptorSet> descriptor_sets = {
+        this->taa_params.get_descriptor_set(index),
+        this->post_inputs[0].get_descriptor_set(index),
+        this->post_inputs[1].get_descriptor_set(index),
+        this->post_inputs[2].get_descriptor_set(index),
+        this->post_outputs[0].get_descriptor_set(index)
+    };
+
+    // one invocation per output pixel, the shader bounds checks against the image size
+    VkExtent2D extent = vkdata.swap_chain_data.extent;
+    dispatch_batch batch;
+    batch.begin(context.cmd, vkdata.capture);
+    batch.dispatch(*this->taa, descriptor_sets, (extent.width + 7) / 8, (extent.height + 7) / 8, 1, {
+        read_image_access(vkdata.graph->get_image(this->taa_scene)),
+        read_image_access(vkdata.graph->get_image(this->taa_motion)),
+        read_image_access(vkdata.graph->get_image(this->taa_history)),
+        write_image_access(vkdata.graph->get_image(this->taa_output))
+    });
+    batch.end();
+}
+
+// the output becomes next frame's history and is converted to the swapchain's format
+void triangle_cmd::record_taa_resolve(vulkan_data& vkdata, const render_graph_context& context)
+{
+    auto extent = vkdata.swap_chain_data.extent;
+    VkImage output = vkdata.graph->get_image(this->taa_output);
+
+    VkImageCopy copy = {};
+    copy.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    copy.srcSubresource.layerCount = 1;
+    copy.dstSubresource = copy.srcSubresource;
+    copy.extent = {extent.width, extent.height, 1};
+    CAPTURED(vkdata.capture, vkCmdCopyImage, context.cmd,
+             output, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+             vkdata.graph->get_image(this->taa_history), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+             1, &copy);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = copy.srcSubresource;
+    blit.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+    blit.dstSubresource = copy.srcSubresource;
+    blit.dstOffsets[1] = blit.srcOffsets[1];
+    CAPTURED(vkdata.capture, vkCmdBlitImage, context.cmd,
+             output, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+             vkdata.swap_chain_data.images[context.image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+             1, &blit, VK_FILTER_NEAREST);
+}
+
+void triangle_cmd::record_present_blit(vulkan_data& vkdata, const render_graph_context& context)
+{
+    // same size, the blit only converts rgba16f to the swapchain's format
+    auto extent = vkdata.swap_chain_data.extent;
+    VkImageBlit blit = {};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+    blit.dstSubresource = blit.srcSubresource;
+    blit.dstOffsets[1] = blit.srcOffsets[1];
+
+    CAPTURED(vkdata.capture, vkCmdBlitImage, context.cmd,
+             vkdata.graph->get_image(this->fxaa_target), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+             vkdata.swap_chain_data.images[context.image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+             1, &blit, VK_FILTER_NEAREST);
+}
+
+void triangle_cmd::record_upscale(vulkan_data& vkdata, const render_graph_context& context)
+{
+    auto extent = vkdata.swap_chain_data.extent;
+    VkImageBlit blit = {};
+    blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    blit.srcSubresource.layerCount = 1;
+    blit.srcOffsets[1] = {static_cast<int32_t>(this->render_extent.width), static_cast<int32_t>(this->render_extent.height), 1};
+    blit.dstSubresource = blit.srcSubresource;
+    blit.dstOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+
+    CAPTURED(vkdata.capture, vkCmdBlitImage, context.cmd,
+             vkdata.graph->get_image(vkdata, this->upscale_source, context.image_index), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+             vkdata.graph->get_image(vkdata, this->upscale_target, context.image_index), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+             1, &blit, VK_FILTER_LINEAR);
+}
+
+void triangle_cmd::rec_fill_command_buffer_model(vulkan_data &vkdata, const size_t &index, uint32_t node_index, glm::mat4 transform) {
+    const auto& scene = this->model->scene();
+    const auto& current_node = scene.nodes[node_index];
+
+    // combine this nodes transform with parent's transform
+    transform = transform * current_node.local_transform;
 
     // do render commands if necessary
     if (current_node.mesh >= 0) {
+        this->node_transforms[node_index] = transform;
         // @TODO: deal with meshes with more than 1 primitive
         const auto& primitive_data = this->model->vk_mesh_data()[current_node.mesh].primitive_data.front();
 
-        /* tex data */
-        // color tex
-        int color_tex = primitive_data.tex_indexes.color;
-        if (color_tex >= 0) {
-            if (this->sampler_tex_map.count(color_tex) == 0) {
-                // tex does not yet exist as descriptor, create it
-                this->sampler_tex_map.emplace(color_tex, static_cast<int>(this->sampler_buffers.size()));
-                this->sampler_buffers.push_back({});
-                this->sampler_buffers.back().image_view().initialise(vkdata, this->model->vk_image_data()[color_tex]);
-                this->sampler_buffers.back().sampler().initialise(vkdata);
-                this->sampler_buffers.back().initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(2));
+        // cull against the view, visible primitives tell the texture streamer how much detail they need
+        glm::mat4 model_view = this->frame_ubo.view * transform;
+        if (!is_outside_frustum(this->frame_ubo.proj * model_view, primitive_data.prim_bounds)) {
+            if (this->model->stream_textures) {
+                float uv_per_pixel = get_uv_per_pixel(model_view, this->frame_ubo.proj, primitive_data.prim_bounds, primitive_data.uv_density,
+                                                      static_cast<float>(this->render_extent.height));
+                for (int tex : {primitive_data.tex_indexes.color, primitive_data.tex_indexes.normal}) {
+                    if (tex >= 0) {
+                        this->model->streamer().request(static_cast<size_t>(tex), uv_per_pixel, vkdata.frame_number);
+                    }
+                }
             }
-            // set tex to point in descriptor vec
-            color_tex = this->sampler_tex_map.at(color_tex);
-        } else {
-            // point to default color tex
-            color_tex = 0;
+            auto& ubo = this->m_uniform_buffers[index].emplace_back();
+            ubo.data().transform = transform;
+            ubo.data().prevTransform = (this->has_prev_frame && node_index < this->prev_node_transforms.size()) ?
+                    this->prev_node_transforms[node_index] : transform;
+            ubo.initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(1));
+            ubo.update_buffer(vkdata);
+            this->draws.push_back({&primitive_data, this->m_uniform_buffers[index].size() - 1});
         }
+    }
 
-        // normal tex
-        int normal_tex = primitive_data.tex_indexes.normal;
-        if (normal_tex >= 0) {
-            if (this->sampler_tex_map.count(normal_tex) == 0) {
-                // tex does not yet exist as descriptor, create it
-                this->sampler_tex_map.emplace(normal_tex, static_cast<int>(this->sampler_buffers.size()));
-                this->sampler_buffers.push_back({});
-                this->sampler_buffers.back().image_view().initialise(vkdata, this->model->vk_image_data()[normal_tex]);
-                this->sampler_buffers.back().sampler().initialise(vkdata);
-                this->sampler_buffers.back().initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(3));
-            }
-            // set tex to point in descriptor vec
-            normal_tex = this->sampler_tex_map.at(normal_tex);
-        } else {
-            // @TODO: point to default normal tex
-            normal_tex = 1;
-        }
+    // do for all node children with new transform
+    for (uint32_t c = 0; c < current_node.child_count; c++) {
+        rec_fill_command_buffer_model(vkdata, index, scene.children[current_node.first_child + c], transform);
+    }
+}
 
-        // create m uniform buffer
-        auto& ubo = this->m_uniform_buffers[index].emplace_back();
-        ubo.data().transform = transform;
-        ubo.initialise(vkdata, 0, this->pipeline->get_descriptor_set_layout(1));
-        ubo.update_buffer(vkdata);
+void triangle_cmd::record_primitive(vulkan_data& vkdata, const size_t& index, const draw_item& draw)
+{
+    const auto& primitive_data = *draw.primitive;
 
-        // record render commands
-        vkCmdBindPipeline(cmd_buffer(),
-                          VK_PIPELINE_BIND_POINT_GRAPHICS,
-                          this->pipeline->get_pipeline(vkdata));
+    /* tex data */
+    // color tex, point to default color tex if there is none
+    int color_tex = primitive_data.tex_indexes.color;
+    color_tex = (color_tex >= 0) ? this->get_sampler_index(vkdata, color_tex, 2) : 0;
 
-        std::array<VkDescriptorSet, 4> descriptor_sets = {
-            this->vp_uniform_buffers[index].get_descriptor_set(index),
-            ubo.get_descriptor_set(index),
-            this->sampler_buffers[color_tex].get_descriptor_set(index),
-            this->sampler_buffers[normal_tex].get_descriptor_set(index)
-        };
+    // normal tex, the default is bound without a normal map but its permutation never samples it
+    int normal_tex = primitive_data.tex_indexes.normal;
+    normal_tex = (normal_tex >= 0) ? this->get_sampler_index(vkdata, normal_tex, 3) : 1;
 
-        vkCmdBindDescriptorSets(cmd_buffer(),
-                                VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                this->pipeline->get_pipeline_layout(),
-                                0, static_cast<uint32_t>(descriptor_sets.size()),
-                                descriptor_sets.data(),
-                                0, nullptr);
-
-        VkBuffer vert_buffers[] = {primitive_data.vertex_buffer.get_vk_buffer()};
-        VkDeviceSize offsets[] = {0};
-        vkCmdBindVertexBuffers(cmd_buffer(), 0, 1, vert_buffers, offsets);
-
-        // determine whether the mesh is indexed or not and draw accordingly
-        if (primitive_data.has_index_buffer) {
-            vkCmdBindIndexBuffer(cmd_buffer(), primitive_data.index_buffer.get_vk_buffer(), 0, VK_INDEX_TYPE_UINT32);
-            vkCmdDrawIndexed(cmd_buffer(), static_cast<uint32_t>(primitive_data.index_buffer.get_count()), 1, 0, 0, 0);
-        } else {
-            vkCmdDraw(cmd_buffer(), static_cast<uint32_t>(primitive_data.vertex_buffer.get_count()), 1, 0, 0);
-        }
-    }
+    // record render commands
+    VkPipeline vk_pipeline = this->pipeline->get_pipeline(vkdata, basic_pipeline::get_prim_permutation(primitive_data));
+    CAPTURED(vkdata.capture, vkCmdBindPipeline, cmd_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, vk_pipeline);
 
-    // do for all node children with new transform
-    for (int c : current_node.children) {
-        rec_fill_command_buffer_model(vkdata, index, this->model->model().nodes[c], transform);
+    std::array<VkDescriptorSet, 4> descriptor_sets = {
+        this->vp_uniform_buffers[index].get_descriptor_set(index),
+        this->m_uniform_buffers[index][draw.m_buffer].get_descriptor_set(index),
+        this->sampler_buffers[color_tex].get_descriptor_set(index),
+        this->sampler_buffers[normal_tex].get_descriptor_set(index)
+    };
+
+    CAPTURED(vkdata.capture, vkCmdBindDescriptorSets, cmd_buffer(),
+             VK_PIPELINE_BIND_POINT_GRAPHICS,
+             this->pipeline->get_pipeline_layout(),
+             0, static_cast<uint32_t>(descriptor_sets.size()),
+             descriptor_sets.data(),
+             0, nullptr);
+
+    this->record_draw(vkdata, primitive_data);
+}
+
+void triangle_cmd::record_draw(vulkan_data& vkdata, const prim_data& primitive_data)
+{
+    VkBuffer vert_buffers[] = {primitive_data.vertex_buffer.get_vk_buffer()};
+    VkDeviceSize offsets[] = {0};
+    CAPTURED(vkdata.capture, vkCmdBindVertexBuffers, cmd_buffer(), 0, 1, vert_buffers, offsets);
+
+    // determine whether the mesh is indexed or not and draw accordingly
+    if (primitive_data.has_index_buffer) {
+        CAPTURED(vkdata.capture, vkCmdBindIndexBuffer, cmd_buffer(), primitive_data.index_buffer.get_vk_buffer(), 0, primitive_data.index_buffer.get_index_type());
+        CAPTURED(vkdata.capture, vkCmdDrawIndexed, cmd_buffer(), static_cast<uint32_t>(primitive_data.index_buffer.get_count()), 1, 0, 0, 0);
+    } else {
+        CAPTURED(vkdata.capture, vkCmdDraw, cmd_buffer(), static_cast<uint32_t>(primitive_data.vertex_buffer.get_count()), 1, 0, 0);
     }
 }
@@ -4,6 +4,9 @@
 #include "vulkan/vulkan_base.h"
 #include "basic_pipeline.h"
 
+// true when every corner of the box is outside the same clip plane, how the scene walk culls primitives
+bool is_outside_frustum(const glm::mat4& model_view_proj, const bounds& b);
+
 class triangle_cmd : public graphics_command_buffer
 {
 private:
@@ -11,9 +14,72 @@ private:
     std::vector<std::vector<uniform_buffer<basic_pipeline::m_ubo>>> m_uniform_buffers;
     std::vector<sampler_uniform_buffer> sampler_buffers;
 
-    std::unordered_map<int, int> sampler_tex_map;
+    // image index -> sampler buffer, rebuilt when texture streaming swaps the image
+    struct sampler_slot {
+        int sampler;
+        uint32_t generation;
+    };
+    std::unordered_map<int, sampler_slot> sampler_tex_map;
+
+    // replaced sampler buffers, kept until frames in flight are done with them
+    struct retired_sampler {
+        sampler_uniform_buffer buffer;
+        uint64_t frame;
+    };
+    std::vector<retired_sampler> retired_samplers;
+
+    // a visible primitive and its m uniform buffer, gathered once per frame for every pass
+    struct draw_item {
+        const prim_data* primitive;
+        size_t m_buffer;
+    };
+    std::vector<draw_item> draws;
+
+    // fxaa and taa read and write graph images, their descriptors are remade whenever the graph is
+    // compiled. inputs and outputs in the order the pass's descriptor sets take them
+    std::vector<sampler_uniform_buffer> post_inputs;
+    std::vector<storage_image_uniform_buffer> post_outputs;
+    uint32_t post_generation = UINT32_MAX;      // UINT32_MAX while there are no descriptors
+    render_graph_resource fxaa_source = UINT32_MAX;
+    render_graph_resource fxaa_target = UINT32_MAX;
 
-    void rec_fill_command_buffer_model(vulkan_data& vkdata, const size_t& index, const tinygltf::Node& current_node, glm::mat4 parent_transform);
+    uniform_buffer<taa_pipeline::taa_ubo> taa_params;
+    bool taa_params_ready = false;
+    render_graph_resource taa_scene = UINT32_MAX;
+    render_graph_resource taa_motion = UINT32_MAX;
+    render_graph_resource taa_history = UINT32_MAX;
+    render_graph_resource taa_output = UINT32_MAX;
+    uint32_t jitter_index = 0;
+    glm::vec2 jitter = glm::vec2(0.0f);         // in scene pixels, this frame
+
+    // last frame's camera and node transforms for motion vectors, advanced once per frame
+    uint64_t history_frame = UINT64_MAX;
+    bool has_prev_frame = false;
+    glm::mat4 view_proj = glm::mat4(1.0f);
+    glm::mat4 prev_view_proj = glm::mat4(1.0f);
+    std::vector<glm::mat4> node_transforms;     // by node index, written as the scene is walked
+    std::vector<glm::mat4> prev_node_transforms;
+
+    render_graph_resource upscale_source = UINT32_MAX;
+    render_graph_resource upscale_target = UINT32_MAX;
+    VkExtent2D render_extent = {};              // of the scene this frame
+
+    int get_sampler_index(vulkan_data& vkdata, int image_index, size_t set);
+    void rec_fill_command_buffer_model(vulkan_data& vkdata, const size_t& index, uint32_t node_index, glm::mat4 parent_transform);
+    void record_primitive(vulkan_data& vkdata, const size_t& index, const draw_item& draw);
+    void record_draw(vulkan_data& vkdata, const prim_data& primitive_data);
+    void record_depth_prepass(vulkan_data& vkdata, const render_graph_context& context);
+    void record_forward_pass(vulkan_data& vkdata, const render_graph_context& context);
+    void advance_frame_history(vulkan_data& vkdata);
+    void add_post_input(vulkan_data& vkdata, render_graph_resource resource, VkDescriptorSetLayout layout);
+    void add_post_output(vulkan_data& vkdata, render_graph_resource resource, VkDescriptorSetLayout layout);
+    void update_post_descriptors(vulkan_data& vkdata);
+    void terminate_post_descriptors(vulkan_data& vkdata);
+    void record_fxaa_pass(vulkan_data& vkdata, const render_graph_context& context);
+    void record_taa_pass(vulkan_data& vkdata, const render_graph_context& context);
+    void record_taa_resolve(vulkan_data& vkdata, const render_graph_context& context);
+    void record_present_blit(vulkan_data& vkdata, const render_graph_context& context);
+    void record_upscale(vulkan_data& vkdata, const render_graph_context& context);
 
 protected:
     VkCommandBufferLevel get_buffer_level() const final;
@@ -21,10 +87,40 @@ protected:
 
 public:
     basic_pipeline* pipeline = nullptr;
+    depth_prepass_pipeline* depth_pipeline = nullptr;  // needed with depth_prepass
+    basic_pipeline* fallback_pipeline = nullptr;        // pipeline->fallback if any, rebuilt along with it
+    fxaa_pipeline* fxaa = nullptr;                      // needed with use_fxaa
+    taa_pipeline* taa = nullptr;                        // needed with use_taa
+    gpu_frame_timer* frame_timer = nullptr;             // optional, times every frame
+    gpu_profiler* profiler = nullptr;                   // optional, times the frame and each pass
     gltf_model* model = nullptr;
 
     glm::vec3 camera_pos = glm::vec3(0.0);
     basic_pipeline::vp_ubo frame_ubo;
+    // lay down depth first so the forward pass shades each pixel once, pays off in high overdraw scenes.
+    // decided per scene before add_passes, the forward pipeline needs after_depth_prepass to match
+    bool depth_prepass = false;
+    render_graph_pass depth_prepass_pass = UINT32_MAX;
+    render_graph_pass forward_pass = UINT32_MAX;
+    // single sampled scene smoothed by a compute pass and blitted to the swapchain instead of
+    // resolving msaa. vkdata.msaa_samples has to be 1 and the swapchain a transfer destination
+    bool use_fxaa = false;
+    // temporal upscaling instead of msaa or fxaa, the scene is drawn at render_scale with a jitter
+    // that changes every frame and accumulated into a full resolution history using motion vectors.
+    // vkdata.msaa_samples has to be 1, the swapchain a transfer destination and pipeline->motion_vectors set
+    bool use_taa = false;
+    // the scene is drawn to the top left render_scale of full size targets and blitted up to the
+    // swapchain, or upscaled by taa. the scale can change every frame, only toggling dynamic_resolution
+    // needs rebuild_passes. without either the scene is drawn at full resolution
+    bool dynamic_resolution = false;
+    float render_scale = 1.0f;
+
+    // declares the passes this draws in, before the graph is compiled. without fxaa or taa the scene
+    // is drawn with vkdata.msaa_samples, resolving into the backbuffer when that is more than 1
+    void add_passes(vulkan_data& vkdata, render_graph& graph);
+    // redeclares and compiles the graph after depth_prepass, use_fxaa, use_taa, dynamic_resolution or vkdata.msaa_samples changed,
+    // then rebuilds the pipelines for the new render passes. waits for the device to go idle
+    void rebuild_passes(vulkan_data& vkdata);
 
     // @TODO: terminate all buffers
     void preterminate(vulkan_data& data);
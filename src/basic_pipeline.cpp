@@ -2,6 +2,9 @@
 #include "platform.h"
 #include "model/gltf_model.h"
 
+#include <cstring>
+#include <unordered_set>
+
 void basic_pipeline::gen_vertex_input_info(
         vulkan_data& data,
         std::vector<VkVertexInputBindingDescription>* binding_descriptions,
@@ -11,20 +14,44 @@ void basic_pipeline::gen_vertex_input_info(
     *attrib_descriptions = vertex::get_attribute_descriptions();
 }
 
-std::vector<VkPipelineShaderStageCreateInfo> basic_pipeline::load_shader_stage_infos(vulkan_data& data)
+VkPipelineColorBlendStateCreateInfo basic_pipeline::gen_color_blend_state(vulkan_data& data, std::vector<VkPipelineColorBlendAttachmentState>& attachment_states)
+{
+    auto colorBlending = graphics_pipeline::gen_color_blend_state(data, attachment_states);
+    if (this->motion_vectors) {
+        // motion is written as is, translucent surfaces move the pixel like opaque ones
+        VkPipelineColorBlendAttachmentState motionAttachment = {};
+        motionAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+        motionAttachment.blendEnable = VK_FALSE;
+        attachment_states.push_back(motionAttachment);
+        colorBlending.attachmentCount = (uint32_t)attachment_states.size();
+        colorBlending.pAttachments = attachment_states.data();
+    }
+    return colorBlending;
+}
+
+// less or equal also passes over depth a pre-pass laid down, so a basic_pipeline without
+// after_depth_prepass can stand in for one with it
+VkPipelineDepthStencilStateCreateInfo basic_pipeline::gen_depth_stencil_state_info(vulkan_data& data)
+{
+    auto depthStencil = graphics_pipeline::gen_depth_stencil_state_info(data);
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    return depthStencil;
+}
+
+std::vector<shader_stage_decl> basic_pipeline::get_shader_stage_declarations()
 {
-    auto vert_info = gen_shader_stage_info_from_spirv(data,
-            to_absolute_path("res/shaders/vertex_v.spv"),
-            shader_type::VERTEX);
-    auto frag_info = gen_shader_stage_info_from_spirv(data,
-            to_absolute_path("res/shaders/vertex_f.spv"),
-            shader_type::FRAGMENT);
-    return {vert_info, frag_info};
+    return {
+        {"res/shaders/vertex_v.spv", shader_type::VERTEX},
+        {"res/shaders/vertex_f.spv", shader_type::FRAGMENT}
+    };
 }
 
+// viewport and scissor follow the render area, so dynamic resolution never rebuilds pipelines
 std::vector<VkDynamicState> basic_pipeline::gen_dynamic_state_info(vulkan_data& data)
 {
     return {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
         VK_DYNAMIC_STATE_LINE_WIDTH
     };
 }
@@ -37,3 +64,153 @@ std::vector<uniform_buffer_decl> basic_pipeline::get_uniform_buffer_declarations
         new_uniform_buffer_decl(3, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
     };
 }
+
+/* constant ids, must match vertex_f.frag */
+#define SPEC_NORMAL_MAP     0
+#define SPEC_VERTEX_COLOR   1
+#define SPEC_ALPHA_TEST     2
+#define SPEC_ALPHA_CUTOFF   3
+
+uint64_t basic_pipeline::permutation::key() const
+{
+    uint64_t key = (normal_map ? 0x1u : 0u) | (vertex_color ? 0x2u : 0u) | (alpha_test ? 0x4u : 0u);
+    if (alpha_test) {
+        uint32_t cutoff_bits;
+        std::memcpy(&cutoff_bits, &alpha_cutoff, sizeof(cutoff_bits));
+        key |= static_cast<uint64_t>(cutoff_bits) << 32;
+    }
+    return key;
+}
+
+std::vector<specialization_constant> basic_pipeline::permutation::constants() const
+{
+    return {
+        new_specialization_constant(SPEC_NORMAL_MAP, normal_map),
+        new_specialization_constant(SPEC_VERTEX_COLOR, vertex_color),
+        new_specialization_constant(SPEC_ALPHA_TEST, alpha_test),
+        new_specialization_constant(SPEC_ALPHA_CUTOFF, alpha_cutoff)
+    };
+}
+
+basic_pipeline::permutation basic_pipeline::get_prim_permutation(const prim_data& prim)
+{
+    permutation features;
+    features.normal_map = (prim.tex_indexes.normal >= 0);
+    features.vertex_color = prim.has_vertex_color;
+    features.alpha_test = (prim.alpha_cutoff >= 0.0f);
+    if (features.alpha_test) {
+        features.alpha_cutoff = prim.alpha_cutoff;
+    }
+    return features;
+}
+
+VkPipeline basic_pipeline::get_pipeline(vulkan_data& vkdata, const permutation& features)
+{
+    uint64_t key = features.key();
+    if (key == permutation{}.key()) {
+        return this->get_pipeline(vkdata);
+    }
+
+    if (this->has_own_depth_state(features)) {
+        auto depth_stencil = this->gen_depth_stencil_state_info(vkdata);
+        return this->get_specialized_pipeline(vkdata, key, features.constants(), &depth_stencil);
+    }
+    return this->get_specialized_pipeline(vkdata, key, features.constants());
+}
+
+void basic_pipeline::warm_up(vulkan_data& vkdata, const gltf_model& model)
+{
+    auto depth_stencil = this->gen_depth_stencil_state_info(vkdata);
+    std::unordered_set<uint64_t> keys = {permutation{}.key()};
+    std::vector<pipeline_state> states;
+    for (auto& mesh : model.vk_mesh_data()) {
+        for (auto& prim : mesh.primitive_data) {
+            auto features = get_prim_permutation(prim);
+            if (!keys.insert(features.key()).second) {
+                continue;
+            }
+            states.push_back(this->get_specialized_state(features.constants(),
+                                                         this->has_own_depth_state(features) ? &depth_stencil : nullptr));
+        }
+    }
+    vkdata.pipelines->warm_up(vkdata, states);
+}
+
+bool basic_pipeline::has_own_depth_state(const permutation& features) const
+{
+    return this->after_depth_prepass && features.alpha_test;
+}
+
+/* depth pre-pass */
+
+void depth_prepass_pipeline::gen_vertex_input_info(
+        vulkan_data& data,
+        std::vector<VkVertexInputBindingDescription>* binding_descriptions,
+        std::vector<VkVertexInputAttributeDescription>* attrib_descriptions)
+{
+    // same vertex buffers as basic_pipeline, only the position is fetched
+    binding_descriptions->push_back(vertex::get_binding_description(0));
+    attrib_descriptions->push_back(vertex::get_attribute_descriptions().front());
+}
+
+VkPipelineColorBlendStateCreateInfo depth_prepass_pipeline::gen_color_blend_state(vulkan_data& data, std::vector<VkPipelineColorBlendAttachmentState>& attachment_states)
+{
+    // no color attachments
+    VkPipelineColorBlendStateCreateInfo colorBlending = {};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.attachmentCount = 0;
+    return colorBlending;
+}
+
+std::vector<shader_stage_decl> depth_prepass_pipeline::get_shader_stage_declarations()
+{
+    return {
+        {"res/shaders/depth_v.spv", shader_type::VERTEX}
+    };
+}
+
+std::vector<VkDynamicState> depth_prepass_pipeline::gen_dynamic_state_info(vulkan_data& data)
+{
+    return {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
+    };
+}
+
+// sets 0 and 1 match basic_pipeline so the same descriptor sets can be bound
+std::vector<uniform_buffer_decl> depth_prepass_pipeline::get_uniform_buffer_declarations() {
+    return {
+        new_uniform_buffer_decl(0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT),
+        new_uniform_buffer_decl(1, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+    };
+}
+
+shader_stage_decl fxaa_pipeline::get_shader_stage_declaration()
+{
+    return {"res/shaders/fxaa_c.spv", shader_type::COMPUTE};
+}
+
+std::vector<uniform_buffer_decl> fxaa_pipeline::get_uniform_buffer_declarations()
+{
+    return {
+        new_uniform_buffer_decl(0, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+        new_uniform_buffer_decl(1, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+    };
+}
+
+shader_stage_decl taa_pipeline::get_shader_stage_declaration()
+{
+    return {"res/shaders/taa_c.spv", shader_type::COMPUTE};
+}
+
+std::vector<uniform_buffer_decl> taa_pipeline::get_uniform_buffer_declarations()
+{
+    return {
+        new_uniform_buffer_decl(0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+        new_uniform_buffer_decl(1, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+        new_uniform_buffer_decl(2, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+        new_uniform_buffer_decl(3, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+        new_uniform_buffer_decl(4, 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+    };
+}
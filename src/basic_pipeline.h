@@ -3,28 +3,110 @@
 #include "vulkan/vulkan_base.h"
 #include <glm/glm.hpp>
 
+struct prim_data;
+class gltf_model;
+
 class basic_pipeline : public graphics_pipeline
 {
 public:
+    // material features compiled in or out of vertex_f.frag through specialization constants
+    struct permutation
+    {
+        bool normal_map = true;
+        bool vertex_color = false;
+        bool alpha_test = false;
+        float alpha_cutoff = 0.5f;
+
+        uint64_t key() const;
+        std::vector<specialization_constant> constants() const;
+    };
+
     struct vp_ubo
     {
         glm::mat4 view = glm::mat4(1.0);
         glm::mat4 proj = glm::mat4(1.0);
         glm::vec3 cameraPos = glm::vec3(0.0);
         float currTime = 0.0f;
+        // last frame's unjittered view * proj, and the ndc offset jittering proj this frame
+        glm::mat4 prevViewProj = glm::mat4(1.0);
+        glm::vec2 jitter = glm::vec2(0.0);
+        glm::vec2 pad = glm::vec2(0.0);
     };
 
     struct m_ubo
     {
         glm::mat4 transform = glm::mat4(1.0);
+        glm::mat4 prevTransform = glm::mat4(1.0);
     };
 
+    // writes each pixel's screen motion since last frame to a second, rg16f color attachment
+    bool motion_vectors = false;
+
+    static permutation get_prim_permutation(const prim_data& prim);
+
+    // the default permutation is the pipeline itself, others compile in the background. alpha
+    // tested ones after a depth pre-pass block instead, warm_up keeps that off the first frame
+    using graphics_pipeline::get_pipeline;
+    VkPipeline get_pipeline(vulkan_data& vkdata, const permutation& features);
+    // compiles the permutations model's primitives use on the registry's workers and waits for them,
+    // call after initialise and load_model
+    void warm_up(vulkan_data& vkdata, const gltf_model& model);
+
+private:
+    // alpha tested primitives are left out of the depth pre-pass, they test and write depth themselves
+    bool has_own_depth_state(const permutation& features) const;
+
 protected:
     void gen_vertex_input_info(vulkan_data& data,
             std::vector<VkVertexInputBindingDescription>* binding_descriptions,
             std::vector<VkVertexInputAttributeDescription>* attrib_descriptions) final;
 
-    std::vector<VkPipelineShaderStageCreateInfo> load_shader_stage_infos(vulkan_data& data) final;
+    VkPipelineColorBlendStateCreateInfo gen_color_blend_state(vulkan_data& data, std::vector<VkPipelineColorBlendAttachmentState>& attachment_states) final;
+    VkPipelineDepthStencilStateCreateInfo gen_depth_stencil_state_info(vulkan_data& data) final;
+    std::vector<shader_stage_decl> get_shader_stage_declarations() final;
     std::vector<VkDynamicState> gen_dynamic_state_info(vulkan_data& data) final;
     std::vector<uniform_buffer_decl> get_uniform_buffer_declarations() final;
 };
+
+// position only, fills the depth buffer ahead of a basic_pipeline with after_depth_prepass set
+class depth_prepass_pipeline : public graphics_pipeline
+{
+protected:
+    void gen_vertex_input_info(vulkan_data& data,
+            std::vector<VkVertexInputBindingDescription>* binding_descriptions,
+            std::vector<VkVertexInputAttributeDescription>* attrib_descriptions) final;
+
+    VkPipelineColorBlendStateCreateInfo gen_color_blend_state(vulkan_data& data, std::vector<VkPipelineColorBlendAttachmentState>& attachment_states) final;
+    std::vector<shader_stage_decl> get_shader_stage_declarations() final;
+    std::vector<VkDynamicState> gen_dynamic_state_info(vulkan_data& data) final;
+    std::vector<uniform_buffer_decl> get_uniform_buffer_declarations() final;
+};
+
+// post-process anti-aliasing for single sampled scenes, a cheaper alternative to msaa.
+// set 0 samples the scene, set 1 is the rgba16f storage image the smoothed result is written to
+class fxaa_pipeline : public compute_pipeline
+{
+protected:
+    shader_stage_decl get_shader_stage_declaration() final;
+    std::vector<uniform_buffer_decl> get_uniform_buffer_declarations() final;
+};
+
+// temporal upscaling, accumulates jittered frames drawn at a fraction of the output resolution.
+// set 0 is taa_ubo, 1 the scene, 2 the motion vectors and 3 last frame's output, all sampled.
+// set 4 is the rgba16f storage image the result is written to
+class taa_pipeline : public compute_pipeline
+{
+public:
+    struct taa_ubo
+    {
+        glm::vec2 jitter = glm::vec2(0.0);      // in scene pixels
+        glm::vec2 renderSize = glm::vec2(1.0);  // drawn to the top left of the scene images
+        float historyValid = 0.0f;
+        float blend = 0.1f;                     // how much a well placed sample contributes
+        glm::vec2 pad = glm::vec2(0.0);
+    };
+
+protected:
+    shader_stage_decl get_shader_stage_declaration() final;
+    std::vector<uniform_buffer_decl> get_uniform_buffer_declarations() final;
+};
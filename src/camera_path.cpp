@@ -0,0 +1,144 @@
+#include "camera_path.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+#define CAMERA_PATH_HEADER "discovery camera path 1"
+
+glm::mat4 get_camera_view(const camera_state& camera)
+{
+    glm::mat4 v = glm::translate(glm::mat4(1.0), {0.0, 0.0, camera.zoom});
+    v = glm::rotate(v, camera.rotation.y, {1, 0, 0});
+    v = glm::rotate(v, camera.rotation.x, {0, 1, 0});
+    v = glm::rotate(v, glm::radians(180.0f), {0, 0, 1}); // flip y
+    v = glm::translate(v, -camera.position);
+    return v;
+}
+
+glm::mat4 get_camera_projection(const camera_state& camera, double aspect)
+{
+    return glm::mat4(glm::perspective(camera.fov_y, aspect, camera.near_plane, camera.far_plane));
+}
+
+double get_camera_path_duration(const camera_path& path)
+{
+    if (path.frames.empty()) {
+        return 0.0;
+    }
+    return path.frames.back().time - path.frames.front().time;
+}
+
+camera_state sample_camera_path(const camera_path& path, double time)
+{
+    if (path.frames.empty()) {
+        return camera_state{};
+    }
+    time += path.frames.front().time;
+    auto next = std::upper_bound(path.frames.begin(), path.frames.end(), time, [](double t, const camera_path_frame& frame) {
+        return t < frame.time;
+    });
+    if (next == path.frames.begin()) {
+        return next->camera;
+    }
+    if (next == path.frames.end()) {
+        return path.frames.back().camera;
+    }
+
+    auto& a = (next - 1)->camera;
+    auto& b = next->camera;
+    double span = next->time - (next - 1)->time;
+    double t = span > 0.0 ? (time - (next - 1)->time) / span : 1.0;
+    camera_state camera = b;
+    camera.position = glm::mix(a.position, b.position, static_cast<float>(t));
+    camera.rotation = glm::mix(a.rotation, b.rotation, static_cast<float>(t));
+    camera.zoom = a.zoom + (b.zoom - a.zoom) * t;
+    camera.fov_y = a.fov_y + (b.fov_y - a.fov_y) * t;
+    return camera;
+}
+
+void write_camera_path(const std::string& file_path, const camera_path& path)
+{
+    std::ofstream file(file_path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open camera path " + file_path + "!");
+    }
+    // round trips every value exactly, so replays match the recording bit for bit
+    file.precision(std::numeric_limits<double>::max_digits10);
+    file << CAMERA_PATH_HEADER "\n";
+    file << "size " << path.width << " " << path.height << "\n";
+    file << "# time position.x position.y position.z yaw pitch zoom fov_y near far\n";
+    for (auto& frame : path.frames) {
+        auto& c = frame.camera;
+        file << frame.time << " " << c.position.x << " " << c.position.y << " " << c.position.z << " " << c.rotation.x << " "
+             << c.rotation.y << " " << c.zoom << " " << c.fov_y << " " << c.near_plane << " " << c.far_plane << "\n";
+    }
+    if (!file) {
+        throw std::runtime_error("failed to write camera path " + file_path + "!");
+    }
+}
+
+camera_path read_camera_path(const std::string& file_path)
+{
+    std::ifstream file(file_path);
+    if (!file) {
+        throw std::runtime_error("failed to open camera path " + file_path + "!");
+    }
+    std::string line;
+    if (!std::getline(file, line) || line != CAMERA_PATH_HEADER) {
+        throw std::runtime_error(file_path + " is not a camera path!");
+    }
+
+    camera_path path;
+    size_t line_number = 1;
+    while (std::getline(file, line)) {
+        line_number++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream values(line);
+        if (line.compare(0, 5, "size ") == 0) {
+            std::string key;
+            values >> key >> path.width >> path.height;
+        } else {
+            camera_path_frame frame;
+            auto& c = frame.camera;
+            values >> frame.time >> c.position.x >> c.position.y >> c.position.z >> c.rotation.x >> c.rotation.y >> c.zoom
+                   >> c.fov_y >> c.near_plane >> c.far_plane;
+            if (values && !path.frames.empty() && frame.time < path.frames.back().time) {
+                throw std::runtime_error(file_path + " goes back in time on line " + std::to_string(line_number) + "!");
+            }
+            path.frames.push_back(frame);
+        }
+        if (!values) {
+            throw std::runtime_error("failed to parse line " + std::to_string(line_number) + " of " + file_path + "!");
+        }
+    }
+    if (path.frames.empty()) {
+        throw std::runtime_error(file_path + " has no frames!");
+    }
+    return path;
+}
+
+void write_frame_times_csv(const std::string& file_path, const std::vector<replay_frame_time>& frames)
+{
+    std::ofstream file(file_path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open frame times " + file_path + "!");
+    }
+    file << "frame,time_s,cpu_ms,gpu_ms\n";
+    for (size_t i = 0; i < frames.size(); i++) {
+        file << i << "," << frames[i].time << "," << frames[i].cpu_ms << ",";
+        if (frames[i].gpu_ms >= 0.0) {
+            file << frames[i].gpu_ms;
+        }
+        file << "\n";
+    }
+    if (!file) {
+        throw std::runtime_error("failed to write frame times " + file_path + "!");
+    }
+}
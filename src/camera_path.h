@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * the viewer's camera recorded once per frame, so a performance run can be replayed with a fixed
+ * time step and two builds render exactly the same frames. the view and projection are rebuilt
+ * from the camera state, so replays in a different window or headless size keep their framing
+ */
+
+// the orbit camera of the viewer
+struct camera_state {
+    glm::vec3 position = {0.0f, 0.0f, 0.0f};   // what the camera orbits
+    glm::vec2 rotation = {0.0f, 0.0f};          // yaw around y then pitch around x, radians
+    double zoom = -3000.0;                      // distance along z, negative
+    double fov_y = 45.0;                        // passed to glm::perspective as is
+    double near_plane = 0.1;
+    double far_plane = 10000.0;
+};
+
+glm::mat4 get_camera_view(const camera_state& camera);
+glm::mat4 get_camera_projection(const camera_state& camera, double aspect);
+
+struct camera_path_frame {
+    double time;            // seconds since the recording started
+    camera_state camera;
+};
+
+struct camera_path {
+    uint32_t width = 0;     // window size when recorded
+    uint32_t height = 0;
+    std::vector<camera_path_frame> frames;
+};
+
+// seconds from the first to the last frame
+double get_camera_path_duration(const camera_path& path);
+// the camera at time, interpolated between the frames around it and clamped to the first and last
+camera_state sample_camera_path(const camera_path& path, double time);
+
+// text files, a header then a line per frame. throw when the file can't be written, read or parsed
+void write_camera_path(const std::string& file_path, const camera_path& path);
+camera_path read_camera_path(const std::string& file_path);
+
+// a replayed frame, gpu_ms is negative when its time was never read back
+struct replay_frame_time {
+    double time;
+    double cpu_ms;          // from the start of the frame to its submission, presenting isn't in it
+    double gpu_ms = -1.0;
+};
+
+// frame,time_s,cpu_ms,gpu_ms with an empty gpu_ms where there is none, throws when it can't be written
+void write_frame_times_csv(const std::string& file_path, const std::vector<replay_frame_time>& frames);
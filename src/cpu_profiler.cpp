@@ -0,0 +1,191 @@
+#include "cpu_profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#define CPU_PROFILE_RING_SIZE 65536         // events kept per thread
+// readers leave out the oldest events, the owning thread may be overwriting them meanwhile
+#define CPU_PROFILE_RING_SLACK 1024
+#define CPU_PROFILE_FRAME_COUNT 4096
+#define CPU_PROFILE_HISTOGRAM_BUCKETS 50
+
+struct cpu_profile_ring {
+    std::vector<cpu_profile_event> events;
+    std::atomic<uint64_t> written{0};
+    uint32_t thread_index = 0;
+};
+
+struct cpu_profile_state {
+    std::mutex mutex;
+    // rings outlive their threads so loader threads' events can still be dumped
+    std::vector<std::unique_ptr<cpu_profile_ring>> rings;
+    uint64_t origin_ns = cpu_profile_now_ns();
+
+    // frame marks only come from the main loop's thread, which also reads them
+    std::vector<uint64_t> frame_ns = std::vector<uint64_t>(CPU_PROFILE_FRAME_COUNT);
+    uint64_t frame_count = 0;
+    uint64_t last_mark_ns = 0;
+};
+
+static cpu_profile_state& get_state()
+{
+    static cpu_profile_state state;
+    return state;
+}
+
+static cpu_profile_ring& get_thread_ring()
+{
+    thread_local cpu_profile_ring* ring = nullptr;
+    if (ring == nullptr) {
+        auto& state = get_state();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.rings.push_back(std::make_unique<cpu_profile_ring>());
+        ring = state.rings.back().get();
+        ring->events.resize(CPU_PROFILE_RING_SIZE);
+        ring->thread_index = static_cast<uint32_t>(state.rings.size() - 1);
+    }
+    return *ring;
+}
+
+// the events of a ring that can be read safely, oldest first
+static void get_ring_range(const cpu_profile_ring& ring, uint64_t* first, uint64_t* end)
+{
+    *end = ring.written.load(std::memory_order_acquire);
+    uint64_t kept = CPU_PROFILE_RING_SIZE - CPU_PROFILE_RING_SLACK;
+    *first = (*end > kept) ? *end - kept : 0;
+}
+
+static cpu_timing_stats get_timing_stats(const std::string& name, std::vector<uint64_t>& durations_ns)
+{
+    cpu_timing_stats stats;
+    stats.name = name;
+    stats.count = durations_ns.size();
+    if (durations_ns.empty()) {
+        return stats;
+    }
+    std::sort(durations_ns.begin(), durations_ns.end());
+    auto percentile = [&](double p) {
+        size_t i = std::min(durations_ns.size() - 1, static_cast<size_t>(p * static_cast<double>(durations_ns.size() - 1) + 0.5));
+        return static_cast<double>(durations_ns[i]) / 1e6;
+    };
+    stats.p50_ms = percentile(0.50);
+    stats.p95_ms = percentile(0.95);
+    stats.p99_ms = percentile(0.99);
+    stats.max_ms = static_cast<double>(durations_ns.back()) / 1e6;
+    return stats;
+}
+
+uint64_t cpu_profile_now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void cpu_profile_record(const char* name, uint64_t start_ns, uint64_t end_ns)
+{
+    auto& ring = get_thread_ring();
+    uint64_t written = ring.written.load(std::memory_order_relaxed);
+    ring.events[written % CPU_PROFILE_RING_SIZE] = {name, start_ns, end_ns};
+    ring.written.store(written + 1, std::memory_order_release);
+}
+
+void cpu_profile_frame_mark()
+{
+    auto& state = get_state();
+    uint64_t now = cpu_profile_now_ns();
+    if (state.last_mark_ns != 0) {
+        state.frame_ns[state.frame_count % CPU_PROFILE_FRAME_COUNT] = now - state.last_mark_ns;
+        state.frame_count++;
+    }
+    state.last_mark_ns = now;
+}
+
+bool cpu_profile_enabled()
+{
+#ifdef DISCOVERY_CPU_PROFILING
+    return true;
+#else
+    return false;
+#endif
+}
+
+cpu_frame_stats cpu_profile_get_frame_stats()
+{
+    auto& state = get_state();
+    size_t count = static_cast<size_t>(std::min<uint64_t>(state.frame_count, CPU_PROFILE_FRAME_COUNT));
+    std::vector<uint64_t> durations(state.frame_ns.begin(), state.frame_ns.begin() + count);
+
+    cpu_frame_stats stats;
+    stats.histogram.resize(CPU_PROFILE_HISTOGRAM_BUCKETS);
+    for (uint64_t ns : durations) {
+        size_t bucket = static_cast<size_t>(static_cast<double>(ns) / 1e6 / stats.bucket_ms);
+        stats.histogram[std::min<size_t>(bucket, CPU_PROFILE_HISTOGRAM_BUCKETS - 1)]++;
+    }
+    stats.timing = get_timing_stats("frame", durations);
+    return stats;
+}
+
+std::vector<cpu_timing_stats> cpu_profile_get_scope_stats()
+{
+    auto& state = get_state();
+    std::unordered_map<std::string, std::vector<uint64_t>> durations;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        for (auto& ring : state.rings) {
+            uint64_t first, end;
+            get_ring_range(*ring, &first, &end);
+            for (uint64_t i = first; i < end; i++) {
+                auto& event = ring->events[i % CPU_PROFILE_RING_SIZE];
+                durations[event.name].push_back(event.end_ns - event.start_ns);
+            }
+        }
+    }
+
+    std::vector<cpu_timing_stats> stats;
+    for (auto& scope : durations) {
+        stats.push_back(get_timing_stats(scope.first, scope.second));
+    }
+    std::sort(stats.begin(), stats.end(), [](const cpu_timing_stats& a, const cpu_timing_stats& b) {
+        return a.p99_ms > b.p99_ms;
+    });
+    return stats;
+}
+
+// complete events, a track per thread in the order threads first recorded. names are literals so need no escaping
+void cpu_profile_write_chrome_trace(const std::string& path)
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open cpu trace " + path + "!");
+    }
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"cpu\"}}";
+
+    auto& state = get_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (auto& ring : state.rings) {
+        file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->thread_index
+             << ",\"args\":{\"name\":\"thread " << ring->thread_index << "\"}}";
+
+        uint64_t first, end;
+        get_ring_range(*ring, &first, &end);
+        for (uint64_t i = first; i < end; i++) {
+            auto& event = ring->events[i % CPU_PROFILE_RING_SIZE];
+            double start_us = static_cast<double>(static_cast<int64_t>(event.start_ns - state.origin_ns)) / 1000.0;
+            file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->thread_index
+                 << ",\"ts\":" << start_us << ",\"dur\":" << static_cast<double>(event.end_ns - event.start_ns) / 1000.0 << "}";
+        }
+    }
+    file << "\n]}\n";
+    if (!file) {
+        throw std::runtime_error("failed to write cpu trace " + path + "!");
+    }
+}
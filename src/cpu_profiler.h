@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * scoped cpu timers for the hot paths. every thread records into its own ring buffer of the
+ * latest events so timing never takes a lock, and CPU_PROFILE_FRAME marks the main loop's
+ * frames for the frame time histogram. without DISCOVERY_CPU_PROFILING (a cmake option) the
+ * macros compile to nothing, the functions below still exist and just have nothing to report
+ */
+
+struct cpu_profile_event {
+    const char* name;       // a string literal, only the pointer is kept
+    uint64_t start_ns;
+    uint64_t end_ns;
+};
+
+// percentiles over the frames or scope runs still recorded
+struct cpu_timing_stats {
+    std::string name;
+    uint64_t count = 0;
+    double p50_ms = 0.0;
+    double p95_ms = 0.0;
+    double p99_ms = 0.0;
+    double max_ms = 0.0;
+};
+
+struct cpu_frame_stats {
+    cpu_timing_stats timing;
+    double bucket_ms = 1.0;
+    // frames per bucket_ms wide bucket, the last one holds everything longer
+    std::vector<uint32_t> histogram;
+};
+
+// steady clock, shared by every thread
+uint64_t cpu_profile_now_ns();
+
+// used by the macros
+void cpu_profile_record(const char* name, uint64_t start_ns, uint64_t end_ns);
+void cpu_profile_frame_mark();
+
+class cpu_profile_scope
+{
+private:
+    const char* name;
+    uint64_t start_ns;
+
+public:
+    explicit cpu_profile_scope(const char* scope_name) : name(scope_name), start_ns(cpu_profile_now_ns()) {}
+    ~cpu_profile_scope() { cpu_profile_record(this->name, this->start_ns, cpu_profile_now_ns()); }
+    cpu_profile_scope(const cpu_profile_scope&) = delete;
+    cpu_profile_scope& operator=(const cpu_profile_scope&) = delete;
+};
+
+#ifdef DISCOVERY_CPU_PROFILING
+#define CPU_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPU_PROFILE_CONCAT(a, b) CPU_PROFILE_CONCAT_INNER(a, b)
+// times the rest of the enclosing scope, name has to be a string literal
+#define CPU_PROFILE_SCOPE(name) cpu_profile_scope CPU_PROFILE_CONCAT(cpu_profile_scope_, __LINE__)(name)
+// once per frame on the main loop's thread
+#define CPU_PROFILE_FRAME() cpu_profile_frame_mark()
+#else
+#define CPU_PROFILE_SCOPE(name) ((void)0)
+#define CPU_PROFILE_FRAME() ((void)0)
+#endif
+
+// whether this build records anything
+bool cpu_profile_enabled();
+
+// the time between frame marks, over the last few thousand frames
+cpu_frame_stats cpu_profile_get_frame_stats();
+// per scope name over the events still in the ring buffers, slowest p99 first.
+// events recorded while this runs may be left out
+std::vector<cpu_timing_stats> cpu_profile_get_scope_stats();
+// every event still in the ring buffers as chrome://tracing json, one track per thread.
+// throws when the file can't be written
+void cpu_profile_write_chrome_trace(const std::string& path);
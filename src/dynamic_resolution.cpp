@@ -0,0 +1,26 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+void dynamic_resolution::update(double gpu_ms)
+{
+    if (gpu_ms <= 0.0) {
+        return;
+    }
+    this->average_ms = (this->average_ms < 0.0) ? gpu_ms : this->average_ms + (gpu_ms - this->average_ms) * this->smoothing;
+
+    double ratio = (this->target_ms * this->headroom) / this->average_ms;
+    if (std::abs(ratio - 1.0) < this->dead_band) {
+        return;
+    }
+
+    float wanted = this->scale * static_cast<float>(std::sqrt(ratio));
+    wanted = std::clamp(wanted, this->scale - this->max_step, this->scale + this->max_step);
+    this->scale = std::clamp(wanted, this->min_scale, this->max_scale);
+}
+
+float dynamic_resolution::get_scale() const
+{
+    return this->scale;
+}
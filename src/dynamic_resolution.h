@@ -0,0 +1,26 @@
+#pragma once
+
+/*
+ * picks the render scale each frame from measured gpu frame times so frames fit in target_ms.
+ * gpu time is taken to follow the pixel count, so the scale moves with the square root of how
+ * far off the target the smoothed time is, a limited step at a time to avoid oscillating
+ */
+class dynamic_resolution
+{
+private:
+    float scale = 1.0f;
+    double average_ms = -1.0;
+
+public:
+    double target_ms = 1000.0 / 60.0;
+    float min_scale = 0.5f;
+    float max_scale = 1.0f;
+    // aim under the target so spikes still fit, and leave the scale alone within the dead band
+    double headroom = 0.9;
+    double dead_band = 0.05;
+    float max_step = 0.05f;         // per update
+    double smoothing = 0.2;         // weight of the newest time in the average
+
+    void update(double gpu_ms);
+    float get_scale() const;
+};
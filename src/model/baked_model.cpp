@@ -0,0 +1,375 @@
+#include "baked_model.h"
+
+#include "gltf_model.h"
+#include "ktx2_texture.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+bool is_baked_model_path(const std::string& path)
+{
+    const std::string extension = BAKED_MODEL_EXTENSION;
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+template <typename T>
+static const T* get_table(const baked_model& model, uint64_t offset, uint32_t count, const char* name)
+{
+    if (offset % alignof(T) != 0 || offset > model.file.size || count * sizeof(T) > model.file.size - offset) {
+        throw std::runtime_error(std::string("baked model ") + name + " table lies outside of the file!");
+    }
+    return reinterpret_cast<const T*>(model.file.data + offset);
+}
+
+void open_baked_model(const std::string& abs_path, baked_model* out)
+{
+    *out = baked_model{};
+    if (!map_file(abs_path, &out->file)) {
+        throw std::runtime_error("failed to map baked model " + abs_path);
+    }
+
+    try {
+        if (out->file.size < sizeof(baked_header)) {
+            throw std::runtime_error("baked model is truncated!");
+        }
+        out->header = reinterpret_cast<const baked_header*>(out->file.data);
+        auto& header = *out->header;
+        if (std::memcmp(header.magic, BAKED_MODEL_MAGIC, sizeof(header.magic)) != 0) {
+            throw std::runtime_error("file is not a baked model!");
+        }
+        if (header.version != BAKED_MODEL_VERSION || header.vertex_stride != sizeof(vertex)) {
+            throw std::runtime_error("baked model was written by a different version, re-bake it!");
+        }
+
+        out->nodes = get_table<baked_node>(*out, header.node_offset, header.node_count, "node");
+        out->children = get_table<uint32_t>(*out, header.child_offset, header.child_count, "child");
+        out->roots = get_table<uint32_t>(*out, header.root_offset, header.root_count, "root");
+        out->materials = get_table<baked_material>(*out, header.material_offset, header.material_count, "material");
+        out->meshes = get_table<baked_mesh>(*out, header.mesh_offset, header.mesh_count, "mesh");
+        out->prims = get_table<baked_prim>(*out, header.prim_offset, header.prim_count, "primitive");
+        out->images = get_table<baked_image>(*out, header.image_offset, header.image_count, "image");
+        out->levels = get_table<baked_level>(*out, header.level_offset, header.level_count, "level");
+
+        if (header.blob_offset > out->file.size || header.blob_size > out->file.size - header.blob_offset) {
+            throw std::runtime_error("baked model blob lies outside of the file!");
+        }
+        out->blob = out->file.data + header.blob_offset;
+
+        /* make sure every reference stays inside the file so loading can trust it */
+        auto in_blob = [&](uint64_t offset, uint64_t size) {
+            return offset >= header.blob_offset && offset <= header.blob_offset + header.blob_size &&
+                   size <= header.blob_offset + header.blob_size - offset;
+        };
+        // count elements of element_size, checked before multiplying so a huge count can't wrap around
+        auto array_in_blob = [&](uint64_t offset, uint64_t count, uint64_t element_size) {
+            return count <= header.blob_size / element_size && in_blob(offset, count * element_size);
+        };
+        // -1 for none
+        auto is_valid_reference = [](int32_t index, uint32_t count) {
+            return index >= -1 && index < static_cast<int64_t>(count);
+        };
+        for (uint32_t i = 0; i < header.material_count; i++) {
+            auto& material = out->materials[i];
+            if (!is_valid_reference(material.color, header.image_count) ||
+                !is_valid_reference(material.emissive, header.image_count) ||
+                !is_valid_reference(material.metal_roughness, header.image_count) ||
+                !is_valid_reference(material.normal, header.image_count)) {
+                throw std::runtime_error("baked material " + std::to_string(i) + " is invalid!");
+            }
+        }
+        for (uint32_t i = 0; i < header.prim_count; i++) {
+            auto& prim = out->prims[i];
+            bool valid_index_type = (prim.index_type == VK_INDEX_TYPE_UINT16 || prim.index_type == VK_INDEX_TYPE_UINT32);
+            if (!valid_index_type ||
+                !array_in_blob(prim.vertex_offset, prim.vertex_count, header.vertex_stride) ||
+                !array_in_blob(prim.index_offset, prim.index_count, get_index_size(static_cast<VkIndexType>(prim.index_type))) ||
+                !is_valid_reference(prim.material, header.material_count)) {
+                throw std::runtime_error("baked primitive " + std::to_string(i) + " is invalid!");
+            }
+        }
+        for (uint32_t i = 0; i < header.mesh_count; i++) {
+            if (static_cast<uint64_t>(out->meshes[i].first_prim) + out->meshes[i].prim_count > header.prim_count) {
+                throw std::runtime_error("baked mesh " + std::to_string(i) + " is invalid!");
+            }
+        }
+        for (uint32_t i = 0; i < header.image_count; i++) {
+            auto& image = out->images[i];
+            if (!in_blob(image.data_offset, image.data_size) || image.level_count == 0 ||
+                static_cast<uint64_t>(image.first_level) + image.level_count > header.level_count) {
+                throw std::runtime_error("baked image " + std::to_string(i) + " is invalid!");
+            }
+            for (uint32_t l = 0; l < image.level_count; l++) {
+                auto& level = out->levels[image.first_level + l];
+                if (level.offset > image.data_size || level.byte_size > image.data_size - level.offset) {
+                    throw std::runtime_error("baked image " + std::to_string(i) + " has an invalid level!");
+                }
+            }
+        }
+        for (uint32_t i = 0; i < header.node_count; i++) {
+            auto& node = out->nodes[i];
+            if (static_cast<uint64_t>(node.first_child) + node.child_count > header.child_count ||
+                !is_valid_reference(node.mesh, header.mesh_count)) {
+                throw std::runtime_error("baked node " + std::to_string(i) + " is invalid!");
+            }
+        }
+        for (uint32_t i = 0; i < header.child_count; i++) {
+            if (out->children[i] >= header.node_count) {
+                throw std::runtime_error("baked node child " + std::to_string(i) + " is invalid!");
+            }
+        }
+        for (uint32_t i = 0; i < header.root_count; i++) {
+            if (out->roots[i] >= header.node_count) {
+                throw std::runtime_error("baked scene root " + std::to_string(i) + " is invalid!");
+            }
+        }
+    } catch (...) {
+        close_baked_model(*out);
+        throw;
+    }
+}
+
+void close_baked_model(baked_model& model)
+{
+    unmap_file(model.file);
+    model = baked_model{};
+}
+
+scene_table get_baked_scene_table(const baked_model& model)
+{
+    auto& header = *model.header;
+
+    scene_table table;
+    table.nodes.resize(header.node_count);
+    for (uint32_t i = 0; i < header.node_count; i++) {
+        auto& node = model.nodes[i];
+        std::memcpy(&table.nodes[i].local_transform, node.local_transform, sizeof(node.local_transform));
+        table.nodes[i].mesh = node.mesh;
+        table.nodes[i].first_child = node.first_child;
+        table.nodes[i].child_count = node.child_count;
+    }
+    table.children.assign(model.children, model.children + header.child_count);
+    table.roots.assign(model.roots, model.roots + header.root_count);
+    return table;
+}
+
+
+/* baking */
+
+static uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// appends a table to the table section and returns its file offset
+template <typename T>
+static uint64_t append_table(std::vector<unsigned char>& section, const std::vector<T>& table)
+{
+    uint64_t offset = align_up(section.size(), 8);
+    section.resize(offset + table.size() * sizeof(T), 0);
+    if (!table.empty()) {
+        std::memcpy(&section[offset], table.data(), table.size() * sizeof(T));
+    }
+    return offset;
+}
+
+static void write_at(std::ofstream& file, uint64_t offset, const void* data, size_t size)
+{
+    // the gap up to offset is padding, fill it with zeros
+    auto position = static_cast<uint64_t>(file.tellp());
+    static const char zeros[BAKED_MODEL_PAGE_SIZE] = {};
+    while (position < offset) {
+        auto count = static_cast<size_t>(std::min<uint64_t>(offset - position, sizeof(zeros)));
+        file.write(zeros, static_cast<std::streamsize>(count));
+        position += count;
+    }
+    file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+}
+
+static void bake_gltf_document(const gltf_document& document, const std::string& abs_output_path, const bake_options& options)
+{
+    auto& model = document.model;
+
+    /* process textures in parallel, each gets its full mip chain */
+    auto is_normal_map = find_normal_map_images(document);
+    std::vector<ktx2_texture> textures(model.images.size());
+    thread_pool pool;
+    pool.initialise(options.thread_count);
+    try {
+        pool.parallel_for(model.images.size(), [&](size_t i) {
+            auto& image = document.images[i];
+            if (image.size == 0) {
+                throw std::runtime_error("image " + model.images[i].uri + " has no data!");
+            }
+            auto usage = is_normal_map[i] ? texture_usage::NORMAL : texture_usage::COLOR;
+            if (is_ktx2_data(image.data, image.size)) {
+                textures[i] = read_ktx2(image.data, image.size);
+            } else if (options.compress_textures) {
+                textures[i] = compress_texture(image.data, image.size, usage, options.prefer_bc7, 1);
+            } else {
+                textures[i] = build_rgba_texture(image.data, image.size, usage);
+            }
+        });
+    } catch (...) {
+        pool.terminate();
+        throw;
+    }
+    pool.terminate();
+
+    /* flatten tables */
+    auto& scene = document.scene;
+    std::vector<baked_node> nodes(scene.nodes.size());
+    for (size_t i = 0; i < scene.nodes.size(); i++) {
+        std::memcpy(nodes[i].local_transform, &scene.nodes[i].local_transform, sizeof(nodes[i].local_transform));
+        nodes[i].mesh = scene.nodes[i].mesh;
+        nodes[i].first_child = scene.nodes[i].first_child;
+        nodes[i].child_count = scene.nodes[i].child_count;
+        nodes[i].pad = 0;
+    }
+
+    std::vector<baked_material> materials(model.materials.size(), baked_material{});
+    for (size_t i = 0; i < model.materials.size(); i++) {
+        auto& material = model.materials[i];
+        materials[i].color = get_texture_image_index(document, material.pbrMetallicRoughness.baseColorTexture.index);
+        materials[i].emissive = get_texture_image_index(document, material.emissiveTexture.index);
+        materials[i].metal_roughness = get_texture_image_index(document, material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+        materials[i].normal = get_texture_image_index(document, material.normalTexture.index);
+        materials[i].alpha_cutoff = get_material_alpha_cutoff(material);
+    }
+
+    std::vector<baked_mesh> meshes(model.meshes.size());
+    std::vector<baked_prim> prims;
+    std::vector<const tinygltf::Primitive*> source_prims;
+    for (size_t m = 0; m < model.meshes.size(); m++) {
+        meshes[m].first_prim = static_cast<uint32_t>(prims.size());
+        meshes[m].prim_count = static_cast<uint32_t>(model.meshes[m].primitives.size());
+        for (auto& source : model.meshes[m].primitives) {
+            baked_prim prim{};
+            // textures are only sampled when the primitive has texture coordinates
+            prim.material = (source.attributes.count("TEXCOORD_0") != 0) ? source.material : -1;
+            prim.vertex_count = get_prim_vertex_count(document, source);
+            prim.index_count = (source.indices >= 0) ? get_prim_index_count(document, source) : 0;
+            prim.index_type = (prim.index_count > 0) ? get_prim_index_type(document, source) : VK_INDEX_TYPE_UINT32;
+            auto b = get_prim_bounds(document, source);
+            std::memcpy(prim.bounds_min, &b.min, sizeof(prim.bounds_min));
+            std::memcpy(prim.bounds_max, &b.max, sizeof(prim.bounds_max));
+            prim.uv_density = get_prim_uv_density(document, source);
+            prim.flags = (source.attributes.count("COLOR_0") != 0) ? BAKED_PRIM_VERTEX_COLOR : 0;
+            prims.push_back(prim);
+            source_prims.push_back(&source);
+        }
+    }
+
+    std::vector<baked_image> images(textures.size());
+    std::vector<baked_level> levels;
+    for (size_t i = 0; i < textures.size(); i++) {
+        images[i].vk_format = static_cast<uint32_t>(textures[i].format);
+        images[i].width = textures[i].width;
+        images[i].height = textures[i].height;
+        images[i].first_level = static_cast<uint32_t>(levels.size());
+        images[i].level_count = static_cast<uint32_t>(textures[i].levels.size());
+        images[i].pad = 0;
+        images[i].data_size = textures[i].data.size();
+        for (auto& level : textures[i].levels) {
+            levels.push_back({level.offset, level.byte_size, level.width, level.height});
+        }
+    }
+
+    /* lay out the blob section, every blob starts on a page boundary */
+    baked_header header{};
+    std::memcpy(header.magic, BAKED_MODEL_MAGIC, sizeof(header.magic));
+    header.version = BAKED_MODEL_VERSION;
+    header.page_size = BAKED_MODEL_PAGE_SIZE;
+    header.vertex_stride = sizeof(vertex);
+    header.node_count = static_cast<uint32_t>(nodes.size());
+    header.child_count = static_cast<uint32_t>(scene.children.size());
+    header.root_count = static_cast<uint32_t>(scene.roots.size());
+    header.material_count = static_cast<uint32_t>(materials.size());
+    header.mesh_count = static_cast<uint32_t>(meshes.size());
+    header.prim_count = static_cast<uint32_t>(prims.size());
+    header.image_count = static_cast<uint32_t>(images.size());
+    header.level_count = static_cast<uint32_t>(levels.size());
+
+    // the section starts with space for the header so table offsets are file offsets
+    std::vector<unsigned char> tables(sizeof(baked_header), 0);
+    header.node_offset = append_table(tables, nodes);
+    header.child_offset = append_table(tables, scene.children);
+    header.root_offset = append_table(tables, scene.roots);
+    header.material_offset = append_table(tables, materials);
+    header.mesh_offset = append_table(tables, meshes);
+    header.prim_offset = append_table(tables, prims);
+    header.image_offset = append_table(tables, images);
+    header.level_offset = append_table(tables, levels);
+
+    header.blob_offset = align_up(tables.size(), BAKED_MODEL_PAGE_SIZE);
+    uint64_t cursor = header.blob_offset;
+    for (auto& prim : prims) {
+        prim.vertex_offset = cursor;
+        cursor = align_up(cursor + prim.vertex_count * sizeof(vertex), BAKED_MODEL_PAGE_SIZE);
+        prim.index_offset = cursor;
+        cursor = align_up(cursor + prim.index_count * get_index_size(static_cast<VkIndexType>(prim.index_type)), BAKED_MODEL_PAGE_SIZE);
+    }
+    for (auto& image : images) {
+        image.data_offset = cursor;
+        cursor = align_up(cursor + image.data_size, BAKED_MODEL_PAGE_SIZE);
+    }
+    header.blob_size = cursor - header.blob_offset;
+
+    // offsets changed after the tables were appended, rewrite them
+    std::memcpy(&tables[header.prim_offset], prims.data(), prims.size() * sizeof(baked_prim));
+    std::memcpy(&tables[header.image_offset], images.data(), images.size() * sizeof(baked_image));
+    std::memcpy(tables.data(), &header, sizeof(header));
+
+    /* write everything out */
+    std::string temp_path = abs_output_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + temp_path + " for writing!");
+        }
+        write_at(file, 0, tables.data(), tables.size());
+
+        std::vector<vertex> vertices;
+        std::vector<unsigned char> indices;
+        for (size_t i = 0; i < prims.size(); i++) {
+            vertices.resize(prims[i].vertex_count);
+            convert_prim_vertices(document, *source_prims[i], vertices.data(), 0, vertices.size());
+            write_at(file, prims[i].vertex_offset, vertices.data(), vertices.size() * sizeof(vertex));
+
+            if (prims[i].index_count > 0) {
+                auto index_type = static_cast<VkIndexType>(prims[i].index_type);
+                indices.resize(prims[i].index_count * get_index_size(index_type));
+                convert_prim_indices(document, *source_prims[i], index_type, indices.data());
+                write_at(file, prims[i].index_offset, indices.data(), indices.size());
+            }
+        }
+        for (size_t i = 0; i < images.size(); i++) {
+            write_at(file, images[i].data_offset, textures[i].data.data(), textures[i].data.size());
+        }
+        // pad the end so the blob section is a whole number of pages
+        write_at(file, header.blob_offset + header.blob_size, nullptr, 0);
+
+        if (!file) {
+            throw std::runtime_error("failed to write " + temp_path);
+        }
+    }
+    std::filesystem::rename(temp_path, abs_output_path);
+}
+
+void bake_gltf_model(const std::string& abs_gltf_path, const std::string& abs_output_path, const bake_options& options)
+{
+    gltf_document document;
+    std::string err, warn;
+    if (!load_gltf_document(abs_gltf_path, &document, &err, &warn)) {
+        throw std::runtime_error("failed to load " + abs_gltf_path + ": " + err);
+    }
+    try {
+        bake_gltf_document(document, abs_output_path, options);
+    } catch (...) {
+        close_gltf_document(document);
+        throw;
+    }
+    close_gltf_document(document);
+}
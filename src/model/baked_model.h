@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <platform.h>
+#include "scene_table.h"
+
+/*
+ * baked model format, written offline by discovery_bake and memory mapped at runtime.
+ *
+ *  [baked_header][tables...][page aligned blobs...]
+ *
+ * tables are tightly packed arrays of the structs below (each table 8 byte aligned),
+ * blobs hold gpu ready vertex/index data and pre-mipped texture levels, each starting
+ * on a page boundary so the blob section can be copied straight into staging memory.
+ * all offsets are absolute file offsets. data is stored in host (little endian) order.
+ */
+
+#define BAKED_MODEL_MAGIC "DSCBAKE"
+#define BAKED_MODEL_VERSION 4
+#define BAKED_MODEL_PAGE_SIZE 4096
+#define BAKED_MODEL_EXTENSION ".dbake"
+
+struct baked_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t vertex_stride;     // sizeof(vertex) when baked, must match the runtime
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t root_count;
+    uint32_t material_count;
+    uint32_t mesh_count;
+    uint32_t prim_count;
+    uint32_t image_count;
+    uint32_t level_count;
+    uint32_t pad;
+    uint64_t node_offset;
+    uint64_t child_offset;
+    uint64_t root_offset;
+    uint64_t material_offset;
+    uint64_t mesh_offset;
+    uint64_t prim_offset;
+    uint64_t image_offset;
+    uint64_t level_offset;
+    uint64_t blob_offset;
+    uint64_t blob_size;
+};
+
+struct baked_node {
+    float local_transform[16];
+    int32_t mesh;
+    uint32_t first_child;
+    uint32_t child_count;
+    uint32_t pad;
+};
+
+// image indexes, -1 when unused
+struct baked_material {
+    int32_t color;
+    int32_t emissive;
+    int32_t metal_roughness;
+    int32_t normal;
+    float alpha_cutoff;         // see get_material_alpha_cutoff
+    uint32_t pad;
+};
+
+struct baked_mesh {
+    uint32_t first_prim;
+    uint32_t prim_count;
+};
+
+struct baked_prim {
+    int32_t material;
+    uint32_t index_type;        // a VkIndexType, 16 or 32 bit
+    uint64_t vertex_count;
+    uint64_t index_count;       // 0 when not indexed
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    float bounds_min[3];
+    float bounds_max[3];
+    float uv_density;           // see get_prim_uv_density
+    uint32_t flags;             // BAKED_PRIM_* bits
+};
+
+#define BAKED_PRIM_VERTEX_COLOR 0x1u
+
+struct baked_image {
+    uint32_t vk_format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t first_level;
+    uint32_t level_count;
+    uint32_t pad;
+    uint64_t data_offset;
+    uint64_t data_size;
+};
+
+// offset is relative to the owning image's data_offset
+struct baked_level {
+    uint64_t offset;
+    uint64_t byte_size;
+    uint32_t width;
+    uint32_t height;
+};
+
+// a mapped baked model, every pointer points into the mapping
+struct baked_model {
+    mapped_file file;
+    const baked_header* header = nullptr;
+    const baked_node* nodes = nullptr;
+    const uint32_t* children = nullptr;
+    const uint32_t* roots = nullptr;
+    const baked_material* materials = nullptr;
+    const baked_mesh* meshes = nullptr;
+    const baked_prim* prims = nullptr;
+    const baked_image* images = nullptr;
+    const baked_level* levels = nullptr;
+    const unsigned char* blob = nullptr;
+};
+
+bool is_baked_model_path(const std::string& path);
+
+// maps and validates a baked model, throws on failure
+void open_baked_model(const std::string& abs_path, baked_model* out);
+void close_baked_model(baked_model& model);
+
+scene_table get_baked_scene_table(const baked_model& model);
+
+struct bake_options {
+    bool compress_textures = false;     // BCn, otherwise rgba8
+    bool prefer_bc7 = false;
+    uint32_t thread_count = 0;
+};
+
+// loads a .gltf/.glb file and writes it out as a baked model, throws on failure
+void bake_gltf_model(const std::string& abs_gltf_path, const std::string& abs_output_path, const bake_options& options);
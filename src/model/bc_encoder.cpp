@@ -0,0 +1,428 @@
+#include "bc_encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+/* helpers */
+
+struct block_texels {
+    uint8_t rgba[16][4];
+};
+
+static void fetch_block(const unsigned char* rgba, uint32_t width, uint32_t height, uint32_t bx, uint32_t by, block_texels& block)
+{
+    // texels outside of the image are clamped to the edge so partial blocks encode sensibly
+    for (uint32_t y = 0; y < 4; y++) {
+        uint32_t sy = std::min(by * 4 + y, height - 1);
+        for (uint32_t x = 0; x < 4; x++) {
+            uint32_t sx = std::min(bx * 4 + x, width - 1);
+            std::memcpy(block.rgba[y * 4 + x], &rgba[(sy * width + sx) * 4], 4);
+        }
+    }
+}
+
+/* finds the two texels at either end of the principal axis of the block over the first n channels */
+template <int N>
+static void find_principal_extremes(const block_texels& block, int& min_index, int& max_index)
+{
+    float mean[N] = {};
+    for (const auto& t : block.rgba) {
+        for (int c = 0; c < N; c++) mean[c] += t[c];
+    }
+    for (float& m : mean) m /= 16.0f;
+
+    float cov[N][N] = {};
+    for (const auto& t : block.rgba) {
+        float d[N];
+        for (int c = 0; c < N; c++) d[c] = t[c] - mean[c];
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) cov[i][j] += d[i] * d[j];
+        }
+    }
+
+    // a few rounds of power iteration is plenty for 16 texels
+    float axis[N];
+    for (float& a : axis) a = 1.0f;
+    for (int iter = 0; iter < 6; iter++) {
+        float next[N] = {};
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < N; j++) next[i] += cov[i][j] * axis[j];
+        }
+        float len = 0.0f;
+        for (float v : next) len = std::max(len, std::fabs(v));
+        if (len < 1e-6f) break;
+        for (int i = 0; i < N; i++) axis[i] = next[i] / len;
+    }
+
+    float min_proj = 1e30f, max_proj = -1e30f;
+    min_index = max_index = 0;
+    for (int i = 0; i < 16; i++) {
+        float proj = 0.0f;
+        for (int c = 0; c < N; c++) proj += block.rgba[i][c] * axis[c];
+        if (proj < min_proj) { min_proj = proj; min_index = i; }
+        if (proj > max_proj) { max_proj = proj; max_index = i; }
+    }
+}
+
+static inline int squared_distance(const uint8_t* a, const int* b, int channels)
+{
+    int dist = 0;
+    for (int c = 0; c < channels; c++) {
+        int d = static_cast<int>(a[c]) - b[c];
+        dist += d * d;
+    }
+    return dist;
+}
+
+static inline void write_u16(unsigned char* out, uint16_t v)
+{
+    out[0] = static_cast<unsigned char>(v & 0xFF);
+    out[1] = static_cast<unsigned char>(v >> 8);
+}
+
+static inline void write_u32(unsigned char* out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) out[i] = static_cast<unsigned char>((v >> (8 * i)) & 0xFF);
+}
+
+
+/* BC1 colour block, also used as the colour half of BC3 */
+
+static inline uint16_t pack_565(const uint8_t* c)
+{
+    uint16_t r = static_cast<uint16_t>((c[0] * 31 + 127) / 255);
+    uint16_t g = static_cast<uint16_t>((c[1] * 63 + 127) / 255);
+    uint16_t b = static_cast<uint16_t>((c[2] * 31 + 127) / 255);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static inline void unpack_565(uint16_t v, int* c)
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+static void encode_color_block(const block_texels& block, unsigned char* out)
+{
+    int min_i, max_i;
+    find_principal_extremes<3>(block, min_i, max_i);
+
+    uint16_t c0 = pack_565(block.rgba[max_i]);
+    uint16_t c1 = pack_565(block.rgba[min_i]);
+    if (c0 < c1) std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        // c0 > c1 selects the four colour (opaque) palette
+        int palette[4][3];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_dist = squared_distance(block.rgba[i], palette[0], 3);
+            for (int p = 1; p < 4; p++) {
+                int dist = squared_distance(block.rgba[i], palette[p], 3);
+                if (dist < best_dist) { best_dist = dist; best = p; }
+            }
+            indices |= static_cast<uint32_t>(best) << (2 * i);
+        }
+    }
+
+    write_u16(out + 0, c0);
+    write_u16(out + 2, c1);
+    write_u32(out + 4, indices);
+}
+
+
+/* BC4 style single channel block, used for BC3 alpha and both halves of BC5 */
+
+static void encode_channel_block(const uint8_t values[16], unsigned char* out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, static_cast<int>(values[i]));
+        a1 = std::min(a1, static_cast<int>(values[i]));
+    }
+
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        // a0 > a1 selects the eight value palette
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (int i = 2; i < 8; i++) {
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_dist = std::abs(values[i] - palette[0]);
+            for (int p = 1; p < 8; p++) {
+                int dist = std::abs(values[i] - palette[p]);
+                if (dist < best_dist) { best_dist = dist; best = p; }
+            }
+            indices |= static_cast<uint64_t>(best) << (3 * i);
+        }
+    }
+
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = static_cast<unsigned char>((indices >> (8 * i)) & 0xFF);
+    }
+}
+
+
+/* BC7, mode 6 only (single subset, 7777.1 rgba endpoints, 4 bit indices) */
+
+struct bit_writer {
+    unsigned char* out;
+    uint32_t position = 0;
+
+    void write(uint32_t value, uint32_t bits) {
+        for (uint32_t i = 0; i < bits; i++, position++) {
+            if ((value >> i) & 1u) {
+                out[position / 8] |= static_cast<unsigned char>(1u << (position % 8));
+            }
+        }
+    }
+};
+
+static void quantize_bc7_endpoint(const uint8_t* endpoint, int* quantized, int& pbit, int* reconstructed)
+{
+    int best_err = -1;
+    for (int p = 0; p < 2; p++) {
+        int q[4], r[4], err = 0;
+        for (int c = 0; c < 4; c++) {
+            q[c] = std::clamp((static_cast<int>(endpoint[c]) - p + 1) / 2, 0, 127);
+            r[c] = (q[c] << 1) | p;
+            err += (r[c] - endpoint[c]) * (r[c] - endpoint[c]);
+        }
+        if (best_err < 0 || err < best_err) {
+            best_err = err;
+            pbit = p;
+            std::memcpy(quantized, q, sizeof(q));
+            std::memcpy(reconstructed, r, sizeof(r));
+        }
+    }
+}
+
+static void encode_bc7_block(const block_texels& block, unsigned char* out)
+{
+    static const int weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+    int min_i, max_i;
+    find_principal_extremes<4>(block, min_i, max_i);
+
+    int q[2][4], r[2][4], p[2];
+    quantize_bc7_endpoint(block.rgba[min_i], q[0], p[0], r[0]);
+    quantize_bc7_endpoint(block.rgba[max_i], q[1], p[1], r[1]);
+
+    int palette[16][4];
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            palette[i][c] = ((64 - weights[i]) * r[0][c] + weights[i] * r[1][c] + 32) >> 6;
+        }
+    }
+
+    int indices[16];
+    for (int i = 0; i < 16; i++) {
+        int best = 0, best_dist = squared_distance(block.rgba[i], palette[0], 4);
+        for (int pi = 1; pi < 16; pi++) {
+            int dist = squared_distance(block.rgba[i], palette[pi], 4);
+            if (dist < best_dist) { best_dist = dist; best = pi; }
+        }
+        indices[i] = best;
+    }
+
+    // the anchor index (texel 0) is stored with an implicit zero msb, flip the endpoints if needed
+    if (indices[0] >= 8) {
+        std::swap(q[0], q[1]);
+        std::swap(p[0], p[1]);
+        for (int& index : indices) index = 15 - index;
+    }
+
+    std::memset(out, 0, 16);
+    bit_writer writer{out};
+    writer.write(1u << 6, 7); // mode 6
+    for (int c = 0; c < 4; c++) {
+        writer.write(static_cast<uint32_t>(q[0][c]), 7);
+        writer.write(static_cast<uint32_t>(q[1][c]), 7);
+    }
+    writer.write(static_cast<uint32_t>(p[0]), 1);
+    writer.write(static_cast<uint32_t>(p[1]), 1);
+    writer.write(static_cast<uint32_t>(indices[0]), 3);
+    for (int i = 1; i < 16; i++) {
+        writer.write(static_cast<uint32_t>(indices[i]), 4);
+    }
+}
+
+
+static void encode_block(const block_texels& block, bc_format format, unsigned char* out)
+{
+    switch (format) {
+        case bc_format::BC1: {
+            encode_color_block(block, out);
+        } break;
+        case bc_format::BC3: {
+            uint8_t alpha[16];
+            for (int i = 0; i < 16; i++) alpha[i] = block.rgba[i][3];
+            encode_channel_block(alpha, out);
+            encode_color_block(block, out + 8);
+        } break;
+        case bc_format::BC5: {
+            uint8_t red[16], green[16];
+            for (int i = 0; i < 16; i++) {
+                red[i] = block.rgba[i][0];
+                green[i] = block.rgba[i][1];
+            }
+            encode_channel_block(red, out);
+            encode_channel_block(green, out + 8);
+        } break;
+        case bc_format::BC7: {
+            encode_bc7_block(block, out);
+        } break;
+    }
+}
+
+
+/* public interface */
+
+size_t bc_block_byte_size(bc_format format)
+{
+    return (format == bc_format::BC1) ? 8 : 16;
+}
+
+size_t bc_level_byte_size(bc_format format, uint32_t width, uint32_t height)
+{
+    size_t blocks_x = (width + 3) / 4;
+    size_t blocks_y = (height + 3) / 4;
+    return blocks_x * blocks_y * bc_block_byte_size(format);
+}
+
+bool rgba_has_alpha(const unsigned char* rgba, uint32_t width, uint32_t height)
+{
+    size_t texel_count = static_cast<size_t>(width) * height;
+    for (size_t i = 0; i < texel_count; i++) {
+        if (rgba[i * 4 + 3] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static float srgb_to_linear(float v)
+{
+    return (v <= 0.04045f) ? (v / 12.92f) : std::pow((v + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(float v)
+{
+    return (v <= 0.0031308f) ? (v * 12.92f) : (1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f);
+}
+
+static inline unsigned char to_unorm8(float v)
+{
+    return static_cast<unsigned char>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+std::vector<rgba_mip_level> build_rgba_mip_chain(const unsigned char* rgba, uint32_t width, uint32_t height, bool is_srgb, bool is_normal_map)
+{
+    float to_linear[256];
+    for (int i = 0; i < 256; i++) {
+        to_linear[i] = is_srgb ? srgb_to_linear(i / 255.0f) : (i / 255.0f);
+    }
+
+    std::vector<rgba_mip_level> levels;
+    levels.push_back({width, height, std::vector<unsigned char>(rgba, rgba + static_cast<size_t>(width) * height * 4)});
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const rgba_mip_level& src = levels.back();
+        rgba_mip_level dst;
+        dst.width = std::max(1u, src.width / 2);
+        dst.height = std::max(1u, src.height / 2);
+        dst.pixels.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+        for (uint32_t y = 0; y < dst.height; y++) {
+            for (uint32_t x = 0; x < dst.width; x++) {
+                float sum[4] = {};
+                for (uint32_t sy = 0; sy < 2; sy++) {
+                    for (uint32_t sx = 0; sx < 2; sx++) {
+                        uint32_t px = std::min(x * 2 + sx, src.width - 1);
+                        uint32_t py = std::min(y * 2 + sy, src.height - 1);
+                        const unsigned char* texel = &src.pixels[(static_cast<size_t>(py) * src.width + px) * 4];
+                        for (int c = 0; c < 3; c++) sum[c] += to_linear[texel[c]];
+                        sum[3] += texel[3] / 255.0f;
+                    }
+                }
+                for (float& s : sum) s *= 0.25f;
+
+                unsigned char* out = &dst.pixels[(static_cast<size_t>(y) * dst.width + x) * 4];
+                if (is_normal_map) {
+                    float n[3], len = 0.0f;
+                    for (int c = 0; c < 3; c++) {
+                        n[c] = sum[c] * 2.0f - 1.0f;
+                        len += n[c] * n[c];
+                    }
+                    len = (len > 1e-8f) ? std::sqrt(len) : 1.0f;
+                    for (int c = 0; c < 3; c++) out[c] = to_unorm8((n[c] / len) * 0.5f + 0.5f);
+                } else {
+                    for (int c = 0; c < 3; c++) out[c] = to_unorm8(is_srgb ? linear_to_srgb(sum[c]) : sum[c]);
+                }
+                out[3] = to_unorm8(sum[3]);
+            }
+        }
+        levels.push_back(std::move(dst));
+    }
+    return levels;
+}
+
+std::vector<unsigned char> encode_bc(const unsigned char* rgba, uint32_t width, uint32_t height, bc_format format, uint32_t thread_count)
+{
+    uint32_t blocks_x = (width + 3) / 4;
+    uint32_t blocks_y = (height + 3) / 4;
+    size_t block_size = bc_block_byte_size(format);
+    std::vector<unsigned char> output(static_cast<size_t>(blocks_x) * blocks_y * block_size);
+
+    auto encode_rows = [&](uint32_t row_start, uint32_t row_end) {
+        block_texels block;
+        for (uint32_t by = row_start; by < row_end; by++) {
+            for (uint32_t bx = 0; bx < blocks_x; bx++) {
+                fetch_block(rgba, width, height, bx, by, block);
+                encode_block(block, format, &output[(static_cast<size_t>(by) * blocks_x + bx) * block_size]);
+            }
+        }
+    };
+
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    thread_count = std::min(thread_count, blocks_y);
+
+    if (thread_count <= 1) {
+        encode_rows(0, blocks_y);
+    } else {
+        // split block rows evenly, each thread writes a disjoint range of the output
+        std::vector<std::thread> threads;
+        uint32_t rows_per_thread = (blocks_y + thread_count - 1) / thread_count;
+        for (uint32_t t = 0; t < thread_count; t++) {
+            uint32_t start = t * rows_per_thread;
+            uint32_t end = std::min(blocks_y, start + rows_per_thread);
+            if (start < end) {
+                threads.emplace_back(encode_rows, start, end);
+            }
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    return output;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+/*
+ * cpu block compression encoders for the BCn formats the renderer can sample.
+ * all encoders take tightly packed 8 bit rgba texels and produce the raw block
+ * stream (row major, 4x4 texel blocks) ready to be copied into a vulkan image.
+ */
+
+enum class bc_format {
+    BC1,    // rgb, 1 bit alpha, 8 bytes per block
+    BC3,    // rgba, 16 bytes per block
+    BC5,    // two channel (rg), 16 bytes per block, used for normal maps
+    BC7     // rgba, 16 bytes per block, higher quality than BC1/BC3
+};
+
+struct rgba_mip_level {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<unsigned char> pixels;
+};
+
+size_t bc_block_byte_size(bc_format format);
+size_t bc_level_byte_size(bc_format format, uint32_t width, uint32_t height);
+
+// returns true if any texel has an alpha value other than 255
+bool rgba_has_alpha(const unsigned char* rgba, uint32_t width, uint32_t height);
+
+// builds a full mip chain (level 0 first) using a box filter. srgb data is filtered in linear space
+// and normal maps are renormalised after each downsample
+std::vector<rgba_mip_level> build_rgba_mip_chain(const unsigned char* rgba, uint32_t width, uint32_t height, bool is_srgb, bool is_normal_map);
+
+// encodes a single level, block rows are split across thread_count threads (0 = hardware concurrency)
+std::vector<unsigned char> encode_bc(const unsigned char* rgba, uint32_t width, uint32_t height, bc_format format, uint32_t thread_count = 0);
@@ -0,0 +1,344 @@
+#include "gltf_accessor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(DISCOVERY_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#   define ACCESSOR_SSE2
+#   include <emmintrin.h>
+#endif
+
+accessor_view get_accessor_view(const gltf_document& document, int accessor_index)
+{
+    auto& accessor = document.model.accessors.at(accessor_index);
+    if (accessor.sparse.isSparse) {
+        throw std::runtime_error("accessor " + std::to_string(accessor_index) + " is sparse, sparse accessors are not supported");
+    }
+
+    accessor_view view;
+    view.count = accessor.count;
+    view.component_type = accessor.componentType;
+    view.normalized = accessor.normalized;
+    int component_count = tinygltf::GetNumComponentsInType(accessor.type);
+    int component_size = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+    if (component_count <= 0 || component_size <= 0) {
+        throw std::runtime_error("accessor " + std::to_string(accessor_index) + " has an invalid type");
+    }
+    view.component_count = static_cast<uint32_t>(component_count);
+    size_t element_size = static_cast<size_t>(component_count) * component_size;
+
+    // no buffer view means every element is zero
+    if (accessor.bufferView < 0) {
+        view.stride = element_size;
+        return view;
+    }
+
+    int stride = accessor.ByteStride(document.model.bufferViews.at(accessor.bufferView));
+    if (stride <= 0 || (view.count > 1 && static_cast<size_t>(stride) < element_size)) {
+        throw std::runtime_error("accessor " + std::to_string(accessor_index) + " has an invalid byte stride");
+    }
+    view.stride = static_cast<size_t>(stride);
+    // the last element only needs to be as long as the element itself, not a whole stride
+    view.byte_range = (view.count > 0) ? (view.count - 1) * view.stride + element_size : 0;
+    view.data = get_buffer_view_data(document, accessor.bufferView, accessor.byteOffset, view.byte_range);
+    return view;
+}
+
+/* scalar path, also used for the tails the simd loads can't reach */
+
+static float decode_component(const unsigned char* src, int component_type, bool normalized)
+{
+    switch (component_type) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+        float value;
+        std::memcpy(&value, src, sizeof(value));
+        return value;
+    }
+    case TINYGLTF_COMPONENT_TYPE_BYTE: {
+        auto value = static_cast<int8_t>(*src);
+        return normalized ? std::max(value / 127.0f, -1.0f) : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return normalized ? (*src / 255.0f) : static_cast<float>(*src);
+    case TINYGLTF_COMPONENT_TYPE_SHORT: {
+        int16_t value;
+        std::memcpy(&value, src, sizeof(value));
+        return normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+        uint16_t value;
+        std::memcpy(&value, src, sizeof(value));
+        return normalized ? (value / 65535.0f) : static_cast<float>(value);
+    }
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+        uint32_t value;
+        std::memcpy(&value, src, sizeof(value));
+        return static_cast<float>(value);
+    }
+    default:
+        throw std::runtime_error("unsupported accessor component type " + std::to_string(component_type));
+    }
+}
+
+static float* dst_element(float* dst, size_t dst_stride, size_t i)
+{
+    return reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(dst) + i * dst_stride);
+}
+
+static void decode_floats_scalar(const accessor_view& view, size_t first, size_t count, float* dst, size_t dst_stride, uint32_t dst_components)
+{
+    size_t component_size = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(view.component_type));
+    uint32_t components = std::min(view.component_count, dst_components);
+    for (size_t i = 0; i < count; i++) {
+        const unsigned char* src = view.data + (first + i) * view.stride;
+        float* out = dst_element(dst, dst_stride, i);
+        for (uint32_t c = 0; c < components; c++) {
+            out[c] = decode_component(src + c * component_size, view.component_type, view.normalized);
+        }
+        for (uint32_t c = components; c < dst_components; c++) {
+            out[c] = 0.0f;
+        }
+    }
+}
+
+#ifdef ACCESSOR_SSE2
+
+/* each loader turns one element into 4 float lanes, reading load_size bytes */
+
+struct load_f32 {
+    static constexpr size_t load_size = 16;
+    __m128 operator()(const unsigned char* src) const { return _mm_loadu_ps(reinterpret_cast<const float*>(src)); }
+};
+
+struct load_u8 {
+    static constexpr size_t load_size = 4;
+    __m128 scale;
+    __m128 operator()(const unsigned char* src) const
+    {
+        int32_t bytes;
+        std::memcpy(&bytes, src, sizeof(bytes));
+        __m128i zero = _mm_setzero_si128();
+        __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+    }
+};
+
+struct load_i8 {
+    static constexpr size_t load_size = 4;
+    __m128 scale;
+    bool normalized;
+    __m128 operator()(const unsigned char* src) const
+    {
+        int32_t bytes;
+        std::memcpy(&bytes, src, sizeof(bytes));
+        // duplicate into both halves then arithmetic shift to sign extend
+        __m128i v = _mm_cvtsi32_si128(bytes);
+        v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+        return normalized ? _mm_max_ps(f, _mm_set1_ps(-1.0f)) : f;
+    }
+};
+
+struct load_u16 {
+    static constexpr size_t load_size = 8;
+    __m128 scale;
+    __m128 operator()(const unsigned char* src) const
+    {
+        __m128i v = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_setzero_si128());
+        return _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+    }
+};
+
+struct load_i16 {
+    static constexpr size_t load_size = 8;
+    __m128 scale;
+    bool normalized;
+    __m128 operator()(const unsigned char* src) const
+    {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+        v = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(v), scale);
+        return normalized ? _mm_max_ps(f, _mm_set1_ps(-1.0f)) : f;
+    }
+};
+
+static void store_lanes(float* out, __m128 v, uint32_t count)
+{
+    switch (count) {
+    case 4: _mm_storeu_ps(out, v); break;
+    case 3:
+        _mm_storel_pi(reinterpret_cast<__m64*>(out), v);
+        _mm_store_ss(out + 2, _mm_movehl_ps(v, v));
+        break;
+    case 2: _mm_storel_pi(reinterpret_cast<__m64*>(out), v); break;
+    case 1: _mm_store_ss(out, v); break;
+    default: break;
+    }
+}
+
+// decodes as many elements as the wide loads can reach without reading past the accessor, returns how many
+template <typename Load>
+static size_t decode_floats_sse2(const accessor_view& view, size_t first, size_t count, float* dst, size_t dst_stride, uint32_t dst_components, const Load& load)
+{
+    if (view.byte_range < Load::load_size) {
+        return 0;
+    }
+    size_t last_reachable = (view.byte_range - Load::load_size) / view.stride;
+    if (last_reachable < first) {
+        return 0;
+    }
+    size_t simd_count = std::min(count, last_reachable - first + 1);
+
+    // lanes past the accessor's component count are zeroed
+    alignas(16) static const uint32_t lane_masks[5][4] = {
+        {0, 0, 0, 0}, {~0u, 0, 0, 0}, {~0u, ~0u, 0, 0}, {~0u, ~0u, ~0u, 0}, {~0u, ~0u, ~0u, ~0u},
+    };
+    __m128 mask = _mm_load_ps(reinterpret_cast<const float*>(lane_masks[std::min(view.component_count, 4u)]));
+
+    const unsigned char* src = view.data + first * view.stride;
+    for (size_t i = 0; i < simd_count; i++) {
+        __m128 v = _mm_and_ps(load(src), mask);
+        store_lanes(dst_element(dst, dst_stride, i), v, std::min(dst_components, 4u));
+        src += view.stride;
+    }
+    return simd_count;
+}
+
+static size_t decode_floats_simd(const accessor_view& view, size_t first, size_t count, float* dst, size_t dst_stride, uint32_t dst_components)
+{
+    if (dst_components > 4) {
+        return 0;
+    }
+    auto scale = [&](float normalized_scale) { return _mm_set1_ps(view.normalized ? normalized_scale : 1.0f); };
+    switch (view.component_type) {
+    case TINYGLTF_COMPONENT_TYPE_FLOAT:
+        return decode_floats_sse2(view, first, count, dst, dst_stride, dst_components, load_f32{});
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        return decode_floats_sse2(view, first, count, dst, dst_stride, dst_components, load_u8{scale(1.0f / 255.0f)});
+    case TINYGLTF_COMPONENT_TYPE_BYTE:
+        return decode_floats_sse2(view, first, count, dst, dst_stride, dst_components, load_i8{scale(1.0f / 127.0f), view.normalized});
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        return decode_floats_sse2(view, first, count, dst, dst_stride, dst_components, load_u16{scale(1.0f / 65535.0f)});
+    case TINYGLTF_COMPONENT_TYPE_SHORT:
+        return decode_floats_sse2(view, first, count, dst, dst_stride, dst_components, load_i16{scale(1.0f / 32767.0f), view.normalized});
+    default:
+        return 0;
+    }
+}
+
+#endif
+
+void decode_accessor_floats(const accessor_view& view, size_t first, size_t count, float* dst, size_t dst_stride, uint32_t dst_components)
+{
+    if (first > view.count || count > view.count - first) {
+        throw std::runtime_error("accessor decode range is out of bounds");
+    }
+
+    if (view.data == nullptr) {
+        for (size_t i = 0; i < count; i++) {
+            std::memset(dst_element(dst, dst_stride, i), 0, dst_components * sizeof(float));
+        }
+        return;
+    }
+
+    size_t done = 0;
+#ifdef ACCESSOR_SSE2
+    done = decode_floats_simd(view, first, count, dst, dst_stride, dst_components);
+#endif
+    if (done < count) {
+        decode_floats_scalar(view, first + done, count - done, dst_element(dst, dst_stride, done), dst_stride, dst_components);
+    }
+}
+
+float decode_accessor_bound(const accessor_view& view, double value)
+{
+    if (!view.normalized) {
+        return static_cast<float>(value);
+    }
+    switch (view.component_type) {
+    case TINYGLTF_COMPONENT_TYPE_BYTE: return std::max(static_cast<float>(value / 127.0), -1.0f);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: return static_cast<float>(value / 255.0);
+    case TINYGLTF_COMPONENT_TYPE_SHORT: return std::max(static_cast<float>(value / 32767.0), -1.0f);
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: return static_cast<float>(value / 65535.0);
+    default: return static_cast<float>(value);
+    }
+}
+
+VkIndexType get_accessor_index_type(const accessor_view& view)
+{
+    return (view.component_type == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
+}
+
+template <typename In, typename Out>
+static void widen_indices(const accessor_view& view, Out* out)
+{
+    for (size_t i = 0; i < view.count; i++) {
+        In value;
+        std::memcpy(&value, view.data + i * view.stride, sizeof(In));
+        out[i] = static_cast<Out>(value);
+    }
+}
+
+// the common case, 8 bit indices widened 16 at a time
+static void widen_u8_to_u16(const unsigned char* src, size_t count, uint16_t* out)
+{
+    size_t i = 0;
+#ifdef ACCESSOR_SSE2
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = src[i];
+    }
+}
+
+void decode_accessor_indices(const accessor_view& view, VkIndexType type, void* dst)
+{
+    size_t out_size = (type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+    if (view.data == nullptr) {
+        std::memset(dst, 0, view.count * out_size);
+        return;
+    }
+    if (view.component_count != 1) {
+        throw std::runtime_error("index accessors must be scalar");
+    }
+
+    switch (view.component_type) {
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+        if (type == VK_INDEX_TYPE_UINT16 && view.stride == 1) {
+            widen_u8_to_u16(view.data, view.count, static_cast<uint16_t*>(dst));
+        } else if (type == VK_INDEX_TYPE_UINT16) {
+            widen_indices<uint8_t>(view, static_cast<uint16_t*>(dst));
+        } else {
+            widen_indices<uint8_t>(view, static_cast<uint32_t*>(dst));
+        }
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+        if (type == VK_INDEX_TYPE_UINT16 && view.stride == sizeof(uint16_t)) {
+            std::memcpy(dst, view.data, view.count * sizeof(uint16_t));   // straight through
+        } else if (type == VK_INDEX_TYPE_UINT16) {
+            widen_indices<uint16_t>(view, static_cast<uint16_t*>(dst));
+        } else {
+            widen_indices<uint16_t>(view, static_cast<uint32_t*>(dst));
+        }
+        break;
+    case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+        if (type != VK_INDEX_TYPE_UINT32) {
+            throw std::runtime_error("32 bit indices can't be narrowed");
+        }
+        if (view.stride == sizeof(uint32_t)) {
+            std::memcpy(dst, view.data, view.count * sizeof(uint32_t));
+        } else {
+            widen_indices<uint32_t>(view, static_cast<uint32_t*>(dst));
+        }
+        break;
+    default:
+        throw std::runtime_error("unsupported index component type " + std::to_string(view.component_type));
+    }
+}
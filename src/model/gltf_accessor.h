@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "gltf_document.h"
+
+/*
+ * glTF accessor decoding. handles byteStride, every component type and normalized
+ * integers (so KHR_mesh_quantization data loads), with SSE2 kernels where available
+ * and a scalar path everywhere else. define DISCOVERY_NO_SIMD to force the scalar path.
+ */
+
+struct accessor_view {
+    const unsigned char* data = nullptr;    // first element, nullptr when the accessor has no buffer view (all zeros)
+    size_t byte_range = 0;                  // bytes readable from data
+    size_t stride = 0;
+    size_t count = 0;
+    int component_type = 0;
+    uint32_t component_count = 0;
+    bool normalized = false;
+};
+
+// throws if the accessor is sparse or reads outside of its buffer
+accessor_view get_accessor_view(const gltf_document& document, int accessor_index);
+
+// decodes elements [first, first + count) to floats. dst_components floats are written per
+// element, dst_stride bytes apart, components the accessor doesn't have are zeroed
+void decode_accessor_floats(const accessor_view& view, size_t first, size_t count, float* dst, size_t dst_stride, uint32_t dst_components);
+
+// applies the same normalization to an accessor min/max value, which are stored unnormalized
+float decode_accessor_bound(const accessor_view& view, double value);
+
+// 8 and 16 bit indices are uploaded as 16 bit, 32 bit indices stay 32 bit
+VkIndexType get_accessor_index_type(const accessor_view& view);
+void decode_accessor_indices(const accessor_view& view, VkIndexType type, void* dst);
@@ -0,0 +1,208 @@
+#include "gltf_document.h"
+#include "gltf_json_parser.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#define GLB_MAGIC 0x46546C67u           // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534Au      // "JSON"
+#define GLB_CHUNK_BIN 0x004E4942u       // "BIN\0"
+
+static uint32_t read_u32(const unsigned char* data)
+{
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static bool ends_with(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static bool is_data_uri(const std::string& uri)
+{
+    return uri.compare(0, 5, "data:") == 0;
+}
+
+// only base64 data uris are valid in glTF
+static void decode_data_uri(const std::string& uri, std::vector<unsigned char>* out)
+{
+    size_t comma = uri.find(',');
+    if (comma == std::string::npos || comma < 7 || uri.compare(comma - 7, 7, ";base64") != 0) {
+        throw std::runtime_error("only base64 data uris are supported!");
+    }
+
+    static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    out->clear();
+    out->reserve((uri.size() - comma) / 4 * 3);
+    uint32_t bits = 0;
+    int bit_count = 0;
+    for (size_t i = comma + 1; i < uri.size() && uri[i] != '='; i++) {
+        size_t value = alphabet.find(uri[i]);
+        if (value == std::string::npos) {
+            throw std::runtime_error("invalid character in base64 data uri!");
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            out->push_back(static_cast<unsigned char>((bits >> bit_count) & 0xFF));
+        }
+    }
+}
+
+// uris are percent encoded, file names are not
+static std::string url_decode(const std::string& uri)
+{
+    std::string decoded;
+    decoded.reserve(uri.size());
+    for (size_t i = 0; i < uri.size(); i++) {
+        if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i+1]))
+                                                && std::isxdigit(static_cast<unsigned char>(uri[i+2]))) {
+            decoded += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += uri[i];
+        }
+    }
+    return decoded;
+}
+
+// splits a mapped .glb into its json and (optional) binary chunk
+static void parse_glb(const mapped_file& glb, gltf_byte_span* json_chunk, gltf_byte_span* bin_chunk)
+{
+    if (glb.size < 20 || read_u32(glb.data) != GLB_MAGIC) {
+        throw std::runtime_error("file is not a binary glTF!");
+    }
+    if (read_u32(glb.data + 4) != 2) {
+        throw std::runtime_error("only glTF 2.0 binaries are supported!");
+    }
+    size_t length = std::min(static_cast<size_t>(read_u32(glb.data + 8)), glb.size);
+
+    size_t offset = 12;
+    while (offset + 8 <= length) {
+        size_t chunk_length = read_u32(glb.data + offset);
+        uint32_t chunk_type = read_u32(glb.data + offset + 4);
+        offset += 8;
+        if (chunk_length > length - offset) {
+            throw std::runtime_error("binary glTF chunk runs past the end of the file!");
+        }
+        if (chunk_type == GLB_CHUNK_JSON && json_chunk->data == nullptr) {
+            *json_chunk = {glb.data + offset, chunk_length};
+        } else if (chunk_type == GLB_CHUNK_BIN && bin_chunk->data == nullptr) {
+            *bin_chunk = {glb.data + offset, chunk_length};
+        }
+        // chunks are 4 byte aligned
+        offset += (chunk_length + 3) & ~static_cast<size_t>(3);
+    }
+
+    if (json_chunk->data == nullptr) {
+        throw std::runtime_error("binary glTF has no json chunk!");
+    }
+}
+
+static gltf_byte_span map_external_file(gltf_document* document, const std::string& abs_path)
+{
+    mapped_file file;
+    if (!map_file(abs_path, &file)) {
+        throw std::runtime_error("failed to map " + abs_path);
+    }
+    document->mappings.push_back(file);
+    return {file.data, file.size};
+}
+
+bool load_gltf_document(const std::string& abs_path, gltf_document* out, std::string* err, std::string* warn)
+{
+    (void)warn;
+    *out = gltf_document{};
+    std::string base_dir = abs_path.substr(0, abs_path.find_last_of("/\\") + 1);
+
+    try {
+        /* map the file and find the json text */
+        gltf_byte_span json_text, bin_chunk;
+        auto file = map_external_file(out, abs_path);
+        if (ends_with(abs_path, ".glb")) {
+            parse_glb(out->mappings.front(), &json_text, &bin_chunk);
+        } else {
+            json_text = file;
+        }
+
+        std::vector<size_t> buffer_lengths;
+        if (!parse_gltf_json(reinterpret_cast<const char*>(json_text.data), json_text.size, &out->model, &out->scene,
+                             &buffer_lengths, err)) {
+            close_gltf_document(*out);
+            return false;
+        }
+        auto& model = out->model;
+
+        /* buffers live in the glb binary chunk, external files or (rarely) data uris */
+        out->buffers.resize(model.buffers.size());
+        for (size_t i = 0; i < model.buffers.size(); i++) {
+            auto& buffer = model.buffers[i];
+            if (buffer.uri.empty()) {
+                if (i != 0 || bin_chunk.data == nullptr) {
+                    throw std::runtime_error("buffer " + std::to_string(i) + " has no uri!");
+                }
+                out->buffers[i] = bin_chunk;
+            } else if (is_data_uri(buffer.uri)) {
+                decode_data_uri(buffer.uri, &buffer.data);
+                out->buffers[i] = {buffer.data.data(), buffer.data.size()};
+            } else {
+                out->buffers[i] = map_external_file(out, base_dir + url_decode(buffer.uri));
+            }
+
+            if (buffer_lengths[i] > out->buffers[i].size) {
+                throw std::runtime_error("buffer " + std::to_string(i) + " is smaller than its byteLength!");
+            }
+            out->buffers[i].size = buffer_lengths[i];
+        }
+
+        /* images reference their encoded bytes where they are */
+        out->images.resize(model.images.size());
+        for (size_t i = 0; i < model.images.size(); i++) {
+            auto& image = model.images[i];
+            if (image.bufferView >= 0) {
+                size_t size = model.bufferViews[image.bufferView].byteLength;
+                out->images[i] = {get_buffer_view_data(*out, image.bufferView, 0, size), size};
+            } else if (image.uri.empty()) {
+                throw std::runtime_error("image " + std::to_string(i) + " has neither a uri nor a bufferView!");
+            } else if (is_data_uri(image.uri)) {
+                decode_data_uri(image.uri, &image.image);
+                out->images[i] = {image.image.data(), image.image.size()};
+            } else {
+                out->images[i] = map_external_file(out, base_dir + url_decode(image.uri));
+            }
+            image.as_is = true;
+        }
+    } catch (const std::exception& e) {
+        *err += e.what();
+        close_gltf_document(*out);
+        return false;
+    }
+    return true;
+}
+
+void close_gltf_document(gltf_document& document)
+{
+    for (auto& file : document.mappings) {
+        unmap_file(file);
+    }
+    document = gltf_document{};
+}
+
+const unsigned char* get_buffer_view_data(const gltf_document& document, int buffer_view, size_t offset, size_t size)
+{
+    auto& view = document.model.bufferViews.at(buffer_view);
+    if (view.buffer < 0 || view.buffer >= static_cast<int>(document.buffers.size())) {
+        throw std::runtime_error("buffer view " + std::to_string(buffer_view) + " references a missing buffer!");
+    }
+    auto& buffer = document.buffers[view.buffer];
+    if (view.byteOffset > buffer.size || view.byteLength > buffer.size - view.byteOffset ||
+        offset > view.byteLength || size > view.byteLength - offset) {
+        throw std::runtime_error("buffer view " + std::to_string(buffer_view) + " reads outside of its buffer!");
+    }
+    return buffer.data + view.byteOffset + offset;
+}
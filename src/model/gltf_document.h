@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <platform.h>
+#include <include/tiny_gltf.h>
+#include "scene_table.h"
+
+/*
+ * a parsed .gltf or .glb file. the json is read by the streaming parser in
+ * gltf_json_parser.h, buffer and image payloads stay in memory mapped files (the
+ * .glb itself, external .bin files and images) so accessors can be read straight
+ * from the mapping into staging memory. data uris are decoded and referenced in place.
+ */
+
+struct gltf_byte_span {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+struct gltf_document {
+    tinygltf::Model model;                  // nodes/scenes are empty, see scene. buffer data is empty unless it was a data uri
+    scene_table scene;
+    std::vector<mapped_file> mappings;
+    std::vector<gltf_byte_span> buffers;    // one per model.buffers
+    std::vector<gltf_byte_span> images;     // encoded image bytes, one per model.images
+};
+
+// loads a .gltf or .glb (by extension), returns false and fills err on failure
+bool load_gltf_document(const std::string& abs_path, gltf_document* out, std::string* err, std::string* warn);
+void close_gltf_document(gltf_document& document);
+
+// returns size bytes of a buffer view starting at offset, throws if they lie outside of the buffer
+const unsigned char* get_buffer_view_data(const gltf_document& document, int buffer_view, size_t offset, size_t size);
@@ -0,0 +1,554 @@
+#include "gltf_json_parser.h"
+
+#include <include/json.hpp>
+
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+
+/* keys we care about, everything else is skipped without being stored */
+enum gltf_key : uint8_t {
+    KEY_UNKNOWN,
+    KEY_ELEMENT,    // array element, not a key
+    KEY_ASSET, KEY_VERSION, KEY_SCENE, KEY_SCENES, KEY_NODES, KEY_MESHES, KEY_ACCESSORS, KEY_BUFFER_VIEWS,
+    KEY_BUFFERS, KEY_MATERIALS, KEY_TEXTURES, KEY_IMAGES,
+    KEY_MESH, KEY_CHILDREN, KEY_MATRIX, KEY_TRANSLATION, KEY_ROTATION, KEY_SCALE,
+    KEY_PRIMITIVES, KEY_ATTRIBUTES, KEY_INDICES, KEY_MATERIAL, KEY_MODE,
+    KEY_BUFFER_VIEW, KEY_BYTE_OFFSET, KEY_COMPONENT_TYPE, KEY_NORMALIZED, KEY_COUNT, KEY_TYPE, KEY_MIN, KEY_MAX, KEY_SPARSE,
+    KEY_BUFFER, KEY_BYTE_LENGTH, KEY_BYTE_STRIDE, KEY_TARGET, KEY_URI, KEY_MIME_TYPE, KEY_NAME,
+    KEY_PBR, KEY_BASE_COLOR_TEXTURE, KEY_METALLIC_ROUGHNESS_TEXTURE, KEY_NORMAL_TEXTURE, KEY_EMISSIVE_TEXTURE,
+    KEY_OCCLUSION_TEXTURE, KEY_INDEX, KEY_TEX_COORD, KEY_SOURCE, KEY_SAMPLER, KEY_EXTENSIONS, KEY_BASISU,
+    KEY_ALPHA_MODE, KEY_ALPHA_CUTOFF,
+};
+
+static gltf_key find_key(const std::string& key)
+{
+    static const std::unordered_map<std::string, gltf_key> keys = {
+        {"asset", KEY_ASSET}, {"version", KEY_VERSION}, {"scene", KEY_SCENE}, {"scenes", KEY_SCENES},
+        {"nodes", KEY_NODES}, {"meshes", KEY_MESHES}, {"accessors", KEY_ACCESSORS}, {"bufferViews", KEY_BUFFER_VIEWS},
+        {"buffers", KEY_BUFFERS}, {"materials", KEY_MATERIALS}, {"textures", KEY_TEXTURES}, {"images", KEY_IMAGES},
+        {"mesh", KEY_MESH}, {"children", KEY_CHILDREN}, {"matrix", KEY_MATRIX}, {"translation", KEY_TRANSLATION},
+        {"rotation", KEY_ROTATION}, {"scale", KEY_SCALE},
+        {"primitives", KEY_PRIMITIVES}, {"attributes", KEY_ATTRIBUTES}, {"indices", KEY_INDICES},
+        {"material", KEY_MATERIAL}, {"mode", KEY_MODE},
+        {"bufferView", KEY_BUFFER_VIEW}, {"byteOffset", KEY_BYTE_OFFSET}, {"componentType", KEY_COMPONENT_TYPE},
+        {"normalized", KEY_NORMALIZED}, {"count", KEY_COUNT}, {"type", KEY_TYPE}, {"min", KEY_MIN}, {"max", KEY_MAX},
+        {"sparse", KEY_SPARSE},
+        {"buffer", KEY_BUFFER}, {"byteLength", KEY_BYTE_LENGTH}, {"byteStride", KEY_BYTE_STRIDE}, {"target", KEY_TARGET},
+        {"uri", KEY_URI}, {"mimeType", KEY_MIME_TYPE}, {"name", KEY_NAME},
+        {"pbrMetallicRoughness", KEY_PBR}, {"baseColorTexture", KEY_BASE_COLOR_TEXTURE},
+        {"metallicRoughnessTexture", KEY_METALLIC_ROUGHNESS_TEXTURE}, {"normalTexture", KEY_NORMAL_TEXTURE},
+        {"emissiveTexture", KEY_EMISSIVE_TEXTURE}, {"occlusionTexture", KEY_OCCLUSION_TEXTURE},
+        {"index", KEY_INDEX}, {"texCoord", KEY_TEX_COORD}, {"source", KEY_SOURCE}, {"sampler", KEY_SAMPLER},
+        {"extensions", KEY_EXTENSIONS}, {"KHR_texture_basisu", KEY_BASISU},
+        {"alphaMode", KEY_ALPHA_MODE}, {"alphaCutoff", KEY_ALPHA_CUTOFF},
+    };
+    auto it = keys.find(key);
+    return (it != keys.end()) ? it->second : KEY_UNKNOWN;
+}
+
+static int get_accessor_type(const std::string& type)
+{
+    if (type == "SCALAR") return TINYGLTF_TYPE_SCALAR;
+    if (type == "VEC2") return TINYGLTF_TYPE_VEC2;
+    if (type == "VEC3") return TINYGLTF_TYPE_VEC3;
+    if (type == "VEC4") return TINYGLTF_TYPE_VEC4;
+    if (type == "MAT2") return TINYGLTF_TYPE_MAT2;
+    if (type == "MAT3") return TINYGLTF_TYPE_MAT3;
+    if (type == "MAT4") return TINYGLTF_TYPE_MAT4;
+    throw std::runtime_error("unknown accessor type " + type);
+}
+
+class gltf_sax_handler : public nlohmann::json_sax<nlohmann::json>
+{
+private:
+    struct frame {
+        gltf_key key;
+        bool is_array;
+    };
+
+    // transform parts of the node being parsed, composed when the node ends
+    struct node_transform {
+        double matrix[16];
+        double translation[3];
+        double rotation[4];
+        double scale[3];
+        uint32_t matrix_count = 0;
+        uint32_t translation_count = 0;
+        uint32_t rotation_count = 0;
+        uint32_t scale_count = 0;
+    };
+
+    tinygltf::Model& model;
+    scene_table& scene;
+    std::vector<size_t>& buffer_lengths;
+
+    std::vector<frame> path;            // containers we are inside of, path[0] is the root object
+    gltf_key pending_key = KEY_UNKNOWN; // last key seen in the innermost object
+    std::string attribute_name;         // attribute keys are names, not known keys
+    size_t skip_depth = 0;              // > 0 while inside a container we don't care about
+
+    node_transform transform;
+    std::vector<std::vector<uint32_t>> scene_roots;
+    int default_scene = -1;
+
+    gltf_key slot() const
+    {
+        return (!path.empty() && path.back().is_array) ? KEY_ELEMENT : pending_key;
+    }
+
+    gltf_key section() const
+    {
+        return (path.size() > 1) ? path[1].key : KEY_UNKNOWN;
+    }
+
+    bool wants_container(gltf_key key, bool is_array)
+    {
+        switch (path.size()) {
+        case 0:     // the root
+            return !is_array;
+        case 1:     // top level sections
+            if (key == KEY_ASSET) return !is_array;
+            return is_array && (key == KEY_SCENES || key == KEY_NODES || key == KEY_MESHES || key == KEY_ACCESSORS ||
+                                key == KEY_BUFFER_VIEWS || key == KEY_BUFFERS || key == KEY_MATERIALS ||
+                                key == KEY_TEXTURES || key == KEY_IMAGES);
+        case 2:     // section elements
+            return !is_array && key == KEY_ELEMENT && section() != KEY_ASSET;
+        case 3:     // fields of an element
+            switch (section()) {
+            case KEY_SCENES: return is_array && key == KEY_NODES;
+            case KEY_NODES: return is_array && (key == KEY_CHILDREN || key == KEY_MATRIX || key == KEY_TRANSLATION ||
+                                                key == KEY_ROTATION || key == KEY_SCALE);
+            case KEY_MESHES: return is_array && key == KEY_PRIMITIVES;
+            case KEY_ACCESSORS:
+                if (key == KEY_SPARSE) {
+                    // only flagged, sparse accessors are rejected when read
+                    model.accessors.back().sparse.isSparse = true;
+                    return false;
+                }
+                return is_array && (key == KEY_MIN || key == KEY_MAX);
+            case KEY_MATERIALS: return !is_array && (key == KEY_PBR || key == KEY_NORMAL_TEXTURE ||
+                                                     key == KEY_EMISSIVE_TEXTURE || key == KEY_OCCLUSION_TEXTURE);
+            case KEY_TEXTURES: return !is_array && key == KEY_EXTENSIONS;
+            default: return false;
+            }
+        case 4:
+            if (section() == KEY_MESHES) return !is_array && key == KEY_ELEMENT;
+            if (section() == KEY_MATERIALS) return !is_array && path[3].key == KEY_PBR &&
+                                                   (key == KEY_BASE_COLOR_TEXTURE || key == KEY_METALLIC_ROUGHNESS_TEXTURE);
+            if (section() == KEY_TEXTURES) return !is_array && key == KEY_BASISU;
+            return false;
+        case 5:
+            return section() == KEY_MESHES && !is_array && key == KEY_ATTRIBUTES;
+        default:
+            return false;
+        }
+    }
+
+    // a new element of a section or primitive array starts
+    void begin_element()
+    {
+        if (path.size() == 3) {
+            switch (section()) {
+            case KEY_SCENES: scene_roots.emplace_back(); break;
+            case KEY_NODES:
+                scene.nodes.emplace_back();
+                scene.nodes.back().first_child = static_cast<uint32_t>(scene.children.size());
+                transform = node_transform{};
+                break;
+            case KEY_MESHES: model.meshes.emplace_back(); break;
+            case KEY_ACCESSORS: model.accessors.emplace_back(); break;
+            case KEY_BUFFER_VIEWS: model.bufferViews.emplace_back(); break;
+            case KEY_BUFFERS:
+                model.buffers.emplace_back();
+                buffer_lengths.push_back(0);
+                break;
+            case KEY_MATERIALS: model.materials.emplace_back(); break;
+            case KEY_TEXTURES: model.textures.emplace_back(); break;
+            case KEY_IMAGES: model.images.emplace_back(); break;
+            default: break;
+            }
+        } else if (path.size() == 5 && section() == KEY_MESHES) {
+            model.meshes.back().primitives.emplace_back();
+            model.meshes.back().primitives.back().mode = TINYGLTF_MODE_TRIANGLES;
+        }
+    }
+
+    void end_node()
+    {
+        auto& t = this->transform;
+        if ((t.matrix_count != 0 && t.matrix_count != 16) || (t.translation_count != 0 && t.translation_count != 3) ||
+            (t.rotation_count != 0 && t.rotation_count != 4) || (t.scale_count != 0 && t.scale_count != 3)) {
+            throw std::runtime_error("node " + std::to_string(scene.nodes.size() - 1) + " has a malformed transform");
+        }
+        scene.nodes.back().local_transform = compose_local_transform(t.matrix_count ? t.matrix : nullptr,
+                                                                     t.translation_count ? t.translation : nullptr,
+                                                                     t.rotation_count ? t.rotation : nullptr,
+                                                                     t.scale_count ? t.scale : nullptr);
+    }
+
+    static void push_component(double* values, uint32_t& count, uint32_t capacity, double value)
+    {
+        if (count >= capacity) {
+            throw std::runtime_error("node transform has too many components");
+        }
+        values[count++] = value;
+    }
+
+    static void set_texture_info(tinygltf::Material& material, gltf_key texture, gltf_key key, int value)
+    {
+        int* index = nullptr;
+        int* tex_coord = nullptr;
+        switch (texture) {
+        case KEY_BASE_COLOR_TEXTURE:
+            index = &material.pbrMetallicRoughness.baseColorTexture.index;
+            tex_coord = &material.pbrMetallicRoughness.baseColorTexture.texCoord;
+            break;
+        case KEY_METALLIC_ROUGHNESS_TEXTURE:
+            index = &material.pbrMetallicRoughness.metallicRoughnessTexture.index;
+            tex_coord = &material.pbrMetallicRoughness.metallicRoughnessTexture.texCoord;
+            break;
+        case KEY_NORMAL_TEXTURE:
+            index = &material.normalTexture.index;
+            tex_coord = &material.normalTexture.texCoord;
+            break;
+        case KEY_EMISSIVE_TEXTURE:
+            index = &material.emissiveTexture.index;
+            tex_coord = &material.emissiveTexture.texCoord;
+            break;
+        case KEY_OCCLUSION_TEXTURE:
+            index = &material.occlusionTexture.index;
+            tex_coord = &material.occlusionTexture.texCoord;
+            break;
+        default:
+            return;
+        }
+        if (key == KEY_INDEX) *index = value;
+        if (key == KEY_TEX_COORD) *tex_coord = value;
+    }
+
+    // json numbers are doubles, and casting one outside the target type's range is undefined.
+    // indexes out of range become INT_MIN, which validate() rejects like any other bad index
+    static int to_int(double value)
+    {
+        if (!(value >= static_cast<double>(INT_MIN) && value <= static_cast<double>(INT_MAX))) {
+            return INT_MIN;
+        }
+        return static_cast<int>(value);
+    }
+
+    // byte offsets, lengths and counts
+    static size_t to_size(double value)
+    {
+        // SIZE_MAX rounds up to 2^64 as a double on 64 bit platforms, so < keeps the cast in range
+        if (!(value >= 0.0 && value < static_cast<double>(SIZE_MAX))) {
+            throw std::runtime_error("size " + std::to_string(value) + " is out of range");
+        }
+        return static_cast<size_t>(value);
+    }
+
+    void on_number(double value)
+    {
+        if (skip_depth > 0) return;
+        gltf_key key = slot();
+        int i = to_int(value);
+        auto size = [&]() { return to_size(value); };
+
+        switch (path.size()) {
+        case 1:
+            if (key == KEY_SCENE) default_scene = i;
+            break;
+        case 3:     // fields of section elements
+            switch (section()) {
+            case KEY_NODES:
+                if (key == KEY_MESH) scene.nodes.back().mesh = i;
+                break;
+            case KEY_ACCESSORS: {
+                auto& accessor = model.accessors.back();
+                if (key == KEY_BUFFER_VIEW) accessor.bufferView = i;
+                else if (key == KEY_BYTE_OFFSET) accessor.byteOffset = size();
+                else if (key == KEY_COMPONENT_TYPE) accessor.componentType = i;
+                else if (key == KEY_COUNT) accessor.count = size();
+                break;
+            }
+            case KEY_BUFFER_VIEWS: {
+                auto& view = model.bufferViews.back();
+                if (key == KEY_BUFFER) view.buffer = i;
+                else if (key == KEY_BYTE_OFFSET) view.byteOffset = size();
+                else if (key == KEY_BYTE_LENGTH) view.byteLength = size();
+                else if (key == KEY_BYTE_STRIDE) view.byteStride = size();
+                else if (key == KEY_TARGET) view.target = i;
+                break;
+            }
+            case KEY_BUFFERS:
+                // tinygltf::Buffer has no length of its own, the payload is only resolved later
+                if (key == KEY_BYTE_LENGTH) buffer_lengths.back() = size();
+                break;
+            case KEY_TEXTURES:
+                if (key == KEY_SOURCE) model.textures.back().source = i;
+                else if (key == KEY_SAMPLER) model.textures.back().sampler = i;
+                break;
+            case KEY_IMAGES:
+                if (key == KEY_BUFFER_VIEW) model.images.back().bufferView = i;
+                break;
+            case KEY_MATERIALS:
+                if (key == KEY_ALPHA_CUTOFF) model.materials.back().alphaCutoff = value;
+                break;
+            default:
+                break;
+            }
+            break;
+        case 4:     // array fields and nested objects
+            switch (section()) {
+            case KEY_SCENES:
+                scene_roots.back().push_back(static_cast<uint32_t>(i));
+                break;
+            case KEY_NODES:
+                switch (path[3].key) {
+                case KEY_CHILDREN:
+                    scene.children.push_back(static_cast<uint32_t>(i));
+                    scene.nodes.back().child_count++;
+                    break;
+                case KEY_MATRIX: push_component(transform.matrix, transform.matrix_count, 16, value); break;
+                case KEY_TRANSLATION: push_component(transform.translation, transform.translation_count, 3, value); break;
+                case KEY_ROTATION: push_component(transform.rotation, transform.rotation_count, 4, value); break;
+                case KEY_SCALE: push_component(transform.scale, transform.scale_count, 3, value); break;
+                default: break;
+                }
+                break;
+            case KEY_ACCESSORS:
+                if (path[3].key == KEY_MIN) model.accessors.back().minValues.push_back(value);
+                else if (path[3].key == KEY_MAX) model.accessors.back().maxValues.push_back(value);
+                break;
+            case KEY_MATERIALS:
+                set_texture_info(model.materials.back(), path[3].key, key, i);
+                break;
+            default:
+                break;
+            }
+            break;
+        case 5:
+            if (section() == KEY_MESHES) {
+                auto& prim = model.meshes.back().primitives.back();
+                if (key == KEY_INDICES) prim.indices = i;
+                else if (key == KEY_MATERIAL) prim.material = i;
+                else if (key == KEY_MODE) prim.mode = i;
+            } else if (section() == KEY_MATERIALS) {
+                set_texture_info(model.materials.back(), path[4].key, key, i);
+            } else if (section() == KEY_TEXTURES && key == KEY_SOURCE) {
+                tinygltf::Value::Object basisu;
+                basisu["source"] = tinygltf::Value(i);
+                model.textures.back().extensions["KHR_texture_basisu"] = tinygltf::Value(basisu);
+            }
+            break;
+        case 6:
+            if (section() == KEY_MESHES) {
+                model.meshes.back().primitives.back().attributes[attribute_name] = i;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    bool enter(bool is_array)
+    {
+        gltf_key key = slot();
+        if (skip_depth > 0 || !wants_container(key, is_array)) {
+            skip_depth++;
+            return true;
+        }
+        path.push_back({key, is_array});
+        pending_key = KEY_UNKNOWN;
+        if (!is_array && key == KEY_ELEMENT) {
+            begin_element();
+        }
+        return true;
+    }
+
+    bool leave()
+    {
+        if (skip_depth > 0) {
+            skip_depth--;
+            return true;
+        }
+        if (path.size() == 3 && section() == KEY_NODES) {
+            end_node();
+        }
+        path.pop_back();
+        return true;
+    }
+
+public:
+    std::string error;
+
+    gltf_sax_handler(tinygltf::Model& model, scene_table& scene, std::vector<size_t>& buffer_lengths)
+        : model(model), scene(scene), buffer_lengths(buffer_lengths) {}
+
+    bool null() override { return true; }
+
+    bool boolean(bool val) override
+    {
+        if (skip_depth == 0 && path.size() == 3 && section() == KEY_ACCESSORS && slot() == KEY_NORMALIZED) {
+            model.accessors.back().normalized = val;
+        }
+        return true;
+    }
+
+    bool number_integer(number_integer_t val) override { on_number(static_cast<double>(val)); return true; }
+    bool number_unsigned(number_unsigned_t val) override { on_number(static_cast<double>(val)); return true; }
+    bool number_float(number_float_t val, const string_t&) override { on_number(val); return true; }
+
+    bool string(string_t& val) override
+    {
+        if (skip_depth > 0) return true;
+        gltf_key key = slot();
+        if (path.size() == 2) {
+            if (section() == KEY_ASSET && key == KEY_VERSION) model.asset.version = std::move(val);
+        } else if (path.size() == 3) {
+            switch (section()) {
+            case KEY_ACCESSORS:
+                if (key == KEY_TYPE) model.accessors.back().type = get_accessor_type(val);
+                break;
+            case KEY_BUFFERS:
+                if (key == KEY_URI) model.buffers.back().uri = std::move(val);
+                break;
+            case KEY_IMAGES:
+                if (key == KEY_URI) model.images.back().uri = std::move(val);
+                else if (key == KEY_MIME_TYPE) model.images.back().mimeType = std::move(val);
+                else if (key == KEY_NAME) model.images.back().name = std::move(val);
+                break;
+            case KEY_MATERIALS:
+                if (key == KEY_ALPHA_MODE) model.materials.back().alphaMode = std::move(val);
+                break;
+            default:
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) override { return enter(false); }
+    bool end_object() override { return leave(); }
+    bool start_array(std::size_t) override { return enter(true); }
+    bool end_array() override { return leave(); }
+
+    bool key(string_t& val) override
+    {
+        if (skip_depth > 0) return true;
+        if (path.size() == 6) {
+            // primitive attribute names
+            attribute_name.swap(val);
+            pending_key = KEY_UNKNOWN;
+        } else {
+            pending_key = find_key(val);
+        }
+        return true;
+    }
+
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& ex) override
+    {
+        error = "json parse error at byte " + std::to_string(position) + ": " + ex.what();
+        return false;
+    }
+
+    void finish()
+    {
+        if (!scene_roots.empty()) {
+            int index = (default_scene >= 0) ? default_scene : 0;
+            if (index >= static_cast<int>(scene_roots.size())) {
+                throw std::runtime_error("default scene " + std::to_string(index) + " does not exist");
+            }
+            scene.roots = std::move(scene_roots[index]);
+        }
+        model.defaultScene = default_scene;
+    }
+};
+
+// -1 is the only valid negative index, it means none
+static void check_index(int64_t index, size_t count, const char* what, size_t owner)
+{
+    if (index < -1 || index >= static_cast<int64_t>(count)) {
+        throw std::runtime_error(std::string(what) + " " + std::to_string(owner) + " references a missing item " + std::to_string(index));
+    }
+}
+
+// every cross reference is checked once here so the loaders can index freely
+static void validate(const tinygltf::Model& model, const scene_table& scene)
+{
+    if (model.asset.version.empty() || model.asset.version[0] != '2') {
+        throw std::runtime_error("only glTF 2.0 is supported, asset version is '" + model.asset.version + "'");
+    }
+    for (size_t i = 0; i < scene.nodes.size(); i++) {
+        check_index(scene.nodes[i].mesh, model.meshes.size(), "node", i);
+    }
+    for (auto c : scene.children) {
+        check_index(c, scene.nodes.size(), "node child", c);
+    }
+    for (auto r : scene.roots) {
+        check_index(r, scene.nodes.size(), "scene root", r);
+    }
+    for (size_t m = 0; m < model.meshes.size(); m++) {
+        for (auto& prim : model.meshes[m].primitives) {
+            check_index(prim.indices, model.accessors.size(), "mesh", m);
+            check_index(prim.material, model.materials.size(), "mesh", m);
+            for (auto& attribute : prim.attributes) {
+                check_index(attribute.second, model.accessors.size(), "mesh", m);
+            }
+        }
+    }
+    for (size_t i = 0; i < model.accessors.size(); i++) {
+        auto& accessor = model.accessors[i];
+        check_index(accessor.bufferView, model.bufferViews.size(), "accessor", i);
+        if (accessor.type < 0 || accessor.componentType < 0) {
+            throw std::runtime_error("accessor " + std::to_string(i) + " has no type or componentType");
+        }
+    }
+    for (size_t i = 0; i < model.bufferViews.size(); i++) {
+        if (model.bufferViews[i].buffer < 0) {
+            throw std::runtime_error("buffer view " + std::to_string(i) + " has no buffer");
+        }
+        check_index(model.bufferViews[i].buffer, model.buffers.size(), "buffer view", i);
+    }
+    for (size_t i = 0; i < model.materials.size(); i++) {
+        auto& material = model.materials[i];
+        check_index(material.pbrMetallicRoughness.baseColorTexture.index, model.textures.size(), "material", i);
+        check_index(material.pbrMetallicRoughness.metallicRoughnessTexture.index, model.textures.size(), "material", i);
+        check_index(material.normalTexture.index, model.textures.size(), "material", i);
+        check_index(material.emissiveTexture.index, model.textures.size(), "material", i);
+        check_index(material.occlusionTexture.index, model.textures.size(), "material", i);
+    }
+    for (size_t i = 0; i < model.textures.size(); i++) {
+        auto& texture = model.textures[i];
+        check_index(texture.source, model.images.size(), "texture", i);
+        auto ext = texture.extensions.find("KHR_texture_basisu");
+        if (ext != texture.extensions.end()) {
+            check_index(ext->second.Get("source").Get<int>(), model.images.size(), "texture", i);
+        }
+    }
+    for (size_t i = 0; i < model.images.size(); i++) {
+        check_index(model.images[i].bufferView, model.bufferViews.size(), "image", i);
+    }
+}
+
+bool parse_gltf_json(const char* json, size_t size, tinygltf::Model* model, scene_table* scene,
+                     std::vector<size_t>* buffer_lengths, std::string* err)
+{
+    *model = tinygltf::Model();
+    *scene = scene_table{};
+    buffer_lengths->clear();
+    try {
+        gltf_sax_handler handler(*model, *scene, *buffer_lengths);
+        if (!nlohmann::json::sax_parse(json, json + size, &handler)) {
+            *err += handler.error;
+            return false;
+        }
+        handler.finish();
+        validate(*model, *scene);
+    } catch (const std::exception& e) {
+        *err += e.what();
+        return false;
+    }
+    return true;
+}
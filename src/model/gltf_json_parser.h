@@ -0,0 +1,18 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <include/tiny_gltf.h>
+#include "scene_table.h"
+
+/*
+ * streaming glTF json parser. walks the json with sax events instead of building a
+ * json dom, filling the parts of tinygltf::Model the loaders use (accessors, buffer
+ * views, buffers, meshes, materials, textures, images) and writing nodes straight
+ * into a scene_table, model.nodes and model.scenes are left empty.
+ * buffer and image payloads are not loaded, only their uri/bufferView, buffer byteLengths
+ * are returned separately.
+ */
+bool parse_gltf_json(const char* json, size_t size, tinygltf::Model* model, scene_table* scene,
+                     std::vector<size_t>* buffer_lengths, std::string* err);
@@ -1,6 +1,9 @@
 #include "gltf_model.h"
 
+#include <cpu_profiler.h>
 #include <platform.h>
+#include "ktx2_texture.h"
+#include "gltf_accessor.h"
 
 #define TINYGLTF_IMPLEMENTATION
 //#define STB_IMAGE_IMPLEMENTATION // defined in vulkan_image.cpp
@@ -8,147 +11,461 @@
 #include <include/tiny_gltf.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+static int64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
 
 void gltf_model::initialise(const std::string& path)
 {
+    CPU_PROFILE_SCOPE("gltf_model::initialise");
+    auto parse_start = std::chrono::steady_clock::now();
     this->relative_path = path;
     this->relative_path.erase(this->relative_path.find_last_of("/\\")+1);
 
-    this->_is_valid = this->loader.LoadASCIIFromFile(&this->gltf_model, &this->err, &this->warn, ::to_absolute_path(path));
+    if (is_baked_model_path(path)) {
+        // baked models are mapped and their tables used in place
+        try {
+            open_baked_model(::to_absolute_path(path), &this->_baked);
+            this->_scene = get_baked_scene_table(this->_baked);
+            this->_is_baked = true;
+            this->_is_valid = true;
+        } catch (const std::exception& e) {
+            this->err = e.what();
+            this->_is_valid = false;
+        }
+        this->_load_stats.parse_ms = static_cast<double>(elapsed_ns(parse_start)) / 1e6;
+        return;
+    }
+
+    this->_is_valid = load_gltf_document(::to_absolute_path(path), &this->document, &this->err, &this->warn);
+    if (this->_is_valid) {
+        // the parser already flattened the hierarchy
+        this->_scene = std::move(this->document.scene);
+    }
+    this->_load_stats.parse_ms = static_cast<double>(elapsed_ns(parse_start)) / 1e6;
 }
 
 void gltf_model::terminate(vulkan_data& vkdata)
 {
     if (this->is_loaded())
         this->unload_model(vkdata);
+
+    if (this->_is_baked) {
+        close_baked_model(this->_baked);
+        this->_is_baked = false;
+    } else {
+        close_gltf_document(this->document);
+    }
+}
+
+// resolves a texture index to the index of the image it samples, prefering KHR_texture_basisu ktx2 sources
+int get_texture_image_index(const gltf_document& document, int texture_index)
+{
+    auto& model = document.model;
+    if (texture_index < 0 || texture_index >= static_cast<int>(model.textures.size())) {
+        return -1;
+    }
+
+    auto& texture = model.textures[texture_index];
+    auto ext = texture.extensions.find("KHR_texture_basisu");
+    if (ext != texture.extensions.end() && ext->second.Has("source")) {
+        int source = ext->second.Get("source").Get<int>();
+        auto& image = document.images[source];
+        // basis universal payloads can't be transcoded, fall back to the regular source if there is one
+        if (texture.source < 0 || !ktx2_needs_transcoder(image.data, image.size)) {
+            return source;
+        }
+    }
+    return texture.source;
+}
+
+std::vector<bool> find_normal_map_images(const gltf_document& document)
+{
+    std::vector<bool> is_normal_map(document.model.images.size(), false);
+    for (auto& material : document.model.materials) {
+        int image_index = get_texture_image_index(document, material.normalTexture.index);
+        if (image_index >= 0) {
+            is_normal_map[image_index] = true;
+        }
+    }
+    return is_normal_map;
 }
 
-prim_data load_prim(vulkan_data& vkdata, tinygltf::Model& model, tinygltf::Primitive& prim)
+/* per stage cpu time, summed across every worker */
+struct load_stage_timers {
+    std::atomic<int64_t> image_ns{0};
+    std::atomic<int64_t> vertex_ns{0};
+    std::atomic<int64_t> index_ns{0};
+};
+
+size_t get_prim_vertex_count(const gltf_document& document, const tinygltf::Primitive& prim)
 {
     if (prim.mode != 4) {
         throw std::runtime_error("Non triangle rendering mode is currently not supported");
     }
+    return document.model.accessors.at(prim.attributes.at("POSITION")).count;
+}
 
-    prim_data p;
+// the texture coordinate set sampled by the base color texture, empty when there is no material to sample
+static std::string get_prim_tex_coord_name(const gltf_document& document, const tinygltf::Primitive& prim)
+{
+    if (prim.attributes.count("TEXCOORD_0") == 0 || prim.material < 0) {
+        return "";
+    }
+    int base_color_tex_index = document.model.materials[prim.material].pbrMetallicRoughness.baseColorTexture.texCoord;
+    std::string name = "TEXCOORD_" + std::to_string(base_color_tex_index);
+    if (prim.attributes.count(name) == 0) {
+        throw std::runtime_error("primitive has no " + name + " attribute");
+    }
+    return name;
+}
 
-    /* set vertex buffer */
+void convert_prim_vertices(const gltf_document& document, const tinygltf::Primitive& prim, vertex* output, size_t first, size_t count)
+{
     auto& atribs = prim.attributes;
 
-    bool tex_coords = (atribs.count("TEXCOORD_0") != 0);
-    bool colors = (atribs.count("COLOR_0") != 0);
-    bool normals = (atribs.count("NORMAL") != 0);
-    bool tangents = (atribs.count("TANGENT") != 0);
-
-    std::vector<vertex> output;
-    size_t vertex_count = model.accessors[atribs.at("POSITION")].count;
-    output.resize(vertex_count);
+    // each attribute is decoded straight into its field of the interleaved output, whatever its
+    // stride and component type. missing attributes are zeroed
+    auto decode = [&](const std::string& name, float* field, uint32_t components) {
+        auto it = atribs.find(name);
+        if (it == atribs.end()) {
+            for (size_t i = 0; i < count; i++) {
+                std::memset(reinterpret_cast<unsigned char*>(field) + i * sizeof(vertex), 0, components * sizeof(float));
+            }
+            return;
+        }
+        auto view = get_accessor_view(document, it->second);
+        if (view.count < first + count) {
+            throw std::runtime_error("attribute " + name + " has fewer elements than POSITION");
+        }
+        decode_accessor_floats(view, first, count, field, sizeof(vertex), components);
+    };
 
-    const float *pos_data, *color_data, *tex_data, *norm_data, *tangent_data;
+    decode("POSITION", &output->position.x, 3);
+    decode("COLOR_0", &output->color.x, 3);
+    decode(get_prim_tex_coord_name(document, prim), &output->texcoord.x, 2);
+    decode("NORMAL", &output->normal.x, 3);
+    decode("TANGENT", &output->tangent.x, 4);
+}
 
-    auto get_data = [model, atribs](std::string attrib, const float* &data_ptr){
-        auto& accessor = model.accessors[atribs.at(attrib)];
-        auto& buffer_view = model.bufferViews[accessor.bufferView];
-        auto& buffer = model.buffers[buffer_view.buffer];
-        data_ptr = reinterpret_cast<const float*>(&buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-    };
+size_t get_prim_index_count(const gltf_document& document, const tinygltf::Primitive& prim)
+{
+    return (prim.indices >= 0) ? document.model.accessors.at(prim.indices).count : 0;
+}
 
-    get_data("POSITION", pos_data);
+VkIndexType get_prim_index_type(const gltf_document& document, const tinygltf::Primitive& prim)
+{
+    return get_accessor_index_type(get_accessor_view(document, prim.indices));
+}
 
-    if (tex_coords) {
-        int base_color_tex_index = model.materials[prim.material].pbrMetallicRoughness.baseColorTexture.texCoord;
-        get_data(("TEXCOORD_" + std::to_string(base_color_tex_index)), tex_data);
+void convert_prim_indices(const gltf_document& document, const tinygltf::Primitive& prim, VkIndexType type, void* output)
+{
+    decode_accessor_indices(get_accessor_view(document, prim.indices), type, output);
+}
 
-        /* tex indicies */
-        p.tex_indexes.color = model.materials[prim.material].pbrMetallicRoughness.baseColorTexture.index;
-        p.tex_indexes.emissive = model.materials[prim.material].emissiveTexture.index;
-        p.tex_indexes.metal_roughness = model.materials[prim.material].pbrMetallicRoughness.metallicRoughnessTexture.index;
-        p.tex_indexes.normal = model.materials[prim.material].normalTexture.index;
+bounds get_prim_bounds(const gltf_document& document, const tinygltf::Primitive& prim)
+{
+    bounds b;
+    int pos_index = prim.attributes.at("POSITION");
+    auto& pos_accessor = document.model.accessors.at(pos_index);
+    if (pos_accessor.minValues.size() < 3 || pos_accessor.maxValues.size() < 3) {
+        throw std::runtime_error("POSITION accessor has no min/max values");
     }
+    // quantized positions store their min/max unnormalized
+    auto view = get_accessor_view(document, pos_index);
+    b.max.x = decode_accessor_bound(view, pos_accessor.maxValues[0]);
+    b.max.y = decode_accessor_bound(view, pos_accessor.maxValues[1]);
+    b.max.z = decode_accessor_bound(view, pos_accessor.maxValues[2]);
+
+    b.min.x = decode_accessor_bound(view, pos_accessor.minValues[0]);
+    b.min.y = decode_accessor_bound(view, pos_accessor.minValues[1]);
+    b.min.z = decode_accessor_bound(view, pos_accessor.minValues[2]);
+    return b;
+}
 
-    if (colors) get_data("COLOR_0", color_data);
-    if (normals) get_data("NORMAL", norm_data);
-    if (tangents) get_data("TANGENT", tangent_data);
+/*
+ * how many mesh space units one unit of uv space covers, from the summed triangle areas in
+ * both spaces. texture streaming uses it to turn projected size into texel density
+ */
+float get_prim_uv_density(const gltf_document& document, const tinygltf::Primitive& prim)
+{
+    std::string tex_coord_name = get_prim_tex_coord_name(document, prim);
+    if (tex_coord_name.empty()) {
+        return 0.0f;
+    }
 
-    for (size_t i = 0; i < vertex_count; i++) {
-        output[i].position[0] =  pos_data[(i*3) + 0];
-        output[i].position[1] =  pos_data[(i*3) + 1];
-        output[i].position[2] =  pos_data[(i*3) + 2];
+    auto pos_view = get_accessor_view(document, prim.attributes.at("POSITION"));
+    auto uv_view = get_accessor_view(document, prim.attributes.at(tex_coord_name));
+    size_t vertex_count = std::min(pos_view.count, uv_view.count);
+    std::vector<glm::vec3> positions(vertex_count);
+    std::vector<glm::vec2> uvs(vertex_count);
+    decode_accessor_floats(pos_view, 0, vertex_count, &positions.data()->x, sizeof(glm::vec3), 3);
+    decode_accessor_floats(uv_view, 0, vertex_count, &uvs.data()->x, sizeof(glm::vec2), 2);
 
-        if (colors) {
-            output[i].color[0] = color_data[(i*3) + 0];
-            output[i].color[1] = color_data[(i*3) + 1];
-            output[i].color[2] = color_data[(i*3) + 2];
+    std::vector<uint32_t> indices;
+    if (prim.indices >= 0) {
+        indices.resize(get_prim_index_count(document, prim));
+        convert_prim_indices(document, prim, VK_INDEX_TYPE_UINT32, indices.data());
+    }
+    size_t index_count = indices.empty() ? vertex_count : indices.size();
+
+    double world_area = 0.0, uv_area = 0.0;
+    for (size_t t = 0; t + 2 < index_count; t += 3) {
+        uint32_t a = indices.empty() ? t : indices[t];
+        uint32_t b = indices.empty() ? t + 1 : indices[t + 1];
+        uint32_t c = indices.empty() ? t + 2 : indices[t + 2];
+        if (a >= vertex_count || b >= vertex_count || c >= vertex_count) {
+            continue;
         }
+        world_area += glm::length(glm::cross(positions[b] - positions[a], positions[c] - positions[a]));
+        glm::vec2 e1 = uvs[b] - uvs[a], e2 = uvs[c] - uvs[a];
+        uv_area += std::abs(e1.x * e2.y - e1.y * e2.x);
+    }
+    return (uv_area > 0.0) ? static_cast<float>(std::sqrt(world_area / uv_area)) : 0.0f;
+}
 
-        if (tex_coords) {
-            output[i].texcoord[0] = tex_data[(i*2) + 0];
-            output[i].texcoord[1] = tex_data[(i*2) + 1];
-        }
+float get_material_alpha_cutoff(const tinygltf::Material& material)
+{
+    return (material.alphaMode == "MASK") ? static_cast<float>(material.alphaCutoff) : -1.0f;
+}
 
-        if (normals) {
-            output[i].normal[0] = norm_data[(i*3) + 0];
-            output[i].normal[1] = norm_data[(i*3) + 1];
-            output[i].normal[2] = norm_data[(i*3) + 2];
-        }
+void set_prim_material(const gltf_document& document, const tinygltf::Primitive& prim, prim_data& p)
+{
+    p.has_vertex_color = (prim.attributes.count("COLOR_0") != 0);
+    if (prim.material < 0 || prim.attributes.count("TEXCOORD_0") == 0) {
+        return;
+    }
+    auto& material = document.model.materials[prim.material];
+    p.tex_indexes.color = get_texture_image_index(document, material.pbrMetallicRoughness.baseColorTexture.index);
+    p.tex_indexes.emissive = get_texture_image_index(document, material.emissiveTexture.index);
+    p.tex_indexes.metal_roughness = get_texture_image_index(document, material.pbrMetallicRoughness.metallicRoughnessTexture.index);
+    p.tex_indexes.normal = get_texture_image_index(document, material.normalTexture.index);
+    p.alpha_cutoff = get_material_alpha_cutoff(material);
+}
 
-        if (tangents) {
-            output[i].tangent[0] = tangent_data[(i*4) + 0];
-            output[i].tangent[1] = tangent_data[(i*4) + 1];
-            output[i].tangent[2] = tangent_data[(i*4) + 2];
-            output[i].tangent[3] = tangent_data[(i*4) + 3];
-        }
+// large primitives are split into blocks of this many vertices across the pool
+#define VERTEX_CONVERT_BLOCK_SIZE 16384
+
+void load_prim(vulkan_data& vkdata, upload_batch& batch, thread_pool& pool, load_stage_timers& timers,
+               const gltf_document& document, const tinygltf::Primitive& prim, prim_data& p)
+{
+    auto vertex_start = std::chrono::steady_clock::now();
+
+    /* vertex buffer, converted straight into staging memory */
+    size_t vertex_count = get_prim_vertex_count(document, prim);
+    auto vertex_staging = batch.reserve(vkdata, vertex_count * sizeof(vertex));
+    auto* output = reinterpret_cast<vertex*>(vertex_staging.data);
+
+    size_t block_count = (vertex_count + VERTEX_CONVERT_BLOCK_SIZE - 1) / VERTEX_CONVERT_BLOCK_SIZE;
+    auto convert_block = [&](size_t block) {
+        size_t first = block * VERTEX_CONVERT_BLOCK_SIZE;
+        size_t count = std::min(vertex_count - first, static_cast<size_t>(VERTEX_CONVERT_BLOCK_SIZE));
+        convert_prim_vertices(document, prim, output + first, first, count);
+    };
+    if (block_count > 1) {
+        pool.parallel_for(block_count, convert_block);
+    } else if (block_count == 1) {
+        convert_block(0);
     }
 
-    p.vertex_buffer.initialise(vkdata, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, output);
+    p.vertex_buffer.initialise(vkdata, batch, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, vertex_staging, vertex_count);
+    set_prim_material(document, prim, p);
+    timers.vertex_ns += elapsed_ns(vertex_start);
 
     /* index buffer */
     if (prim.indices >= 0) {
+        auto index_start = std::chrono::steady_clock::now();
         p.has_index_buffer = true;
 
-        auto& accessor = model.accessors[prim.indices];
-        auto& buffer_view = model.bufferViews[accessor.bufferView];
-        auto& buffer = model.buffers[buffer_view.buffer];
-
-        std::vector<uint32_t> output;
-        if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
-            const auto* i_data = reinterpret_cast<const uint16_t*>(&buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-            output = std::vector<uint32_t>(i_data, i_data + accessor.count);
-        } else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
-            const auto* i_data = reinterpret_cast<const uint32_t*>(&buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-            output = std::vector<uint32_t>(i_data, i_data + accessor.count);
-        }
+        size_t index_count = get_prim_index_count(document, prim);
+        VkIndexType index_type = get_prim_index_type(document, prim);
+        auto index_staging = batch.reserve(vkdata, index_count * get_index_size(index_type));
+        convert_prim_indices(document, prim, index_type, index_staging.data);
 
-        //p.index_buffer.initialise_static(vkdata, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, output.data(), output.size() * sizeof(uint32_t));
-        p.index_buffer.initialise(vkdata, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, output);
+        p.index_buffer.initialise(vkdata, batch, index_staging, index_count, index_type);
+        timers.index_ns += elapsed_ns(index_start);
     } else {
         p.has_index_buffer = false;
     }
 
     /* bounds */
-    auto& pos_accessor = model.accessors[atribs.at("POSITION")];
-    p.prim_bounds.max.x = static_cast<float>(pos_accessor.maxValues[0]);
-    p.prim_bounds.max.y = static_cast<float>(pos_accessor.maxValues[1]);
-    p.prim_bounds.max.z = static_cast<float>(pos_accessor.maxValues[2]);
+    p.prim_bounds = get_prim_bounds(document, prim);
+}
 
-    p.prim_bounds.min.x = static_cast<float>(pos_accessor.minValues[0]);
-    p.prim_bounds.min.y = static_cast<float>(pos_accessor.minValues[1]);
-    p.prim_bounds.min.z = static_cast<float>(pos_accessor.minValues[2]);
+void gltf_model::load_image(vulkan_data& vkdata, upload_batch& batch, size_t image_index, bool is_normal_map)
+{
+    auto& image = this->document.model.images[image_index];
+    const unsigned char* data = this->document.images[image_index].data;
+    size_t data_length = this->document.images[image_index].size;
+    if (data_length == 0) {
+        throw std::runtime_error("image " + image.uri + " has no data!");
+    }
+
+    ktx2_texture texture;
+    if (is_ktx2_data(data, data_length)) {
+        // ktx2 files already contain their mip chain, upload them directly
+        texture = read_ktx2(data, data_length);
+        if (!is_format_sampleable(vkdata, texture.format)) {
+            throw std::runtime_error("ktx2 image " + image.uri + " uses a format not supported by this device!");
+        }
+    } else if (this->compress_textures && vkdata.texture_compression_bc) {
+        // already running on a worker, don't spawn more encoder threads
+        texture = compress_texture_cached(data, data_length,
+                                          is_normal_map ? texture_usage::NORMAL : texture_usage::COLOR,
+                                          this->prefer_bc7, to_absolute_path(this->texture_cache_dir), 1);
+    } else if (this->stream_textures) {
+        // streaming needs the whole mip chain up front
+        texture = build_rgba_texture(data, data_length, is_normal_map ? texture_usage::NORMAL : texture_usage::COLOR);
+    } else {
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(data_length), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+            throw std::runtime_error("failed to load texture image!");
+        }
+        size_t byte_size = static_cast<size_t>(width) * height * 4;
+        auto staging = batch.reserve(vkdata, byte_size);
+        std::memcpy(staging.data, pixels, byte_size);
+        stbi_image_free(pixels);
+
+        image_mip_level level;
+        level.byte_size = byte_size;
+        level.width = static_cast<uint32_t>(width);
+        level.height = static_cast<uint32_t>(height);
+
+        // normal maps hold linear data
+        auto& vkimage = this->_image_data[image_index];
+        vkimage.format = is_normal_map ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+        vkimage.initialise_deferred(vkdata, batch, staging, {level});
+        return;
+    }
+
+    if (this->stream_textures) {
+        this->_streamer.add_texture(vkdata, batch, image_index, texture.format, std::move(texture.levels), nullptr, std::move(texture.data));
+        return;
+    }
 
-    /* return populated prim data */
-    return p;
+    auto staging = batch.reserve(vkdata, texture.data.size());
+    std::memcpy(staging.data, texture.data.data(), texture.data.size());
+    auto& vkimage = this->_image_data[image_index];
+    vkimage.format = texture.format;
+    vkimage.initialise_deferred(vkdata, batch, staging, texture.levels);
 }
 
-vulkan_image load_image(vulkan_data& vkdata, const std::string& gltf_path, tinygltf::Image& image)
+// copy blocks for the baked blob, big enough to amortise task overhead
+#define BAKED_COPY_BLOCK_SIZE (4 * 1024 * 1024)
+
+void gltf_model::load_baked_model(vulkan_data& vkdata, thread_pool& pool, upload_batch& batch)
 {
-    vulkan_image vkimage{};
-    if (image.bufferView < 0) {
-        // it is a file
-        vkimage.initialise(vkdata, to_absolute_path(gltf_path + image.uri));
+    CPU_PROFILE_SCOPE("load_baked_model");
+    auto& baked = this->_baked;
+    auto& header = *baked.header;
+
+    if (header.blob_size == 0) {
+        return;
+    }
+
+    /*
+     * the blob section is already gpu ready, copy it into staging memory in one go. when
+     * streaming, images are read from the mapping later so only buffer ranges are staged
+     */
+    auto copy_start = std::chrono::steady_clock::now();
+    bool stream = this->stream_textures;
+    staging_region staging{};
+    if (!stream) {
+        staging = batch.reserve(vkdata, header.blob_size, header.page_size);
+        size_t block_count = (header.blob_size + BAKED_COPY_BLOCK_SIZE - 1) / BAKED_COPY_BLOCK_SIZE;
+        pool.parallel_for(block_count, [&](size_t block) {
+            size_t offset = block * BAKED_COPY_BLOCK_SIZE;
+            size_t size = std::min(static_cast<size_t>(header.blob_size) - offset, static_cast<size_t>(BAKED_COPY_BLOCK_SIZE));
+            std::memcpy(staging.data + offset, baked.blob + offset, size);
+        });
+        this->_load_stats.blob_copy_ms = static_cast<double>(elapsed_ns(copy_start)) / 1e6;
+    }
+
+    auto blob_region = [&](uint64_t file_offset, uint64_t byte_size) {
+        if (stream) {
+            staging_region region = batch.reserve(vkdata, byte_size);
+            std::memcpy(region.data, baked.blob + (file_offset - header.blob_offset), byte_size);
+            return region;
+        }
+        staging_region region = staging;
+        region.data += file_offset - header.blob_offset;
+        region.offset += file_offset - header.blob_offset;
+        return region;
+    };
+
+    /* images */
+    if (stream) {
+        this->_streamer.initialise(vkdata, header.image_count);
     } else {
-        // buffer of data
-        vkimage.initialise(vkdata, image.image.data(), image.image.size());
+        this->_image_data.resize(header.image_count);
+    }
+    for (uint32_t i = 0; i < header.image_count; i++) {
+        auto& image = baked.images[i];
+        auto format = static_cast<VkFormat>(image.vk_format);
+        if (!is_format_sampleable(vkdata, format)) {
+            throw std::runtime_error("baked image " + std::to_string(i) + " uses a format not supported by this device, re-bake without texture compression!");
+        }
+
+        std::vector<image_mip_level> levels(image.level_count);
+        uint64_t image_size = 0;
+        for (uint32_t l = 0; l < image.level_count; l++) {
+            auto& level = baked.levels[image.first_level + l];
+            levels[l].offset = level.offset;
+            levels[l].byte_size = level.byte_size;
+            levels[l].width = level.width;
+            levels[l].height = level.height;
+            image_size = std::max(image_size, level.offset + level.byte_size);
+        }
+
+        if (stream) {
+            // levels stay in the mapping, only the small ones are uploaded now
+            this->_streamer.add_texture(vkdata, batch, i, format, std::move(levels), baked.blob + (image.data_offset - header.blob_offset));
+        } else {
+            auto& vkimage = this->_image_data[i];
+            vkimage.format = format;
+            vkimage.initialise_deferred(vkdata, batch, blob_region(image.data_offset, image_size), levels);
+        }
+    }
+
+    /* meshes */
+    this->_mesh_data.resize(header.mesh_count);
+    for (uint32_t m = 0; m < header.mesh_count; m++) {
+        auto& mesh = baked.meshes[m];
+        this->_mesh_data[m].primitive_data.resize(mesh.prim_count);
+        for (uint32_t p = 0; p < mesh.prim_count; p++) {
+            auto& prim = baked.prims[mesh.first_prim + p];
+            auto& pd = this->_mesh_data[m].primitive_data[p];
+
+            pd.vertex_buffer.initialise(vkdata, batch, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                        blob_region(prim.vertex_offset, prim.vertex_count * sizeof(vertex)), prim.vertex_count);
+            pd.has_index_buffer = (prim.index_count > 0);
+            if (pd.has_index_buffer) {
+                auto index_type = static_cast<VkIndexType>(prim.index_type);
+                pd.index_buffer.initialise(vkdata, batch, blob_region(prim.index_offset, prim.index_count * get_index_size(index_type)),
+                                           prim.index_count, index_type);
+            }
+
+            if (prim.material >= 0) {
+                auto& material = baked.materials[prim.material];
+                pd.tex_indexes.color = material.color;
+                pd.tex_indexes.emissive = material.emissive;
+                pd.tex_indexes.metal_roughness = material.metal_roughness;
+                pd.tex_indexes.normal = material.normal;
+                pd.alpha_cutoff = material.alpha_cutoff;
+            }
+            pd.has_vertex_color = (prim.flags & BAKED_PRIM_VERTEX_COLOR) != 0;
+            pd.prim_bounds.min = glm::make_vec3(prim.bounds_min);
+            pd.prim_bounds.max = glm::make_vec3(prim.bounds_max);
+            pd.uv_density = prim.uv_density;
+        }
+        this->_load_stats.primitive_count += mesh.prim_count;
     }
-    return vkimage;
 }
 
 void gltf_model::load_model(vulkan_data& vkdata)
@@ -158,40 +475,91 @@ void gltf_model::load_model(vulkan_data& vkdata)
         throw std::runtime_error("attempted to load model which has already been loaded");
     }
 
-    /* load images */
-    this->_image_data.reserve(this->gltf_model.images.size());
-    for (size_t i = 0; i < this->gltf_model.images.size(); i++) {
-        // load image
-        auto vkim = load_image(vkdata, this->relative_path, this->gltf_model.images[i]);
-        this->_image_data.push_back(vkim);
-    }
+    CPU_PROFILE_SCOPE("load_model");
+    auto load_start = std::chrono::steady_clock::now();
+    double parse_ms = this->_load_stats.parse_ms;
+    this->_load_stats = {};
+    this->_load_stats.parse_ms = parse_ms;
+
+    thread_pool pool;
+    pool.initialise(this->load_thread_count);
+    upload_batch batch;
+    batch.initialise(vkdata);
+    load_stage_timers timers;
+
+    try {
+        if (this->_is_baked) {
+            this->load_baked_model(vkdata, pool, batch);
+        } else {
+            /* find normal map images, they need to be created with a linear format */
+            auto is_normal_map = find_normal_map_images(this->document);
+
+            /* size all outputs up front, workers write into them in place */
+            if (this->stream_textures) {
+                this->_streamer.initialise(vkdata, this->document.model.images.size());
+            } else {
+                this->_image_data.resize(this->document.model.images.size());
+            }
+            this->_mesh_data.resize(this->document.model.meshes.size());
+            for (size_t m = 0; m < this->document.model.meshes.size(); m++) {
+                this->_mesh_data[m].primitive_data.resize(this->document.model.meshes[m].primitives.size());
+                this->_load_stats.primitive_count += this->document.model.meshes[m].primitives.size();
+            }
 
-    /* load meshes */
-    this->_mesh_data.reserve(this->gltf_model.meshes.size());
-    for (size_t m = 0; m < this->gltf_model.meshes.size(); m++) {
-        // load mesh
-        mesh_data md;
-        md.primitive_data.reserve(this->gltf_model.meshes[m].primitives.size());
-        for (size_t p = 0; p < this->gltf_model.meshes[m].primitives.size(); p++) {
-            // load primative
-            auto pd = load_prim(vkdata, this->gltf_model, this->gltf_model.meshes[m].primitives[p]);
-            md.primitive_data.push_back(pd);
-        }
-        this->_mesh_data.push_back(md);
-    }
+            /* decode images and convert primitives on the pool */
+            for (size_t i = 0; i < this->document.model.images.size(); i++) {
+                pool.submit([&, i]{
+                    CPU_PROFILE_SCOPE("load_image");
+                    auto image_start = std::chrono::steady_clock::now();
+                    this->load_image(vkdata, batch, i, is_normal_map[i]);
+                    timers.image_ns += elapsed_ns(image_start);
+                });
+            }
 
-    // @TODO: load materials
+            for (size_t m = 0; m < this->document.model.meshes.size(); m++) {
+                for (size_t p = 0; p < this->document.model.meshes[m].primitives.size(); p++) {
+                    pool.submit([&, m, p]{
+                        CPU_PROFILE_SCOPE("load_prim");
+                        auto& prim = this->document.model.meshes[m].primitives[p];
+                        auto& pd = this->_mesh_data[m].primitive_data[p];
+                        load_prim(vkdata, batch, pool, timers, this->document, prim, pd);
+                        if (this->stream_textures) {
+                            pd.uv_density = get_prim_uv_density(this->document, prim);
+                        }
+                    });
+                }
+            }
 
+            pool.wait_idle();
+            this->_load_stats.image_decode_ms = static_cast<double>(timers.image_ns) / 1e6;
+            this->_load_stats.vertex_convert_ms = static_cast<double>(timers.vertex_ns) / 1e6;
+            this->_load_stats.index_convert_ms = static_cast<double>(timers.index_ns) / 1e6;
+        }
+        this->_load_stats.cpu_stage_ms = static_cast<double>(elapsed_ns(load_start)) / 1e6;
 
-    /* fix image formats */
-    for (auto& mesh : this->_mesh_data) {
-        for (auto& prim : mesh.primitive_data) {
-            if (prim.tex_indexes.normal >= 0) {
-                this->_image_data[prim.tex_indexes.normal].format = VK_FORMAT_R8G8B8A8_UNORM;
-            }
+        /* every upload goes to the gpu in a single submission */
+        auto upload_start = std::chrono::steady_clock::now();
+        {
+            CPU_PROFILE_SCOPE("upload_submit");
+            batch.submit(vkdata);
         }
+        this->_load_stats.upload_ms = static_cast<double>(elapsed_ns(upload_start)) / 1e6;
+    } catch (...) {
+        pool.terminate();
+        batch.terminate(vkdata);
+        throw;
     }
 
+    this->_load_stats.thread_count = pool.thread_count();
+    pool.terminate();
+    this->_load_stats.staged_bytes = static_cast<size_t>(batch.staged_byte_size());
+    batch.terminate(vkdata);
+
+    // @TODO: load materials
+
+    this->_load_stats.image_count = this->stream_textures ? this->_streamer.texture_count() : this->_image_data.size();
+    this->_load_stats.total_ms = static_cast<double>(elapsed_ns(load_start)) / 1e6;
+
     this->_is_loaded = true;
 }
 
@@ -207,6 +575,7 @@ void gltf_model::unload_model(vulkan_data& vkdata)
         image.terminate(vkdata);
     }
     this->_image_data.clear();
+    this->_streamer.terminate(vkdata);
 
     /* unload all meshes */
     for (mesh_data& mesh : this->_mesh_data) {
@@ -222,13 +591,23 @@ void gltf_model::unload_model(vulkan_data& vkdata)
     this->_is_loaded = false;
 }
 
+bool gltf_model::is_valid() const
+{
+    return this->_is_valid;
+}
+
 bool gltf_model::is_loaded() const
 {
     return this->_is_loaded;
 }
 
 const tinygltf::Model& gltf_model::model() const {
-    return this->gltf_model;
+    return this->document.model;
+}
+
+const scene_table& gltf_model::scene() const
+{
+    return this->_scene;
 }
 
 const std::vector<mesh_data>& gltf_model::vk_mesh_data() const
@@ -241,13 +620,38 @@ const std::vector<vulkan_image>& gltf_model::vk_image_data() const
     return this->_image_data;
 }
 
+const vulkan_image& gltf_model::get_image(size_t image_index, uint32_t* generation) const
+{
+    if (this->stream_textures) {
+        if (generation) *generation = this->_streamer.get_generation(image_index);
+        return this->_streamer.get_image(image_index);
+    }
+    if (generation) *generation = 0;
+    return this->_image_data.at(image_index);
+}
+
+texture_streamer& gltf_model::streamer()
+{
+    return this->_streamer;
+}
+
+const gltf_load_stats& gltf_model::load_stats() const
+{
+    return this->_load_stats;
+}
+
 bounds gltf_model::get_model_bounds() const
+{
+    return get_mesh_bounds(this->_mesh_data);
+}
+
+bounds get_mesh_bounds(const std::vector<mesh_data>& meshes)
 {
     bounds ret;
     ret.max.x = ret.max.y = ret.max.z = -99999999999999.0f;
     ret.min.x = ret.min.y = ret.min.z =  99999999999999.0f;
 
-    for (auto& m : this->_mesh_data) {
+    for (auto& m : meshes) {
         for (auto& p : m.primitive_data) {
             ret.max.x = std::max(ret.max.x, p.prim_bounds.max.x);
             ret.max.y = std::max(ret.max.y, p.prim_bounds.max.y);
@@ -3,7 +3,11 @@
 #include <glm/glm.hpp>
 #include <basic_pipeline.h>
 #include "vulkan/vulkan_base.h"
-#include <include/tiny_gltf.h>
+#include "thread_pool.h"
+#include "scene_table.h"
+#include "baked_model.h"
+#include "gltf_document.h"
+#include "texture_streamer.h"
 
 struct vertex {
     glm::vec3 position = glm::vec3(0.0f);
@@ -22,36 +26,94 @@ struct bounds {
 
 struct prim_data {
     static_buffer<vertex> vertex_buffer;
-    static_buffer<uint32_t> index_buffer;
+    static_index_buffer index_buffer;
     bool has_index_buffer = false;
-    struct {
+    struct {    // indexes into the model's images (not textures)
         int color = -1;
         int emissive = -1;
         int metal_roughness = -1;
         int normal = -1;
     } tex_indexes;
     bounds prim_bounds;
+    float uv_density = 0.0f;    // mesh space units per uv unit, 0 when unknown
+    bool has_vertex_color = false;
+    float alpha_cutoff = -1.0f; // fragments below this alpha are discarded, negative when not masked
 };
 
 struct mesh_data {
     std::vector<prim_data> primitive_data;
 };
 
+struct gltf_load_stats {
+    uint32_t thread_count = 0;
+    size_t image_count = 0;
+    size_t primitive_count = 0;
+    size_t staged_bytes = 0;
+
+    // cpu time summed across all worker threads
+    double image_decode_ms = 0.0;
+    double vertex_convert_ms = 0.0;
+    double index_convert_ms = 0.0;
+    double blob_copy_ms = 0.0;      // baked models only
+
+    // wall clock time on the loading thread
+    double parse_ms = 0.0;          // in initialise, parsing the json or mapping the baked tables
+    double cpu_stage_ms = 0.0;
+    double upload_ms = 0.0;
+    double total_ms = 0.0;
+};
+
+// helpers shared by the runtime loader and the offline baker
+int get_texture_image_index(const gltf_document& document, int texture_index);
+std::vector<bool> find_normal_map_images(const gltf_document& document);
+size_t get_prim_vertex_count(const gltf_document& document, const tinygltf::Primitive& prim);
+void convert_prim_vertices(const gltf_document& document, const tinygltf::Primitive& prim, vertex* output, size_t first, size_t count);
+size_t get_prim_index_count(const gltf_document& document, const tinygltf::Primitive& prim);
+VkIndexType get_prim_index_type(const gltf_document& document, const tinygltf::Primitive& prim);
+void convert_prim_indices(const gltf_document& document, const tinygltf::Primitive& prim, VkIndexType type, void* output);
+bounds get_prim_bounds(const gltf_document& document, const tinygltf::Primitive& prim);
+float get_prim_uv_density(const gltf_document& document, const tinygltf::Primitive& prim);
+// alphaCutoff for MASK materials, -1 otherwise
+float get_material_alpha_cutoff(const tinygltf::Material& material);
+// the box around every primitive's bounds, inverted (min above max) when there are none
+bounds get_mesh_bounds(const std::vector<mesh_data>& meshes);
+
 class gltf_model {
 private:
     std::string relative_path = "";
-    tinygltf::TinyGLTF loader;
-    tinygltf::Model gltf_model;
+    gltf_document document;
     bool _is_valid = false;
     bool _is_loaded = false;
 
     std::vector<mesh_data> _mesh_data;
     std::vector<vulkan_image> _image_data;
+    gltf_load_stats _load_stats;
+    scene_table _scene;
+    baked_model _baked;
+    bool _is_baked = false;
+    texture_streamer _streamer;
+
+    void load_baked_model(vulkan_data& vkdata, thread_pool& pool, upload_batch& batch);
+    void load_image(vulkan_data& vkdata, upload_batch& batch, size_t image_index, bool is_normal_map);
 
 public:
     std::string err = "";
     std::string warn = "";
 
+    /* texture compression, png/jpeg images are block compressed on first load and
+       cached as ktx2 files. ktx2 images are always uploaded as is */
+    bool compress_textures = false;
+    bool prefer_bc7 = false;
+    std::string texture_cache_dir = "res/cache/textures/";
+
+    // worker threads used by load_model, 0 uses the hardware concurrency
+    uint32_t load_thread_count = 0;
+
+    /* texture streaming, images start with their small mips and the rest stream in as the
+       renderer requests them, call streamer().update() once per frame */
+    bool stream_textures = false;
+
+    // .dbake files are loaded as baked models, .gltf/.glb through a mapped gltf_document
     void initialise(const std::string& relative_path);
     void terminate(vulkan_data& vkdata);
 
@@ -63,7 +125,12 @@ public:
 
     bounds get_model_bounds() const;
 
-    const tinygltf::Model& model() const;
+    const tinygltf::Model& model() const;     // empty for baked models, nodes live in scene()
+    const scene_table& scene() const;
     const std::vector<mesh_data>& vk_mesh_data() const;
-    const std::vector<vulkan_image>& vk_image_data() const;
+    const std::vector<vulkan_image>& vk_image_data() const;   // empty when textures are streamed
+    // the image currently resident for image_index, the generation changes whenever streaming swaps it
+    const vulkan_image& get_image(size_t image_index, uint32_t* generation = nullptr) const;
+    texture_streamer& streamer();
+    const gltf_load_stats& load_stats() const;
 };
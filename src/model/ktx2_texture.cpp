@@ -0,0 +1,404 @@
+#include "ktx2_texture.h"
+
+#include <platform.h>
+
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "stb_image.h"
+
+static const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+static const size_t KTX2_HEADER_SIZE = 80;
+static const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+enum ktx2_supercompression : uint32_t {
+    KTX2_SUPERCOMPRESSION_NONE = 0,
+    KTX2_SUPERCOMPRESSION_BASIS_LZ = 1,
+    KTX2_SUPERCOMPRESSION_ZSTD = 2,
+    KTX2_SUPERCOMPRESSION_ZLIB = 3
+};
+
+struct ktx2_format_info {
+    uint32_t block_bytes = 0;   // bytes per block (or per texel for uncompressed formats)
+    uint32_t block_dim = 1;     // texels per block edge
+};
+
+static bool get_format_info(VkFormat format, ktx2_format_info& info)
+{
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            info = {8, 4};
+            return true;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            info = {16, 4};
+            return true;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            info = {4, 1};
+            return true;
+        default:
+            return false;
+    }
+}
+
+static size_t get_level_byte_size(const ktx2_format_info& info, uint32_t width, uint32_t height)
+{
+    size_t blocks_x = (width + info.block_dim - 1) / info.block_dim;
+    size_t blocks_y = (height + info.block_dim - 1) / info.block_dim;
+    return blocks_x * blocks_y * info.block_bytes;
+}
+
+template <typename T>
+static T read_le(const unsigned char* data)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+template <typename T>
+static void write_le(std::vector<unsigned char>& out, size_t offset, T value)
+{
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out[offset + i] = static_cast<unsigned char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xFF);
+    }
+}
+
+bool is_ktx2_data(const unsigned char* data, size_t data_length)
+{
+    return data_length >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool ktx2_needs_transcoder(const unsigned char* data, size_t data_length)
+{
+    if (!is_ktx2_data(data, data_length) || data_length < KTX2_HEADER_SIZE) {
+        return false;
+    }
+    return read_le<uint32_t>(data + 12) == VK_FORMAT_UNDEFINED || read_le<uint32_t>(data + 44) == KTX2_SUPERCOMPRESSION_BASIS_LZ;
+}
+
+ktx2_texture read_ktx2(const unsigned char* data, size_t data_length)
+{
+    if (!is_ktx2_data(data, data_length) || data_length < KTX2_HEADER_SIZE) {
+        throw std::runtime_error("data is not a valid ktx2 file!");
+    }
+
+    auto vk_format = read_le<uint32_t>(data + 12);
+    auto pixel_width = read_le<uint32_t>(data + 20);
+    auto pixel_height = read_le<uint32_t>(data + 24);
+    auto pixel_depth = read_le<uint32_t>(data + 28);
+    auto layer_count = read_le<uint32_t>(data + 32);
+    auto face_count = read_le<uint32_t>(data + 36);
+    auto level_count = std::max(1u, read_le<uint32_t>(data + 40));
+    auto supercompression = read_le<uint32_t>(data + 44);
+
+    if (supercompression == KTX2_SUPERCOMPRESSION_BASIS_LZ || vk_format == VK_FORMAT_UNDEFINED) {
+        throw std::runtime_error("ktx2 file requires basis universal transcoding which is not supported, re-encode it to a BCn format!");
+    }
+    if (supercompression != KTX2_SUPERCOMPRESSION_NONE) {
+        throw std::runtime_error("ktx2 supercompression scheme " + std::to_string(supercompression) + " is not supported!");
+    }
+    if (pixel_depth > 1 || layer_count > 1 || face_count != 1 || pixel_width == 0 || pixel_height == 0) {
+        throw std::runtime_error("only single layer 2d ktx2 textures are supported!");
+    }
+
+    ktx2_texture texture;
+    texture.format = static_cast<VkFormat>(vk_format);
+    texture.width = pixel_width;
+    texture.height = pixel_height;
+
+    ktx2_format_info info;
+    if (!get_format_info(texture.format, info)) {
+        throw std::runtime_error("ktx2 file has an unsupported vkFormat " + std::to_string(vk_format) + "!");
+    }
+
+    // a full mip chain ends at 1x1, more levels would shift the size by 32 or more below
+    uint32_t max_level_count = 1;
+    while ((std::max(pixel_width, pixel_height) >> max_level_count) > 0) {
+        max_level_count++;
+    }
+    if (level_count > max_level_count) {
+        throw std::runtime_error("ktx2 file has " + std::to_string(level_count) + " levels, more than a full mip chain!");
+    }
+
+    if (data_length < KTX2_HEADER_SIZE + level_count * KTX2_LEVEL_INDEX_ENTRY_SIZE) {
+        throw std::runtime_error("ktx2 level index is truncated!");
+    }
+
+    /* copy levels into a single allocation ordered largest to smallest */
+    std::vector<std::pair<uint64_t, uint64_t>> source_ranges(level_count);
+    size_t total_size = 0;
+    for (uint32_t i = 0; i < level_count; i++) {
+        const unsigned char* entry = data + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        auto byte_offset = read_le<uint64_t>(entry);
+        auto byte_length = read_le<uint64_t>(entry + 8);
+        // the offset comes from the file, adding the length to it could wrap
+        if (byte_offset > data_length || byte_length > data_length - byte_offset) {
+            throw std::runtime_error("ktx2 level " + std::to_string(i) + " lies outside of the file!");
+        }
+
+        image_mip_level level;
+        level.width = std::max(1u, pixel_width >> i);
+        level.height = std::max(1u, pixel_height >> i);
+        level.offset = total_size;
+        level.byte_size = get_level_byte_size(info, level.width, level.height);
+        if (byte_length < level.byte_size) {
+            throw std::runtime_error("ktx2 level " + std::to_string(i) + " is smaller than expected!");
+        }
+
+        source_ranges[i] = {byte_offset, byte_length};
+        texture.levels.push_back(level);
+        // keep offsets block aligned for the buffer to image copies
+        total_size += (level.byte_size + 15) & ~static_cast<size_t>(15);
+    }
+
+    texture.data.resize(total_size);
+    for (uint32_t i = 0; i < level_count; i++) {
+        std::memcpy(&texture.data[texture.levels[i].offset], data + source_ranges[i].first, texture.levels[i].byte_size);
+    }
+    return texture;
+}
+
+ktx2_texture read_ktx2_file(const std::string& abs_path)
+{
+    auto file_data = read_data_from_binary_file(abs_path);
+    return read_ktx2(reinterpret_cast<const unsigned char*>(file_data.data()), file_data.size());
+}
+
+/* builds the basic data format descriptor block for the formats written by the texture cache */
+static std::vector<unsigned char> build_dfd(VkFormat format, uint32_t block_bytes)
+{
+    struct dfd_sample { uint32_t bit_offset; uint32_t bit_length; uint32_t channel; };
+
+    uint32_t color_model = 0;
+    bool srgb = false;
+    std::vector<dfd_sample> samples;
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:  srgb = true; [[fallthrough]];
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK: color_model = 128; samples = {{0, 64, 0}}; break;
+        case VK_FORMAT_BC3_SRGB_BLOCK:      srgb = true; [[fallthrough]];
+        case VK_FORMAT_BC3_UNORM_BLOCK:     color_model = 130; samples = {{0, 64, 15}, {64, 64, 0}}; break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:     color_model = 132; samples = {{0, 64, 0}, {64, 64, 1}}; break;
+        case VK_FORMAT_BC7_SRGB_BLOCK:      srgb = true; [[fallthrough]];
+        case VK_FORMAT_BC7_UNORM_BLOCK:     color_model = 134; samples = {{0, 128, 0}}; break;
+        default: throw std::runtime_error("unable to write ktx2 data format descriptor for this format!");
+    }
+
+    uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+    std::vector<unsigned char> dfd(4 + block_size, 0);
+    write_le<uint32_t>(dfd, 0, static_cast<uint32_t>(dfd.size()));
+    write_le<uint32_t>(dfd, 4, 0);                                      // vendor id, descriptor type
+    write_le<uint32_t>(dfd, 8, 2u | (block_size << 16));                // version, block size
+    write_le<uint32_t>(dfd, 12, color_model | (1u << 8) | ((srgb ? 2u : 1u) << 16)); // model, bt709, transfer
+    write_le<uint32_t>(dfd, 16, 3u | (3u << 8));                        // 4x4x1x1 texel blocks
+    write_le<uint32_t>(dfd, 20, block_bytes);                           // bytes plane 0
+    write_le<uint32_t>(dfd, 24, 0);
+    for (size_t i = 0; i < samples.size(); i++) {
+        size_t offset = 28 + i * 16;
+        write_le<uint32_t>(dfd, offset, samples[i].bit_offset | ((samples[i].bit_length - 1) << 16) | (samples[i].channel << 24));
+        write_le<uint32_t>(dfd, offset + 4, 0);
+        write_le<uint32_t>(dfd, offset + 8, 0);
+        write_le<uint32_t>(dfd, offset + 12, 0xFFFFFFFFu);
+    }
+    return dfd;
+}
+
+void write_ktx2_file(const std::string& abs_path, const ktx2_texture& texture)
+{
+    ktx2_format_info info;
+    if (!get_format_info(texture.format, info) || texture.levels.empty()) {
+        throw std::runtime_error("attempted to write an invalid ktx2 texture!");
+    }
+
+    auto level_count = static_cast<uint32_t>(texture.levels.size());
+    auto dfd = build_dfd(texture.format, info.block_bytes);
+    size_t dfd_offset = KTX2_HEADER_SIZE + level_count * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+
+    /* level data is stored smallest level first, each aligned to the block size */
+    std::vector<size_t> level_offsets(level_count);
+    size_t file_size = dfd_offset + dfd.size();
+    for (uint32_t i = level_count; i-- > 0;) {
+        file_size = (file_size + info.block_bytes - 1) / info.block_bytes * info.block_bytes;
+        level_offsets[i] = file_size;
+        file_size += texture.levels[i].byte_size;
+    }
+
+    std::vector<unsigned char> out(file_size, 0);
+    std::memcpy(out.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    write_le<uint32_t>(out, 12, static_cast<uint32_t>(texture.format));
+    write_le<uint32_t>(out, 16, 1);                                     // type size
+    write_le<uint32_t>(out, 20, texture.width);
+    write_le<uint32_t>(out, 24, texture.height);
+    write_le<uint32_t>(out, 28, 0);                                     // depth
+    write_le<uint32_t>(out, 32, 0);                                     // layers
+    write_le<uint32_t>(out, 36, 1);                                     // faces
+    write_le<uint32_t>(out, 40, level_count);
+    write_le<uint32_t>(out, 44, KTX2_SUPERCOMPRESSION_NONE);
+    write_le<uint32_t>(out, 48, static_cast<uint32_t>(dfd_offset));
+    write_le<uint32_t>(out, 52, static_cast<uint32_t>(dfd.size()));
+    // key/value and supercompression global data are left empty
+
+    for (uint32_t i = 0; i < level_count; i++) {
+        size_t entry = KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+        write_le<uint64_t>(out, entry, level_offsets[i]);
+        write_le<uint64_t>(out, entry + 8, texture.levels[i].byte_size);
+        write_le<uint64_t>(out, entry + 16, texture.levels[i].byte_size);
+        std::memcpy(&out[level_offsets[i]], &texture.data[texture.levels[i].offset], texture.levels[i].byte_size);
+    }
+    std::memcpy(&out[dfd_offset], dfd.data(), dfd.size());
+
+    // write to a temporary file first so a partially written cache entry is never read back
+    std::string temp_path = abs_path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open " + temp_path + " for writing!");
+        }
+        file.write(reinterpret_cast<const char*>(out.data()), static_cast<std::streamsize>(out.size()));
+        file.close();
+        if (!file) {
+            // a short write, e.g. a full disk, must not be renamed into place
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            throw std::runtime_error("failed to write " + temp_path + "!");
+        }
+    }
+    std::filesystem::rename(temp_path, abs_path);
+}
+
+VkFormat get_bc_vk_format(bc_format format, bool is_srgb)
+{
+    switch (format) {
+        case bc_format::BC1: return is_srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        case bc_format::BC3: return is_srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+        case bc_format::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+        case bc_format::BC7: return is_srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return VK_FORMAT_UNDEFINED;
+}
+
+static uint64_t hash_bytes(const unsigned char* data, size_t data_length)
+{
+    // FNV-1a, good enough to key the cache on file contents
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < data_length; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static std::vector<rgba_mip_level> decode_mip_chain(const unsigned char* encoded_data, size_t data_length, texture_usage usage, bool* has_alpha)
+{
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load_from_memory(encoded_data, static_cast<int>(data_length), &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+
+    if (has_alpha) {
+        *has_alpha = rgba_has_alpha(pixels, width, height);
+    }
+    auto mips = build_rgba_mip_chain(pixels, width, height, usage == texture_usage::COLOR, usage == texture_usage::NORMAL);
+    stbi_image_free(pixels);
+    return mips;
+}
+
+ktx2_texture build_rgba_texture(const unsigned char* encoded_data, size_t data_length, texture_usage usage)
+{
+    auto mips = decode_mip_chain(encoded_data, data_length, usage, nullptr);
+
+    ktx2_texture texture;
+    texture.format = (usage == texture_usage::COLOR) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    texture.width = mips[0].width;
+    texture.height = mips[0].height;
+    for (auto& mip : mips) {
+        image_mip_level level;
+        level.offset = texture.data.size();
+        level.byte_size = mip.pixels.size();
+        level.width = mip.width;
+        level.height = mip.height;
+        texture.levels.push_back(level);
+        texture.data.insert(texture.data.end(), mip.pixels.begin(), mip.pixels.end());
+    }
+    return texture;
+}
+
+ktx2_texture compress_texture(const unsigned char* encoded_data, size_t data_length, texture_usage usage, bool prefer_bc7, uint32_t thread_count)
+{
+    bool has_alpha = false;
+    auto mips = decode_mip_chain(encoded_data, data_length, usage, &has_alpha);
+
+    bool is_srgb = (usage == texture_usage::COLOR);
+    bc_format format;
+    if (usage == texture_usage::NORMAL) {
+        format = bc_format::BC5;
+    } else if (prefer_bc7) {
+        format = bc_format::BC7;
+    } else {
+        format = has_alpha ? bc_format::BC3 : bc_format::BC1;
+    }
+
+    ktx2_texture texture;
+    texture.format = get_bc_vk_format(format, is_srgb);
+    texture.width = mips[0].width;
+    texture.height = mips[0].height;
+    for (auto& mip : mips) {
+        auto blocks = encode_bc(mip.pixels.data(), mip.width, mip.height, format, thread_count);
+
+        image_mip_level level;
+        level.offset = texture.data.size();
+        level.byte_size = blocks.size();
+        level.width = mip.width;
+        level.height = mip.height;
+        texture.levels.push_back(level);
+        texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+    }
+    return texture;
+}
+
+ktx2_texture compress_texture_cached(const unsigned char* encoded_data, size_t data_length, texture_usage usage, bool prefer_bc7,
+                                     const std::string& abs_cache_dir, uint32_t thread_count)
+{
+    /* check the cache first */
+    char name[64];
+    std::snprintf(name, sizeof(name), "%016llx_%s%s.ktx2",
+                  static_cast<unsigned long long>(hash_bytes(encoded_data, data_length)),
+                  (usage == texture_usage::NORMAL) ? "normal" : "color",
+                  (prefer_bc7 && usage == texture_usage::COLOR) ? "_bc7" : "");
+    std::string cache_path = abs_cache_dir + name;
+
+    if (std::filesystem::exists(cache_path)) {
+        try {
+            return read_ktx2_file(cache_path);
+        } catch (const std::exception&) {
+            // corrupt or stale cache entry, fall through and re-encode it
+        }
+    }
+
+    auto texture = compress_texture(encoded_data, data_length, usage, prefer_bc7, thread_count);
+
+    /* store the result, failing to write the cache is not fatal */
+    try {
+        std::filesystem::create_directories(abs_cache_dir);
+        write_ktx2_file(cache_path, texture);
+    } catch (const std::exception&) {
+    }
+    return texture;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan_base.h"
+#include "bc_encoder.h"
+
+/*
+ * minimal KTX2 container support. only single layer, single face 2d textures without
+ * supercompression are handled, which covers block compressed textures written by
+ * `toktx --encode none` style tools and the files produced by the texture cache below.
+ */
+struct ktx2_texture {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<image_mip_level> levels;  // level 0 first, offsets are relative to data
+    std::vector<unsigned char> data;
+};
+
+bool is_ktx2_data(const unsigned char* data, size_t data_length);
+// true for basis universal (BasisLZ/UASTC) files, these need a transcoder which is not available
+bool ktx2_needs_transcoder(const unsigned char* data, size_t data_length);
+ktx2_texture read_ktx2(const unsigned char* data, size_t data_length);
+ktx2_texture read_ktx2_file(const std::string& abs_path);
+void write_ktx2_file(const std::string& abs_path, const ktx2_texture& texture);
+
+enum class texture_usage {
+    COLOR,      // srgb, compressed to BC1 (opaque), BC3 (alpha) or BC7
+    NORMAL      // linear, compressed to BC5 and reconstructed in the shader
+};
+
+VkFormat get_bc_vk_format(bc_format format, bool is_srgb);
+
+// decodes an encoded (png/jpeg/etc.) image and builds an uncompressed rgba8 mip chain
+ktx2_texture build_rgba_texture(const unsigned char* encoded_data, size_t data_length, texture_usage usage);
+
+// as above but every level is block compressed
+ktx2_texture compress_texture(const unsigned char* encoded_data, size_t data_length, texture_usage usage, bool prefer_bc7,
+                              uint32_t thread_count = 0);
+
+/*
+ * compress_texture with the result cached in abs_cache_dir keyed on the source bytes so subsequent loads
+ * only read the ktx2 file back.
+ */
+ktx2_texture compress_texture_cached(const unsigned char* encoded_data, size_t data_length, texture_usage usage, bool prefer_bc7,
+                                     const std::string& abs_cache_dir, uint32_t thread_count = 0);
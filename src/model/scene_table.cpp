@@ -0,0 +1,58 @@
+#include "scene_table.h"
+
+#include <include/tiny_gltf.h>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+glm::mat4 compose_local_transform(const double* matrix, const double* translation, const double* rotation, const double* scale)
+{
+    if (matrix) {
+        return glm::make_mat4x4(matrix);
+    }
+
+    glm::mat4 transform = glm::mat4(1.0f);
+    if (translation) {
+        transform = glm::translate(transform, glm::vec3(glm::make_vec3(translation)));
+    }
+    if (rotation) {
+        glm::quat q = glm::make_quat(rotation);
+        transform = transform * glm::mat4(q);
+    }
+    if (scale) {
+        transform = glm::scale(transform, glm::vec3(glm::make_vec3(scale)));
+    }
+    return transform;
+}
+
+static const double* data_or_null(const std::vector<double>& values)
+{
+    return values.empty() ? nullptr : values.data();
+}
+
+scene_table build_scene_table(const tinygltf::Model& model)
+{
+    scene_table table;
+    table.nodes.resize(model.nodes.size());
+
+    for (size_t i = 0; i < model.nodes.size(); i++) {
+        auto& node = model.nodes[i];
+        auto& entry = table.nodes[i];
+        entry.local_transform = compose_local_transform(data_or_null(node.matrix), data_or_null(node.translation),
+                                                        data_or_null(node.rotation), data_or_null(node.scale));
+        entry.mesh = node.mesh;
+        entry.first_child = static_cast<uint32_t>(table.children.size());
+        entry.child_count = static_cast<uint32_t>(node.children.size());
+        for (int c : node.children) {
+            table.children.push_back(static_cast<uint32_t>(c));
+        }
+    }
+
+    if (!model.scenes.empty()) {
+        int scene = (model.defaultScene >= 0) ? model.defaultScene : 0;
+        for (int n : model.scenes[scene].nodes) {
+            table.roots.push_back(static_cast<uint32_t>(n));
+        }
+    }
+    return table;
+}
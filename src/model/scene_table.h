@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace tinygltf { class Model; }
+
+/*
+ * flattened node hierarchy. children of a node are stored contiguously in
+ * `children` so the whole scene can be walked without touching the source
+ * document, the same table is filled from glTF or from a baked model.
+ */
+struct scene_node {
+    glm::mat4 local_transform = glm::mat4(1.0f);
+    int32_t mesh = -1;
+    uint32_t first_child = 0;   // index into scene_table::children
+    uint32_t child_count = 0;
+};
+
+struct scene_table {
+    std::vector<scene_node> nodes;
+    std::vector<uint32_t> children;
+    std::vector<uint32_t> roots;
+};
+
+// uses the default scene (or the first scene) of the model
+scene_table build_scene_table(const tinygltf::Model& model);
+
+// glTF node transform, matrix wins over TRS. absent parts are passed as nullptr
+glm::mat4 compose_local_transform(const double* matrix, const double* translation, const double* rotation, const double* scale);
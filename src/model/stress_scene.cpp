@@ -0,0 +1,412 @@
+#include "stress_scene.h"
+
+#include <include/stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <vector>
+
+#define STRESS_PI 3.14159265358979f
+
+// splitmix64, every part of the scene draws from its own stream so changing e.g. the texture
+// count doesn't move the nodes
+struct stress_rng {
+    uint64_t state;
+
+    stress_rng(uint32_t seed, uint32_t stream) : state((static_cast<uint64_t>(seed) << 32) | stream) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // [0, 1)
+    float unit() { return static_cast<float>(next() >> 40) / static_cast<float>(1ull << 24); }
+    float range(float lo, float hi) { return lo + (hi - lo) * unit(); }
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+
+    float gaussian()
+    {
+        float u = std::max(unit(), 1e-7f);
+        return std::sqrt(-2.0f * std::log(u)) * std::cos(2.0f * STRESS_PI * unit());
+    }
+};
+
+struct stress_vec3 {
+    float x, y, z;
+};
+
+struct stress_mesh_bounds {
+    stress_vec3 min, max;
+};
+
+bool parse_stress_distribution(const std::string& name, stress_distribution* distribution)
+{
+    if (name == "uniform") {
+        *distribution = stress_distribution::UNIFORM;
+    } else if (name == "clustered") {
+        *distribution = stress_distribution::CLUSTERED;
+    } else if (name == "grid") {
+        *distribution = stress_distribution::GRID;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// smallest branching factor whose complete tree of depth levels holds node_count nodes
+static uint32_t get_branching(uint32_t node_count, uint32_t depth)
+{
+    if (depth <= 1) {
+        return 0;
+    }
+    for (uint64_t b = 1;; b++) {
+        uint64_t total = 0, level = 1;
+        for (uint32_t d = 0; d < depth && total < node_count; d++) {
+            total += level;
+            level *= b;
+        }
+        if (total >= node_count) {
+            return static_cast<uint32_t>(b);
+        }
+    }
+}
+
+static std::vector<stress_vec3> place_nodes(const stress_scene_params& params)
+{
+    stress_rng rng(params.seed, 1);
+    std::vector<stress_vec3> positions(params.node_count);
+    float half = params.extent * 0.5f;
+
+    switch (params.distribution) {
+    case stress_distribution::UNIFORM:
+        for (auto& p : positions) {
+            p = {rng.range(-half, half), rng.range(-half, half), rng.range(-half, half)};
+        }
+        break;
+    case stress_distribution::CLUSTERED: {
+        std::vector<stress_vec3> centres(std::max(1u, params.node_count / 1000));
+        for (auto& c : centres) {
+            c = {rng.range(-half, half), rng.range(-half, half), rng.range(-half, half)};
+        }
+        float sigma = params.extent * 0.02f;
+        for (auto& p : positions) {
+            auto& c = centres[rng.below(static_cast<uint32_t>(centres.size()))];
+            p = {c.x + rng.gaussian() * sigma, c.y + rng.gaussian() * sigma, c.z + rng.gaussian() * sigma};
+        }
+        break;
+    }
+    case stress_distribution::GRID: {
+        uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(params.node_count))));
+        float spacing = params.extent / static_cast<float>(side);
+        float origin = -half + spacing * 0.5f;
+        for (uint32_t i = 0; i < params.node_count; i++) {
+            positions[i] = {origin + spacing * static_cast<float>(i % side),
+                            origin + spacing * static_cast<float>((i / side) % side),
+                            origin + spacing * static_cast<float>(i / (side * side))};
+        }
+        break;
+    }
+    }
+    return positions;
+}
+
+// checkerboard with a per texture pair of colours and cell count
+static void write_texture(const std::string& path, uint32_t index, uint32_t size, uint32_t seed)
+{
+    stress_rng rng(seed, 1000 + index);
+    uint8_t a[3], b[3];
+    for (int c = 0; c < 3; c++) {
+        a[c] = static_cast<uint8_t>(rng.range(64.0f, 255.0f));
+        b[c] = static_cast<uint8_t>(rng.range(0.0f, 128.0f));
+    }
+    uint32_t cell = std::max(1u, size >> (2 + index % 4));
+
+    std::vector<uint8_t> pixels(static_cast<size_t>(size) * size * 4);
+    for (uint32_t y = 0; y < size; y++) {
+        for (uint32_t x = 0; x < size; x++) {
+            const uint8_t* colour = ((x / cell + y / cell) % 2 == 0) ? a : b;
+            uint8_t* p = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+            p[0] = colour[0];
+            p[1] = colour[1];
+            p[2] = colour[2];
+            p[3] = 255;
+        }
+    }
+    if (stbi_write_png(path.c_str(), static_cast<int>(size), static_cast<int>(size), 4, pixels.data(), static_cast<int>(size * 4)) == 0) {
+        throw std::runtime_error("failed to write stress scene texture " + path + "!");
+    }
+}
+
+template <typename T>
+static void write_vector(std::ofstream& file, const std::vector<T>& data)
+{
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size() * sizeof(T)));
+}
+
+/*
+ * a (grid + 1)^2 vertex lat-long ellipsoid. every mesh has the same vertex and index count so
+ * the buffer views can be computed from the mesh index, only the bounds have to be kept.
+ * front faces wind counter clockwise seen from outside, as glTF expects
+ */
+static stress_mesh_bounds write_mesh(std::ofstream& file, uint32_t mesh, uint32_t grid, float radius, uint32_t seed, size_t index_size)
+{
+    stress_rng rng(seed, 2000000 + mesh);
+    stress_vec3 scale = {radius * rng.range(0.5f, 1.5f), radius * rng.range(0.5f, 1.5f), radius * rng.range(0.5f, 1.5f)};
+
+    uint32_t row = grid + 1;
+    std::vector<float> positions, normals, texcoords, tangents;
+    positions.reserve(row * row * 3);
+    normals.reserve(row * row * 3);
+    texcoords.reserve(row * row * 2);
+    tangents.reserve(row * row * 4);
+    stress_mesh_bounds b = {{scale.x, scale.y, scale.z}, {-scale.x, -scale.y, -scale.z}};
+    for (uint32_t i = 0; i < row; i++) {
+        float theta = STRESS_PI * static_cast<float>(i) / static_cast<float>(grid);
+        for (uint32_t j = 0; j < row; j++) {
+            float phi = 2.0f * STRESS_PI * static_cast<float>(j) / static_cast<float>(grid);
+            stress_vec3 unit = {std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)};
+            stress_vec3 p = {unit.x * scale.x, unit.y * scale.y, unit.z * scale.z};
+            positions.insert(positions.end(), {p.x, p.y, p.z});
+
+            // the ellipsoid's gradient
+            stress_vec3 n = {unit.x / scale.x, unit.y / scale.y, unit.z / scale.z};
+            float len = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            normals.insert(normals.end(), {n.x / len, n.y / len, n.z / len});
+            texcoords.insert(texcoords.end(), {static_cast<float>(j) / static_cast<float>(grid), static_cast<float>(i) / static_cast<float>(grid)});
+            tangents.insert(tangents.end(), {-std::sin(phi), 0.0f, std::cos(phi), 1.0f});
+
+            b.min = {std::min(b.min.x, p.x), std::min(b.min.y, p.y), std::min(b.min.z, p.z)};
+            b.max = {std::max(b.max.x, p.x), std::max(b.max.y, p.y), std::max(b.max.z, p.z)};
+        }
+    }
+
+    std::vector<uint32_t> indices;
+    indices.reserve(grid * grid * 6);
+    for (uint32_t i = 0; i < grid; i++) {
+        for (uint32_t j = 0; j < grid; j++) {
+            uint32_t v0 = i * row + j;
+            uint32_t v1 = v0 + 1;
+            uint32_t v2 = v0 + row;
+            uint32_t v3 = v2 + 1;
+            indices.insert(indices.end(), {v0, v1, v2, v1, v3, v2});
+        }
+    }
+
+    write_vector(file, positions);
+    write_vector(file, normals);
+    write_vector(file, texcoords);
+    write_vector(file, tangents);
+    if (index_size == sizeof(uint16_t)) {
+        std::vector<uint16_t> short_indices(indices.begin(), indices.end());
+        write_vector(file, short_indices);
+    } else {
+        write_vector(file, indices);
+    }
+    // keep every mesh 4 byte aligned
+    size_t index_bytes = indices.size() * index_size;
+    static const char zeros[4] = {};
+    file.write(zeros, static_cast<std::streamsize>((4 - index_bytes % 4) % 4));
+    return b;
+}
+
+static void write_float_array(std::ofstream& file, const float* values, size_t count)
+{
+    file << "[";
+    for (size_t i = 0; i < count; i++) {
+        file << (i == 0 ? "" : ",") << values[i];
+    }
+    file << "]";
+}
+
+stress_scene_stats write_stress_scene(const std::string& gltf_path, const stress_scene_params& params)
+{
+    if (params.node_count == 0) {
+        throw std::logic_error("a stress scene needs at least one node!");
+    }
+    if (params.depth > STRESS_SCENE_MAX_DEPTH) {
+        throw std::logic_error("a stress scene can be at most " + std::to_string(STRESS_SCENE_MAX_DEPTH) + " levels deep!");
+    }
+    std::filesystem::path path(gltf_path);
+    std::string stem = path.stem().string();
+    std::filesystem::path directory = path.parent_path();
+    std::string bin_name = stem + ".bin";
+
+    stress_scene_stats stats;
+    float reuse = std::clamp(params.mesh_reuse, 0.0f, 1.0f);
+    stats.mesh_count = std::max(1u, static_cast<uint32_t>(std::lround(static_cast<double>(params.node_count) * (1.0 - reuse))));
+    stats.mesh_count = std::min(stats.mesh_count, params.node_count);
+    uint32_t grid = std::max(2u, static_cast<uint32_t>(std::lround(std::sqrt(params.triangles_per_mesh / 2.0))));
+    stats.triangles_per_mesh = grid * grid * 2;
+    stats.triangle_count = static_cast<uint64_t>(stats.triangles_per_mesh) * params.node_count;
+
+    /* geometry, one stretch of the buffer per mesh */
+    uint32_t vertex_count = (grid + 1) * (grid + 1);
+    uint32_t index_count = grid * grid * 6;
+    size_t index_size = vertex_count <= 65536 ? sizeof(uint16_t) : sizeof(uint32_t);
+    size_t attribute_bytes[4] = {vertex_count * 12u, vertex_count * 12u, vertex_count * 8u, vertex_count * 16u};
+    size_t index_bytes = index_count * index_size;
+    size_t mesh_bytes = attribute_bytes[0] + attribute_bytes[1] + attribute_bytes[2] + attribute_bytes[3] + (index_bytes + 3) / 4 * 4;
+    stats.buffer_bytes = static_cast<uint64_t>(mesh_bytes) * stats.mesh_count;
+
+    // sized so an average node covers about a quarter of the space it has around it
+    float radius = params.extent / std::cbrt(static_cast<float>(params.node_count)) * 0.25f;
+    std::vector<stress_mesh_bounds> mesh_bounds(stats.mesh_count);
+    {
+        std::ofstream bin(directory / bin_name, std::ios::binary | std::ios::trunc);
+        if (!bin) {
+            throw std::runtime_error("failed to open stress scene buffer " + (directory / bin_name).string() + "!");
+        }
+        for (uint32_t m = 0; m < stats.mesh_count; m++) {
+            mesh_bounds[m] = write_mesh(bin, m, grid, radius, params.seed, index_size);
+        }
+        if (!bin) {
+            throw std::runtime_error("failed to write stress scene buffer " + (directory / bin_name).string() + "!");
+        }
+    }
+
+    std::vector<std::string> texture_names;
+    for (uint32_t t = 0; t < params.texture_count; t++) {
+        texture_names.push_back(stem + "_texture_" + std::to_string(t) + ".png");
+        write_texture((directory / texture_names.back()).string(), t, std::max(1u, params.texture_size), params.seed);
+    }
+
+    /* hierarchy, world positions come from the distribution and the locals undo the parents */
+    uint32_t branching = get_branching(params.node_count, params.depth);
+    std::vector<stress_vec3> world_positions = place_nodes(params);
+    std::vector<float> world_yaw(params.node_count);
+    stress_rng node_rng(params.seed, 2);
+    stress_rng mesh_rng(params.seed, 3);
+
+    std::ofstream file(gltf_path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open stress scene " + gltf_path + "!");
+    }
+    file << std::setprecision(9);
+    file << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"discovery stress scene\"},\n\"scene\":0,\n\"scenes\":[{\"nodes\":[";
+    stats.root_count = branching == 0 ? params.node_count : 1;
+    for (uint32_t i = 0; i < stats.root_count; i++) {
+        file << (i == 0 ? "" : ",") << i;
+    }
+    file << "]}],\n\"nodes\":[";
+    for (uint32_t i = 0; i < params.node_count; i++) {
+        float yaw = node_rng.range(-STRESS_PI, STRESS_PI);
+        float scale = node_rng.range(0.75f, 1.25f);
+        uint32_t mesh = i < stats.mesh_count ? i : mesh_rng.below(stats.mesh_count);
+
+        // only leaves are scaled, so a parent's transform is a yaw and a translation and the
+        // local translation is just the world offset rotated into the parent's frame
+        uint64_t first_child = static_cast<uint64_t>(i) * branching + 1;
+        bool leaf = branching == 0 || first_child >= params.node_count;
+        if (!leaf) {
+            scale = 1.0f;
+        }
+
+        stress_vec3 t = world_positions[i];
+        world_yaw[i] = yaw;
+        if (branching != 0 && i != 0) {
+            uint32_t parent = (i - 1) / branching;
+            stress_vec3 d = {t.x - world_positions[parent].x, t.y - world_positions[parent].y, t.z - world_positions[parent].z};
+            float c = std::cos(world_yaw[parent]), s = std::sin(world_yaw[parent]);
+            t = {c * d.x - s * d.z, d.y, s * d.x + c * d.z};
+            world_yaw[i] = world_yaw[parent] + yaw;
+        }
+
+        file << (i == 0 ? "\n" : ",\n") << "{\"mesh\":" << mesh
+             << ",\"translation\":[" << t.x << "," << t.y << "," << t.z << "]"
+             << ",\"rotation\":[0," << std::sin(yaw * 0.5f) << ",0," << std::cos(yaw * 0.5f) << "]"
+             << ",\"scale\":[" << scale << "," << scale << "," << scale << "]";
+        if (!leaf) {
+            uint64_t last_child = std::min<uint64_t>(first_child + branching, params.node_count);
+            file << ",\"children\":[";
+            for (uint64_t c = first_child; c < last_child; c++) {
+                file << (c == first_child ? "" : ",") << c;
+            }
+            file << "]";
+        }
+        file << "}";
+    }
+    file << "],\n";
+
+    file << "\"meshes\":[";
+    for (uint32_t m = 0; m < stats.mesh_count; m++) {
+        uint32_t accessor = m * 5;
+        file << (m == 0 ? "\n" : ",\n") << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << accessor
+             << ",\"NORMAL\":" << accessor + 1 << ",\"TEXCOORD_0\":" << accessor + 2 << ",\"TANGENT\":" << accessor + 3
+             << "},\"indices\":" << accessor + 4;
+        if (params.material_count > 0) {
+            file << ",\"material\":" << m % params.material_count;
+        }
+        file << ",\"mode\":4}]}";
+    }
+    file << "],\n";
+
+    if (params.material_count > 0) {
+        stress_rng material_rng(params.seed, 4);
+        file << "\"materials\":[";
+        for (uint32_t m = 0; m < params.material_count; m++) {
+            float colour[4] = {material_rng.range(0.2f, 1.0f), material_rng.range(0.2f, 1.0f), material_rng.range(0.2f, 1.0f), 1.0f};
+            file << (m == 0 ? "\n" : ",\n") << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":";
+            write_float_array(file, colour, 4);
+            if (params.texture_count > 0) {
+                file << ",\"baseColorTexture\":{\"index\":" << m % params.texture_count << ",\"texCoord\":0}";
+            }
+            file << ",\"metallicFactor\":0,\"roughnessFactor\":" << material_rng.range(0.3f, 1.0f) << "}}";
+        }
+        file << "],\n";
+    }
+
+    if (params.texture_count > 0) {
+        file << "\"samplers\":[{\"magFilter\":9729,\"minFilter\":9987,\"wrapS\":10497,\"wrapT\":10497}],\n\"images\":[";
+        for (uint32_t t = 0; t < params.texture_count; t++) {
+            file << (t == 0 ? "\n" : ",\n") << "{\"uri\":\"" << texture_names[t] << "\"}";
+        }
+        file << "],\n\"textures\":[";
+        for (uint32_t t = 0; t < params.texture_count; t++) {
+            file << (t == 0 ? "\n" : ",\n") << "{\"sampler\":0,\"source\":" << t << "}";
+        }
+        file << "],\n";
+    }
+
+    file << "\"buffers\":[{\"uri\":\"" << bin_name << "\",\"byteLength\":" << stats.buffer_bytes << "}],\n\"bufferViews\":[";
+    for (uint32_t m = 0; m < stats.mesh_count; m++) {
+        uint64_t offset = static_cast<uint64_t>(m) * mesh_bytes;
+        for (int a = 0; a < 4; a++) {
+            file << (m == 0 && a == 0 ? "\n" : ",\n") << "{\"buffer\":0,\"byteOffset\":" << offset
+                 << ",\"byteLength\":" << attribute_bytes[a] << ",\"target\":34962}";
+            offset += attribute_bytes[a];
+        }
+        file << ",\n{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << index_bytes << ",\"target\":34963}";
+    }
+    file << "],\n\"accessors\":[";
+    const char* attribute_types[4] = {"VEC3", "VEC3", "VEC2", "VEC4"};
+    for (uint32_t m = 0; m < stats.mesh_count; m++) {
+        uint32_t view = m * 5;
+        for (int a = 0; a < 4; a++) {
+            file << (m == 0 && a == 0 ? "\n" : ",\n") << "{\"bufferView\":" << view + a << ",\"componentType\":5126,\"count\":"
+                 << vertex_count << ",\"type\":\"" << attribute_types[a] << "\"";
+            if (a == 0) {
+                file << ",\"min\":";
+                write_float_array(file, &mesh_bounds[m].min.x, 3);
+                file << ",\"max\":";
+                write_float_array(file, &mesh_bounds[m].max.x, 3);
+            }
+            file << "}";
+        }
+        file << ",\n{\"bufferView\":" << view + 4 << ",\"componentType\":" << (index_size == sizeof(uint16_t) ? 5123 : 5125)
+             << ",\"count\":" << index_count << ",\"type\":\"SCALAR\"}";
+    }
+    file << "]\n}\n";
+
+    if (!file) {
+        throw std::runtime_error("failed to write stress scene " + gltf_path + "!");
+    }
+    return stats;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*
+ * procedurally generated glTF scenes for benchmarking culling, instancing, recording and
+ * streaming at 10k to 1M nodes. the same parameters and seed always write the same files.
+ *
+ * nodes form a complete tree (breadth first, the branching picked so it fits in depth levels),
+ * each node draws one of the unique meshes, a lat-long ellipsoid with its own proportions.
+ * node positions follow the distribution in world space whatever the hierarchy looks like
+ */
+
+// deepest hierarchy write_stress_scene accepts, the renderer walks the node tree recursively
+#define STRESS_SCENE_MAX_DEPTH 64
+
+enum class stress_distribution {
+    UNIFORM,        // anywhere inside the extent
+    CLUSTERED,      // gaussian clumps with empty space between them
+    GRID            // evenly spaced
+};
+
+struct stress_scene_params {
+    uint32_t node_count = 10000;
+    uint32_t depth = 4;                 // levels of the hierarchy, 1 makes every node a root, at most STRESS_SCENE_MAX_DEPTH
+    float mesh_reuse = 0.9f;            // fraction of nodes drawing another node's mesh
+    uint32_t material_count = 16;       // 0 leaves the primitives without materials
+    uint32_t texture_count = 8;         // base color textures shared by the materials, 0 for none
+    uint32_t texture_size = 256;
+    uint32_t triangles_per_mesh = 512;  // rounded to the nearest lat-long grid
+    stress_distribution distribution = stress_distribution::UNIFORM;
+    float extent = 1000.0f;             // side of the cube the nodes are placed in
+    uint32_t seed = 1;
+};
+
+struct stress_scene_stats {
+    uint32_t mesh_count = 0;
+    uint32_t root_count = 0;
+    uint32_t triangles_per_mesh = 0;
+    uint64_t triangle_count = 0;        // drawn by the whole scene, reused meshes counted every time
+    uint64_t buffer_bytes = 0;
+};
+
+// "uniform", "clustered" or "grid", false for anything else
+bool parse_stress_distribution(const std::string& name, stress_distribution* distribution);
+
+// writes gltf_path with a .bin and png textures next to it, throws when a file can't be written
+// or the parameters are out of range
+stress_scene_stats write_stress_scene(const std::string& gltf_path, const stress_scene_params& params);
@@ -0,0 +1,313 @@
+#include "texture_streamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// a swapped out image may still be sampled by frames in flight
+#define STREAMING_RETIRE_FRAMES (MAX_FRAMES_IN_FLIGHT + 1)
+
+static size_t align_up(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void texture_streamer::initialise(vulkan_data& vkdata, size_t texture_count)
+{
+    this->textures.clear();
+    this->textures.resize(texture_count);
+    this->stats = {};
+}
+
+void texture_streamer::terminate(vulkan_data& vkdata)
+{
+    for (auto& upload : this->uploads) {
+        upload.batch->terminate(vkdata);
+        upload.image.terminate(vkdata);
+    }
+    this->uploads.clear();
+
+    for (auto& r : this->retired) {
+        r.image.terminate(vkdata);
+    }
+    this->retired.clear();
+
+    for (auto& texture : this->textures) {
+        if (texture.image.image != VK_NULL_HANDLE) {
+            texture.image.terminate(vkdata);
+        }
+    }
+    this->textures.clear();
+}
+
+vulkan_image texture_streamer::create_resident_image(vulkan_data& vkdata, upload_batch& batch, const streamed_texture& texture,
+                                                     uint32_t first_level, size_t* image_bytes)
+{
+    // repack the resident levels contiguously, offsets stay block aligned
+    std::vector<image_mip_level> levels(texture.levels.begin() + first_level, texture.levels.end());
+    size_t total = 0;
+    for (auto& level : levels) {
+        total = align_up(total, 16);
+        total += level.byte_size;
+    }
+
+    auto staging = batch.reserve(vkdata, total);
+    size_t offset = 0;
+    for (auto& level : levels) {
+        offset = align_up(offset, 16);
+        std::memcpy(staging.data + offset, texture.data + level.offset, level.byte_size);
+        level.offset = offset;
+        offset += level.byte_size;
+    }
+
+    vulkan_image image{};
+    image.format = texture.format;
+    image.initialise_deferred(vkdata, batch, staging, levels);
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(vkdata.mem_allocator, image.allocation, &info);
+    *image_bytes = static_cast<size_t>(info.size);
+    return image;
+}
+
+void texture_streamer::add_texture(vulkan_data& vkdata, upload_batch& batch, size_t index, VkFormat format,
+                                   std::vector<image_mip_level> levels, const unsigned char* data, std::vector<unsigned char> owned_data)
+{
+    if (levels.empty()) {
+        throw std::runtime_error("streamed texture " + std::to_string(index) + " has no mip levels!");
+    }
+
+    auto& texture = this->textures.at(index);
+    texture.format = format;
+    texture.levels = std::move(levels);
+    texture.owned_data = std::move(owned_data);
+    texture.data = texture.owned_data.empty() ? data : texture.owned_data.data();
+
+    // the finest level no bigger than initial_max_extent is always resident
+    auto level_count = static_cast<uint32_t>(texture.levels.size());
+    texture.min_level = level_count - 1;
+    for (uint32_t l = 0; l < level_count; l++) {
+        if (std::max(texture.levels[l].width, texture.levels[l].height) <= this->initial_max_extent) {
+            texture.min_level = l;
+            break;
+        }
+    }
+
+    texture.image = this->create_resident_image(vkdata, batch, texture, texture.min_level, &texture.image_bytes);
+    texture.resident_level = texture.min_level;
+    texture.wanted_level = texture.min_level;
+}
+
+void texture_streamer::request(size_t index, float uv_per_pixel, uint64_t frame_number)
+{
+    auto& texture = this->textures[index];
+    if (texture.levels.empty()) {
+        return;
+    }
+    texture.last_used_frame = frame_number;
+
+    // one mip level per doubling of texels per pixel
+    float extent = static_cast<float>(std::max(texture.levels[0].width, texture.levels[0].height));
+    float texels_per_pixel = uv_per_pixel * extent;
+    uint32_t level = 0;
+    if (texels_per_pixel > 1.0f) {
+        level = static_cast<uint32_t>(std::min(std::floor(std::log2(texels_per_pixel)), 31.0f));
+    }
+    texture.wanted_level = std::min(texture.wanted_level, level);
+}
+
+void texture_streamer::swap_image(vulkan_data& vkdata, streamed_texture& texture, vulkan_image image, size_t image_bytes, uint32_t level)
+{
+    if (level > texture.resident_level) {
+        this->stats.evicted_bytes += texture.image_bytes - std::min(texture.image_bytes, image_bytes);
+    }
+    this->retired.push_back({texture.image, texture.image_bytes, vkdata.frame_number});
+    this->retiring_bytes += texture.image_bytes;
+
+    texture.image = image;
+    texture.image_bytes = image_bytes;
+    texture.resident_level = level;
+    texture.pending = false;
+    texture.generation++;
+}
+
+size_t texture_streamer::chain_bytes(const streamed_texture& texture, uint32_t first_level) const
+{
+    size_t bytes = 0;
+    for (size_t l = first_level; l < texture.levels.size(); l++) {
+        bytes += texture.levels[l].byte_size;
+    }
+    return bytes;
+}
+
+bool texture_streamer::over_budget(int64_t extra_bytes) const
+{
+    return this->usage_estimate + extra_bytes > this->usage_limit;
+}
+
+void texture_streamer::start_upload(vulkan_data& vkdata, size_t index, uint32_t level)
+{
+    auto& texture = this->textures[index];
+    pending_upload upload;
+    upload.texture = index;
+    upload.level = level;
+    upload.batch = std::make_unique<upload_batch>();
+    upload.batch->initialise(vkdata, chain_bytes(texture, level) + 16 * texture.levels.size());
+    upload.image = this->create_resident_image(vkdata, *upload.batch, texture, level, &upload.image_bytes);
+    upload.batch->submit_async(vkdata);
+
+    // the current image is retired once the new one lands
+    texture.pending = true;
+    this->usage_estimate += static_cast<int64_t>(upload.image_bytes) - static_cast<int64_t>(texture.image_bytes);
+    this->stats.uploaded_bytes += upload.batch->staged_byte_size();
+    this->uploads.push_back(std::move(upload));
+}
+
+void texture_streamer::evict(vulkan_data& vkdata, int64_t bytes_needed)
+{
+    // textures holding finer levels than they were last asked for, least recently used first.
+    // textures not drawn last frame want their min_level so they come first
+    std::vector<size_t> order;
+    for (size_t i = 0; i < this->textures.size(); i++) {
+        auto& texture = this->textures[i];
+        if (!texture.pending && !texture.levels.empty() && texture.wanted_level > texture.resident_level) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return this->textures[a].last_used_frame < this->textures[b].last_used_frame;
+    });
+
+    for (size_t i : order) {
+        if (!this->over_budget(bytes_needed) || this->uploads.size() >= this->max_uploads_in_flight) {
+            break;
+        }
+        // drop to the level it wants, the smaller image is uploaded from the source like any other
+        this->start_upload(vkdata, i, this->textures[i].wanted_level);
+    }
+}
+
+void texture_streamer::update(vulkan_data& vkdata)
+{
+    /* swap in finished uploads, never waits on the gpu */
+    for (auto it = this->uploads.begin(); it != this->uploads.end();) {
+        if (!it->batch->is_complete(vkdata)) {
+            ++it;
+            continue;
+        }
+        it->batch->terminate(vkdata);
+        this->swap_image(vkdata, this->textures[it->texture], it->image, it->image_bytes, it->level);
+        it = this->uploads.erase(it);
+    }
+
+    /* destroy images no frame in flight can still sample */
+    for (size_t i = 0; i < this->retired.size();) {
+        if (vkdata.frame_number >= this->retired[i].frame + STREAMING_RETIRE_FRAMES) {
+            this->retired[i].image.terminate(vkdata);
+            this->retiring_bytes -= this->retired[i].image_bytes;
+            this->retired[i] = this->retired.back();
+            this->retired.pop_back();
+        } else {
+            i++;
+        }
+    }
+
+    /*
+     * budget, either the device's or our own accounting against the override. retired images
+     * and the images pending uploads replace are counted as freed already so they don't
+     * trigger more evictions while they wait
+     */
+    size_t resident = 0, in_flight = 0, replaced = 0;
+    for (auto& texture : this->textures) {
+        resident += texture.image_bytes;
+    }
+    for (auto& upload : this->uploads) {
+        in_flight += upload.image_bytes;
+        replaced += this->textures[upload.texture].image_bytes;
+    }
+    VkDeviceSize device_usage, device_budget;
+    get_device_memory_budget(vkdata, &device_usage, &device_budget);
+    size_t usage;
+    if (this->budget_override > 0) {
+        usage = resident + in_flight + this->retiring_bytes;
+        this->usage_limit = static_cast<int64_t>(this->budget_override);
+    } else {
+        usage = static_cast<size_t>(device_usage);
+        this->usage_limit = static_cast<int64_t>(device_budget * this->budget_fraction);
+    }
+    this->usage_estimate = static_cast<int64_t>(usage) - static_cast<int64_t>(this->retiring_bytes + replaced);
+
+    if (this->over_budget(0)) {
+        this->evict(vkdata, 0);
+    }
+
+    /* upgrades, textures furthest from the level they want first */
+    std::vector<size_t> order;
+    for (size_t i = 0; i < this->textures.size(); i++) {
+        auto& texture = this->textures[i];
+        if (!texture.pending && !texture.levels.empty() && texture.wanted_level < texture.resident_level) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        auto& ta = this->textures[a];
+        auto& tb = this->textures[b];
+        uint32_t da = ta.resident_level - ta.wanted_level;
+        uint32_t db = tb.resident_level - tb.wanted_level;
+        return (da != db) ? (da > db) : (ta.last_used_frame > tb.last_used_frame);
+    });
+
+    size_t frame_bytes = 0;
+    for (size_t i : order) {
+        if (this->uploads.size() >= this->max_uploads_in_flight || frame_bytes >= this->max_upload_bytes_per_frame) {
+            break;
+        }
+        auto& texture = this->textures[i];
+
+        // go as fine as the wanted level allows within this frame's upload limit, at least one level
+        uint32_t level = texture.wanted_level;
+        while (level + 1 < texture.resident_level && frame_bytes + chain_bytes(texture, level) > this->max_upload_bytes_per_frame) {
+            level++;
+        }
+        size_t bytes = chain_bytes(texture, level);
+        int64_t growth = static_cast<int64_t>(bytes) - static_cast<int64_t>(texture.image_bytes);
+        if (this->over_budget(growth)) {
+            this->evict(vkdata, growth);
+            if (this->over_budget(growth)) {
+                break;  // try again once evictions have landed
+            }
+        }
+        this->start_upload(vkdata, i, level);
+        frame_bytes += bytes;
+    }
+
+    /* stats, then start collecting the next frame's requests */
+    this->stats.texture_count = this->textures.size();
+    this->stats.resident_bytes = resident;
+    this->stats.uploads_in_flight = this->uploads.size();
+    this->stats.device_usage = device_usage;
+    this->stats.device_budget = device_budget;
+    for (auto& texture : this->textures) {
+        texture.wanted_level = texture.min_level;
+    }
+}
+
+const vulkan_image& texture_streamer::get_image(size_t index) const
+{
+    return this->textures.at(index).image;
+}
+
+uint32_t texture_streamer::get_generation(size_t index) const
+{
+    return this->textures.at(index).generation;
+}
+
+size_t texture_streamer::texture_count() const
+{
+    return this->textures.size();
+}
+
+texture_streaming_stats texture_streamer::get_stats() const
+{
+    return this->stats;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include "vulkan/vulkan_base.h"
+
+/*
+ * streams texture mip levels in and out of vram. every texture starts with only its
+ * small levels resident, the renderer requests finer levels each frame from the texel
+ * density of what it draws and update() uploads them in the background. when device
+ * memory gets close to the budget (VK_EXT_memory_budget, or vma's estimate without it)
+ * the least recently used textures drop back down their mip chain.
+ *
+ * residency changes create a new image holding levels [resident_level, level_count), the
+ * old image is kept alive until no frame in flight can still sample it.
+ */
+
+struct texture_streaming_stats {
+    size_t texture_count = 0;
+    size_t resident_bytes = 0;
+    size_t uploads_in_flight = 0;
+    size_t uploaded_bytes = 0;      // totals since initialise
+    size_t evicted_bytes = 0;
+    VkDeviceSize device_usage = 0;
+    VkDeviceSize device_budget = 0;
+};
+
+class texture_streamer {
+private:
+    struct streamed_texture {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::vector<image_mip_level> levels;    // full chain, offsets relative to data
+        const unsigned char* data = nullptr;     // source levels, mapped or owned_data
+        std::vector<unsigned char> owned_data;
+
+        vulkan_image image{};
+        size_t image_bytes = 0;
+        uint32_t resident_level = 0;            // finest level in image
+        uint32_t min_level = 0;                 // finest level kept resident under memory pressure
+        uint32_t wanted_level = 0;              // finest level requested since the last update
+        bool pending = false;
+        uint64_t last_used_frame = 0;
+        uint32_t generation = 0;
+    };
+
+    struct pending_upload {
+        size_t texture;
+        uint32_t level;
+        vulkan_image image;
+        size_t image_bytes;
+        std::unique_ptr<upload_batch> batch;
+    };
+
+    struct retired_image {
+        vulkan_image image;
+        size_t image_bytes;
+        uint64_t frame;
+    };
+
+    std::vector<streamed_texture> textures;
+    std::list<pending_upload> uploads;
+    std::vector<retired_image> retired;
+    size_t retiring_bytes = 0;
+    int64_t usage_estimate = 0;     // refreshed by update, adjusted as uploads start
+    int64_t usage_limit = 0;
+    texture_streaming_stats stats;
+
+    vulkan_image create_resident_image(vulkan_data& vkdata, upload_batch& batch, const streamed_texture& texture, uint32_t first_level, size_t* image_bytes);
+    void start_upload(vulkan_data& vkdata, size_t index, uint32_t level);
+    void swap_image(vulkan_data& vkdata, streamed_texture& texture, vulkan_image image, size_t image_bytes, uint32_t level);
+    void evict(vulkan_data& vkdata, int64_t bytes_needed);
+    size_t chain_bytes(const streamed_texture& texture, uint32_t first_level) const;
+    bool over_budget(int64_t extra_bytes) const;
+
+public:
+    /* tunables, read by update() */
+    uint32_t initial_max_extent = 64;                   // levels up to this size are uploaded at load
+    VkDeviceSize budget_override = 0;                   // non zero replaces the device budget, for testing
+    float budget_fraction = 0.9f;                       // start evicting above this fraction of the budget
+    size_t max_upload_bytes_per_frame = 32 * 1024 * 1024;
+    size_t max_uploads_in_flight = 8;
+
+    // textures are added into pre-sized slots so loading threads can fill them concurrently
+    void initialise(vulkan_data& vkdata, size_t texture_count);
+    void terminate(vulkan_data& vkdata);
+
+    // uploads the small levels into batch, data must outlive the streamer unless owned_data holds it
+    void add_texture(vulkan_data& vkdata, upload_batch& batch, size_t index, VkFormat format,
+                     std::vector<image_mip_level> levels, const unsigned char* data, std::vector<unsigned char> owned_data = {});
+
+    // called while recording, uv_per_pixel is how much of the texture's uv space one screen pixel covers
+    void request(size_t index, float uv_per_pixel, uint64_t frame_number);
+
+    // once per frame before recording: completes uploads, evicts and starts new uploads
+    void update(vulkan_data& vkdata);
+
+    const vulkan_image& get_image(size_t index) const;
+    // changes every time the image is swapped, views of older generations must be recreated
+    uint32_t get_generation(size_t index) const;
+    size_t texture_count() const;
+    texture_streaming_stats get_stats() const;
+};
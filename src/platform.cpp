@@ -5,9 +5,18 @@
 
 #ifdef _WIN32
 #   include <Windows.h>
+#   include <psapi.h>
 #endif
 #ifdef linux
 #   include <unistd.h>
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/resource.h>
+#   include <sys/stat.h>
+#   include <sys/wait.h>
+#   include <cerrno>
+#   include <spawn.h>
+extern char** environ;
 #endif
 
 /* used internally to retrieve the absolute path of the executable */
@@ -89,4 +98,243 @@ std::vector<char> read_data_from_binary_file(std::string abs_path)
     file.read(buffer.data(), file_size);
     file.close();
     return buffer;
-}
\ No newline at end of file
+}
+
+bool map_file(const std::string& abs_path, mapped_file* out)
+{
+    *out = mapped_file{};
+#   ifdef linux
+        int fd = open(abs_path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size == 0) {
+            close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            return false;
+        }
+        // the whole file is about to be read front to back. advice values aren't flags, one call each
+        madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+        madvise(mapped, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+        out->data = static_cast<const unsigned char*>(mapped);
+        out->size = static_cast<size_t>(st.st_size);
+        return true;
+#   elif _WIN32
+        HANDLE file = CreateFileA(abs_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+            CloseHandle(file);
+            return false;
+        }
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL) {
+            CloseHandle(file);
+            return false;
+        }
+        void* mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (mapped == NULL) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        out->data = static_cast<const unsigned char*>(mapped);
+        out->size = static_cast<size_t>(file_size.QuadPart);
+        out->file_handle = file;
+        out->mapping_handle = mapping;
+        return true;
+#   else
+        return false;
+#   endif
+}
+
+void unmap_file(mapped_file& file)
+{
+    if (file.data == nullptr) {
+        return;
+    }
+#   ifdef linux
+        munmap(const_cast<unsigned char*>(file.data), file.size);
+#   elif _WIN32
+        UnmapViewOfFile(file.data);
+        CloseHandle(file.mapping_handle);
+        CloseHandle(file.file_handle);
+#   endif
+    file = mapped_file{};
+}
+
+size_t get_peak_memory_usage()
+{
+#   ifdef linux
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;  // reported in KiB
+#   elif _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+            return 0;
+        }
+        return counters.PeakWorkingSetSize;
+#   else
+        return 0;
+#   endif
+}
+
+bool evict_file_from_page_cache(const std::string& abs_path)
+{
+#   ifdef linux
+        int fd = open(abs_path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return false;
+        }
+        // dirty pages can't be dropped, write them back first
+        fdatasync(fd);
+        bool evicted = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+        close(fd);
+        return evicted;
+#   else
+        return false;
+#   endif
+}
+
+bool drop_page_cache()
+{
+#   ifdef linux
+        sync();
+        std::ofstream file("/proc/sys/vm/drop_caches");
+        if (!file) {
+            return false;
+        }
+        file << "3" << std::endl;
+        return static_cast<bool>(file);
+#   else
+        return false;
+#   endif
+}
+
+#ifdef _WIN32
+// quotes arg so the child's c runtime splits its command line back into the same argument
+static std::string quote_windows_argument(const std::string& arg)
+{
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : arg) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        // backslashes are only special in front of a quote
+        quoted.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+        quoted += c;
+        backslashes = 0;
+    }
+    quoted.append(backslashes * 2, '\\');
+    quoted += '"';
+    return quoted;
+}
+#endif
+
+bool run_process(const std::string& path, const std::vector<std::string>& args, std::string* output, int* exit_code)
+{
+#   ifdef linux
+        int fds[2];
+        if (pipe(fds) != 0) {
+            return false;
+        }
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, fds[0]);
+        posix_spawn_file_actions_addclose(&actions, fds[1]);
+
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(path.c_str()));
+        for (auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        int spawned = posix_spawnp(&pid, path.c_str(), &actions, nullptr, argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[1]);
+        if (spawned != 0) {
+            close(fds[0]);
+            return false;
+        }
+
+        char buffer[512];
+        for (;;) {
+            ssize_t read_size = read(fds[0], buffer, sizeof(buffer));
+            if (read_size > 0) {
+                output->append(buffer, static_cast<size_t>(read_size));
+            } else if (read_size == 0 || errno != EINTR) {
+                break;
+            }
+        }
+        close(fds[0]);
+
+        int status;
+        while (waitpid(pid, &status, 0) == -1) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        *exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        return true;
+#   elif _WIN32
+        SECURITY_ATTRIBUTES security = {sizeof(security), nullptr, TRUE};
+        HANDLE read_pipe, write_pipe;
+        if (!CreatePipe(&read_pipe, &write_pipe, &security, 0)) {
+            return false;
+        }
+        // only the write end is inherited, or the read below would never see the end of the pipe
+        SetHandleInformation(read_pipe, HANDLE_FLAG_INHERIT, 0);
+
+        std::string command_line = quote_windows_argument(path);
+        for (auto& arg : args) {
+            command_line += " " + quote_windows_argument(arg);
+        }
+
+        STARTUPINFOA startup_info = {};
+        startup_info.cb = sizeof(startup_info);
+        startup_info.dwFlags = STARTF_USESTDHANDLES;
+        startup_info.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        startup_info.hStdOutput = write_pipe;
+        startup_info.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+        PROCESS_INFORMATION process = {};
+        BOOL created = CreateProcessA(nullptr, &command_line[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup_info, &process);
+        CloseHandle(write_pipe);
+        if (!created) {
+            CloseHandle(read_pipe);
+            return false;
+        }
+
+        char buffer[512];
+        DWORD read_size;
+        while (ReadFile(read_pipe, buffer, sizeof(buffer), &read_size, nullptr) && read_size > 0) {
+            output->append(buffer, read_size);
+        }
+        CloseHandle(read_pipe);
+
+        WaitForSingleObject(process.hProcess, INFINITE);
+        DWORD code = 0;
+        GetExitCodeProcess(process.hProcess, &code);
+        CloseHandle(process.hProcess);
+        CloseHandle(process.hThread);
+        *exit_code = static_cast<int>(code);
+        return true;
+#   else
+        return false;
+#   endif
+}
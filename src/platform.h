@@ -10,4 +10,33 @@ std::string to_absolute_path(std::string pRelativePath);
 std::string read_string_from_file(std::string pAbsolutePath);
 
 // reads binary data from a given absolute file path
-std::vector<char> read_data_from_binary_file(std::string abs_path);
\ No newline at end of file
+std::vector<char> read_data_from_binary_file(std::string abs_path);
+
+// read only memory mapping of a whole file
+struct mapped_file {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+};
+
+// maps the file at the given absolute path, returns false if it can't be opened
+bool map_file(const std::string& abs_path, mapped_file* out);
+void unmap_file(mapped_file& file);
+
+// peak resident memory of this process in bytes, 0 if it can't be queried
+size_t get_peak_memory_usage();
+
+// drops the clean pages of the file from the os page cache so the next read comes from disk.
+// false where that isn't supported
+bool evict_file_from_page_cache(const std::string& abs_path);
+
+// drops the whole os page cache, false when not permitted (it needs root on linux)
+bool drop_page_cache();
+
+// runs the executable with args and collects what it writes to stdout, stderr is left shared with
+// this process. no shell is involved, so the arguments reach it unchanged whatever they contain.
+// false if it couldn't be started, *exit_code is set otherwise
+bool run_process(const std::string& path, const std::vector<std::string>& args, std::string* output, int* exit_code);
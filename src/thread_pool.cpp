@@ -0,0 +1,143 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+void thread_pool::initialise(uint32_t thread_count)
+{
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    this->stopping = false;
+    this->workers.reserve(thread_count);
+    for (uint32_t i = 0; i < thread_count; i++) {
+        this->workers.emplace_back(&thread_pool::worker_loop, this);
+    }
+}
+
+void thread_pool::terminate()
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->task_available.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+    this->workers.clear();
+}
+
+void thread_pool::submit(std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->tasks.push(std::move(task));
+        this->pending_tasks++;
+    }
+    this->task_available.notify_one();
+}
+
+/* pops and runs a single task, the lock is released while the task runs */
+bool thread_pool::run_one_task(std::unique_lock<std::mutex>& lock)
+{
+    if (this->tasks.empty()) {
+        return false;
+    }
+    auto task = std::move(this->tasks.front());
+    this->tasks.pop();
+
+    lock.unlock();
+    std::exception_ptr exception = nullptr;
+    try {
+        task();
+    } catch (...) {
+        exception = std::current_exception();
+    }
+    lock.lock();
+
+    if (exception && !this->first_exception) {
+        this->first_exception = exception;
+    }
+    this->pending_tasks--;
+    this->task_finished.notify_all();
+    return true;
+}
+
+void thread_pool::worker_loop()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->task_available.wait(lock, [this]{ return this->stopping || !this->tasks.empty(); });
+        if (this->stopping && this->tasks.empty()) {
+            return;
+        }
+        this->run_one_task(lock);
+    }
+}
+
+void thread_pool::help_until(std::unique_lock<std::mutex>& lock, const std::function<bool()>& done)
+{
+    while (!done()) {
+        // help out rather than sitting idle
+        if (!this->run_one_task(lock)) {
+            this->task_finished.wait(lock, [&]{ return done() || !this->tasks.empty(); });
+        }
+    }
+}
+
+void thread_pool::wait_idle()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->help_until(lock, [this]{ return this->pending_tasks == 0; });
+
+    if (this->first_exception) {
+        auto exception = this->first_exception;
+        this->first_exception = nullptr;
+        std::rethrow_exception(exception);
+    }
+}
+
+void thread_pool::parallel_for(size_t count, const std::function<void(size_t)>& fn)
+{
+    if (count == 0) {
+        return;
+    }
+
+    // a few chunks per thread keeps the load balanced without flooding the queue
+    size_t chunk_count = std::min(count, static_cast<size_t>(this->thread_count()) * 4);
+    size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+
+    // completion is tracked separately from the pool so this can be called from inside a task
+    size_t remaining = (count + chunk_size - 1) / chunk_size;
+    std::exception_ptr exception = nullptr;
+    for (size_t start = 0; start < count; start += chunk_size) {
+        size_t end = std::min(count, start + chunk_size);
+        this->submit([this, &fn, &remaining, &exception, start, end]{
+            std::exception_ptr chunk_exception = nullptr;
+            try {
+                for (size_t i = start; i < end; i++) {
+                    fn(i);
+                }
+            } catch (...) {
+                chunk_exception = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(this->mutex);
+            if (chunk_exception && !exception) {
+                exception = chunk_exception;
+            }
+            remaining--;
+        });
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->help_until(lock, [&remaining]{ return remaining == 0; });
+    if (exception) {
+        std::rethrow_exception(exception);
+    }
+}
+
+uint32_t thread_pool::thread_count() const
+{
+    return static_cast<uint32_t>(std::max<size_t>(1, this->workers.size()));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * fixed size pool of worker threads pulling tasks from a single queue.
+ * threads waiting on the pool also run queued tasks, so parallel_for can
+ * be used from inside a task without deadlocking.
+ */
+class thread_pool
+{
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::condition_variable task_finished;
+    size_t pending_tasks = 0;
+    bool stopping = false;
+    std::exception_ptr first_exception = nullptr;
+
+    bool run_one_task(std::unique_lock<std::mutex>& lock);
+    void help_until(std::unique_lock<std::mutex>& lock, const std::function<bool()>& done);
+    void worker_loop();
+
+public:
+    // thread_count of 0 uses the hardware concurrency
+    void initialise(uint32_t thread_count = 0);
+    void terminate();
+
+    void submit(std::function<void()> task);
+
+    // blocks until every submitted task has finished, rethrows the first exception thrown by a task
+    void wait_idle();
+
+    // runs fn(i) for i in [0, count) split into roughly even chunks, blocks until complete
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn);
+
+    uint32_t thread_count() const;
+};
@@ -1,7 +1,9 @@
 #include "vulkan_base.h"
 
+#include "../cpu_profiler.h"
 #include "../platform.h"
 
+#include <chrono>
 #include <fstream>
 
 #define VMA_IMPLEMENTATION
@@ -38,9 +40,13 @@ void create_instance(vulkan_data* data)
     create_info.pApplicationInfo = &appInfo;
     create_info.enabledLayerCount = 0;
 
-    uint32_t numGlfwExt = 0;
-    auto glfwExt = glfwGetRequiredInstanceExtensions(&numGlfwExt);
-    std::vector<const char*> extensions(glfwExt, glfwExt + numGlfwExt);
+    // headless there is no surface, so none of glfw's surface extensions
+    std::vector<const char*> extensions;
+    if (!data->headless) {
+        uint32_t numGlfwExt = 0;
+        auto glfwExt = glfwGetRequiredInstanceExtensions(&numGlfwExt);
+        extensions.assign(glfwExt, glfwExt + numGlfwExt);
+    }
 
 #ifndef NDEBUG
     /* extensions */
@@ -100,7 +106,9 @@ physical_device_indices get_device_indices(VkPhysicalDevice device, VkSurfaceKHR
         }
 
         VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, index, surface, &present_support);
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, index, surface, &present_support);
+        }
         if (present_support) {
             indices.has_present_queue = true;
             indices.present_queue_index = index;
@@ -109,6 +117,12 @@ physical_device_indices get_device_indices(VkPhysicalDevice device, VkSurfaceKHR
         index++;
     }
 
+    // headless frames are never presented, the graphics queue stands in for the present queue
+    if (surface == VK_NULL_HANDLE) {
+        indices.has_present_queue = indices.has_graphics_queue;
+        indices.present_queue_index = indices.graphics_queue_index;
+    }
+
     return indices;
 }
 
@@ -160,8 +174,8 @@ bool is_device_suitable(VkPhysicalDevice device, VkSurfaceKHR surface, std::vect
 {
     auto indices = get_device_indices(device, surface);
     bool ext = check_device_extension_support(device, required_extensions);
-    bool swap_chain_is_adequate = false;
-    if (ext) {
+    bool swap_chain_is_adequate = (surface == VK_NULL_HANDLE);    // headless, nothing to present to
+    if (ext && surface != VK_NULL_HANDLE) {
         auto details = query_swap_chain_support(device, surface);
         swap_chain_is_adequate = !details.formats.empty() && !details.present_modes.empty();
     }
@@ -191,8 +205,8 @@ void pick_physical_device(vulkan_data* data, std::vector<const char*>& required_
     }
 
     // score suitable devices for best physical device (optional features)
-    VkPhysicalDevice* best_device = VK_NULL_HANDLE;
-    int best_score = 0;
+    VkPhysicalDevice best_device = VK_NULL_HANDLE;
+    int best_score = -1;
     for (VkPhysicalDevice device: suitable_devices) {
         int score = 0;
         VkPhysicalDeviceFeatures supportedFeatures;
@@ -203,12 +217,12 @@ void pick_physical_device(vulkan_data* data, std::vector<const char*>& required_
         }
 
         if (score > best_score) {
-            best_device = &device;
+            best_device = device;
             best_score = score;
         }
     }
 
-    data->physical_device = *best_device;
+    data->physical_device = best_device;
     if (data->physical_device == VK_NULL_HANDLE) {
         throw std::runtime_error("Unable to select a suitable physical device!");
     }
@@ -219,7 +233,10 @@ void create_logical_device(vulkan_data* data, std::vector<const char*>& required
     auto queue_indices = get_device_indices(data->physical_device, data->surface);
 
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::vector<uint32_t> uniqueQueueFamilies = {queue_indices.graphics_queue_index, queue_indices.present_queue_index};
+    std::vector<uint32_t> uniqueQueueFamilies = {queue_indices.graphics_queue_index};
+    if (queue_indices.present_queue_index != queue_indices.graphics_queue_index) {
+        uniqueQueueFamilies.push_back(queue_indices.present_queue_index);
+    }
 
     float queuePriority = 1.0f;
     for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -231,15 +248,32 @@ void create_logical_device(vulkan_data* data, std::vector<const char*>& required
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(data->physical_device, &supportedFeatures);
+
+    // enable block compressed texture formats if the device supports them
     VkPhysicalDeviceFeatures deviceFeatures = {};
+    deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+    data->texture_compression_bc = (supportedFeatures.textureCompressionBC == VK_TRUE);
+    // lets gpu_profiler count vertices and shader invocations per pass
+    deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+    data->pipeline_statistics = (supportedFeatures.pipelineStatisticsQuery == VK_TRUE);
 
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(required_extensions.size());
-    deviceCreateInfo.ppEnabledExtensionNames = required_extensions.data();
+
+    // memory budget reporting is optional, texture streaming falls back to vma's own estimate without it
+    std::vector<const char*> extensions = required_extensions;
+    std::vector<const char*> budget_extension = {VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+    data->memory_budget_ext = check_device_extension_support(data->physical_device, budget_extension);
+    if (data->memory_budget_ext) {
+        extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    }
+    deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    deviceCreateInfo.ppEnabledExtensionNames = extensions.data();
 
     if (vkCreateDevice(data->physical_device, &deviceCreateInfo, nullptr, &data->logical_device) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
@@ -247,6 +281,7 @@ void create_logical_device(vulkan_data* data, std::vector<const char*>& required
 
     vkGetDeviceQueue(data->logical_device, queue_indices.graphics_queue_index, 0, &data->graphics_queue);
     vkGetDeviceQueue(data->logical_device, queue_indices.present_queue_index, 0, &data->present_queue);
+    data->graphics_queue_family = queue_indices.graphics_queue_index;
 }
 
 VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats)
@@ -304,7 +339,9 @@ void create_swap_chain(vulkan_data* data, uint32_t width, uint32_t height)
     createInfo.imageColorSpace = surface_format.colorSpace;
     createInfo.imageExtent = extent;
     createInfo.imageArrayLayers = 1;
+    // transfer destination where the surface allows it, post processing blits its result over
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    createInfo.imageUsage |= swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     createInfo.preTransform = swap_chain_support.capabilities.currentTransform;
 
     // specify ownership for sharing images across queue families
@@ -338,6 +375,61 @@ void create_swap_chain(vulkan_data* data, uint32_t width, uint32_t height)
 
     data->swap_chain_data.extent = extent;
     data->swap_chain_data.image_format = surface_format.format;
+    data->swap_chain_data.image_usage = createInfo.imageUsage;
+
+    // replays render into an image like it
+    if (data->capture != nullptr) {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = surface_format.format;
+        image_info.extent = {extent.width, extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = createInfo.imageUsage;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        for (VkImage image : data->swap_chain_data.images) {
+            data->capture->track_image(image, image_info);
+        }
+    }
+}
+
+// stands in for the swapchain when headless. one image per frame in flight, so waiting on a
+// frame's fence also means its image is free again
+void create_offscreen_images(vulkan_data* data, uint32_t width, uint32_t height)
+{
+    auto& swap_chain_data = data->swap_chain_data;
+    swap_chain_data.image_format = VK_FORMAT_B8G8R8A8_UNORM;
+    swap_chain_data.image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    swap_chain_data.extent = {width, height};
+    swap_chain_data.images.resize(MAX_FRAMES_IN_FLIGHT);
+    swap_chain_data.allocations.resize(MAX_FRAMES_IN_FLIGHT);
+
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = swap_chain_data.image_format;
+        image_info.extent = {width, height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = swap_chain_data.image_usage;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        VmaAllocationCreateInfo alloc_info = {};
+        alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        if (vmaCreateImage(data->mem_allocator, &image_info, &alloc_info, &swap_chain_data.images[i], &swap_chain_data.allocations[i], nullptr) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create offscreen image!");
+        }
+        if (data->capture != nullptr) {
+            data->capture->track_image(swap_chain_data.images[i], image_info);
+        }
+    }
 }
 
 void create_swap_chain_image_views(vulkan_data* data)
@@ -364,6 +456,9 @@ void create_swap_chain_image_views(vulkan_data* data)
         if (vkCreateImageView(data->logical_device, &create_info, nullptr, &data->swap_chain_data.image_views[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create image views!");
         }
+        if (data->capture != nullptr) {
+            data->capture->track_image_view(data->swap_chain_data.image_views[i], create_info);
+        }
     }
 }
 
@@ -389,106 +484,19 @@ VkFormat find_depth_format(vulkan_data& data) {
                                        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
-void create_render_pass(vulkan_data* data)
-{
-    // @TODO this will have to be updated in the future for post processing etc.
-    // @TODO multisampling
-    VkAttachmentDescription colorAttachment = {};
-    colorAttachment.format = data->swap_chain_data.image_format;
-    colorAttachment.samples = data->msaa_samples;
-    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference colorAttachmentRef = {};
-    colorAttachmentRef.attachment = 0;
-    colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentDescription depthAttachment = {};
-    depthAttachment.format = find_depth_format(*data);
-    depthAttachment.samples = data->msaa_samples;
-    depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depthAttachmentRef = {};
-    depthAttachmentRef.attachment = 1;
-    depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentDescription colorAttachmentResolve{};
-    colorAttachmentResolve.format = data->swap_chain_data.image_format;
-    colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
-    colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    VkAttachmentReference colorAttachmentResolveRef{};
-    colorAttachmentResolveRef.attachment = 2;
-    colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass = {};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorAttachmentRef;
-    subpass.pDepthStencilAttachment = &depthAttachmentRef;
-    subpass.pResolveAttachments = &colorAttachmentResolveRef;
-
-    VkSubpassDependency dependency = {};
-    dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.srcAccessMask = 0;
-    dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    std::array<VkAttachmentDescription, 3> attachments = {colorAttachment, depthAttachment, colorAttachmentResolve};
-    VkRenderPassCreateInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-    renderPassInfo.pAttachments = attachments.data();
-    renderPassInfo.subpassCount = 1;
-    renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
-
-    if (vkCreateRenderPass(data->logical_device, &renderPassInfo, nullptr, &data->render_pass) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create render pass!");
-    }
-}
-
-void create_frame_buffers(vulkan_data* data)
-{
-    // @FIX framebuffers and render passes, this will need to be generalised at some point probably
-    data->swap_chain_data.frame_buffers.resize(data->swap_chain_data.image_views.size());
-    for (size_t i = 0; i < data->swap_chain_data.image_views.size(); i++) {
-        std::array<VkImageView, 3> attachments = {
-            data->color_resources.image_view,
-            data->depth_resources.image_view,
-            data->swap_chain_data.image_views[i]
-        };
-
-        VkFramebufferCreateInfo framebufferInfo = {};
-        framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        framebufferInfo.renderPass = data->render_pass;
-        framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-        framebufferInfo.pAttachments = attachments.data();
-        framebufferInfo.width = data->swap_chain_data.extent.width;
-        framebufferInfo.height = data->swap_chain_data.extent.height;
-        framebufferInfo.layers = 1;
-
-        if (vkCreateFramebuffer(data->logical_device, &framebufferInfo, nullptr, &data->swap_chain_data.frame_buffers[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create framebuffer!");
+VkSampleCountFlagBits clamp_msaa_samples(vulkan_data& data, VkSampleCountFlagBits requested)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(data.physical_device, &properties);
+    VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+    // counts are single bits, 1 sample is always supported
+    for (uint32_t count = VK_SAMPLE_COUNT_64_BIT; count > VK_SAMPLE_COUNT_1_BIT; count >>= 1) {
+        if (count <= static_cast<uint32_t>(requested) && (supported & count) != 0) {
+            return static_cast<VkSampleCountFlagBits>(count);
         }
     }
+    return VK_SAMPLE_COUNT_1_BIT;
 }
 
 void create_command_pools(vulkan_data* data)
@@ -510,6 +518,11 @@ void initialise_memory_allocator(vulkan_data* data)
     VmaAllocatorCreateInfo allocatorInfo = {};
     allocatorInfo.physicalDevice = data->physical_device;
     allocatorInfo.device = data->logical_device;
+    allocatorInfo.instance = data->instance;
+    allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+    if (data->memory_budget_ext) {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
     
     if (vmaCreateAllocator(&allocatorInfo, &data->mem_allocator) != VK_SUCCESS) {
         throw std::runtime_error("Unable to initialise VK memory allocator!");
@@ -545,114 +558,27 @@ void create_fences(vulkan_data* data, std::array<VkFence, MAX_FRAMES_IN_FLIGHT>&
     }
 }
 
-void create_depth_resources(vulkan_data* data) {
-    VkFormat depth_format = find_depth_format(*data);
-
-    // create depth image
-    VkImageCreateInfo imageInfo = {};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = data->swap_chain_data.extent.width;
-    imageInfo.extent.height = data->swap_chain_data.extent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = depth_format;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.samples = data->msaa_samples;
-    imageInfo.flags = 0; // Optional
-
-    VmaAllocationCreateInfo allocationCreateInfo = {};
-    allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-    if (vmaCreateImage(data->mem_allocator, &imageInfo, &allocationCreateInfo, &data->depth_resources.image, &data->depth_resources.image_allocation, nullptr) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create depth image!");
-    }
-
-    // create depth image view
-    VkImageViewCreateInfo viewInfo = {};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = data->depth_resources.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = depth_format;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    if (vkCreateImageView(data->logical_device, &viewInfo, nullptr, &data->depth_resources.image_view) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create depth image view!");
-    }
-}
-
-void cleanup_depth_resources(vulkan_data* data) {
-    vkDestroyImageView(data->logical_device, data->depth_resources.image_view, nullptr);
-    vmaDestroyImage(data->mem_allocator, data->depth_resources.image, data->depth_resources.image_allocation);
-}
-
-void create_color_resources(vulkan_data* data) {
-    // create image
-    VkImageCreateInfo imageInfo = {};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = data->swap_chain_data.extent.width;
-    imageInfo.extent.height = data->swap_chain_data.extent.height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = data->swap_chain_data.image_format;
-    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    imageInfo.usage = VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.samples = data->msaa_samples;
-    imageInfo.flags = 0; // Optional
-
-    VmaAllocationCreateInfo allocationCreateInfo = {};
-    allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-
-    if (vmaCreateImage(data->mem_allocator, &imageInfo, &allocationCreateInfo, &data->color_resources.image, &data->color_resources.image_allocation, nullptr) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to create depth image!");
-    }
-
-    // create image view
-    VkImageViewCreateInfo viewInfo = {};
-    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    viewInfo.image = data->color_resources.image;
-    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = data->swap_chain_data.image_format;
-    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
-    viewInfo.subresourceRange.baseArrayLayer = 0;
-    viewInfo.subresourceRange.layerCount = 1;
-
-    if (vkCreateImageView(data->logical_device, &viewInfo, nullptr, &data->color_resources.image_view) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create depth image view!");
-    }
-}
-
-void cleanup_color_resources(vulkan_data* data) {
-    vkDestroyImageView(data->logical_device, data->color_resources.image_view, nullptr);
-    vmaDestroyImage(data->mem_allocator, data->color_resources.image, data->color_resources.image_allocation);
-}
-
 void cleanup_swap_chain(vulkan_data* data)
 {
-    for (auto framebuffer : data->swap_chain_data.frame_buffers) {
-        vkDestroyFramebuffer(data->logical_device, framebuffer, nullptr);
+    if (data->capture != nullptr) {
+        for (auto image_view : data->swap_chain_data.image_views) {
+            data->capture->forget(capture_object_type::IMAGE_VIEW, image_view);
+        }
+        for (auto image : data->swap_chain_data.images) {
+            data->capture->forget(capture_object_type::IMAGE, image);
+        }
     }
-    cleanup_color_resources(data);
-    cleanup_depth_resources(data);
-    vkDestroyRenderPass(data->logical_device, data->render_pass, nullptr);
     for (auto image_view : data->swap_chain_data.image_views) {
         vkDestroyImageView(data->logical_device, image_view, nullptr);
     }
-    vkDestroySwapchainKHR(data->logical_device, data->swap_chain, nullptr);
+    if (data->headless) {
+        for (size_t i = 0; i < data->swap_chain_data.images.size(); i++) {
+            vmaDestroyImage(data->mem_allocator, data->swap_chain_data.images[i], data->swap_chain_data.allocations[i]);
+        }
+        data->swap_chain_data.allocations.clear();
+    } else {
+        vkDestroySwapchainKHR(data->logical_device, data->swap_chain, nullptr);
+    }
 }
 
 void recreate_swap_chain(vulkan_data* data, GLFWwindow* window)
@@ -669,17 +595,21 @@ void recreate_swap_chain(vulkan_data* data, GLFWwindow* window)
     for (graphics_pipeline* pipeline : data->registered_pipelines) {
         pipeline->reterminate(*data);
     }
+    for (VkRenderPass render_pass : data->graph->get_render_passes()) {
+        data->pipelines->release_render_pass(*data, render_pass);
+    }
+    bool recompile = data->graph->is_compiled();
+    data->graph->release(*data);
     cleanup_swap_chain(data);
 
-    // recreate
+    // recreate, the graph keeps its render passes so pipelines are rebuilt for the same ones
     create_swap_chain(data, width, height);
     create_swap_chain_image_views(data);
-    create_render_pass(data);
-    create_color_resources(data);
-    create_depth_resources(data);
-    create_frame_buffers(data);
+    if (recompile) {
+        data->graph->compile(*data);
+    }
     for (graphics_pipeline* pipeline : data->registered_pipelines) {
-        pipeline->reinitialise(*data, data->render_pass);
+        pipeline->reinitialise(*data, pipeline->get_render_pass());
     }
     for (graphics_command_buffer* buffer : data->registered_command_buffers) {
         buffer->reinitialise(*data);
@@ -700,6 +630,35 @@ void terminate_defaults(vulkan_data& data) {
     delete data.default_image;
 }
 
+// everything after the surface up to the swapchain, shared with headless
+static void initialise_device(vulkan_data* data, std::vector<const char*>& required_extensions)
+{
+    pick_physical_device(data, required_extensions);
+    create_logical_device(data, required_extensions);
+    initialise_memory_allocator(data);
+    create_pipeline_cache(data);
+    data->pipelines = new pipeline_registry;
+    data->pipelines->initialise(*data);
+    create_semaphores(data, data->image_available_sems);
+    create_semaphores(data, data->render_finished_sems);
+    create_fences(data, data->in_flight_fences);
+    create_command_pools(data);
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// everything that depends on the swapchain or offscreen images
+static void initialise_frame_targets(vulkan_data* data)
+{
+    create_swap_chain_image_views(data);
+    data->msaa_samples = clamp_msaa_samples(*data, data->msaa_samples);
+    data->graph = new render_graph;
+    create_defaults(data);
+}
+
 void initialise_vulkan(vulkan_data* data, GLFWwindow* window)
 {
     data->glfw_window = window;
@@ -709,23 +668,41 @@ void initialise_vulkan(vulkan_data* data, GLFWwindow* window)
     int width, height;
     glfwGetWindowSize(window, &width, &height);
 
+    auto start = std::chrono::steady_clock::now();
     create_instance(data);
     create_surface(data, window);
-    pick_physical_device(data, required_extensions);
-    create_logical_device(data, required_extensions);
-    initialise_memory_allocator(data);
-    create_semaphores(data, data->image_available_sems);
-    create_semaphores(data, data->render_finished_sems);
-    create_fences(data, data->in_flight_fences);
-    create_command_pools(data);
+    data->startup_times.instance_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    initialise_device(data, required_extensions);
+    data->startup_times.device_ms = elapsed_ms(start);
 
+    start = std::chrono::steady_clock::now();
     create_swap_chain(data, width, height);
-    create_swap_chain_image_views(data);
-    create_render_pass(data);
-    create_color_resources(data);
-    create_depth_resources(data);
-    create_frame_buffers(data);
-    create_defaults(data);
+    initialise_frame_targets(data);
+    data->startup_times.swap_chain_ms = elapsed_ms(start);
+}
+
+void initialise_vulkan_headless(vulkan_data* data, uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0) {
+        throw std::logic_error("headless frames need a size!");
+    }
+    data->headless = true;
+    std::vector<const char*> required_extensions;
+
+    auto start = std::chrono::steady_clock::now();
+    create_instance(data);
+    data->startup_times.instance_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    initialise_device(data, required_extensions);
+    data->startup_times.device_ms = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    create_offscreen_images(data, width, height);
+    initialise_frame_targets(data);
+    data->startup_times.swap_chain_ms = elapsed_ms(start);
 }
 
 void terminate_vulkan(vulkan_data& data)
@@ -733,6 +710,9 @@ void terminate_vulkan(vulkan_data& data)
     vkDeviceWaitIdle(data.logical_device);
 
     terminate_defaults(data);
+    data.graph->terminate(data);
+    delete data.graph;
+    data.graph = nullptr;
     cleanup_swap_chain(&data);
     vkDestroyCommandPool(data.logical_device, data.command_pool_graphics, nullptr);
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -740,9 +720,16 @@ void terminate_vulkan(vulkan_data& data)
         vkDestroySemaphore(data.logical_device, data.render_finished_sems[i], nullptr);
         vkDestroyFence(data.logical_device, data.in_flight_fences[i], nullptr);
     }
+    data.pipelines->terminate(data);
+    delete data.pipelines;
+    data.pipelines = nullptr;
+    destroy_pipeline_cache(data);
     terminate_memory_allocator(data);
     vkDestroyDevice(data.logical_device, nullptr);
-    vkDestroySurfaceKHR(data.instance, data.surface, nullptr);
+    if (data.surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(data.instance, data.surface, nullptr);
+        data.surface = VK_NULL_HANDLE;
+    }
     vkDestroyInstance(data.instance, nullptr);
     data.instance = nullptr;
     data.glfw_window = nullptr;
@@ -762,7 +749,8 @@ VkShaderModule create_shader_module_from_spirv(vulkan_data& vulkan, std::vector<
     return module;
 }
 
-VkPipelineShaderStageCreateInfo gen_shader_stage_create_info(VkShaderModule module, shader_type type, const char* entry_point)
+VkPipelineShaderStageCreateInfo gen_shader_stage_create_info(VkShaderModule module, shader_type type, const char* entry_point,
+                                                             const VkSpecializationInfo* specialization_info)
 {
     VkShaderStageFlagBits stage_flag;
     switch (type) {
@@ -777,31 +765,37 @@ VkPipelineShaderStageCreateInfo gen_shader_stage_create_info(VkShaderModule modu
     create_info.stage = stage_flag;
     create_info.module = module;
     create_info.pName = entry_point;
+    create_info.pSpecializationInfo = specialization_info;
 
     return create_info;
 }
 
 void submit_command_buffers_graphics(vulkan_data& data, std::vector<VkCommandBuffer> command_buffers)
 {
-    vkWaitForFences(data.logical_device, 1, &data.in_flight_fences[data.current_frame], VK_TRUE, UINT64_MAX);
+    CPU_PROFILE_SCOPE("submit_command_buffers_graphics");
+    {
+        CPU_PROFILE_SCOPE("wait_fence");
+        vkWaitForFences(data.logical_device, 1, &data.in_flight_fences[data.current_frame], VK_TRUE, UINT64_MAX);
+    }
 
     uint32_t imageIndex = get_image_index(data);
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
+    // headless images are never acquired or presented, the fence alone guards them
     VkSemaphore waitSemaphores[] = {data.image_available_sems[data.current_frame]};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = data.headless ? 0 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &command_buffers[imageIndex];
     VkSemaphore signalSemaphores[] = {data.render_finished_sems[data.current_frame]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = data.headless ? 0 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     vkResetFences(data.logical_device, 1, &data.in_flight_fences[data.current_frame]);
-    auto err = vkQueueSubmit(data.graphics_queue, 1, &submitInfo, data.in_flight_fences[data.current_frame]);
+    auto err = CAPTURED(data.capture, vkQueueSubmit, data.graphics_queue, 1, &submitInfo, data.in_flight_fences[data.current_frame]);
     if (err != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!  error id: " + std::to_string(err));
     }
@@ -809,27 +803,107 @@ void submit_command_buffers_graphics(vulkan_data& data, std::vector<VkCommandBuf
 
 void present_frame(vulkan_data& data)
 {
-    VkSemaphore signalSemaphores[] = {data.render_finished_sems[data.current_frame]};
-    VkSwapchainKHR swapChains[] = {data.swap_chain};
-    uint32_t imageIndex = get_image_index(data);
-
-    VkPresentInfoKHR presentInfo = {};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-    presentInfo.swapchainCount = 1; 
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
-    presentInfo.pResults = nullptr; // Optional
-
-    auto result = vkQueuePresentKHR(data.present_queue, &presentInfo);
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        recreate_swap_chain(&data, data.glfw_window);
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("failed to present swap chain image!");
+    CPU_PROFILE_SCOPE("present_frame");
+    // headless frames stay in their offscreen image, only the frame counters move on
+    if (!data.headless) {
+        VkSemaphore signalSemaphores[] = {data.render_finished_sems[data.current_frame]};
+        VkSwapchainKHR swapChains[] = {data.swap_chain};
+        uint32_t imageIndex = get_image_index(data);
+
+        VkPresentInfoKHR presentInfo = {};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+        presentInfo.swapchainCount = 1; 
+        presentInfo.pSwapchains = swapChains;
+        presentInfo.pImageIndices = &imageIndex;
+        presentInfo.pResults = nullptr; // Optional
+
+        auto result = vkQueuePresentKHR(data.present_queue, &presentInfo);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+            recreate_swap_chain(&data, data.glfw_window);
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
     }
     data.current_frame = ((data.current_frame + 1) % MAX_FRAMES_IN_FLIGHT);
     data.image_index = -1;
+
+    // vma refreshes its budget once per frame index
+    data.frame_number++;
+    vmaSetCurrentFrameIndex(data.mem_allocator, static_cast<uint32_t>(data.frame_number));
+
+    if (data.capture != nullptr) {
+        data.capture->end_frame(data);
+    }
+}
+
+void read_headless_frame(vulkan_data& data, std::vector<uint8_t>& rgba)
+{
+    if (!data.headless) {
+        throw std::logic_error("only headless frames can be read back!");
+    }
+    VkImage image = data.swap_chain_data.images[get_image_index(data)];
+    VkExtent2D extent = data.swap_chain_data.extent;
+    VkDeviceSize byte_size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+    VkBuffer buffer; VmaAllocation allocation;
+    create_buffer(data, &buffer, &allocation, byte_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = data.command_pool_graphics;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    vkAllocateCommandBuffers(data.logical_device, &allocInfo, &cmd);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    // the render graph already left the image in TRANSFER_SRC_OPTIMAL for transfer reads
+    VkBufferImageCopy region = {};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {extent.width, extent.height, 1};
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    vkEndCommandBuffer(cmd);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    vkQueueSubmit(data.graphics_queue, 1, &submitInfo, VK_NULL_HANDLE);
+    vkQueueWaitIdle(data.graphics_queue);
+    vkFreeCommandBuffers(data.logical_device, data.command_pool_graphics, 1, &cmd);
+
+    /* offscreen images are bgra */
+    rgba.resize(static_cast<size_t>(byte_size));
+    void* mapped;
+    vmaMapMemory(data.mem_allocator, allocation, &mapped);
+    vmaInvalidateAllocation(data.mem_allocator, allocation, 0, VK_WHOLE_SIZE);
+    auto src = static_cast<const uint8_t*>(mapped);
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        rgba[i + 0] = src[i + 2];
+        rgba[i + 1] = src[i + 1];
+        rgba[i + 2] = src[i + 0];
+        rgba[i + 3] = src[i + 3];
+    }
+    vmaUnmapMemory(data.mem_allocator, allocation);
+    vmaDestroyBuffer(data.mem_allocator, buffer, allocation);
 }
 
 template <typename T>
@@ -895,12 +969,29 @@ void create_buffer(vulkan_data& data, VkBuffer* buffer, VmaAllocation* allocatio
     if (vmaCreateBuffer(data.mem_allocator, &bufferInfo, &allocInfo, buffer, allocation, nullptr) != VK_SUCCESS) {
         throw std::runtime_error("failed to create vertex buffer!");
     }
+    // staging and readback buffers never reach a frame's commands
+    if (data.capture != nullptr && (usage & ~(VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)) != 0) {
+        data.capture->track_buffer(*buffer, bufferInfo);
+    }
+}
+
+void destroy_buffer(vulkan_data& data, VkBuffer buffer, VmaAllocation allocation)
+{
+    if (data.capture != nullptr) {
+        data.capture->forget(capture_object_type::BUFFER, buffer);
+    }
+    vmaDestroyBuffer(data.mem_allocator, buffer, allocation);
 }
 
 uint32_t get_image_index(vulkan_data& data)
 {
     uint32_t image_index;
-    if (data.image_index < 0) {
+    if (data.image_index < 0 && data.headless) {
+        // an offscreen image per frame in flight
+        image_index = data.current_frame;
+        data.image_index = image_index;
+    } else if (data.image_index < 0) {
+        CPU_PROFILE_SCOPE("acquire_image");
         vkAcquireNextImageKHR(data.logical_device, data.swap_chain, UINT64_MAX, data.image_available_sems[data.current_frame], VK_NULL_HANDLE, &image_index);
         data.image_index = image_index;
     } else {
@@ -923,3 +1014,20 @@ void fill_buffer(vulkan_data& vkdata, VmaAllocation& alloc, size_t data_length,
     memcpy(mapped_mem, data_start, data_length);
     vmaUnmapMemory(vkdata.mem_allocator, alloc);
 }
+
+void get_device_memory_budget(vulkan_data& data, VkDeviceSize* usage, VkDeviceSize* budget)
+{
+    const VkPhysicalDeviceMemoryProperties* props;
+    vmaGetMemoryProperties(data.mem_allocator, &props);
+    std::vector<VmaBudget> budgets(props->memoryHeapCount);
+    vmaGetBudget(data.mem_allocator, budgets.data());
+
+    *usage = 0;
+    *budget = 0;
+    for (uint32_t i = 0; i < props->memoryHeapCount; i++) {
+        if (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            *usage += budgets[i].usage;
+            *budget += budgets[i].budget;
+        }
+    }
+}
@@ -4,19 +4,34 @@
 #include <array>
 #include <string>
 #include <stdexcept>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <map>
+#include <fstream>
+#include <functional>
 
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
 #include "vk_mem_alloc.h"
 #include "dense_id_list.hpp"
+#include "../thread_pool.h"
 
 
 class graphics_command_buffer;
 class graphics_pipeline;
+class pipeline_registry;
+class render_graph;
 class uniform_buffer_base;
 struct vulkan_image;
 struct vulkan_image_view;
+class upload_batch;
+struct staging_region;
+class vulkan_capture;
 
 struct vkimage_and_allocation
 {
@@ -28,36 +43,37 @@ struct vkimage_and_allocation
 /* vulkan data */
 
 #define MAX_FRAMES_IN_FLIGHT 2
+// wall clock time spent in each step of initialise_vulkan(_headless)
+struct vulkan_startup_times {
+    double instance_ms = 0.0;
+    double device_ms = 0.0;         // device, allocator, pipeline cache, sync objects and command pools
+    double swap_chain_ms = 0.0;     // swapchain or offscreen images, their views and the default resources
+};
+
 struct vulkan_data
 {
 public:
-    GLFWwindow* glfw_window;
+    GLFWwindow* glfw_window = nullptr;
     VkInstance instance = nullptr;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
     VkDevice logical_device = VK_NULL_HANDLE;
     VkQueue graphics_queue;
     VkQueue present_queue;
+    uint32_t graphics_queue_family = 0;
     VkSwapchainKHR swap_chain;
-    VkRenderPass render_pass;
     VkCommandPool command_pool_graphics;
     struct {
         std::vector<VkImage> images;
         std::vector<VkImageView> image_views;
-        std::vector<VkFramebuffer> frame_buffers;
         VkFormat image_format;
+        VkImageUsageFlags image_usage;
         VkExtent2D extent;
+        std::vector<VmaAllocation> allocations;     // headless only, the images are ours
     } swap_chain_data;
-    struct {
-        VkImage image;
-        VmaAllocation image_allocation;
-        VkImageView image_view;
-    } depth_resources;
-    struct {
-        VkImage image;
-        VmaAllocation image_allocation;
-        VkImageView image_view;
-    } color_resources;
+    // no window, surface or swapchain. frames are rendered into offscreen images that are never
+    // presented, one per frame in flight, and can be copied out with read_headless_frame
+    bool headless = false;
     std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> image_available_sems;
     std::array<VkSemaphore, MAX_FRAMES_IN_FLIGHT> render_finished_sems;
     std::array<VkFence, MAX_FRAMES_IN_FLIGHT> in_flight_fences;
@@ -67,7 +83,21 @@ public:
     std::vector<graphics_pipeline*> registered_pipelines;
     VmaAllocator mem_allocator;
     vulkan_image* default_image;
-    VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_8_BIT;
+    // samples of the scene attachments, kept within the device's limits by clamp_msaa_samples
+    VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_4_BIT;
+    bool texture_compression_bc = false;
+    bool memory_budget_ext = false;
+    bool pipeline_statistics = false;   // pipelineStatisticsQuery is enabled
+    uint64_t frame_number = 0;      // frames presented so far
+    VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+    pipeline_registry* pipelines = nullptr;
+    // the frame's passes, declared by the renderer and recompiled with the swapchain
+    render_graph* graph = nullptr;
+    // loaded by initialise_vulkan and saved by terminate_vulkan, empty to keep it in memory only
+    std::string pipeline_cache_path = "res/cache/pipeline_cache.bin";
+    vulkan_startup_times startup_times;
+    // records a frame's vulkan calls to a file when set, before initialise_vulkan so it sees every object
+    vulkan_capture* capture = nullptr;
 };
 
 
@@ -77,13 +107,24 @@ enum class shader_type {
 
 
 void initialise_vulkan(vulkan_data* data, GLFWwindow* window);
+// without glfw or a display, e.g. on a software icd. the swapchain data describes the offscreen images
+void initialise_vulkan_headless(vulkan_data* data, uint32_t width, uint32_t height);
 void terminate_vulkan(vulkan_data& data);
 
+// the pipeline cache every pipeline is created through, kept on disk between runs
+void create_pipeline_cache(vulkan_data* data);
+void save_pipeline_cache(vulkan_data& data);
+void destroy_pipeline_cache(vulkan_data& data);
+
 VkShaderModule create_shader_module_from_spirv(vulkan_data& vulkan, std::vector<char>& shader_data);
-VkPipelineShaderStageCreateInfo gen_shader_stage_create_info(VkShaderModule module, shader_type type, const char* entry_point = "main");
+VkPipelineShaderStageCreateInfo gen_shader_stage_create_info(VkShaderModule module, shader_type type, const char* entry_point = "main",
+                                                             const VkSpecializationInfo* specialization_info = nullptr);
 
 void submit_command_buffers_graphics(vulkan_data& data, std::vector<VkCommandBuffer> command_buffers);
 void present_frame(vulkan_data& data);
+// copies the frame just submitted out as tightly packed rgba8, between submit and present_frame.
+// waits for the queue to go idle
+void read_headless_frame(vulkan_data& data, std::vector<uint8_t>& rgba);
 
 void register_command_buffer(vulkan_data& data, graphics_command_buffer* buffer);
 void unregister_command_buffer(vulkan_data& data, graphics_command_buffer* buffer);
@@ -91,8 +132,14 @@ void register_pipeline(vulkan_data& data, graphics_pipeline* pipeline);
 void unregister_pipeline(vulkan_data& data, graphics_pipeline* pipeline);
 
 void create_buffer(vulkan_data& data, VkBuffer* buffer, VmaAllocation* allocation, VkDeviceSize byte_data_size, VkBufferUsageFlags usage, VmaMemoryUsage memory_usage);
+void destroy_buffer(vulkan_data& data, VkBuffer buffer, VmaAllocation allocation);
 void fill_buffer(vulkan_data& vkdata, VmaAllocation& alloc, size_t data_length, void* data_start);
 uint32_t get_image_index(vulkan_data& data);
+VkFormat find_depth_format(vulkan_data& data);
+// the highest sample count up to requested that color and depth framebuffers both support
+VkSampleCountFlagBits clamp_msaa_samples(vulkan_data& data, VkSampleCountFlagBits requested);
+// device local memory in use and available to this process, from VK_EXT_memory_budget when supported
+void get_device_memory_budget(vulkan_data& data, VkDeviceSize* usage, VkDeviceSize* budget);
 
 VkPhysicalDeviceFeatures get_device_features(vulkan_data& data);
 
@@ -117,6 +164,8 @@ protected:
 public:
     void initialise_static(vulkan_data& data, VkBufferUsageFlagBits usage, void* vertex_data, size_t byte_size);
     void initialise_dynamic(vulkan_data& data, VkBufferUsageFlagBits usage, size_t byte_size);
+    // creates the gpu buffer now, the copy from src is recorded when the batch is submitted
+    void initialise_static_deferred(vulkan_data& data, upload_batch& batch, VkBufferUsageFlagBits usage, const staging_region& src, size_t byte_size);
     void terminate(vulkan_data& data);
 
     bool fill_buffer(vulkan_data& vkdata, void* data, size_t byte_size);
@@ -139,6 +188,12 @@ public:
         this->initialise_static(data, usage, input_data.data(), input_data.size() * sizeof(T));
     }
 
+    void initialise(vulkan_data& data, upload_batch& batch, VkBufferUsageFlagBits usage, const staging_region& src, size_t element_count)
+    {
+        this->count = element_count;
+        this->initialise_static_deferred(data, batch, usage, src, element_count * sizeof(T));
+    }
+
     size_t get_count() const {
         return this->count; 
     }
@@ -169,6 +224,23 @@ public:
 };
 
 
+size_t get_index_size(VkIndexType type);
+
+// index buffer whose index type (16 or 32 bit) is picked at load time
+class static_index_buffer : public buffer_base
+{
+protected:
+    size_t count = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+
+public:
+    void initialise(vulkan_data& data, upload_batch& batch, const staging_region& src, size_t index_count, VkIndexType type);
+
+    size_t get_count() const;
+    VkIndexType get_index_type() const;
+};
+
+
 /* vulkan command buffer */
 class graphics_command_buffer
 {
@@ -194,11 +266,6 @@ protected:
     inline VkCommandBuffer& cmd_buffer() {
         return command_buffers[current_index];
     }
-
-    inline VkFramebuffer& frame_buffer(vulkan_data& data) {
-        return data.swap_chain_data.frame_buffers[current_index];
-    }
-    
 };
 
 
@@ -210,25 +277,137 @@ struct uniform_buffer_decl {
     VkShaderStageFlagBits shaderFlags = VK_SHADER_STAGE_VERTEX_BIT;
 };
 
-class graphics_pipeline
+struct shader_stage_decl {
+    std::string path;           // relative to the executable, resolved with to_absolute_path
+    shader_type type = shader_type::VERTEX;
+    std::string entry_point = "main";
+};
+
+// a 32 bit specialization constant, bools are stored as VkBool32 and floats by bit pattern
+struct specialization_constant {
+    uint32_t id = 0;
+    uint32_t value = 0;
+};
+
+inline specialization_constant new_specialization_constant(uint32_t id, bool value) {
+    return {id, value ? VK_TRUE : VK_FALSE};
+}
+
+inline specialization_constant new_specialization_constant(uint32_t id, float value) {
+    specialization_constant constant{id, 0};
+    std::memcpy(&constant.value, &value, sizeof(value));
+    return constant;
+}
+
+/*
+ * everything a graphics pipeline is built from. graphics_pipeline fills one in from its gen_*
+ * calls, the registry keys pipelines by it so equal states share one VkPipeline
+ */
+struct pipeline_state {
+    std::vector<shader_stage_decl> shader_stages;
+    std::vector<VkVertexInputBindingDescription> vertex_bindings;
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+    std::vector<VkViewport> viewports;
+    std::vector<VkRect2D> scissors;
+    VkPipelineRasterizationStateCreateInfo rasterization{};
+    VkPipelineMultisampleStateCreateInfo multisample{};
+    VkPipelineColorBlendStateCreateInfo color_blend{};     // pAttachments is ignored, blend_attachments is used
+    std::vector<VkPipelineColorBlendAttachmentState> blend_attachments;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+    std::vector<VkDynamicState> dynamic_states;
+    std::vector<uniform_buffer_decl> descriptor_decls;
+    std::vector<specialization_constant> specialization_constants;  // given to every stage, ids a stage doesn't declare are ignored
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+    uint32_t subpass = 0;
+};
+
+// the bytes of everything that affects the pipeline, equal keys make identical pipelines
+std::string get_pipeline_state_key(const pipeline_state& state);
+
+struct compute_pipeline_state {
+    shader_stage_decl shader_stage;
+    std::vector<uniform_buffer_decl> descriptor_decls;
+    std::vector<specialization_constant> specialization_constants;
+};
+
+std::string get_compute_pipeline_state_key(const compute_pipeline_state& state);
+
+struct pipeline_layout_entry {
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> set_layouts;     // indexed by set
+};
+
+/*
+ * owns every pipeline, pipeline layout, descriptor set layout and shader module. equal states
+ * are created once and shared, pipelines can be compiled on worker threads ahead of time or
+ * asynchronously when first asked for. objects live until their render pass is released
+ * (swapchain recreation) or the registry is terminated
+ */
+class pipeline_registry
 {
 private:
-    VkRenderPass render_pass;
-    std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
-    void clear_shader_stages(vulkan_data& data);
+    struct pipeline_entry {
+        pipeline_state state;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        bool ready = false;
+        bool compiling = false;
+        std::exception_ptr error = nullptr;
+    };
+
+    std::mutex mutex;
+    std::condition_variable compiled;
+    thread_pool pool;
+    // keyed by the state's bytes, not a hash of them, so a lookup never returns another state's object
+    std::unordered_map<std::string, std::unique_ptr<pipeline_entry>> pipelines;
+    std::unordered_map<std::string, VkPipeline> compute_pipelines;
+    std::unordered_map<std::string, pipeline_layout_entry> layouts;
+    std::unordered_map<std::string, VkDescriptorSetLayout> set_layouts;
+    std::unordered_map<std::string, VkShaderModule> shader_modules;
+
+    VkShaderModule get_shader_module(vulkan_data& vkdata, const std::string& path);
+    pipeline_entry* find_or_insert(const pipeline_state& state);
+    void compile(vulkan_data& vkdata, pipeline_entry& entry);
+    void wait_for(std::unique_lock<std::mutex>& lock, pipeline_entry& entry);
+
+public:
+    // thread_count of 0 uses the hardware concurrency
+    void initialise(vulkan_data& vkdata, uint32_t thread_count = 0);
+    void terminate(vulkan_data& vkdata);
+
+    // one layout per distinct set of descriptor declarations, created immediately
+    pipeline_layout_entry get_layout(vulkan_data& vkdata, std::vector<uniform_buffer_decl> decls);
+
+    // blocks until the pipeline for state exists, compiling it on this thread if nobody else is
+    VkPipeline get(vulkan_data& vkdata, const pipeline_state& state);
+    // queues the pipeline on the workers if needed, VK_NULL_HANDLE until it is ready
+    VkPipeline get_async(vulkan_data& vkdata, const pipeline_state& state);
+    // compiles a known list of permutations in parallel and waits for them
+    void warm_up(vulkan_data& vkdata, const std::vector<pipeline_state>& states);
 
+    // compute pipelines don't depend on a render pass, they live until terminate
+    VkPipeline get_compute(vulkan_data& vkdata, const compute_pipeline_state& state);
+
+    // destroys the pipelines built for render_pass, the device must be idle
+    void release_render_pass(vulkan_data& vkdata, VkRenderPass render_pass);
+};
+
+class graphics_pipeline
+{
+private:
     std::vector<uniform_buffer_decl> uniformBufferDecls;
-    std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
     std::vector<uniform_buffer_base*> allocated_uniform_buffers;
 
+    pipeline_state state;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+    std::unordered_map<uint64_t, VkPipeline> specialized_pipelines;
+
     void initialise_routine(vulkan_data& vkdata, VkRenderPass input_render_pass);
     void terminate_routine(vulkan_data& vkdata);
 
 protected:
-    VkPipeline pipeline;
-    VkPipelineLayout layout;
-
-
     static VkDescriptorSetLayoutBinding create_descriptor_set_binding(uint32_t binding, VkDescriptorType descriptor_type, VkShaderStageFlags stages);
 
     virtual void gen_vertex_input_info(
@@ -241,19 +420,449 @@ protected:
     virtual VkPipelineRasterizationStateCreateInfo gen_rasterization_state_info(vulkan_data& data);
     virtual VkPipelineMultisampleStateCreateInfo gen_multisampling_state_info(vulkan_data& data);
     virtual VkPipelineColorBlendStateCreateInfo gen_color_blend_state(vulkan_data& data, std::vector<VkPipelineColorBlendAttachmentState>& attachment_states);
+    virtual VkPipelineDepthStencilStateCreateInfo gen_depth_stencil_state_info(vulkan_data& data);
     virtual std::vector<VkDynamicState> gen_dynamic_state_info(vulkan_data& data);
-    virtual std::vector<VkPipelineShaderStageCreateInfo> load_shader_stage_infos(vulkan_data& data);
+    virtual std::vector<shader_stage_decl> get_shader_stage_declarations();
     virtual std::vector<uniform_buffer_decl> get_uniform_buffer_declarations();
+    virtual std::vector<specialization_constant> get_specialization_constants();
+
+    // this pipeline's state with other specialization constants, and depth_stencil if given
+    pipeline_state get_specialized_state(const std::vector<specialization_constant>& constants,
+                                         const VkPipelineDepthStencilStateCreateInfo* depth_stencil = nullptr) const;
+    // this pipeline with other specialization constants, key identifies the set of constants and
+    // depth_stencil if given. compiled on the registry's workers, get_pipeline() is returned until it is
+    // ready. with depth_stencil it is compiled on this thread instead, get_pipeline() can't stand in for it
+    VkPipeline get_specialized_pipeline(vulkan_data& vkdata, uint64_t key, const std::vector<specialization_constant>& constants,
+                                        const VkPipelineDepthStencilStateCreateInfo* depth_stencil = nullptr);
 
 public:
+    // compile through the registry's workers instead of blocking initialise, fallback is
+    // bound until the pipeline is ready and must use the same descriptor declarations
+    bool compile_async = false;
+    graphics_pipeline* fallback = nullptr;
+    // depth was laid down by a depth pre-pass, only fragments equal to it are shaded and none write depth
+    bool after_depth_prepass = false;
+
     void initialise(vulkan_data& vkdata, VkRenderPass input_render_pass);
     void terminate(vulkan_data& data);
     void reinitialise(vulkan_data& vkdata, VkRenderPass input_render_pass);
     void reterminate(vulkan_data& vkdata);
 
-    VkPipeline& get_pipeline(vulkan_data& vkdata);
-    VkPipelineLayout& get_pipeline_layout();
+    // the state this pipeline would be built from, used to list permutations for warm up
+    pipeline_state describe(vulkan_data& vkdata, VkRenderPass input_render_pass);
+
+    VkPipeline get_pipeline(vulkan_data& vkdata);
+    VkPipelineLayout get_pipeline_layout();
     VkDescriptorSetLayout get_descriptor_set_layout(size_t set);
+    VkRenderPass get_render_pass() const;
+};
+
+
+/* compute pipeline, descriptors are declared the same way as for graphics_pipeline */
+class compute_pipeline
+{
+private:
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
+
+protected:
+    virtual shader_stage_decl get_shader_stage_declaration() = 0;
+    virtual std::vector<uniform_buffer_decl> get_uniform_buffer_declarations();
+    virtual std::vector<specialization_constant> get_specialization_constants();
+
+public:
+    void initialise(vulkan_data& vkdata);
+    void terminate(vulkan_data& vkdata);
+
+    VkPipeline get_pipeline() const;
+    VkPipelineLayout get_pipeline_layout() const;
+    VkDescriptorSetLayout get_descriptor_set_layout(size_t set) const;
+};
+
+// a buffer or image a dispatch reads or writes, storage images are expected in VK_IMAGE_LAYOUT_GENERAL
+struct compute_access {
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    bool write = false;
+};
+
+inline compute_access read_buffer_access(VkBuffer buffer) { return {buffer, VK_NULL_HANDLE, false}; }
+inline compute_access write_buffer_access(VkBuffer buffer) { return {buffer, VK_NULL_HANDLE, true}; }
+inline compute_access read_image_access(VkImage image) { return {VK_NULL_HANDLE, image, false}; }
+inline compute_access write_image_access(VkImage image) { return {VK_NULL_HANDLE, image, true}; }
+
+/*
+ * records dispatches into a command buffer, tracking what each one reads and writes. a barrier
+ * is only recorded before a dispatch that depends on an earlier one since the last barrier:
+ * reading or writing what it wrote needs a memory barrier, writing what it only read needs
+ * an execution barrier. independent dispatches run back to back, redundant binds are skipped
+ */
+class dispatch_batch
+{
+private:
+    VkCommandBuffer cmd = VK_NULL_HANDLE;
+    vulkan_capture* capture = nullptr;
+    VkPipeline bound_pipeline = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> bound_sets;
+    std::vector<compute_access> written;        // since the last barrier
+    std::vector<compute_access> read;
+    bool has_writes = false;                    // since begin, for end()'s barrier
+    uint32_t dispatches = 0;
+    uint32_t barriers = 0;
+
+    static bool contains(const std::vector<compute_access>& accesses, const compute_access& access);
+
+public:
+    // pass vkdata.capture for the batch to show up in captures
+    void begin(VkCommandBuffer command_buffer, vulkan_capture* capture = nullptr);
+    void dispatch(const compute_pipeline& pipeline, const std::vector<VkDescriptorSet>& descriptor_sets,
+                  uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z,
+                  const std::vector<compute_access>& accesses);
+    // makes the batch's writes visible to the stages consuming them, e.g. vertex input or fragment sampling.
+    // no dst_stages records nothing, for callers that order the writes against their consumers themselves
+    void end(VkPipelineStageFlags dst_stages = 0, VkAccessFlags dst_access = 0);
+
+    uint32_t dispatch_count() const;
+    uint32_t barrier_count() const;
+};
+
+
+/* gpu frame timer */
+
+/*
+ * times whole frames on the gpu, a timestamp pair per frame in flight. nothing waits on the
+ * results, a frame's time is read once the gpu is done with it, usually MAX_FRAMES_IN_FLIGHT later
+ */
+class gpu_frame_timer
+{
+private:
+    // one more than the frames in flight, so a slot is only reused once its frame's fence was waited on
+    static constexpr uint32_t SLOT_COUNT = MAX_FRAMES_IN_FLIGHT + 1;
+
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    double tick_ns = 0.0;
+    uint64_t valid_mask = 0;
+    std::array<bool, SLOT_COUNT> submitted{};
+    std::array<uint64_t, SLOT_COUNT> frames{};     // frame_number that wrote each slot
+    double last_ms = -1.0;
+    uint64_t last_frame = 0;
+
+    uint32_t get_slot(const vulkan_data& vkdata) const;
+
+public:
+    // without timestamp support on the graphics queue the timer does nothing
+    void initialise(vulkan_data& vkdata);
+    void terminate(vulkan_data& vkdata);
+    bool is_supported() const;
+
+    // once per frame before recording, true when an earlier frame's time was read back
+    bool update(vulkan_data& vkdata);
+    // first and last commands of every command buffer recorded this frame, outside render passes
+    void begin(vulkan_data& vkdata, VkCommandBuffer cmd);
+    void end(vulkan_data& vkdata, VkCommandBuffer cmd);
+
+    // the latest gpu frame time read back, negative before the first
+    double get_last_time_ms() const;
+    // vkdata.frame_number of the frame that time was measured on
+    uint64_t get_last_frame() const;
+};
+
+
+// what the gpu did inside a region, all zero without pipeline statistics support
+struct gpu_pipeline_stats {
+    uint64_t input_vertices = 0;
+    uint64_t input_primitives = 0;
+    uint64_t vertex_invocations = 0;
+    uint64_t clipping_primitives = 0;
+    uint64_t fragment_invocations = 0;
+    uint64_t compute_invocations = 0;
+};
+
+struct gpu_region_stats {
+    std::string name;
+    double average_ms = 0.0;        // over the last average_window frames the region ran in
+    double last_ms = 0.0;
+    gpu_pipeline_stats last_stats;
+};
+
+/*
+ * timestamps named regions of a frame, the render graph wraps each of its passes in one. every
+ * frame gets its own queries and they are read MAX_FRAMES_IN_FLIGHT + 1 frames later, when the
+ * frame's fence has already been waited on, so nothing stalls. results are kept as rolling
+ * averages per region name and, while trace is set, as events for a chrome://tracing json file
+ */
+class gpu_profiler
+{
+private:
+    static constexpr uint32_t SLOT_COUNT = MAX_FRAMES_IN_FLIGHT + 1;
+
+    struct region_record {
+        std::string name;
+        bool statistics;
+    };
+
+    struct frame_slot {
+        std::vector<region_record> regions;
+        bool submitted = false;
+        uint64_t frame = 0;
+    };
+
+    struct region_history {
+        std::string name;
+        std::deque<double> times;
+        double sum = 0.0;
+        double last_ms = 0.0;
+        gpu_pipeline_stats last_stats;
+    };
+
+    struct trace_event {
+        uint32_t region;            // into history
+        uint64_t frame;
+        double start_us;
+        double duration_us;
+        gpu_pipeline_stats stats;
+        bool has_stats;
+    };
+
+    VkQueryPool timestamp_pool = VK_NULL_HANDLE;
+    VkQueryPool statistics_pool = VK_NULL_HANDLE;
+    uint32_t max_regions = 0;
+    double tick_ns = 0.0;
+    uint64_t valid_mask = 0;
+    std::array<frame_slot, SLOT_COUNT> slots;
+    std::vector<uint32_t> open_regions;     // of the frame being recorded
+    bool statistics_open = false;
+
+    std::vector<region_history> history;
+    std::unordered_map<std::string, uint32_t> history_index;
+    std::vector<trace_event> events;
+    uint64_t trace_origin = UINT64_MAX;     // ticks of the first region read back
+    uint64_t dropped_frames = 0;
+
+    uint32_t get_slot(const vulkan_data& vkdata) const;
+    void read_slot(vulkan_data& vkdata, frame_slot& slot, uint32_t slot_index);
+
+public:
+    uint32_t average_window = 60;
+    bool trace = false;
+    size_t max_trace_events = 1 << 20;      // later events are dropped
+
+    // without timestamp support on the graphics queue the profiler does nothing
+    void initialise(vulkan_data& vkdata, uint32_t region_capacity = 64);
+    void terminate(vulkan_data& vkdata);
+    bool is_supported() const;
+
+    // once per frame before recording, reads back the oldest frame's regions
+    void update(vulkan_data& vkdata);
+    // first command of every command buffer recorded this frame, outside render passes
+    void begin_frame(vulkan_data& vkdata, VkCommandBuffer cmd);
+    // regions nest and have to be closed in the order they were opened, outside render passes.
+    // statistics are only gathered for one region at a time. UINT32_MAX when out of queries
+    uint32_t begin_region(vulkan_data& vkdata, VkCommandBuffer cmd, const std::string& name, bool statistics = false);
+    void end_region(vulkan_data& vkdata, VkCommandBuffer cmd, uint32_t region);
+
+    // in the order the regions were first seen
+    std::vector<gpu_region_stats> get_region_stats() const;
+    uint64_t get_dropped_frames() const;
+    // every event gathered while trace was set, throws when the file can't be written
+    void write_chrome_trace(const std::string& path) const;
+};
+
+
+/* render graph */
+
+// handles into a render_graph, valid until it is terminated
+typedef uint32_t render_graph_resource;
+typedef uint32_t render_graph_pass;
+
+enum class render_graph_pass_type {
+    GRAPHICS, COMPUTE, TRANSFER
+};
+
+// how a pass uses an image, decides the layout, stages and access the graph synchronises
+enum class render_graph_usage {
+    COLOR_ATTACHMENT,
+    DEPTH_ATTACHMENT,
+    DEPTH_READ,             // depth tested against but not written
+    RESOLVE_ATTACHMENT,     // the pass's color attachments resolve into these, in declaration order
+    SAMPLED,
+    STORAGE_READ,
+    STORAGE_WRITE,
+    TRANSFER_SRC,           // copies and blits, transfer passes only
+    TRANSFER_DST
+};
+
+// transient images are the swapchain extent times scale unless width and height are set
+struct render_graph_image_desc {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    float scale = 1.0f;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // keeps its contents from one frame to the next (history buffers), never aliased and can be
+    // read before it is written. undefined on the first frame after a compile, see has_history
+    bool persistent = false;
+};
+
+struct render_graph_context {
+    VkCommandBuffer cmd;
+    uint32_t image_index;
+    VkRenderPass render_pass;       // begun by the graph, VK_NULL_HANDLE for compute and transfer passes
+    VkExtent2D extent;              // of the pass's attachments
+};
+
+struct render_graph_stats {
+    uint32_t pass_count = 0;
+    uint32_t culled_pass_count = 0;
+    uint32_t barrier_count = 0;             // image barriers recorded per frame
+    VkDeviceSize transient_bytes = 0;       // the transient images unaliased
+    VkDeviceSize allocated_bytes = 0;       // what they take once aliased
+};
+
+/*
+ * the frame as a list of passes declaring which images they read and write. compile() culls
+ * passes nothing written to an output depends on, works out the barriers and layout transitions
+ * between the remaining passes and places transient images whose lifetimes don't overlap in the
+ * same memory. passes run in declaration order.
+ *
+ * declarations are fixed by the first compile so render passes (and the pipelines built for
+ * them) survive swapchain recreation, recompiling only rebuilds images and framebuffers
+ */
+class render_graph
+{
+public:
+    typedef std::function<void(vulkan_data&, const render_graph_context&)> record_function;
+
+private:
+    struct image_use {
+        render_graph_resource resource;
+        render_graph_usage usage;
+        bool clear = false;
+        VkClearValue clear_value = {};
+        VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        VkAttachmentStoreOp store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    };
+
+    struct image_barrier {
+        render_graph_resource resource;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+        VkAccessFlags src_access;
+        VkAccessFlags dst_access;
+        bool history = false;       // from last frame's layout, UNDEFINED on the first frame
+    };
+
+    // recorded as one vkCmdPipelineBarrier, stages without barriers are an execution dependency
+    struct barrier_batch {
+        VkPipelineStageFlags src_stages = 0;
+        VkPipelineStageFlags dst_stages = 0;
+        std::vector<image_barrier> barriers;
+    };
+
+    struct pass_entry {
+        std::string name;
+        render_graph_pass_type type;
+        record_function record;
+        std::vector<image_use> uses;
+        bool live = false;
+        barrier_batch before;
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        std::vector<VkFramebuffer> frame_buffers;   // one per swapchain image when it uses the backbuffer
+        std::vector<VkClearValue> clear_values;
+        VkExtent2D extent = {};
+        VkExtent2D render_area = {};                // 0 x 0 for the whole extent
+    };
+
+    struct resource_entry {
+        std::string name;
+        render_graph_image_desc desc;
+        bool backbuffer = false;
+        bool output = false;
+        // worked out by compile
+        VkImageUsageFlags usage = 0;
+        uint32_t first_pass = UINT32_MAX;
+        uint32_t last_pass = 0;
+        uint32_t slot = UINT32_MAX;
+        VkExtent2D extent = {};
+        VkMemoryRequirements requirements = {};
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView image_view = VK_NULL_HANDLE;
+    };
+
+    // memory shared by transient images with disjoint lifetimes
+    struct memory_slot {
+        VkMemoryRequirements requirements = {};
+        std::vector<render_graph_resource> resources;
+        bool persistent = false;    // holds a single persistent image
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags write_access = 0;
+        VmaAllocation allocation = VK_NULL_HANDLE;
+    };
+
+    std::vector<pass_entry> passes;
+    std::vector<resource_entry> resources;
+    std::vector<memory_slot> slots;
+    barrier_batch present;
+    render_graph_resource backbuffer = UINT32_MAX;
+    bool planned = false;
+    bool compiled = false;
+    uint32_t generation = 0;
+    mutable uint64_t history_frame = UINT64_MAX;    // first frame executed since the compile
+    render_graph_stats stats;
+
+    void check_declarable() const;
+    void add_use(render_graph_pass pass, render_graph_resource resource, render_graph_usage usage, bool write);
+    void plan(vulkan_data& vkdata);
+    void create_render_pass(vulkan_data& vkdata, pass_entry& pass);
+    void create_images(vulkan_data& vkdata);
+    void alias_memory(vulkan_data& vkdata);
+    void create_frame_buffers(vulkan_data& vkdata);
+    void build_barriers(vulkan_data& vkdata);
+    void record_barriers(vulkan_data& vkdata, VkCommandBuffer cmd, uint32_t image_index, const barrier_batch& batch, bool first_frame) const;
+
+public:
+    render_graph_resource create_image(const std::string& name, const render_graph_image_desc& desc);
+    // the swapchain image being rendered, presented once the graph has run
+    render_graph_resource get_backbuffer();
+    // keeps the passes writing resource alive, the backbuffer always is
+    void set_output(render_graph_resource resource);
+
+    render_graph_pass add_pass(const std::string& name, render_graph_pass_type type, record_function record);
+    void read(render_graph_pass pass, render_graph_resource resource, render_graph_usage usage);
+    // writes keep the previous contents unless cleared, resolves overwrite them
+    void write(render_graph_pass pass, render_graph_resource resource, render_graph_usage usage);
+    void clear(render_graph_pass pass, render_graph_resource resource, VkClearValue value);
+
+    // the first call fixes the declarations, later calls follow the swapchain extent
+    void compile(vulkan_data& vkdata);
+    // frees the images, memory and framebuffers, the render passes are kept for the next compile
+    void release(vulkan_data& vkdata);
+    void terminate(vulkan_data& vkdata);
+    bool is_compiled() const;
+    // changes every compile, descriptors of older generations point at destroyed images
+    uint32_t get_generation() const;
+    // whether persistent images hold what the previous frame left in them, false until a frame
+    // has been executed since the last compile
+    bool has_history(const vulkan_data& vkdata) const;
+
+    // records every live pass and leaves the backbuffer ready to present. each pass is a region
+    // of profiler when one is given
+    void execute(vulkan_data& vkdata, VkCommandBuffer cmd, uint32_t image_index, gpu_profiler* profiler = nullptr) const;
+
+    // a graphics pass only draws to the top left extent of its attachments, clamped to them. 0 x 0
+    // draws all of them. state, not a declaration, so it can change every frame without a compile
+    void set_render_area(render_graph_pass pass, VkExtent2D extent);
+
+    VkRenderPass get_render_pass(render_graph_pass pass) const;
+    std::vector<VkRenderPass> get_render_passes() const;
+    bool is_pass_live(render_graph_pass pass) const;
+    // transient images only, they change every compile so descriptors need rebuilding after one
+    VkImage get_image(render_graph_resource resource) const;
+    // for recording, the backbuffer is the swapchain image image_index
+    VkImage get_image(vulkan_data& vkdata, render_graph_resource resource, uint32_t image_index) const;
+    VkImageView get_image_view(render_graph_resource resource) const;
+    render_graph_stats get_stats() const;
 };
 
 
@@ -299,19 +908,107 @@ inline uniform_buffer_decl new_uniform_buffer_decl(uint32_t set, uint32_t bindin
 
 
 /* vulkan image */
+struct image_mip_level
+{
+    size_t offset = 0;      // byte offset of this level within the image data
+    size_t byte_size = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
 struct vulkan_image
 {
     VkImage image;
     VmaAllocation allocation;
     VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+    uint32_t mip_levels = 1;
 
     void initialise(vulkan_data& vkdata, const unsigned char* data, size_t data_length);
     void initialise(vulkan_data& vkdata, std::string abs_file_path);
+    void initialise_mips(vulkan_data& vkdata, const unsigned char* data, size_t data_length, const std::vector<image_mip_level>& levels);
+    // creates the image now, level offsets are relative to src and uploaded when the batch is submitted
+    void initialise_deferred(vulkan_data& vkdata, upload_batch& batch, const staging_region& src, const std::vector<image_mip_level>& levels);
     void initialise_default(vulkan_data& data);
     void terminate(vulkan_data& vkdata);
 
 private:
-    void initialise_with_staging_buffer(vulkan_data& data, VkBuffer* stagingBuffer, VmaAllocation* stagingAllocation, uint32_t texWidth, uint32_t texHeight);
+    void create_image(vulkan_data& vkdata, const std::vector<image_mip_level>& levels);
+    void initialise_with_staging_buffer(vulkan_data& data, VkBuffer* stagingBuffer, VmaAllocation* stagingAllocation, const std::vector<image_mip_level>& levels);
+};
+
+bool is_format_sampleable(vulkan_data& vkdata, VkFormat format);
+
+
+/* upload batch */
+
+// a slice of persistently mapped staging memory, write the source data to `data`
+struct staging_region
+{
+    unsigned char* data = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+};
+
+/*
+ * collects buffer and image uploads so they can be recorded into a single command buffer
+ * and submitted once. reserve and the copy functions are thread safe so staging memory can
+ * be filled directly from worker threads, submit must be called from one thread.
+ */
+class upload_batch
+{
+private:
+    struct staging_chunk {
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        unsigned char* mapped;
+        VkDeviceSize byte_size;
+        VkDeviceSize used;
+    };
+    struct buffer_copy {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+    struct image_copy {
+        VkBuffer src;
+        VkImage dst;
+        uint32_t mip_levels;
+        std::vector<VkBufferImageCopy> regions;
+    };
+
+    std::mutex mutex;
+    VkDeviceSize chunk_byte_size = 0;
+    VkDeviceSize staged_bytes = 0;
+    std::vector<staging_chunk> chunks;
+    std::vector<buffer_copy> buffer_copies;
+    std::vector<image_copy> image_copies;
+
+    // the in flight submission, if any
+    VkCommandBuffer submitted_cmd = VK_NULL_HANDLE;
+    VkFence submitted_fence = VK_NULL_HANDLE;
+
+    void release_submission(vulkan_data& vkdata);
+
+public:
+    void initialise(vulkan_data& vkdata, VkDeviceSize chunk_byte_size = 64 * 1024 * 1024);
+    void terminate(vulkan_data& vkdata);
+
+    staging_region reserve(vulkan_data& vkdata, VkDeviceSize byte_size, VkDeviceSize alignment = 16);
+    void copy_to_buffer(const staging_region& src, VkBuffer dst, VkDeviceSize byte_size);
+    void copy_to_image(const staging_region& src, VkImage dst, const std::vector<image_mip_level>& levels);
+
+    // records every pending copy, submits them and waits for completion
+    void submit(vulkan_data& vkdata);
+
+    /*
+     * as submit but returns straight away, poll is_complete before using the destination
+     * resources. staging memory stays allocated until the batch is terminated
+     */
+    void submit_async(vulkan_data& vkdata);
+    bool is_complete(vulkan_data& vkdata);
+    void wait(vulkan_data& vkdata);
+
+    VkDeviceSize staged_byte_size() const;
 };
 
 
@@ -328,7 +1025,7 @@ struct vulkan_sampler
 {
     VkSampler sampler;
 
-    void initialise(vulkan_data& vkdata);
+    void initialise(vulkan_data& vkdata, VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
     void terminate(vulkan_data& vkdata);
 };
 
@@ -395,7 +1092,7 @@ protected:
 
     void virtual_terminate(vulkan_data& vk_data) final {
         for (size_t i = 0; i < uniform_buffers.size(); i++) {
-            vmaDestroyBuffer(vk_data.mem_allocator, uniform_buffers[i], allocations[i]);
+            ::destroy_buffer(vk_data, uniform_buffers[i], allocations[i]);
         }
     }
 
@@ -431,6 +1128,7 @@ class sampler_uniform_buffer : public uniform_buffer_base
 private:
     vulkan_image_view image_view_data{};
     vulkan_sampler sampler_data{};
+    VkImageView external_view = VK_NULL_HANDLE;     // not owned
 
 protected:
     void virtual_initialise(vulkan_data& vk_data, uint32_t binding) final {
@@ -447,7 +1145,7 @@ protected:
         info.binding = this->uniform_binding;
 
         info.imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        info.imageInfo.imageView = this->image_view_data.imageView;
+        info.imageInfo.imageView = (this->external_view != VK_NULL_HANDLE) ? this->external_view : this->image_view_data.imageView;
         info.imageInfo.sampler = this->sampler_data.sampler;
         return info;
     }
@@ -461,7 +1159,230 @@ public:
         return this->sampler_data;
     }
 
+    // samples a view owned elsewhere instead, e.g. a render graph image. set before initialise
+    void set_image_view(VkImageView view) {
+        this->external_view = view;
+    }
+
     void update_buffer(vulkan_data& vkdata) {
         this->update_descriptor_sets(vkdata);
     }
 };
+
+
+class storage_uniform_buffer : public uniform_buffer_base
+{
+private:
+    VkBuffer buffer_data = VK_NULL_HANDLE;     // not owned
+    VkDeviceSize offset = 0;
+    VkDeviceSize range = VK_WHOLE_SIZE;
+
+protected:
+    uniform_info get_uniform_info(size_t index) final {
+        uniform_info info{};
+        info.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        info.binding = this->uniform_binding;
+
+        info.bufferInfo.buffer = this->buffer_data;
+        info.bufferInfo.offset = this->offset;
+        info.bufferInfo.range = this->range;
+        return info;
+    }
+
+public:
+    // set before initialise, or call update_buffer after changing it
+    void set_buffer(VkBuffer buffer, VkDeviceSize buffer_offset = 0, VkDeviceSize buffer_range = VK_WHOLE_SIZE) {
+        this->buffer_data = buffer;
+        this->offset = buffer_offset;
+        this->range = buffer_range;
+    }
+
+    void update_buffer(vulkan_data& vkdata) {
+        this->update_descriptor_sets(vkdata);
+    }
+};
+
+
+class storage_image_uniform_buffer : public uniform_buffer_base
+{
+private:
+    vulkan_image_view image_view_data{};
+    VkImageView external_view = VK_NULL_HANDLE;     // not owned
+
+protected:
+    void virtual_terminate(vulkan_data& data) final {
+        this->image_view_data.terminate(data);
+    }
+
+    uniform_info get_uniform_info(size_t index) final {
+        uniform_info info{};
+        info.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        info.binding = this->uniform_binding;
+
+        info.imageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        info.imageInfo.imageView = (this->external_view != VK_NULL_HANDLE) ? this->external_view : this->image_view_data.imageView;
+        info.imageInfo.sampler = VK_NULL_HANDLE;
+        return info;
+    }
+
+public:
+    inline vulkan_image_view& image_view() {
+        return this->image_view_data;
+    }
+
+    // writes a view owned elsewhere instead, e.g. a render graph image. set before initialise
+    void set_image_view(VkImageView view) {
+        this->external_view = view;
+    }
+
+    void update_buffer(vulkan_data& vkdata) {
+        this->update_descriptor_sets(vkdata);
+    }
+};
+
+
+/* vulkan capture */
+
+enum class capture_object_type {
+    BUFFER, IMAGE, IMAGE_VIEW, SAMPLER, RENDER_PASS, FRAMEBUFFER, DESCRIPTOR_SET_LAYOUT, PIPELINE_LAYOUT, PIPELINE, DESCRIPTOR_SET, COUNT
+};
+
+/*
+ * writes the vulkan calls of one frame to a file replay_capture can re-issue without the scene,
+ * window or input that produced it. objects are tracked from startup, so the buffers, images,
+ * pipelines and descriptor sets the frame uses are written ahead of it as a prologue. what they
+ * hold isn't captured, neither are uploads, queries or semaphores. every method is thread safe.
+ *
+ * commands go through CAPTURED, which hands them to the vk* method of the same name while the
+ * frame is being captured, then makes the call. objects are passed to track_* once created and
+ * to forget before they are destroyed
+ */
+class vulkan_capture
+{
+private:
+    enum class capture_state {
+        WAITING, CAPTURING, DONE
+    };
+
+    struct tracked_object {
+        uint64_t id = 0;
+        std::vector<uint8_t> packet;                            // recreates it
+        uint64_t pool = 0;                                      // descriptor sets only
+        std::map<uint64_t, std::vector<uint8_t>> descriptors;   // descriptor sets only, latest write by binding and element
+    };
+
+    std::mutex mutex;
+    std::string path;
+    std::ofstream file;                                             // opened up front so a bad path fails early
+    uint64_t frame = 0;
+    capture_state state = capture_state::WAITING;
+    uint64_t next_id = 1;
+    std::array<std::unordered_map<uint64_t, tracked_object>, static_cast<size_t>(capture_object_type::COUNT)> objects;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> pool_sets;
+    std::unordered_map<uint64_t, uint64_t> command_buffer_ids;     // of the frame being captured
+    std::vector<uint8_t> prologue;
+    std::vector<uint8_t> stream;
+    uint64_t untracked = 0;                                         // handles the frame used that were never tracked
+    size_t byte_size = 0;
+
+    tracked_object* track(capture_object_type type, uint64_t key, uint32_t op, std::vector<uint8_t> payload);
+    void forget_key(capture_object_type type, uint64_t key);
+    uint64_t get_id(capture_object_type type, uint64_t key);
+    uint64_t get_command_buffer_id(VkCommandBuffer cmd);
+    void begin_capture();
+    void finish_capture(vulkan_data& vkdata);
+
+public:
+    // captures the frame rendered once frame frames have been presented, at least 1. throws when
+    // file_path can't be opened
+    void initialise(const std::string& file_path, uint64_t capture_frame);
+    bool is_done();
+    // bytes written, 0 until done
+    size_t get_byte_size();
+
+    // at the end of present_frame, starts the capture and writes it out a frame later. throws
+    // when it can't be written, nothing is captured after that
+    void end_frame(vulkan_data& vkdata);
+
+    void track_buffer(VkBuffer buffer, const VkBufferCreateInfo& info);
+    void track_image(VkImage image, const VkImageCreateInfo& info);
+    void track_image_view(VkImageView view, const VkImageViewCreateInfo& info);
+    void track_sampler(VkSampler sampler, const VkSamplerCreateInfo& info);
+    void track_render_pass(VkRenderPass render_pass, const VkRenderPassCreateInfo& info);
+    void track_framebuffer(VkFramebuffer framebuffer, const VkFramebufferCreateInfo& info);
+    void track_descriptor_set_layout(VkDescriptorSetLayout set_layout, const VkDescriptorSetLayoutCreateInfo& info);
+    void track_pipeline_layout(VkPipelineLayout layout, const VkPipelineLayoutCreateInfo& info);
+    void track_pipeline(VkPipeline pipeline, const pipeline_state& state);
+    void track_pipeline(VkPipeline pipeline, const compute_pipeline_state& state);
+    void track_descriptor_sets(const VkDescriptorSetAllocateInfo& info, const VkDescriptorSet* sets);
+    // the sets allocated from it go with it
+    void forget_descriptor_pool(VkDescriptorPool pool);
+
+    template <typename T>
+    void forget(capture_object_type type, T handle) {
+        uint64_t key = 0;
+        std::memcpy(&key, &handle, sizeof(handle));
+        this->forget_key(type, key);
+    }
+
+    void vkUpdateDescriptorSets(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet* writes, uint32_t copyCount, const VkCopyDescriptorSet* copies);
+    void vkBeginCommandBuffer(VkCommandBuffer cmd, const VkCommandBufferBeginInfo* info);
+    void vkEndCommandBuffer(VkCommandBuffer cmd);
+    void vkCmdBeginRenderPass(VkCommandBuffer cmd, const VkRenderPassBeginInfo* info, VkSubpassContents contents);
+    void vkCmdEndRenderPass(VkCommandBuffer cmd);
+    void vkCmdBindPipeline(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipeline pipeline);
+    void vkCmdBindDescriptorSets(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t firstSet,
+                                 uint32_t setCount, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets);
+    void vkCmdBindVertexBuffers(VkCommandBuffer cmd, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers, const VkDeviceSize* offsets);
+    void vkCmdBindIndexBuffer(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType);
+    void vkCmdSetViewport(VkCommandBuffer cmd, uint32_t firstViewport, uint32_t viewportCount, const VkViewport* viewports);
+    void vkCmdSetScissor(VkCommandBuffer cmd, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* scissors);
+    void vkCmdDraw(VkCommandBuffer cmd, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+    void vkCmdDrawIndexed(VkCommandBuffer cmd, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance);
+    void vkCmdDispatch(VkCommandBuffer cmd, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ);
+    void vkCmdPipelineBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+                              uint32_t memoryBarrierCount, const VkMemoryBarrier* memoryBarriers,
+                              uint32_t bufferBarrierCount, const VkBufferMemoryBarrier* bufferBarriers,
+                              uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers);
+    void vkCmdCopyImage(VkCommandBuffer cmd, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout,
+                        uint32_t regionCount, const VkImageCopy* regions);
+    void vkCmdBlitImage(VkCommandBuffer cmd, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout,
+                        uint32_t regionCount, const VkImageBlit* regions, VkFilter filter);
+    void vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence);
+};
+
+// records call into capture (a vulkan_capture*, may be null) then makes it, arguments are evaluated twice
+#define CAPTURED(capture, call, ...) ((((capture) != nullptr) ? (capture)->call(__VA_ARGS__) : (void)0), ::call(__VA_ARGS__))
+
+enum class capture_backend {
+    NONE,       // decodes and counts every packet, no device needed
+    DEVICE      // re-issued on a headless device against stand-ins for the captured objects
+};
+
+struct capture_replay_stats {
+    uint32_t width = 0;                     // of the captured frame
+    uint32_t height = 0;
+    size_t byte_size = 0;
+    uint64_t prologue_objects = 0;
+    // per iteration
+    uint64_t frame_objects = 0;             // created by the frame, destroyed once it is replayed
+    uint64_t commands = 0;
+    uint64_t draws = 0;
+    uint64_t dispatches = 0;
+    uint64_t barriers = 0;
+    uint64_t pipeline_binds = 0;
+    uint64_t redundant_pipeline_binds = 0;  // of the pipeline already bound in the command buffer
+    uint64_t descriptor_set_binds = 0;      // sets, not calls
+    uint64_t redundant_descriptor_set_binds = 0;
+    uint64_t descriptor_writes = 0;
+    uint64_t submits = 0;
+    uint64_t skipped = 0;                   // packets using objects the capture doesn't have
+    double load_ms = 0.0;                   // reading and splitting up the file
+    double setup_ms = 0.0;                  // creating the prologue's objects
+    std::vector<double> replay_ms;          // per iteration, everything but the submits
+    std::vector<double> submit_ms;
+    std::vector<double> wait_ms;            // for the gpu once submitted
+};
+
+// replays the frame in a capture iterations times, throws when the file can't be read
+capture_replay_stats replay_capture(const std::string& file_path, capture_backend backend, uint32_t iterations);
@@ -47,6 +47,14 @@ void buffer_base::initialise_static(vulkan_data& data, VkBufferUsageFlagBits usa
     vmaDestroyBuffer(data.mem_allocator, staging_buffer, staging_allocation);
 }
 
+void buffer_base::initialise_static_deferred(vulkan_data& data, upload_batch& batch, VkBufferUsageFlagBits usage, const staging_region& src, size_t byte_size)
+{
+    this->is_static = true;
+    this->max_byte_size = byte_size;
+    ::create_buffer(data, &buffer, &allocation, byte_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage, VMA_MEMORY_USAGE_GPU_ONLY);
+    batch.copy_to_buffer(src, buffer, byte_size);
+}
+
 void buffer_base::initialise_dynamic(vulkan_data& data, VkBufferUsageFlagBits usage, size_t byte_size)
 {
     this->is_static = false;
@@ -57,7 +65,7 @@ void buffer_base::initialise_dynamic(vulkan_data& data, VkBufferUsageFlagBits us
 void buffer_base::terminate(vulkan_data& data)
 {
     vkDeviceWaitIdle(data.logical_device);
-    vmaDestroyBuffer(data.mem_allocator, buffer, allocation);
+    ::destroy_buffer(data, buffer, allocation);
 }
 
 bool buffer_base::fill_buffer(vulkan_data& vkdata, void* data, size_t byte_size)
@@ -80,3 +88,26 @@ VkBuffer buffer_base::get_vk_buffer() const {
 size_t buffer_base::byte_size() const {
     return this->max_byte_size;
 }
+
+
+size_t get_index_size(VkIndexType type)
+{
+    return (type == VK_INDEX_TYPE_UINT16) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+void static_index_buffer::initialise(vulkan_data& data, upload_batch& batch, const staging_region& src, size_t index_count, VkIndexType type)
+{
+    this->count = index_count;
+    this->index_type = type;
+    this->initialise_static_deferred(data, batch, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, src, index_count * get_index_size(type));
+}
+
+size_t static_index_buffer::get_count() const
+{
+    return this->count;
+}
+
+VkIndexType static_index_buffer::get_index_type() const
+{
+    return this->index_type;
+}
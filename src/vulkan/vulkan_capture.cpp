@@ -0,0 +1,763 @@
+#include "vulkan_base.h"
+#include "vulkan_capture_format.h"
+
+#include <algorithm>
+
+template <typename T>
+static uint64_t get_key(T handle)
+{
+    uint64_t key = 0;
+    std::memcpy(&key, &handle, sizeof(handle));
+    return key;
+}
+
+void vulkan_capture::initialise(const std::string& file_path, uint64_t capture_frame)
+{
+    if (capture_frame == 0) {
+        throw std::logic_error("the first frame can't be captured, it starts before any frame is presented!");
+    }
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->file.open(file_path, std::ios::binary | std::ios::trunc);
+    if (!this->file) {
+        throw std::runtime_error("failed to open capture " + file_path + "!");
+    }
+    this->path = file_path;
+    this->frame = capture_frame;
+    this->state = capture_state::WAITING;
+}
+
+bool vulkan_capture::is_done()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->state == capture_state::DONE;
+}
+
+size_t vulkan_capture::get_byte_size()
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    return this->byte_size;
+}
+
+/* objects */
+
+vulkan_capture::tracked_object* vulkan_capture::track(capture_object_type type, uint64_t key, uint32_t op, std::vector<uint8_t> payload)
+{
+    // ids are never reused, a handle can be once what it referred to is destroyed
+    capture_writer packet;
+    packet.put(this->next_id);
+    packet.bytes.insert(packet.bytes.end(), payload.begin(), payload.end());
+
+    tracked_object object;
+    object.id = this->next_id++;
+    packet.put_packet(static_cast<capture_op>(op), object.packet);
+    if (this->state == capture_state::CAPTURING) {
+        this->stream.insert(this->stream.end(), object.packet.begin(), object.packet.end());
+    }
+    auto& slot = this->objects[static_cast<size_t>(type)][key];
+    slot = std::move(object);
+    return &slot;
+}
+
+void vulkan_capture::forget_key(capture_object_type type, uint64_t key)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto& objects = this->objects[static_cast<size_t>(type)];
+    auto it = objects.find(key);
+    if (it == objects.end()) {
+        return;
+    }
+    if (this->state == capture_state::CAPTURING) {
+        capture_writer payload;
+        payload.put(it->second.id);
+        payload.put_packet(capture_op::DESTROY, this->stream);
+    }
+    objects.erase(it);
+}
+
+uint64_t vulkan_capture::get_id(capture_object_type type, uint64_t key)
+{
+    if (key == 0) {
+        return 0;
+    }
+    auto& objects = this->objects[static_cast<size_t>(type)];
+    auto it = objects.find(key);
+    if (it == objects.end()) {
+        this->untracked++;
+        return 0;
+    }
+    return it->second.id;
+}
+
+void vulkan_capture::track_buffer(VkBuffer buffer, const VkBufferCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(info.size);
+    payload.put(info.usage);
+    this->track(capture_object_type::BUFFER, get_key(buffer), static_cast<uint32_t>(capture_op::BUFFER), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_image(VkImage image, const VkImageCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    VkImageCreateInfo stored = info;
+    stored.pNext = nullptr;
+    stored.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    stored.queueFamilyIndexCount = 0;
+    stored.pQueueFamilyIndices = nullptr;
+    capture_writer payload;
+    payload.put_raw(stored);
+    this->track(capture_object_type::IMAGE, get_key(image), static_cast<uint32_t>(capture_op::IMAGE), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_image_view(VkImageView view, const VkImageViewCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_id(capture_object_type::IMAGE, get_key(info.image)));
+    payload.put(info.viewType);
+    payload.put(info.format);
+    payload.put_raw(info.components);
+    payload.put_raw(info.subresourceRange);
+    this->track(capture_object_type::IMAGE_VIEW, get_key(view), static_cast<uint32_t>(capture_op::IMAGE_VIEW), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_sampler(VkSampler sampler, const VkSamplerCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    VkSamplerCreateInfo stored = info;
+    stored.pNext = nullptr;
+    capture_writer payload;
+    payload.put_raw(stored);
+    this->track(capture_object_type::SAMPLER, get_key(sampler), static_cast<uint32_t>(capture_op::SAMPLER), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_render_pass(VkRenderPass render_pass, const VkRenderPassCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    payload.put_raw_array(info.pAttachments, info.attachmentCount);
+    payload.put(info.subpassCount);
+    for (uint32_t i = 0; i < info.subpassCount; i++) {
+        auto& subpass = info.pSubpasses[i];
+        payload.put(subpass.pipelineBindPoint);
+        payload.put_raw_array(subpass.pInputAttachments, subpass.inputAttachmentCount);
+        payload.put_raw_array(subpass.pColorAttachments, subpass.colorAttachmentCount);
+        // resolves are either absent or one per color attachment
+        payload.put_raw_array(subpass.pResolveAttachments, subpass.pResolveAttachments != nullptr ? subpass.colorAttachmentCount : 0);
+        payload.put_raw_array(subpass.pDepthStencilAttachment, subpass.pDepthStencilAttachment != nullptr ? 1 : 0);
+        payload.put_raw_array(subpass.pPreserveAttachments, subpass.preserveAttachmentCount);
+    }
+    payload.put_raw_array(info.pDependencies, info.dependencyCount);
+    this->track(capture_object_type::RENDER_PASS, get_key(render_pass), static_cast<uint32_t>(capture_op::RENDER_PASS), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_framebuffer(VkFramebuffer framebuffer, const VkFramebufferCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_id(capture_object_type::RENDER_PASS, get_key(info.renderPass)));
+    payload.put(info.attachmentCount);
+    for (uint32_t i = 0; i < info.attachmentCount; i++) {
+        payload.put(this->get_id(capture_object_type::IMAGE_VIEW, get_key(info.pAttachments[i])));
+    }
+    payload.put(info.width);
+    payload.put(info.height);
+    payload.put(info.layers);
+    this->track(capture_object_type::FRAMEBUFFER, get_key(framebuffer), static_cast<uint32_t>(capture_op::FRAMEBUFFER), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_descriptor_set_layout(VkDescriptorSetLayout set_layout, const VkDescriptorSetLayoutCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    // immutable samplers aren't kept, the engine has none
+    capture_writer payload;
+    payload.put(info.bindingCount);
+    for (uint32_t i = 0; i < info.bindingCount; i++) {
+        auto& binding = info.pBindings[i];
+        payload.put(binding.binding);
+        payload.put(binding.descriptorType);
+        payload.put(binding.descriptorCount);
+        payload.put(binding.stageFlags);
+    }
+    this->track(capture_object_type::DESCRIPTOR_SET_LAYOUT, get_key(set_layout), static_cast<uint32_t>(capture_op::DESCRIPTOR_SET_LAYOUT),
+                std::move(payload.bytes));
+}
+
+void vulkan_capture::track_pipeline_layout(VkPipelineLayout layout, const VkPipelineLayoutCreateInfo& info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(info.setLayoutCount);
+    for (uint32_t i = 0; i < info.setLayoutCount; i++) {
+        payload.put(this->get_id(capture_object_type::DESCRIPTOR_SET_LAYOUT, get_key(info.pSetLayouts[i])));
+    }
+    payload.put_raw_array(info.pPushConstantRanges, info.pushConstantRangeCount);
+    this->track(capture_object_type::PIPELINE_LAYOUT, get_key(layout), static_cast<uint32_t>(capture_op::PIPELINE_LAYOUT), std::move(payload.bytes));
+}
+
+static void put_shader_stage(capture_writer& payload, const shader_stage_decl& stage)
+{
+    payload.put_string(stage.path);
+    payload.put(static_cast<uint32_t>(stage.type));
+    payload.put_string(stage.entry_point);
+}
+
+static void put_layout_state(capture_writer& payload, const std::vector<uniform_buffer_decl>& decls, const std::vector<specialization_constant>& constants)
+{
+    payload.put(decls.size());
+    for (auto& decl : decls) {
+        payload.put(decl.set);
+        payload.put(decl.binding);
+        payload.put(decl.type);
+        payload.put(decl.shaderFlags);
+    }
+    payload.put(constants.size());
+    for (auto& constant : constants) {
+        payload.put(constant.id);
+        payload.put(constant.value);
+    }
+}
+
+// the replayer builds it through its own registry from the same state
+void vulkan_capture::track_pipeline(VkPipeline pipeline, const pipeline_state& state)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(state.shader_stages.size());
+    for (auto& stage : state.shader_stages) {
+        put_shader_stage(payload, stage);
+    }
+    payload.put_raw_array(state.vertex_bindings.data(), static_cast<uint32_t>(state.vertex_bindings.size()));
+    payload.put_raw_array(state.vertex_attributes.data(), static_cast<uint32_t>(state.vertex_attributes.size()));
+    auto input_assembly = state.input_assembly;
+    input_assembly.pNext = nullptr;
+    payload.put_raw(input_assembly);
+    payload.put_raw_array(state.viewports.data(), static_cast<uint32_t>(state.viewports.size()));
+    payload.put_raw_array(state.scissors.data(), static_cast<uint32_t>(state.scissors.size()));
+
+    auto rasterization = state.rasterization;
+    rasterization.pNext = nullptr;
+    payload.put_raw(rasterization);
+    auto multisample = state.multisample;
+    multisample.pNext = nullptr;
+    multisample.pSampleMask = nullptr;
+    payload.put_raw(multisample);
+    auto color_blend = state.color_blend;
+    color_blend.pNext = nullptr;
+    color_blend.pAttachments = nullptr;
+    payload.put_raw(color_blend);
+    payload.put_raw_array(state.blend_attachments.data(), static_cast<uint32_t>(state.blend_attachments.size()));
+    auto depth_stencil = state.depth_stencil;
+    depth_stencil.pNext = nullptr;
+    payload.put_raw(depth_stencil);
+    payload.put_raw_array(state.dynamic_states.data(), static_cast<uint32_t>(state.dynamic_states.size()));
+
+    put_layout_state(payload, state.descriptor_decls, state.specialization_constants);
+    payload.put(this->get_id(capture_object_type::RENDER_PASS, get_key(state.render_pass)));
+    payload.put(state.subpass);
+    this->track(capture_object_type::PIPELINE, get_key(pipeline), static_cast<uint32_t>(capture_op::GRAPHICS_PIPELINE), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_pipeline(VkPipeline pipeline, const compute_pipeline_state& state)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    capture_writer payload;
+    put_shader_stage(payload, state.shader_stage);
+    put_layout_state(payload, state.descriptor_decls, state.specialization_constants);
+    this->track(capture_object_type::PIPELINE, get_key(pipeline), static_cast<uint32_t>(capture_op::COMPUTE_PIPELINE), std::move(payload.bytes));
+}
+
+void vulkan_capture::track_descriptor_sets(const VkDescriptorSetAllocateInfo& info, const VkDescriptorSet* sets)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    uint64_t pool = get_key(info.descriptorPool);
+    for (uint32_t i = 0; i < info.descriptorSetCount; i++) {
+        capture_writer payload;
+        payload.put(this->get_id(capture_object_type::DESCRIPTOR_SET_LAYOUT, get_key(info.pSetLayouts[i])));
+        auto object = this->track(capture_object_type::DESCRIPTOR_SET, get_key(sets[i]), static_cast<uint32_t>(capture_op::DESCRIPTOR_SET),
+                                  std::move(payload.bytes));
+        object->pool = pool;
+        this->pool_sets[pool].push_back(get_key(sets[i]));
+    }
+}
+
+void vulkan_capture::forget_descriptor_pool(VkDescriptorPool pool)
+{
+    std::vector<uint64_t> sets;
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        auto it = this->pool_sets.find(get_key(pool));
+        if (it == this->pool_sets.end()) {
+            return;
+        }
+        sets = std::move(it->second);
+        this->pool_sets.erase(it);
+    }
+    for (uint64_t set : sets) {
+        this->forget_key(capture_object_type::DESCRIPTOR_SET, set);
+    }
+}
+
+/* commands */
+
+uint64_t vulkan_capture::get_command_buffer_id(VkCommandBuffer cmd)
+{
+    return this->command_buffer_ids.emplace(get_key(cmd), this->command_buffer_ids.size() + 1).first->second;
+}
+
+// descriptor contents are tracked all the time, the prologue writes every set's latest
+void vulkan_capture::vkUpdateDescriptorSets(VkDevice device, uint32_t writeCount, const VkWriteDescriptorSet* writes,
+                                            uint32_t copyCount, const VkCopyDescriptorSet* copies)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::DONE) {
+        return;
+    }
+    auto& sets = this->objects[static_cast<size_t>(capture_object_type::DESCRIPTOR_SET)];
+    for (uint32_t w = 0; w < writeCount; w++) {
+        auto& write = writes[w];
+        auto set = sets.find(get_key(write.dstSet));
+        if (set == sets.end()) {
+            this->untracked++;
+            continue;
+        }
+        for (uint32_t i = 0; i < write.descriptorCount; i++) {
+            capture_writer payload;
+            payload.put(set->second.id);
+            payload.put(write.dstBinding);
+            payload.put(write.dstArrayElement + i);
+            payload.put(write.descriptorType);
+            switch (write.descriptorType) {
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+                case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                    payload.put(this->get_id(capture_object_type::BUFFER, get_key(write.pBufferInfo[i].buffer)));
+                    payload.put(write.pBufferInfo[i].offset);
+                    payload.put(write.pBufferInfo[i].range);
+                    break;
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                    payload.put(this->get_id(capture_object_type::SAMPLER, get_key(write.pImageInfo[i].sampler)));
+                    payload.put(this->get_id(capture_object_type::IMAGE_VIEW, get_key(write.pImageInfo[i].imageView)));
+                    payload.put(write.pImageInfo[i].imageLayout);
+                    break;
+                default:
+                    // texel buffers, the engine has none
+                    this->untracked++;
+                    continue;
+            }
+
+            auto& packet = set->second.descriptors[(static_cast<uint64_t>(write.dstBinding) << 32) | (write.dstArrayElement + i)];
+            packet.clear();
+            payload.put_packet(capture_op::DESCRIPTOR_WRITE, packet);
+            if (this->state == capture_state::CAPTURING) {
+                this->stream.insert(this->stream.end(), packet.begin(), packet.end());
+            }
+        }
+    }
+    if (copyCount > 0) {
+        this->untracked += copyCount;
+    }
+}
+
+void vulkan_capture::vkBeginCommandBuffer(VkCommandBuffer cmd, const VkCommandBufferBeginInfo* info)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(info->flags);
+    payload.put_packet(capture_op::BEGIN_COMMAND_BUFFER, this->stream);
+}
+
+void vulkan_capture::vkEndCommandBuffer(VkCommandBuffer cmd)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put_packet(capture_op::END_COMMAND_BUFFER, this->stream);
+}
+
+void vulkan_capture::vkCmdBeginRenderPass(VkCommandBuffer cmd, const VkRenderPassBeginInfo* info, VkSubpassContents contents)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(this->get_id(capture_object_type::RENDER_PASS, get_key(info->renderPass)));
+    payload.put(this->get_id(capture_object_type::FRAMEBUFFER, get_key(info->framebuffer)));
+    payload.put_raw(info->renderArea);
+    payload.put_raw_array(info->pClearValues, info->clearValueCount);
+    payload.put(contents);
+    payload.put_packet(capture_op::BEGIN_RENDER_PASS, this->stream);
+}
+
+void vulkan_capture::vkCmdEndRenderPass(VkCommandBuffer cmd)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put_packet(capture_op::END_RENDER_PASS, this->stream);
+}
+
+void vulkan_capture::vkCmdBindPipeline(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipeline pipeline)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(bind_point);
+    payload.put(this->get_id(capture_object_type::PIPELINE, get_key(pipeline)));
+    payload.put_packet(capture_op::BIND_PIPELINE, this->stream);
+}
+
+void vulkan_capture::vkCmdBindDescriptorSets(VkCommandBuffer cmd, VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t firstSet,
+                                             uint32_t setCount, const VkDescriptorSet* sets, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(bind_point);
+    payload.put(this->get_id(capture_object_type::PIPELINE_LAYOUT, get_key(layout)));
+    payload.put(firstSet);
+    payload.put(setCount);
+    for (uint32_t i = 0; i < setCount; i++) {
+        payload.put(this->get_id(capture_object_type::DESCRIPTOR_SET, get_key(sets[i])));
+    }
+    payload.put(dynamicOffsetCount);
+    for (uint32_t i = 0; i < dynamicOffsetCount; i++) {
+        payload.put(dynamicOffsets[i]);
+    }
+    payload.put_packet(capture_op::BIND_DESCRIPTOR_SETS, this->stream);
+}
+
+void vulkan_capture::vkCmdBindVertexBuffers(VkCommandBuffer cmd, uint32_t firstBinding, uint32_t bindingCount, const VkBuffer* buffers,
+                                            const VkDeviceSize* offsets)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(firstBinding);
+    payload.put(bindingCount);
+    for (uint32_t i = 0; i < bindingCount; i++) {
+        payload.put(this->get_id(capture_object_type::BUFFER, get_key(buffers[i])));
+        payload.put(offsets[i]);
+    }
+    payload.put_packet(capture_op::BIND_VERTEX_BUFFERS, this->stream);
+}
+
+void vulkan_capture::vkCmdBindIndexBuffer(VkCommandBuffer cmd, VkBuffer buffer, VkDeviceSize offset, VkIndexType indexType)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(this->get_id(capture_object_type::BUFFER, get_key(buffer)));
+    payload.put(offset);
+    payload.put(indexType);
+    payload.put_packet(capture_op::BIND_INDEX_BUFFER, this->stream);
+}
+
+void vulkan_capture::vkCmdSetViewport(VkCommandBuffer cmd, uint32_t firstViewport, uint32_t viewportCount, const VkViewport* viewports)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(firstViewport);
+    payload.put_raw_array(viewports, viewportCount);
+    payload.put_packet(capture_op::SET_VIEWPORT, this->stream);
+}
+
+void vulkan_capture::vkCmdSetScissor(VkCommandBuffer cmd, uint32_t firstScissor, uint32_t scissorCount, const VkRect2D* scissors)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(firstScissor);
+    payload.put_raw_array(scissors, scissorCount);
+    payload.put_packet(capture_op::SET_SCISSOR, this->stream);
+}
+
+void vulkan_capture::vkCmdDraw(VkCommandBuffer cmd, uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(vertexCount);
+    payload.put(instanceCount);
+    payload.put(firstVertex);
+    payload.put(firstInstance);
+    payload.put_packet(capture_op::DRAW, this->stream);
+}
+
+void vulkan_capture::vkCmdDrawIndexed(VkCommandBuffer cmd, uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
+                                      uint32_t firstInstance)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(indexCount);
+    payload.put(instanceCount);
+    payload.put(firstIndex);
+    payload.put_signed(vertexOffset);
+    payload.put(firstInstance);
+    payload.put_packet(capture_op::DRAW_INDEXED, this->stream);
+}
+
+void vulkan_capture::vkCmdDispatch(VkCommandBuffer cmd, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(groupCountX);
+    payload.put(groupCountY);
+    payload.put(groupCountZ);
+    payload.put_packet(capture_op::DISPATCH, this->stream);
+}
+
+void vulkan_capture::vkCmdPipelineBarrier(VkCommandBuffer cmd, VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+                                          VkDependencyFlags dependencyFlags,
+                                          uint32_t memoryBarrierCount, const VkMemoryBarrier* memoryBarriers,
+                                          uint32_t bufferBarrierCount, const VkBufferMemoryBarrier* bufferBarriers,
+                                          uint32_t imageBarrierCount, const VkImageMemoryBarrier* imageBarriers)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(srcStageMask);
+    payload.put(dstStageMask);
+    payload.put(dependencyFlags);
+    payload.put(memoryBarrierCount);
+    for (uint32_t i = 0; i < memoryBarrierCount; i++) {
+        payload.put(memoryBarriers[i].srcAccessMask);
+        payload.put(memoryBarriers[i].dstAccessMask);
+    }
+    payload.put(bufferBarrierCount);
+    for (uint32_t i = 0; i < bufferBarrierCount; i++) {
+        auto& b = bufferBarriers[i];
+        payload.put(b.srcAccessMask);
+        payload.put(b.dstAccessMask);
+        payload.put(b.srcQueueFamilyIndex);
+        payload.put(b.dstQueueFamilyIndex);
+        payload.put(this->get_id(capture_object_type::BUFFER, get_key(b.buffer)));
+        payload.put(b.offset);
+        payload.put(b.size);
+    }
+    payload.put(imageBarrierCount);
+    for (uint32_t i = 0; i < imageBarrierCount; i++) {
+        auto& b = imageBarriers[i];
+        payload.put(b.srcAccessMask);
+        payload.put(b.dstAccessMask);
+        payload.put(b.oldLayout);
+        payload.put(b.newLayout);
+        payload.put(b.srcQueueFamilyIndex);
+        payload.put(b.dstQueueFamilyIndex);
+        payload.put(this->get_id(capture_object_type::IMAGE, get_key(b.image)));
+        payload.put_raw(b.subresourceRange);
+    }
+    payload.put_packet(capture_op::PIPELINE_BARRIER, this->stream);
+}
+
+void vulkan_capture::vkCmdCopyImage(VkCommandBuffer cmd, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout,
+                                    uint32_t regionCount, const VkImageCopy* regions)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(this->get_id(capture_object_type::IMAGE, get_key(srcImage)));
+    payload.put(srcLayout);
+    payload.put(this->get_id(capture_object_type::IMAGE, get_key(dstImage)));
+    payload.put(dstLayout);
+    payload.put_raw_array(regions, regionCount);
+    payload.put_packet(capture_op::COPY_IMAGE, this->stream);
+}
+
+void vulkan_capture::vkCmdBlitImage(VkCommandBuffer cmd, VkImage srcImage, VkImageLayout srcLayout, VkImage dstImage, VkImageLayout dstLayout,
+                                    uint32_t regionCount, const VkImageBlit* regions, VkFilter filter)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(this->get_command_buffer_id(cmd));
+    payload.put(this->get_id(capture_object_type::IMAGE, get_key(srcImage)));
+    payload.put(srcLayout);
+    payload.put(this->get_id(capture_object_type::IMAGE, get_key(dstImage)));
+    payload.put(dstLayout);
+    payload.put_raw_array(regions, regionCount);
+    payload.put(filter);
+    payload.put_packet(capture_op::BLIT_IMAGE, this->stream);
+}
+
+// semaphores and fences are left out, the replayer waits for each frame as a whole
+void vulkan_capture::vkQueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state != capture_state::CAPTURING) {
+        return;
+    }
+    capture_writer payload;
+    payload.put(submitCount);
+    for (uint32_t s = 0; s < submitCount; s++) {
+        payload.put(submits[s].commandBufferCount);
+        for (uint32_t i = 0; i < submits[s].commandBufferCount; i++) {
+            payload.put(this->get_command_buffer_id(submits[s].pCommandBuffers[i]));
+        }
+    }
+    payload.put_packet(capture_op::QUEUE_SUBMIT, this->stream);
+}
+
+/* the capture */
+
+// every live object in the order they were created, so anything one refers to comes before it,
+// then the descriptor sets' contents
+void vulkan_capture::begin_capture()
+{
+    std::vector<const tracked_object*> live;
+    for (auto& objects : this->objects) {
+        for (auto& object : objects) {
+            live.push_back(&object.second);
+        }
+    }
+    std::sort(live.begin(), live.end(), [](const tracked_object* a, const tracked_object* b) {
+        return a->id < b->id;
+    });
+
+    this->prologue.clear();
+    for (auto object : live) {
+        this->prologue.insert(this->prologue.end(), object->packet.begin(), object->packet.end());
+    }
+    for (auto object : live) {
+        for (auto& descriptor : object->descriptors) {
+            this->prologue.insert(this->prologue.end(), descriptor.second.begin(), descriptor.second.end());
+        }
+    }
+    capture_writer().put_packet(capture_op::PROLOGUE_END, this->prologue);
+
+    this->stream.clear();
+    this->command_buffer_ids.clear();
+    this->untracked = 0;
+    this->state = capture_state::CAPTURING;
+}
+
+void vulkan_capture::finish_capture(vulkan_data& vkdata)
+{
+    capture_writer header;
+    header.bytes.insert(header.bytes.end(), CAPTURE_MAGIC, CAPTURE_MAGIC + 4);
+    header.put(CAPTURE_VERSION);
+    header.put(vkdata.swap_chain_data.extent.width);
+    header.put(vkdata.swap_chain_data.extent.height);
+    header.put(vkdata.swap_chain_data.images.size());
+    header.put(vkdata.swap_chain_data.image_format);
+    header.put(this->untracked);
+
+    this->file.write(reinterpret_cast<const char*>(header.bytes.data()), static_cast<std::streamsize>(header.bytes.size()));
+    this->file.write(reinterpret_cast<const char*>(this->prologue.data()), static_cast<std::streamsize>(this->prologue.size()));
+    this->file.write(reinterpret_cast<const char*>(this->stream.data()), static_cast<std::streamsize>(this->stream.size()));
+    this->file.close();
+    bool written = !this->file.fail();
+
+    // nothing is tracked once done, written or not
+    this->byte_size = written ? header.bytes.size() + this->prologue.size() + this->stream.size() : 0;
+    for (auto& objects : this->objects) {
+        objects.clear();
+    }
+    this->pool_sets.clear();
+    this->command_buffer_ids.clear();
+    std::vector<uint8_t>().swap(this->prologue);
+    std::vector<uint8_t>().swap(this->stream);
+    this->state = capture_state::DONE;
+    if (!written) {
+        throw std::runtime_error("failed to write capture " + this->path + "!");
+    }
+}
+
+void vulkan_capture::end_frame(vulkan_data& vkdata)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    if (this->state == capture_state::WAITING && vkdata.frame_number >= this->frame) {
+        this->begin_capture();
+    } else if (this->state == capture_state::CAPTURING) {
+        this->finish_capture(vkdata);
+    }
+}
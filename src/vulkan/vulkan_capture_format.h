@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*
+ * the capture file shared by vulkan_capture and replay_capture. a header, then packets of
+ * [op][payload byte size][payload] with every integer a LEB128 varint, so ids and small counts
+ * take a byte or two. vulkan structs without pointers (viewports, copy regions, clear values,
+ * attachment descriptions) are stored as their bytes, create infos with their pointers cleared,
+ * so a capture only replays on the platform and byte order it was made on
+ */
+
+#define CAPTURE_MAGIC "DCAP"
+#define CAPTURE_VERSION 1
+#define CAPTURE_EXTENSION ".dcap"
+
+enum class capture_op : uint32_t {
+    // objects, the payload starts with the id every later packet refers to them by
+    BUFFER = 1,
+    IMAGE,
+    IMAGE_VIEW,
+    SAMPLER,
+    RENDER_PASS,
+    FRAMEBUFFER,
+    DESCRIPTOR_SET_LAYOUT,
+    PIPELINE_LAYOUT,
+    GRAPHICS_PIPELINE,
+    COMPUTE_PIPELINE,
+    DESCRIPTOR_SET,
+    DESTROY,
+    DESCRIPTOR_WRITE,
+    // everything before it existed when the frame began, everything after is the frame
+    PROLOGUE_END,
+
+    // commands, the payload starts with the command buffer's id
+    BEGIN_COMMAND_BUFFER = 32,
+    END_COMMAND_BUFFER,
+    BEGIN_RENDER_PASS,
+    END_RENDER_PASS,
+    BIND_PIPELINE,
+    BIND_DESCRIPTOR_SETS,
+    BIND_VERTEX_BUFFERS,
+    BIND_INDEX_BUFFER,
+    SET_VIEWPORT,
+    SET_SCISSOR,
+    DRAW,
+    DRAW_INDEXED,
+    DISPATCH,
+    PIPELINE_BARRIER,
+    COPY_IMAGE,
+    BLIT_IMAGE,
+
+    QUEUE_SUBMIT = 64
+};
+
+class capture_writer
+{
+public:
+    std::vector<uint8_t> bytes;
+
+    void put(uint64_t value) {
+        while (value >= 0x80) {
+            this->bytes.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        this->bytes.push_back(static_cast<uint8_t>(value));
+    }
+
+    // zigzag, small negative numbers stay small
+    void put_signed(int64_t value) {
+        this->put((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void put_float(float value) {
+        this->put_raw(value);
+    }
+
+    void put_string(const std::string& value) {
+        this->put(value.size());
+        this->bytes.insert(this->bytes.end(), value.begin(), value.end());
+    }
+
+    template <typename T>
+    void put_raw(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain structs are stored as bytes");
+        auto data = reinterpret_cast<const uint8_t*>(&value);
+        this->bytes.insert(this->bytes.end(), data, data + sizeof(T));
+    }
+
+    template <typename T>
+    void put_raw_array(const T* values, uint32_t count) {
+        this->put(count);
+        for (uint32_t i = 0; i < count; i++) {
+            this->put_raw(values[i]);
+        }
+    }
+
+    // [op][size][payload] onto the end of out
+    void put_packet(capture_op op, std::vector<uint8_t>& out) const {
+        capture_writer header;
+        header.put(static_cast<uint32_t>(op));
+        header.put(this->bytes.size());
+        out.insert(out.end(), header.bytes.begin(), header.bytes.end());
+        out.insert(out.end(), this->bytes.begin(), this->bytes.end());
+    }
+};
+
+// reads what capture_writer wrote, throws on anything running past the end
+class capture_reader
+{
+private:
+    const uint8_t* pos = nullptr;
+    const uint8_t* end = nullptr;
+
+    void check(uint64_t byte_size) const {
+        if (static_cast<uint64_t>(this->end - this->pos) < byte_size) {
+            throw std::runtime_error("capture is truncated!");
+        }
+    }
+
+public:
+    capture_reader() = default;
+    capture_reader(const uint8_t* data, size_t byte_size) : pos(data), end(data + byte_size) {}
+
+    bool at_end() const {
+        return this->pos == this->end;
+    }
+
+    uint64_t get() {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            this->check(1);
+            uint8_t byte = *this->pos++;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw std::runtime_error("capture has a malformed integer!");
+    }
+
+    uint32_t get_u32() {
+        return static_cast<uint32_t>(this->get());
+    }
+
+    int64_t get_signed() {
+        uint64_t value = this->get();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    float get_float() {
+        return this->get_raw<float>();
+    }
+
+    std::string get_string() {
+        size_t size = this->get();
+        this->check(size);
+        std::string value(reinterpret_cast<const char*>(this->pos), size);
+        this->pos += size;
+        return value;
+    }
+
+    template <typename T>
+    T get_raw() {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain structs are stored as bytes");
+        this->check(sizeof(T));
+        T value;
+        std::memcpy(&value, this->pos, sizeof(T));
+        this->pos += sizeof(T);
+        return value;
+    }
+
+    template <typename T>
+    std::vector<T> get_raw_array() {
+        size_t count = this->get();
+        if (count > static_cast<size_t>(this->end - this->pos) / sizeof(T)) {
+            throw std::runtime_error("capture is truncated!");
+        }
+        std::vector<T> values(count);
+        if (count > 0) {
+            std::memcpy(values.data(), this->pos, count * sizeof(T));
+        }
+        this->pos += count * sizeof(T);
+        return values;
+    }
+
+    // the next byte_size bytes as their own reader
+    capture_reader get_bytes(size_t byte_size) {
+        this->check(byte_size);
+        capture_reader bytes(this->pos, byte_size);
+        this->pos += byte_size;
+        return bytes;
+    }
+};
@@ -0,0 +1,1285 @@
+#include "vulkan_base.h"
+#include "vulkan_capture_format.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+/*
+ * re-issues a capture's frame. the prologue's objects are created once, then every iteration
+ * records and submits the frame's command buffers, waits for them and destroys what the frame
+ * created. the stand-ins have the captured sizes, formats and layouts but not the contents,
+ * buffers are zeroed and images undefined, so what is drawn is meaningless, the work isn't
+ */
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <typename T>
+static T to_handle(uint64_t key)
+{
+    T handle;
+    std::memcpy(&handle, &key, sizeof(handle));
+    return handle;
+}
+
+template <typename T>
+static uint64_t get_key(T handle)
+{
+    uint64_t key = 0;
+    std::memcpy(&key, &handle, sizeof(handle));
+    return key;
+}
+
+// the headless device has nothing to present to
+static VkImageLayout get_replay_layout(VkImageLayout layout)
+{
+    return layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? VK_IMAGE_LAYOUT_GENERAL : layout;
+}
+
+static VkImageAspectFlags get_aspect_mask(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+static bool is_buffer_descriptor(VkDescriptorType type)
+{
+    return type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+        || type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC || type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+}
+
+struct capture_packet {
+    capture_op op;
+    capture_reader payload;
+};
+
+struct capture_file {
+    std::vector<uint8_t> bytes;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<capture_packet> prologue;
+    std::vector<capture_packet> frame;
+};
+
+static void load_capture(const std::string& file_path, capture_file& capture)
+{
+    std::ifstream file(file_path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("failed to open capture " + file_path + "!");
+    }
+    capture.bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (capture.bytes.size() < 4 || std::memcmp(capture.bytes.data(), CAPTURE_MAGIC, 4) != 0) {
+        throw std::runtime_error(file_path + " is not a capture!");
+    }
+
+    capture_reader reader(capture.bytes.data() + 4, capture.bytes.size() - 4);
+    uint64_t version = reader.get();
+    if (version != CAPTURE_VERSION) {
+        throw std::runtime_error(file_path + " is a version " + std::to_string(version) + " capture, only version "
+                                 + std::to_string(CAPTURE_VERSION) + " can be replayed!");
+    }
+    capture.width = reader.get_u32();
+    capture.height = reader.get_u32();
+    reader.get();   // swapchain image count
+    reader.get();   // swapchain format
+    reader.get();   // untracked handles
+
+    bool in_prologue = true;
+    while (!reader.at_end()) {
+        capture_packet packet;
+        packet.op = static_cast<capture_op>(reader.get_u32());
+        packet.payload = reader.get_bytes(reader.get());
+        if (packet.op == capture_op::PROLOGUE_END) {
+            in_prologue = false;
+        } else {
+            (in_prologue ? capture.prologue : capture.frame).push_back(packet);
+        }
+    }
+    if (in_prologue) {
+        throw std::runtime_error(file_path + " has no frame!");
+    }
+}
+
+/* the replayer */
+
+class capture_replayer
+{
+private:
+    struct replay_object {
+        capture_op op;
+        uint64_t handle = 0;                        // the stand-in, 0 on the null backend
+        VmaAllocation allocation = VK_NULL_HANDLE;
+        uint64_t image = 0;                         // image views, the id of their image
+        VkFormat format = VK_FORMAT_UNDEFINED;      // images
+        bool in_frame = false;
+    };
+
+    struct replay_command_buffer {
+        VkCommandBuffer cmd = VK_NULL_HANDLE;
+        bool recording = false;
+        bool in_render_pass = false;
+        std::array<uint64_t, 2> pipelines{};                // bound per bind point, graphics and compute
+        std::array<std::vector<uint64_t>, 2> sets;
+    };
+
+    capture_backend backend;
+    vulkan_data* vkdata;
+    capture_replay_stats& stats;
+    bool anisotropy = false;
+    VkCommandPool command_pool = VK_NULL_HANDLE;
+    std::unordered_map<uint64_t, replay_object> objects;
+    std::unordered_map<uint64_t, replay_command_buffer> command_buffers;
+    std::vector<uint64_t> frame_objects;                    // in the order they were created
+    std::vector<VkDescriptorPool> prologue_pools;
+    std::vector<VkDescriptorPool> frame_pools;              // reset once each iteration is done
+    size_t frame_pool = 0;
+    std::unordered_map<uint64_t, VkImageLayout> first_layouts;
+    std::vector<VkBuffer> zeroed_buffers;                   // filled once the prologue is created
+    bool in_frame = false;
+
+    bool is_device() const {
+        return this->backend == capture_backend::DEVICE;
+    }
+
+    bool has(uint64_t id) const {
+        return this->objects.count(id) != 0;
+    }
+
+    template <typename T>
+    T get(uint64_t id) const {
+        auto it = this->objects.find(id);
+        return to_handle<T>(it != this->objects.end() ? it->second.handle : 0);
+    }
+
+    replay_object& add(uint64_t id, capture_op op, uint64_t handle = 0) {
+        auto& object = this->objects[id];
+        object.op = op;
+        object.handle = handle;
+        object.in_frame = this->in_frame;
+        if (this->in_frame) {
+            this->stats.frame_objects++;
+            this->frame_objects.push_back(id);
+        } else {
+            this->stats.prologue_objects++;
+        }
+        return object;
+    }
+
+    VkDescriptorPool create_descriptor_pool() {
+        std::vector<VkDescriptorPoolSize> sizes;
+        for (VkDescriptorType type : {VK_DESCRIPTOR_TYPE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                                      VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                      VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC,
+                                      VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT}) {
+            sizes.push_back({type, 1024});
+        }
+        VkDescriptorPoolCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+        info.pPoolSizes = sizes.data();
+        info.maxSets = 1024;
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(this->vkdata->logical_device, &info, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        return pool;
+    }
+
+    // from the last pool, or a new one once it is full
+    VkDescriptorSet allocate_descriptor_set(VkDescriptorSetLayout layout) {
+        VkDescriptorSetAllocateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        info.descriptorSetCount = 1;
+        info.pSetLayouts = &layout;
+        for (uint32_t attempt = 0; attempt < 2; attempt++) {
+            if (this->in_frame) {
+                if (this->frame_pool == this->frame_pools.size()) {
+                    this->frame_pools.push_back(this->create_descriptor_pool());
+                }
+                info.descriptorPool = this->frame_pools[this->frame_pool];
+            } else {
+                if (attempt > 0 || this->prologue_pools.empty()) {
+                    this->prologue_pools.push_back(this->create_descriptor_pool());
+                }
+                info.descriptorPool = this->prologue_pools.back();
+            }
+            VkDescriptorSet set;
+            if (vkAllocateDescriptorSets(this->vkdata->logical_device, &info, &set) == VK_SUCCESS) {
+                return set;
+            }
+            if (this->in_frame) {
+                this->frame_pool++;
+            }
+        }
+        return VK_NULL_HANDLE;
+    }
+
+    void destroy_object(replay_object& object) {
+        if (!this->is_device() || object.handle == 0) {
+            return;
+        }
+        VkDevice device = this->vkdata->logical_device;
+        switch (object.op) {
+            case capture_op::BUFFER:
+                vmaDestroyBuffer(this->vkdata->mem_allocator, to_handle<VkBuffer>(object.handle), object.allocation);
+                break;
+            case capture_op::IMAGE:
+                vmaDestroyImage(this->vkdata->mem_allocator, to_handle<VkImage>(object.handle), object.allocation);
+                break;
+            case capture_op::IMAGE_VIEW:
+                vkDestroyImageView(device, to_handle<VkImageView>(object.handle), nullptr);
+                break;
+            case capture_op::SAMPLER:
+                vkDestroySampler(device, to_handle<VkSampler>(object.handle), nullptr);
+                break;
+            case capture_op::RENDER_PASS:
+                vkDestroyRenderPass(device, to_handle<VkRenderPass>(object.handle), nullptr);
+                break;
+            case capture_op::FRAMEBUFFER:
+                vkDestroyFramebuffer(device, to_handle<VkFramebuffer>(object.handle), nullptr);
+                break;
+            case capture_op::DESCRIPTOR_SET_LAYOUT:
+                vkDestroyDescriptorSetLayout(device, to_handle<VkDescriptorSetLayout>(object.handle), nullptr);
+                break;
+            case capture_op::PIPELINE_LAYOUT:
+                vkDestroyPipelineLayout(device, to_handle<VkPipelineLayout>(object.handle), nullptr);
+                break;
+            default:
+                // pipelines belong to the registry, descriptor sets to their pools
+                break;
+        }
+    }
+
+    /* objects */
+
+    void create_buffer(uint64_t id, capture_reader& payload) {
+        VkBufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        info.size = payload.get();
+        info.usage = static_cast<VkBufferUsageFlags>(payload.get()) | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        if (!this->is_device()) {
+            this->add(id, capture_op::BUFFER);
+            return;
+        }
+        if (info.size == 0) {
+            this->stats.skipped++;
+            return;
+        }
+        // the frame's own buffers are the per draw uniforms, written by the cpu
+        VmaAllocationCreateInfo alloc_info{};
+        alloc_info.usage = this->in_frame ? VMA_MEMORY_USAGE_CPU_TO_GPU : VMA_MEMORY_USAGE_GPU_ONLY;
+        VkBuffer buffer;
+        VmaAllocation allocation;
+        if (vmaCreateBuffer(this->vkdata->mem_allocator, &info, &alloc_info, &buffer, &allocation, nullptr) != VK_SUCCESS) {
+            this->stats.skipped++;
+            return;
+        }
+        if (this->in_frame) {
+            void* data;
+            if (vmaMapMemory(this->vkdata->mem_allocator, allocation, &data) == VK_SUCCESS) {
+                std::memset(data, 0, info.size);
+                vmaUnmapMemory(this->vkdata->mem_allocator, allocation);
+            }
+        } else {
+            this->zeroed_buffers.push_back(buffer);
+        }
+        this->add(id, capture_op::BUFFER, get_key(buffer)).allocation = allocation;
+    }
+
+    void create_image(uint64_t id, capture_reader& payload) {
+        auto info = payload.get_raw<VkImageCreateInfo>();
+        if (!this->is_device()) {
+            this->add(id, capture_op::IMAGE).format = info.format;
+            return;
+        }
+        info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VmaAllocationCreateInfo alloc_info{};
+        alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        VkImage image;
+        VmaAllocation allocation;
+        if (vmaCreateImage(this->vkdata->mem_allocator, &info, &alloc_info, &image, &allocation, nullptr) != VK_SUCCESS) {
+            this->stats.skipped++;
+            return;
+        }
+        auto& object = this->add(id, capture_op::IMAGE, get_key(image));
+        object.allocation = allocation;
+        object.format = info.format;
+    }
+
+    void create_image_view(uint64_t id, capture_reader& payload) {
+        VkImageViewCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        uint64_t image = payload.get();
+        info.viewType = static_cast<VkImageViewType>(payload.get());
+        info.format = static_cast<VkFormat>(payload.get());
+        info.components = payload.get_raw<VkComponentMapping>();
+        info.subresourceRange = payload.get_raw<VkImageSubresourceRange>();
+        if (!this->has(image)) {
+            this->stats.skipped++;
+            return;
+        }
+        VkImageView view = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            info.image = this->get<VkImage>(image);
+            if (vkCreateImageView(this->vkdata->logical_device, &info, nullptr, &view) != VK_SUCCESS) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::IMAGE_VIEW, get_key(view)).image = image;
+    }
+
+    void create_sampler(uint64_t id, capture_reader& payload) {
+        auto info = payload.get_raw<VkSamplerCreateInfo>();
+        VkSampler sampler = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            if (!this->anisotropy) {
+                info.anisotropyEnable = VK_FALSE;
+            }
+            if (vkCreateSampler(this->vkdata->logical_device, &info, nullptr, &sampler) != VK_SUCCESS) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::SAMPLER, get_key(sampler));
+    }
+
+    void create_render_pass(uint64_t id, capture_reader& payload) {
+        struct subpass_attachments {
+            std::vector<VkAttachmentReference> input, color, resolve, depth_stencil;
+            std::vector<uint32_t> preserve;
+        };
+
+        auto attachments = payload.get_raw_array<VkAttachmentDescription>();
+        for (auto& attachment : attachments) {
+            attachment.initialLayout = get_replay_layout(attachment.initialLayout);
+            attachment.finalLayout = get_replay_layout(attachment.finalLayout);
+        }
+        std::vector<VkSubpassDescription> subpasses(payload.get());
+        std::vector<subpass_attachments> references(subpasses.size());
+        for (size_t i = 0; i < subpasses.size(); i++) {
+            auto& refs = references[i];
+            subpasses[i].pipelineBindPoint = static_cast<VkPipelineBindPoint>(payload.get());
+            refs.input = payload.get_raw_array<VkAttachmentReference>();
+            refs.color = payload.get_raw_array<VkAttachmentReference>();
+            refs.resolve = payload.get_raw_array<VkAttachmentReference>();
+            refs.depth_stencil = payload.get_raw_array<VkAttachmentReference>();
+            refs.preserve = payload.get_raw_array<uint32_t>();
+            for (auto list : {&refs.input, &refs.color, &refs.resolve, &refs.depth_stencil}) {
+                for (auto& ref : *list) {
+                    ref.layout = get_replay_layout(ref.layout);
+                }
+            }
+            subpasses[i].inputAttachmentCount = static_cast<uint32_t>(refs.input.size());
+            subpasses[i].pInputAttachments = refs.input.data();
+            subpasses[i].colorAttachmentCount = static_cast<uint32_t>(refs.color.size());
+            subpasses[i].pColorAttachments = refs.color.data();
+            subpasses[i].pResolveAttachments = refs.resolve.empty() ? nullptr : refs.resolve.data();
+            subpasses[i].pDepthStencilAttachment = refs.depth_stencil.empty() ? nullptr : refs.depth_stencil.data();
+            subpasses[i].preserveAttachmentCount = static_cast<uint32_t>(refs.preserve.size());
+            subpasses[i].pPreserveAttachments = refs.preserve.data();
+        }
+        auto dependencies = payload.get_raw_array<VkSubpassDependency>();
+
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            VkRenderPassCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+            info.attachmentCount = static_cast<uint32_t>(attachments.size());
+            info.pAttachments = attachments.data();
+            info.subpassCount = static_cast<uint32_t>(subpasses.size());
+            info.pSubpasses = subpasses.data();
+            info.dependencyCount = static_cast<uint32_t>(dependencies.size());
+            info.pDependencies = dependencies.data();
+            if (vkCreateRenderPass(this->vkdata->logical_device, &info, nullptr, &render_pass) != VK_SUCCESS) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::RENDER_PASS, get_key(render_pass));
+    }
+
+    void create_framebuffer(uint64_t id, capture_reader& payload) {
+        uint64_t render_pass = payload.get();
+        std::vector<VkImageView> views(payload.get());
+        bool complete = this->has(render_pass);
+        for (auto& view : views) {
+            uint64_t view_id = payload.get();
+            complete &= this->has(view_id);
+            view = this->get<VkImageView>(view_id);
+        }
+        VkFramebufferCreateInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        info.width = payload.get_u32();
+        info.height = payload.get_u32();
+        info.layers = payload.get_u32();
+        if (!complete) {
+            this->stats.skipped++;
+            return;
+        }
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            info.renderPass = this->get<VkRenderPass>(render_pass);
+            info.attachmentCount = static_cast<uint32_t>(views.size());
+            info.pAttachments = views.data();
+            if (vkCreateFramebuffer(this->vkdata->logical_device, &info, nullptr, &framebuffer) != VK_SUCCESS) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::FRAMEBUFFER, get_key(framebuffer));
+    }
+
+    void create_descriptor_set_layout(uint64_t id, capture_reader& payload) {
+        std::vector<VkDescriptorSetLayoutBinding> bindings(payload.get());
+        for (auto& binding : bindings) {
+            binding.binding = payload.get_u32();
+            binding.descriptorType = static_cast<VkDescriptorType>(payload.get());
+            binding.descriptorCount = payload.get_u32();
+            binding.stageFlags = static_cast<VkShaderStageFlags>(payload.get());
+            binding.pImmutableSamplers = nullptr;
+        }
+        VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            VkDescriptorSetLayoutCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            info.bindingCount = static_cast<uint32_t>(bindings.size());
+            info.pBindings = bindings.data();
+            if (vkCreateDescriptorSetLayout(this->vkdata->logical_device, &info, nullptr, &set_layout) != VK_SUCCESS) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::DESCRIPTOR_SET_LAYOUT, get_key(set_layout));
+    }
+
+    void create_pipeline_layout(uint64_t id, capture_reader& payload) {
+        std::vector<VkDescriptorSetLayout> set_layouts(payload.get());
+        bool complete = true;
+        for (auto& set_layout : set_layouts) {
+            uint64_t layout_id = payload.get();
+            complete &= this->has(layout_id);
+            set_layout = this->get<VkDescriptorSetLayout>(layout_id);
+        }
+        auto push_constants = payload.get_raw_array<VkPushConstantRange>();
+        if (!complete) {
+            this->stats.skipped++;
+            return;
+        }
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            VkPipelineLayoutCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+            info.pSetLayouts = set_layouts.data();
+            info.pushConstantRangeCount = static_cast<uint32_t>(push_constants.size());
+            info.pPushConstantRanges = push_constants.data();
+            if (vkCreatePipelineLayout(this->vkdata->logical_device, &info, nullptr, &layout) != VK_SUCCESS) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::PIPELINE_LAYOUT, get_key(layout));
+    }
+
+    static shader_stage_decl get_shader_stage(capture_reader& payload) {
+        shader_stage_decl stage;
+        stage.path = payload.get_string();
+        stage.type = static_cast<shader_type>(payload.get());
+        stage.entry_point = payload.get_string();
+        return stage;
+    }
+
+    static void get_layout_state(capture_reader& payload, std::vector<uniform_buffer_decl>& decls, std::vector<specialization_constant>& constants) {
+        decls.resize(payload.get());
+        for (auto& decl : decls) {
+            decl.set = payload.get_u32();
+            decl.binding = payload.get_u32();
+            decl.type = static_cast<VkDescriptorType>(payload.get());
+            decl.shaderFlags = static_cast<VkShaderStageFlagBits>(payload.get());
+        }
+        constants.resize(payload.get());
+        for (auto& constant : constants) {
+            constant.id = payload.get_u32();
+            constant.value = payload.get_u32();
+        }
+    }
+
+    // built from the same shaders in res/ through the registry, which owns it
+    void create_graphics_pipeline(uint64_t id, capture_reader& payload) {
+        pipeline_state state;
+        state.shader_stages.resize(payload.get());
+        for (auto& stage : state.shader_stages) {
+            stage = get_shader_stage(payload);
+        }
+        state.vertex_bindings = payload.get_raw_array<VkVertexInputBindingDescription>();
+        state.vertex_attributes = payload.get_raw_array<VkVertexInputAttributeDescription>();
+        state.input_assembly = payload.get_raw<VkPipelineInputAssemblyStateCreateInfo>();
+        state.viewports = payload.get_raw_array<VkViewport>();
+        state.scissors = payload.get_raw_array<VkRect2D>();
+        state.rasterization = payload.get_raw<VkPipelineRasterizationStateCreateInfo>();
+        state.multisample = payload.get_raw<VkPipelineMultisampleStateCreateInfo>();
+        state.color_blend = payload.get_raw<VkPipelineColorBlendStateCreateInfo>();
+        state.blend_attachments = payload.get_raw_array<VkPipelineColorBlendAttachmentState>();
+        state.depth_stencil = payload.get_raw<VkPipelineDepthStencilStateCreateInfo>();
+        state.dynamic_states = payload.get_raw_array<VkDynamicState>();
+        get_layout_state(payload, state.descriptor_decls, state.specialization_constants);
+        uint64_t render_pass = payload.get();
+        state.subpass = payload.get_u32();
+        if (!this->has(render_pass)) {
+            this->stats.skipped++;
+            return;
+        }
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            state.render_pass = this->get<VkRenderPass>(render_pass);
+            try {
+                pipeline = this->vkdata->pipelines->get(*this->vkdata, state);
+            } catch (const std::exception&) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::GRAPHICS_PIPELINE, get_key(pipeline));
+    }
+
+    void create_compute_pipeline(uint64_t id, capture_reader& payload) {
+        compute_pipeline_state state;
+        state.shader_stage = get_shader_stage(payload);
+        get_layout_state(payload, state.descriptor_decls, state.specialization_constants);
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            try {
+                pipeline = this->vkdata->pipelines->get_compute(*this->vkdata, state);
+            } catch (const std::exception&) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::COMPUTE_PIPELINE, get_key(pipeline));
+    }
+
+    void create_descriptor_set(uint64_t id, capture_reader& payload) {
+        uint64_t layout = payload.get();
+        if (!this->has(layout)) {
+            this->stats.skipped++;
+            return;
+        }
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        if (this->is_device()) {
+            set = this->allocate_descriptor_set(this->get<VkDescriptorSetLayout>(layout));
+            if (set == VK_NULL_HANDLE) {
+                this->stats.skipped++;
+                return;
+            }
+        }
+        this->add(id, capture_op::DESCRIPTOR_SET, get_key(set));
+    }
+
+    // prologue objects stay, the frame destroying them just means it is done with them
+    void destroy(capture_reader& payload) {
+        uint64_t id = payload.get();
+        auto it = this->objects.find(id);
+        if (it == this->objects.end() || !it->second.in_frame) {
+            return;
+        }
+        this->destroy_object(it->second);
+        this->objects.erase(it);
+    }
+
+    void write_descriptor(capture_reader& payload) {
+        uint64_t set = payload.get();
+        uint32_t binding = payload.get_u32();
+        uint32_t element = payload.get_u32();
+        auto type = static_cast<VkDescriptorType>(payload.get());
+        VkDescriptorBufferInfo buffer_info{};
+        VkDescriptorImageInfo image_info{};
+        bool complete = this->has(set);
+        if (is_buffer_descriptor(type)) {
+            uint64_t buffer = payload.get();
+            buffer_info.buffer = this->get<VkBuffer>(buffer);
+            buffer_info.offset = payload.get();
+            buffer_info.range = payload.get();
+            complete &= this->has(buffer);
+        } else {
+            uint64_t sampler = payload.get();
+            uint64_t view = payload.get();
+            image_info.sampler = this->get<VkSampler>(sampler);
+            image_info.imageView = this->get<VkImageView>(view);
+            image_info.imageLayout = get_replay_layout(static_cast<VkImageLayout>(payload.get()));
+            bool needs_sampler = type == VK_DESCRIPTOR_TYPE_SAMPLER || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            bool needs_view = type != VK_DESCRIPTOR_TYPE_SAMPLER;
+            complete &= (!needs_sampler || this->has(sampler)) && (!needs_view || this->has(view));
+        }
+        if (!complete) {
+            this->stats.skipped++;
+            return;
+        }
+        this->stats.descriptor_writes++;
+        if (this->is_device()) {
+            VkWriteDescriptorSet write{};
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = this->get<VkDescriptorSet>(set);
+            write.dstBinding = binding;
+            write.dstArrayElement = element;
+            write.descriptorType = type;
+            write.descriptorCount = 1;
+            write.pBufferInfo = &buffer_info;
+            write.pImageInfo = &image_info;
+            vkUpdateDescriptorSets(this->vkdata->logical_device, 1, &write, 0, nullptr);
+        }
+    }
+
+    void create(capture_op op, capture_reader payload) {
+        if (op == capture_op::DESTROY) {
+            this->destroy(payload);
+            return;
+        }
+        if (op == capture_op::DESCRIPTOR_WRITE) {
+            this->write_descriptor(payload);
+            return;
+        }
+        uint64_t id = payload.get();
+        switch (op) {
+            case capture_op::BUFFER: this->create_buffer(id, payload); break;
+            case capture_op::IMAGE: this->create_image(id, payload); break;
+            case capture_op::IMAGE_VIEW: this->create_image_view(id, payload); break;
+            case capture_op::SAMPLER: this->create_sampler(id, payload); break;
+            case capture_op::RENDER_PASS: this->create_render_pass(id, payload); break;
+            case capture_op::FRAMEBUFFER: this->create_framebuffer(id, payload); break;
+            case capture_op::DESCRIPTOR_SET_LAYOUT: this->create_descriptor_set_layout(id, payload); break;
+            case capture_op::PIPELINE_LAYOUT: this->create_pipeline_layout(id, payload); break;
+            case capture_op::GRAPHICS_PIPELINE: this->create_graphics_pipeline(id, payload); break;
+            case capture_op::COMPUTE_PIPELINE: this->create_compute_pipeline(id, payload); break;
+            case capture_op::DESCRIPTOR_SET: this->create_descriptor_set(id, payload); break;
+            default: this->stats.skipped++; break;
+        }
+    }
+
+    /* commands */
+
+    replay_command_buffer& get_command_buffer(uint64_t id) {
+        auto& cmd = this->command_buffers[id];
+        if (this->is_device() && cmd.cmd == VK_NULL_HANDLE) {
+            VkCommandBufferAllocateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            info.commandPool = this->command_pool;
+            info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            info.commandBufferCount = 1;
+            if (vkAllocateCommandBuffers(this->vkdata->logical_device, &info, &cmd.cmd) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate command buffers!");
+            }
+        }
+        return cmd;
+    }
+
+    void bind_pipeline(replay_command_buffer& cmd, capture_reader& payload) {
+        auto bind_point = static_cast<VkPipelineBindPoint>(payload.get());
+        uint64_t pipeline = payload.get();
+        if (bind_point > VK_PIPELINE_BIND_POINT_COMPUTE || !this->has(pipeline)) {
+            this->stats.skipped++;
+            return;
+        }
+        this->stats.pipeline_binds++;
+        auto& bound = cmd.pipelines[bind_point];
+        if (bound == pipeline) {
+            this->stats.redundant_pipeline_binds++;
+        }
+        bound = pipeline;
+        if (this->is_device()) {
+            vkCmdBindPipeline(cmd.cmd, bind_point, this->get<VkPipeline>(pipeline));
+        }
+    }
+
+    void bind_descriptor_sets(replay_command_buffer& cmd, capture_reader& payload) {
+        auto bind_point = static_cast<VkPipelineBindPoint>(payload.get());
+        uint64_t layout = payload.get();
+        uint32_t first_set = payload.get_u32();
+        std::vector<uint64_t> set_ids(payload.get());
+        std::vector<VkDescriptorSet> sets(set_ids.size());
+        bool complete = bind_point <= VK_PIPELINE_BIND_POINT_COMPUTE && this->has(layout);
+        for (size_t i = 0; i < set_ids.size(); i++) {
+            set_ids[i] = payload.get();
+            complete &= this->has(set_ids[i]);
+            sets[i] = this->get<VkDescriptorSet>(set_ids[i]);
+        }
+        std::vector<uint32_t> dynamic_offsets(payload.get());
+        for (auto& offset : dynamic_offsets) {
+            offset = payload.get_u32();
+        }
+        if (!complete) {
+            this->stats.skipped++;
+            return;
+        }
+
+        // dynamic offsets make a rebind of the same set do something
+        auto& bound = cmd.sets[bind_point];
+        if (bound.size() < first_set + set_ids.size()) {
+            bound.resize(first_set + set_ids.size(), 0);
+        }
+        for (size_t i = 0; i < set_ids.size(); i++) {
+            this->stats.descriptor_set_binds++;
+            if (bound[first_set + i] == set_ids[i] && dynamic_offsets.empty()) {
+                this->stats.redundant_descriptor_set_binds++;
+            }
+            bound[first_set + i] = set_ids[i];
+        }
+        if (this->is_device()) {
+            vkCmdBindDescriptorSets(cmd.cmd, bind_point, this->get<VkPipelineLayout>(layout), first_set, static_cast<uint32_t>(sets.size()),
+                                    sets.data(), static_cast<uint32_t>(dynamic_offsets.size()), dynamic_offsets.data());
+        }
+    }
+
+    void pipeline_barrier(replay_command_buffer& cmd, capture_reader& payload) {
+        auto src_stages = static_cast<VkPipelineStageFlags>(payload.get());
+        auto dst_stages = static_cast<VkPipelineStageFlags>(payload.get());
+        auto dependency_flags = static_cast<VkDependencyFlags>(payload.get());
+        std::vector<VkMemoryBarrier> memory_barriers(payload.get());
+        for (auto& b : memory_barriers) {
+            b = {};
+            b.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            b.srcAccessMask = static_cast<VkAccessFlags>(payload.get());
+            b.dstAccessMask = static_cast<VkAccessFlags>(payload.get());
+        }
+        std::vector<VkBufferMemoryBarrier> buffer_barriers;
+        size_t count = payload.get();
+        for (size_t i = 0; i < count; i++) {
+            VkBufferMemoryBarrier b{};
+            b.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            b.srcAccessMask = static_cast<VkAccessFlags>(payload.get());
+            b.dstAccessMask = static_cast<VkAccessFlags>(payload.get());
+            b.srcQueueFamilyIndex = payload.get_u32();
+            b.dstQueueFamilyIndex = payload.get_u32();
+            uint64_t buffer = payload.get();
+            b.buffer = this->get<VkBuffer>(buffer);
+            b.offset = payload.get();
+            b.size = payload.get();
+            if (this->has(buffer)) {
+                buffer_barriers.push_back(b);
+            } else {
+                this->stats.skipped++;
+            }
+        }
+        std::vector<VkImageMemoryBarrier> image_barriers;
+        count = payload.get();
+        for (size_t i = 0; i < count; i++) {
+            VkImageMemoryBarrier b{};
+            b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            b.srcAccessMask = static_cast<VkAccessFlags>(payload.get());
+            b.dstAccessMask = static_cast<VkAccessFlags>(payload.get());
+            b.oldLayout = get_replay_layout(static_cast<VkImageLayout>(payload.get()));
+            b.newLayout = get_replay_layout(static_cast<VkImageLayout>(payload.get()));
+            b.srcQueueFamilyIndex = payload.get_u32();
+            b.dstQueueFamilyIndex = payload.get_u32();
+            uint64_t image = payload.get();
+            b.image = this->get<VkImage>(image);
+            b.subresourceRange = payload.get_raw<VkImageSubresourceRange>();
+            if (this->has(image)) {
+                image_barriers.push_back(b);
+            } else {
+                this->stats.skipped++;
+            }
+        }
+        this->stats.barriers += memory_barriers.size() + buffer_barriers.size() + image_barriers.size();
+        if (this->is_device()) {
+            vkCmdPipelineBarrier(cmd.cmd, src_stages, dst_stages, dependency_flags,
+                                 static_cast<uint32_t>(memory_barriers.size()), memory_barriers.data(),
+                                 static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                                 static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        }
+    }
+
+    void command(capture_op op, capture_reader payload) {
+        auto& cmd = this->get_command_buffer(payload.get());
+        this->stats.commands++;
+        switch (op) {
+            case capture_op::BEGIN_COMMAND_BUFFER: {
+                VkCommandBufferBeginInfo info{};
+                info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                info.flags = static_cast<VkCommandBufferUsageFlags>(payload.get());
+                cmd.recording = true;
+                cmd.in_render_pass = false;
+                cmd.pipelines = {};
+                cmd.sets[0].clear();
+                cmd.sets[1].clear();
+                if (this->is_device() && vkBeginCommandBuffer(cmd.cmd, &info) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to begin recording command buffer!");
+                }
+                return;
+            }
+            case capture_op::END_COMMAND_BUFFER:
+                if (!cmd.recording) {
+                    this->stats.skipped++;
+                    return;
+                }
+                cmd.recording = false;
+                if (this->is_device() && vkEndCommandBuffer(cmd.cmd) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to record command buffer!");
+                }
+                return;
+            default:
+                break;
+        }
+        // commands outside a command buffer being recorded have nowhere to go
+        if (!cmd.recording) {
+            this->stats.skipped++;
+            return;
+        }
+
+        switch (op) {
+            case capture_op::BEGIN_RENDER_PASS: {
+                uint64_t render_pass = payload.get();
+                uint64_t framebuffer = payload.get();
+                VkRenderPassBeginInfo info{};
+                info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                info.renderArea = payload.get_raw<VkRect2D>();
+                auto clear_values = payload.get_raw_array<VkClearValue>();
+                auto contents = static_cast<VkSubpassContents>(payload.get());
+                if (!this->has(render_pass) || !this->has(framebuffer)) {
+                    this->stats.skipped++;
+                    return;
+                }
+                cmd.in_render_pass = true;
+                if (this->is_device()) {
+                    info.renderPass = this->get<VkRenderPass>(render_pass);
+                    info.framebuffer = this->get<VkFramebuffer>(framebuffer);
+                    info.clearValueCount = static_cast<uint32_t>(clear_values.size());
+                    info.pClearValues = clear_values.data();
+                    vkCmdBeginRenderPass(cmd.cmd, &info, contents);
+                }
+                break;
+            }
+            case capture_op::END_RENDER_PASS:
+                if (!cmd.in_render_pass) {
+                    this->stats.skipped++;
+                    return;
+                }
+                cmd.in_render_pass = false;
+                if (this->is_device()) {
+                    vkCmdEndRenderPass(cmd.cmd);
+                }
+                break;
+            case capture_op::BIND_PIPELINE:
+                this->bind_pipeline(cmd, payload);
+                break;
+            case capture_op::BIND_DESCRIPTOR_SETS:
+                this->bind_descriptor_sets(cmd, payload);
+                break;
+            case capture_op::BIND_VERTEX_BUFFERS: {
+                uint32_t first_binding = payload.get_u32();
+                std::vector<VkBuffer> buffers(payload.get());
+                std::vector<VkDeviceSize> offsets(buffers.size());
+                bool complete = true;
+                for (size_t i = 0; i < buffers.size(); i++) {
+                    uint64_t buffer = payload.get();
+                    complete &= this->has(buffer);
+                    buffers[i] = this->get<VkBuffer>(buffer);
+                    offsets[i] = payload.get();
+                }
+                if (!complete) {
+                    this->stats.skipped++;
+                    return;
+                }
+                if (this->is_device()) {
+                    vkCmdBindVertexBuffers(cmd.cmd, first_binding, static_cast<uint32_t>(buffers.size()), buffers.data(), offsets.data());
+                }
+                break;
+            }
+            case capture_op::BIND_INDEX_BUFFER: {
+                uint64_t buffer = payload.get();
+                VkDeviceSize offset = payload.get();
+                auto index_type = static_cast<VkIndexType>(payload.get());
+                if (!this->has(buffer)) {
+                    this->stats.skipped++;
+                    return;
+                }
+                if (this->is_device()) {
+                    vkCmdBindIndexBuffer(cmd.cmd, this->get<VkBuffer>(buffer), offset, index_type);
+                }
+                break;
+            }
+            case capture_op::SET_VIEWPORT: {
+                uint32_t first = payload.get_u32();
+                auto viewports = payload.get_raw_array<VkViewport>();
+                if (this->is_device()) {
+                    vkCmdSetViewport(cmd.cmd, first, static_cast<uint32_t>(viewports.size()), viewports.data());
+                }
+                break;
+            }
+            case capture_op::SET_SCISSOR: {
+                uint32_t first = payload.get_u32();
+                auto scissors = payload.get_raw_array<VkRect2D>();
+                if (this->is_device()) {
+                    vkCmdSetScissor(cmd.cmd, first, static_cast<uint32_t>(scissors.size()), scissors.data());
+                }
+                break;
+            }
+            case capture_op::DRAW:
+            case capture_op::DRAW_INDEXED: {
+                uint32_t count = payload.get_u32();
+                uint32_t instance_count = payload.get_u32();
+                uint32_t first = payload.get_u32();
+                auto vertex_offset = static_cast<int32_t>(op == capture_op::DRAW_INDEXED ? payload.get_signed() : 0);
+                uint32_t first_instance = payload.get_u32();
+                // nothing to draw with when the pipeline or render pass was skipped
+                if (!cmd.in_render_pass || cmd.pipelines[VK_PIPELINE_BIND_POINT_GRAPHICS] == 0) {
+                    this->stats.skipped++;
+                    return;
+                }
+                this->stats.draws++;
+                if (!this->is_device()) {
+                    break;
+                }
+                if (op == capture_op::DRAW) {
+                    vkCmdDraw(cmd.cmd, count, instance_count, first, first_instance);
+                } else {
+                    vkCmdDrawIndexed(cmd.cmd, count, instance_count, first, vertex_offset, first_instance);
+                }
+                break;
+            }
+            case capture_op::DISPATCH: {
+                uint32_t x = payload.get_u32();
+                uint32_t y = payload.get_u32();
+                uint32_t z = payload.get_u32();
+                if (cmd.in_render_pass || cmd.pipelines[VK_PIPELINE_BIND_POINT_COMPUTE] == 0) {
+                    this->stats.skipped++;
+                    return;
+                }
+                this->stats.dispatches++;
+                if (this->is_device()) {
+                    vkCmdDispatch(cmd.cmd, x, y, z);
+                }
+                break;
+            }
+            case capture_op::PIPELINE_BARRIER:
+                this->pipeline_barrier(cmd, payload);
+                break;
+            case capture_op::COPY_IMAGE:
+            case capture_op::BLIT_IMAGE: {
+                uint64_t src = payload.get();
+                auto src_layout = get_replay_layout(static_cast<VkImageLayout>(payload.get()));
+                uint64_t dst = payload.get();
+                auto dst_layout = get_replay_layout(static_cast<VkImageLayout>(payload.get()));
+                if (op == capture_op::COPY_IMAGE) {
+                    auto regions = payload.get_raw_array<VkImageCopy>();
+                    if (this->has(src) && this->has(dst) && this->is_device()) {
+                        vkCmdCopyImage(cmd.cmd, this->get<VkImage>(src), src_layout, this->get<VkImage>(dst), dst_layout,
+                                       static_cast<uint32_t>(regions.size()), regions.data());
+                    }
+                } else {
+                    auto regions = payload.get_raw_array<VkImageBlit>();
+                    auto filter = static_cast<VkFilter>(payload.get());
+                    if (this->has(src) && this->has(dst) && this->is_device()) {
+                        vkCmdBlitImage(cmd.cmd, this->get<VkImage>(src), src_layout, this->get<VkImage>(dst), dst_layout,
+                                       static_cast<uint32_t>(regions.size()), regions.data(), filter);
+                    }
+                }
+                if (!this->has(src) || !this->has(dst)) {
+                    this->stats.skipped++;
+                }
+                break;
+            }
+            default:
+                this->stats.skipped++;
+                break;
+        }
+    }
+
+    // the time spent in vkQueueSubmit
+    double submit(capture_reader payload) {
+        double submit_ms = 0.0;
+        size_t submit_count = payload.get();
+        for (size_t s = 0; s < submit_count; s++) {
+            std::vector<VkCommandBuffer> cmds;
+            size_t count = payload.get();
+            for (size_t i = 0; i < count; i++) {
+                auto it = this->command_buffers.find(payload.get());
+                if (it == this->command_buffers.end() || it->second.recording) {
+                    this->stats.skipped++;
+                } else {
+                    cmds.push_back(it->second.cmd);
+                }
+            }
+            this->stats.submits++;
+            if (!this->is_device() || cmds.empty()) {
+                continue;
+            }
+            VkSubmitInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            info.commandBufferCount = static_cast<uint32_t>(cmds.size());
+            info.pCommandBuffers = cmds.data();
+            auto start = std::chrono::steady_clock::now();
+            if (vkQueueSubmit(this->vkdata->graphics_queue, 1, &info, VK_NULL_HANDLE) != VK_SUCCESS) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+            submit_ms += elapsed_ms(start);
+        }
+        return submit_ms;
+    }
+
+    /* setup */
+
+    // the layout each image is expected in when the frame starts: what its first barrier
+    // transitions from, or else what a descriptor reads it as
+    void find_first_layouts(const capture_file& capture) {
+        for (auto& packet : capture.frame) {
+            if (packet.op != capture_op::PIPELINE_BARRIER) {
+                continue;
+            }
+            capture_reader payload = packet.payload;
+            for (uint32_t i = 0; i < 4; i++) {
+                payload.get();  // command buffer, stages and dependency flags
+            }
+            for (size_t i = 0, count = payload.get(); i < count; i++) {
+                payload.get();
+                payload.get();
+            }
+            for (size_t i = 0, count = payload.get(); i < count; i++) {
+                for (uint32_t field = 0; field < 7; field++) {
+                    payload.get();
+                }
+            }
+            for (size_t i = 0, count = payload.get(); i < count; i++) {
+                payload.get();
+                payload.get();
+                auto old_layout = static_cast<VkImageLayout>(payload.get());
+                payload.get();
+                payload.get();
+                payload.get();
+                uint64_t image = payload.get();
+                payload.get_raw<VkImageSubresourceRange>();
+                this->first_layouts.emplace(image, get_replay_layout(old_layout));
+            }
+        }
+        for (auto& packet : capture.prologue) {
+            if (packet.op != capture_op::DESCRIPTOR_WRITE) {
+                continue;
+            }
+            capture_reader payload = packet.payload;
+            payload.get();
+            payload.get();
+            payload.get();
+            if (is_buffer_descriptor(static_cast<VkDescriptorType>(payload.get()))) {
+                continue;
+            }
+            payload.get();
+            auto view = this->objects.find(payload.get());
+            auto layout = static_cast<VkImageLayout>(payload.get());
+            if (view != this->objects.end()) {
+                this->first_layouts.emplace(view->second.image, get_replay_layout(layout));
+            }
+        }
+    }
+
+    // zeroes the prologue's buffers and puts its images in the layout the frame expects
+    void prepare_prologue_objects() {
+        VkCommandBufferAllocateInfo alloc_info{};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.commandPool = this->command_pool;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandBufferCount = 1;
+        VkCommandBuffer cmd;
+        if (vkAllocateCommandBuffers(this->vkdata->logical_device, &alloc_info, &cmd) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+        VkCommandBufferBeginInfo begin_info{};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(cmd, &begin_info);
+
+        for (VkBuffer buffer : this->zeroed_buffers) {
+            vkCmdFillBuffer(cmd, buffer, 0, VK_WHOLE_SIZE, 0);
+        }
+        std::vector<VkImageMemoryBarrier> barriers;
+        for (auto& first : this->first_layouts) {
+            auto it = this->objects.find(first.first);
+            if (it == this->objects.end() || it->second.in_frame || first.second == VK_IMAGE_LAYOUT_UNDEFINED
+                || first.second == VK_IMAGE_LAYOUT_PREINITIALIZED) {
+                continue;
+            }
+            VkImageMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = first.second;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = to_handle<VkImage>(it->second.handle);
+            barrier.subresourceRange = {get_aspect_mask(it->second.format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+            barriers.push_back(barrier);
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+                             static_cast<uint32_t>(barriers.size()), barriers.data());
+        vkEndCommandBuffer(cmd);
+
+        VkSubmitInfo submit_info{};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &cmd;
+        vkQueueSubmit(this->vkdata->graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+        vkQueueWaitIdle(this->vkdata->graphics_queue);
+        vkFreeCommandBuffers(this->vkdata->logical_device, this->command_pool, 1, &cmd);
+        this->zeroed_buffers.clear();
+    }
+
+public:
+    capture_replayer(capture_backend backend, vulkan_data* vkdata, capture_replay_stats& stats)
+        : backend(backend), vkdata(vkdata), stats(stats) {}
+
+    void initialise(const capture_file& capture) {
+        if (this->is_device()) {
+            this->anisotropy = get_device_features(*this->vkdata).samplerAnisotropy == VK_TRUE;
+            VkCommandPoolCreateInfo info{};
+            info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            info.queueFamilyIndex = this->vkdata->graphics_queue_family;
+            info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            if (vkCreateCommandPool(this->vkdata->logical_device, &info, nullptr, &this->command_pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create command pool!");
+            }
+        }
+        for (auto& packet : capture.prologue) {
+            this->create(packet.op, packet.payload);
+        }
+        this->find_first_layouts(capture);
+        if (this->is_device()) {
+            this->prepare_prologue_objects();
+        }
+    }
+
+    // the frame once, returns the time spent in vkQueueSubmit
+    double replay_frame(const capture_file& capture) {
+        double submit_ms = 0.0;
+        this->in_frame = true;
+        for (auto& packet : capture.frame) {
+            if (packet.op == capture_op::QUEUE_SUBMIT) {
+                submit_ms += this->submit(packet.payload);
+            } else if (static_cast<uint32_t>(packet.op) >= static_cast<uint32_t>(capture_op::BEGIN_COMMAND_BUFFER)) {
+                this->command(packet.op, packet.payload);
+            } else {
+                this->create(packet.op, packet.payload);
+            }
+        }
+        this->in_frame = false;
+        return submit_ms;
+    }
+
+    void wait_idle() {
+        if (this->is_device()) {
+            vkQueueWaitIdle(this->vkdata->graphics_queue);
+        }
+    }
+
+    // what the frame created and never destroyed, newest first
+    void release_frame_objects() {
+        for (auto id = this->frame_objects.rbegin(); id != this->frame_objects.rend(); ++id) {
+            auto it = this->objects.find(*id);
+            if (it != this->objects.end() && it->second.in_frame) {
+                this->destroy_object(it->second);
+                this->objects.erase(it);
+            }
+        }
+        this->frame_objects.clear();
+        if (this->is_device()) {
+            for (VkDescriptorPool pool : this->frame_pools) {
+                vkResetDescriptorPool(this->vkdata->logical_device, pool, 0);
+            }
+        }
+        this->frame_pool = 0;
+    }
+
+    void terminate() {
+        this->release_frame_objects();
+        if (!this->is_device()) {
+            return;
+        }
+        std::vector<std::pair<uint64_t, replay_object*>> live;
+        for (auto& object : this->objects) {
+            live.push_back({object.first, &object.second});
+        }
+        std::sort(live.begin(), live.end(), [](const std::pair<uint64_t, replay_object*>& a, const std::pair<uint64_t, replay_object*>& b) {
+            return a.first > b.first;
+        });
+        for (auto& object : live) {
+            this->destroy_object(*object.second);
+        }
+        this->objects.clear();
+        for (auto pools : {&this->prologue_pools, &this->frame_pools}) {
+            for (VkDescriptorPool pool : *pools) {
+                vkDestroyDescriptorPool(this->vkdata->logical_device, pool, nullptr);
+            }
+            pools->clear();
+        }
+        vkDestroyCommandPool(this->vkdata->logical_device, this->command_pool, nullptr);
+    }
+};
+
+capture_replay_stats replay_capture(const std::string& file_path, capture_backend backend, uint32_t iterations)
+{
+    capture_replay_stats stats;
+    auto start = std::chrono::steady_clock::now();
+    capture_file capture;
+    load_capture(file_path, capture);
+    stats.load_ms = elapsed_ms(start);
+    stats.width = capture.width;
+    stats.height = capture.height;
+    stats.byte_size = capture.bytes.size();
+
+    vulkan_data vkdata;
+    if (backend == capture_backend::DEVICE) {
+        initialise_vulkan_headless(&vkdata, std::max(capture.width, 1u), std::max(capture.height, 1u));
+    }
+    capture_replayer replayer(backend, &vkdata, stats);
+    try {
+        start = std::chrono::steady_clock::now();
+        replayer.initialise(capture);
+        stats.setup_ms = elapsed_ms(start);
+
+        for (uint32_t i = 0; i < iterations; i++) {
+            // the counts are per iteration, each one replays the same frame
+            stats.frame_objects = stats.commands = stats.draws = stats.dispatches = stats.barriers = 0;
+            stats.pipeline_binds = stats.redundant_pipeline_binds = stats.descriptor_set_binds = stats.redundant_descriptor_set_binds = 0;
+            stats.descriptor_writes = stats.submits = stats.skipped = 0;
+
+            start = std::chrono::steady_clock::now();
+            double submit_ms = replayer.replay_frame(capture);
+            double replay_ms = elapsed_ms(start) - submit_ms;
+            start = std::chrono::steady_clock::now();
+            replayer.wait_idle();
+            stats.wait_ms.push_back(elapsed_ms(start));
+            start = std::chrono::steady_clock::now();
+            replayer.release_frame_objects();
+            stats.replay_ms.push_back(replay_ms + elapsed_ms(start));
+            stats.submit_ms.push_back(submit_ms);
+        }
+    } catch (...) {
+        if (backend == capture_backend::DEVICE) {
+            vkDeviceWaitIdle(vkdata.logical_device);
+            replayer.terminate();
+            terminate_vulkan(vkdata);
+        }
+        throw;
+    }
+    if (backend == capture_backend::DEVICE) {
+        vkDeviceWaitIdle(vkdata.logical_device);
+        replayer.terminate();
+        terminate_vulkan(vkdata);
+    }
+    return stats;
+}
@@ -16,7 +16,7 @@ void graphics_command_buffer::initialise(vulkan_data& data)
 
 void graphics_command_buffer::reinitialise(vulkan_data& data)
 {
-    this->command_buffers.resize(data.swap_chain_data.frame_buffers.size());
+    this->command_buffers.resize(data.swap_chain_data.images.size());
 
     /* allocate command buffers */
     VkCommandBufferAllocateInfo allocInfo = {};
@@ -36,14 +36,14 @@ void graphics_command_buffer::reinitialise(vulkan_data& data)
         beginInfo.flags = this->flags; // Optional
         beginInfo.pInheritanceInfo = nullptr; // Optional
 
-        if (vkBeginCommandBuffer(this->command_buffers[i], &beginInfo) != VK_SUCCESS) {
+        if (CAPTURED(data.capture, vkBeginCommandBuffer, this->command_buffers[i], &beginInfo) != VK_SUCCESS) {
             throw std::runtime_error("failed to begin recording command buffer!");
         }
 
         this->current_index = static_cast<uint32_t>(i);
         this->fill_command_buffer(data, i);
 
-        if (vkEndCommandBuffer(this->command_buffers[i]) != VK_SUCCESS) {
+        if (CAPTURED(data.capture, vkEndCommandBuffer, this->command_buffers[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to record command buffer!");
         }
     }
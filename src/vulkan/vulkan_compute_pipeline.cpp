@@ -0,0 +1,163 @@
+#include "vulkan_base.h"
+
+#include <algorithm>
+
+/* compute pipeline */
+
+std::vector<uniform_buffer_decl> compute_pipeline::get_uniform_buffer_declarations()
+{
+    return {};
+}
+
+std::vector<specialization_constant> compute_pipeline::get_specialization_constants()
+{
+    return {};
+}
+
+void compute_pipeline::initialise(vulkan_data& vkdata)
+{
+    compute_pipeline_state state;
+    state.shader_stage = this->get_shader_stage_declaration();
+    if (state.shader_stage.type != shader_type::COMPUTE) {
+        throw std::logic_error("compute pipelines need a compute shader stage!");
+    }
+    state.descriptor_decls = this->get_uniform_buffer_declarations();
+    state.specialization_constants = this->get_specialization_constants();
+
+    // layouts and pipeline are shared through the registry like graphics pipelines
+    auto layout_entry = vkdata.pipelines->get_layout(vkdata, state.descriptor_decls);
+    this->layout = layout_entry.layout;
+    this->descriptor_set_layouts = layout_entry.set_layouts;
+    this->pipeline = vkdata.pipelines->get_compute(vkdata, state);
+}
+
+void compute_pipeline::terminate(vulkan_data& vkdata)
+{
+    // the registry owns the vulkan objects
+    this->pipeline = VK_NULL_HANDLE;
+    this->layout = VK_NULL_HANDLE;
+    this->descriptor_set_layouts.clear();
+}
+
+VkPipeline compute_pipeline::get_pipeline() const
+{
+    return this->pipeline;
+}
+
+VkPipelineLayout compute_pipeline::get_pipeline_layout() const
+{
+    return this->layout;
+}
+
+VkDescriptorSetLayout compute_pipeline::get_descriptor_set_layout(size_t set) const
+{
+    return this->descriptor_set_layouts[set];
+}
+
+
+/* dispatch batch */
+
+bool dispatch_batch::contains(const std::vector<compute_access>& accesses, const compute_access& access)
+{
+    return std::any_of(accesses.begin(), accesses.end(), [&](const compute_access& other) {
+        return (access.buffer != VK_NULL_HANDLE && other.buffer == access.buffer) ||
+               (access.image != VK_NULL_HANDLE && other.image == access.image);
+    });
+}
+
+void dispatch_batch::begin(VkCommandBuffer command_buffer, vulkan_capture* capture)
+{
+    this->cmd = command_buffer;
+    this->capture = capture;
+    this->bound_pipeline = VK_NULL_HANDLE;
+    this->bound_sets.clear();
+    this->written.clear();
+    this->read.clear();
+    this->has_writes = false;
+    this->dispatches = 0;
+    this->barriers = 0;
+}
+
+void dispatch_batch::dispatch(const compute_pipeline& pipeline, const std::vector<VkDescriptorSet>& descriptor_sets,
+                              uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z,
+                              const std::vector<compute_access>& accesses)
+{
+    /* find what this dispatch depends on since the last barrier */
+    bool memory_dependency = false;
+    bool execution_dependency = false;
+    for (auto& access : accesses) {
+        if (contains(this->written, access)) {
+            memory_dependency = true;                           // read after write, write after write
+        } else if (access.write && contains(this->read, access)) {
+            execution_dependency = true;                        // write after read
+        }
+    }
+
+    if (memory_dependency || execution_dependency) {
+        // one global barrier covers every resource, cheaper than per resource barriers on current drivers.
+        // any pending write is made visible too, even for a write after read, since both lists are cleared
+        bool flush_writes = !this->written.empty();
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        CAPTURED(this->capture, vkCmdPipelineBarrier, this->cmd,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                 flush_writes ? 1 : 0, flush_writes ? &barrier : nullptr,
+                 0, nullptr, 0, nullptr);
+        this->written.clear();
+        this->read.clear();
+        this->barriers++;
+    }
+
+    for (auto& access : accesses) {
+        if (access.write) {
+            this->written.push_back(access);
+            this->has_writes = true;
+        } else {
+            this->read.push_back(access);
+        }
+    }
+
+    /* bind only what changed */
+    if (pipeline.get_pipeline() != this->bound_pipeline) {
+        CAPTURED(this->capture, vkCmdBindPipeline, this->cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.get_pipeline());
+        this->bound_pipeline = pipeline.get_pipeline();
+        this->bound_sets.clear();
+    }
+    if (!descriptor_sets.empty() && descriptor_sets != this->bound_sets) {
+        CAPTURED(this->capture, vkCmdBindDescriptorSets, this->cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.get_pipeline_layout(),
+                 0, static_cast<uint32_t>(descriptor_sets.size()), descriptor_sets.data(),
+                 0, nullptr);
+        this->bound_sets = descriptor_sets;
+    }
+
+    CAPTURED(this->capture, vkCmdDispatch, this->cmd, group_count_x, group_count_y, group_count_z);
+    this->dispatches++;
+}
+
+void dispatch_batch::end(VkPipelineStageFlags dst_stages, VkAccessFlags dst_access)
+{
+    if (this->has_writes && dst_stages != 0) {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = dst_access;
+        CAPTURED(this->capture, vkCmdPipelineBarrier, this->cmd,
+                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dst_stages, 0,
+                 1, &barrier, 0, nullptr, 0, nullptr);
+        this->barriers++;
+    }
+    this->cmd = VK_NULL_HANDLE;
+    this->capture = nullptr;
+}
+
+uint32_t dispatch_batch::dispatch_count() const
+{
+    return this->dispatches;
+}
+
+uint32_t dispatch_batch::barrier_count() const
+{
+    return this->barriers;
+}
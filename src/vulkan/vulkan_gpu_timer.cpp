@@ -0,0 +1,401 @@
+#include "vulkan_base.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+// false when the graphics queue can't write timestamps, otherwise the mask of their valid bits and the tick length
+static bool get_timestamp_support(vulkan_data& vkdata, uint64_t* valid_mask, double* tick_ns)
+{
+    uint32_t family_count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(vkdata.physical_device, &family_count, nullptr);
+    std::vector<VkQueueFamilyProperties> families(family_count);
+    vkGetPhysicalDeviceQueueFamilyProperties(vkdata.physical_device, &family_count, families.data());
+
+    uint32_t valid_bits = families.at(vkdata.graphics_queue_family).timestampValidBits;
+    if (valid_bits == 0) {
+        return false;
+    }
+    *valid_mask = (valid_bits >= 64) ? UINT64_MAX : ((uint64_t(1) << valid_bits) - 1);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(vkdata.physical_device, &properties);
+    *tick_ns = properties.limits.timestampPeriod;
+    return true;
+}
+
+/* gpu frame timer */
+
+void gpu_frame_timer::initialise(vulkan_data& vkdata)
+{
+    if (!get_timestamp_support(vkdata, &this->valid_mask, &this->tick_ns)) {
+        return;
+    }
+
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * SLOT_COUNT;
+    if (vkCreateQueryPool(vkdata.logical_device, &poolInfo, nullptr, &this->query_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+    this->submitted = {};
+    this->last_ms = -1.0;
+    this->last_frame = 0;
+}
+
+void gpu_frame_timer::terminate(vulkan_data& vkdata)
+{
+    if (this->query_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(vkdata.logical_device, this->query_pool, nullptr);
+        this->query_pool = VK_NULL_HANDLE;
+    }
+}
+
+bool gpu_frame_timer::is_supported() const
+{
+    return this->query_pool != VK_NULL_HANDLE;
+}
+
+// keyed by frame number rather than the frame in flight, the frame that last had the same
+// current_frame is usually still running on the gpu when this one is recorded
+uint32_t gpu_frame_timer::get_slot(const vulkan_data& vkdata) const
+{
+    return static_cast<uint32_t>(vkdata.frame_number % SLOT_COUNT);
+}
+
+bool gpu_frame_timer::update(vulkan_data& vkdata)
+{
+    if (!this->is_supported()) {
+        return false;
+    }
+
+    // this frame reuses the queries of the frame SLOT_COUNT frames ago, which has finished
+    uint32_t slot = this->get_slot(vkdata);
+    bool read = false;
+    if (this->submitted[slot]) {
+        // value and availability for both timestamps
+        uint64_t results[4] = {};
+        vkGetQueryPoolResults(vkdata.logical_device, this->query_pool, 2 * slot, 2, sizeof(results), results,
+                              2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if (results[1] != 0 && results[3] != 0) {
+            uint64_t ticks = ((results[2] & this->valid_mask) - (results[0] & this->valid_mask)) & this->valid_mask;
+            this->last_ms = static_cast<double>(ticks) * this->tick_ns / 1000000.0;
+            this->last_frame = this->frames[slot];
+            read = true;
+        }
+    }
+
+    // whichever command buffer gets submitted this frame writes the slot
+    this->submitted[slot] = true;
+    this->frames[slot] = vkdata.frame_number;
+    return read;
+}
+
+void gpu_frame_timer::begin(vulkan_data& vkdata, VkCommandBuffer cmd)
+{
+    if (!this->is_supported()) {
+        return;
+    }
+    uint32_t slot = this->get_slot(vkdata);
+    vkCmdResetQueryPool(cmd, this->query_pool, 2 * slot, 2);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->query_pool, 2 * slot);
+}
+
+void gpu_frame_timer::end(vulkan_data& vkdata, VkCommandBuffer cmd)
+{
+    if (!this->is_supported()) {
+        return;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->query_pool, 2 * this->get_slot(vkdata) + 1);
+}
+
+double gpu_frame_timer::get_last_time_ms() const
+{
+    return this->last_ms;
+}
+
+uint64_t gpu_frame_timer::get_last_frame() const
+{
+    return this->last_frame;
+}
+
+/* gpu profiler */
+
+// counters come back in flag bit order
+static const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+#define STATISTIC_COUNT 6
+
+void gpu_profiler::initialise(vulkan_data& vkdata, uint32_t region_capacity)
+{
+    if (!get_timestamp_support(vkdata, &this->valid_mask, &this->tick_ns)) {
+        return;
+    }
+    this->max_regions = std::max(region_capacity, 1u);
+
+    VkQueryPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = 2 * this->max_regions * SLOT_COUNT;
+    if (vkCreateQueryPool(vkdata.logical_device, &poolInfo, nullptr, &this->timestamp_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create profiler timestamp query pool!");
+    }
+
+    if (vkdata.pipeline_statistics) {
+        poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        poolInfo.queryCount = this->max_regions * SLOT_COUNT;
+        poolInfo.pipelineStatistics = STATISTIC_FLAGS;
+        if (vkCreateQueryPool(vkdata.logical_device, &poolInfo, nullptr, &this->statistics_pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create profiler pipeline statistics query pool!");
+        }
+    }
+
+    this->slots = {};
+    this->open_regions.clear();
+    this->statistics_open = false;
+}
+
+void gpu_profiler::terminate(vulkan_data& vkdata)
+{
+    if (this->timestamp_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(vkdata.logical_device, this->timestamp_pool, nullptr);
+        this->timestamp_pool = VK_NULL_HANDLE;
+    }
+    if (this->statistics_pool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(vkdata.logical_device, this->statistics_pool, nullptr);
+        this->statistics_pool = VK_NULL_HANDLE;
+    }
+}
+
+bool gpu_profiler::is_supported() const
+{
+    return this->timestamp_pool != VK_NULL_HANDLE;
+}
+
+// a slot is reused SLOT_COUNT frames later, by then the fence of the frame that wrote it has been waited on
+uint32_t gpu_profiler::get_slot(const vulkan_data& vkdata) const
+{
+    return static_cast<uint32_t>(vkdata.frame_number % SLOT_COUNT);
+}
+
+void gpu_profiler::update(vulkan_data& vkdata)
+{
+    if (!this->is_supported()) {
+        return;
+    }
+    uint32_t index = this->get_slot(vkdata);
+    auto& slot = this->slots[index];
+    if (slot.submitted) {
+        this->read_slot(vkdata, slot, index);
+    }
+    slot.submitted = true;
+    slot.frame = vkdata.frame_number;
+    slot.regions.clear();
+}
+
+void gpu_profiler::read_slot(vulkan_data& vkdata, frame_slot& slot, uint32_t slot_index)
+{
+    uint32_t count = static_cast<uint32_t>(slot.regions.size());
+    if (count == 0) {
+        return;
+    }
+    uint32_t first = slot_index * this->max_regions;
+
+    // value and availability for every query, never waits
+    std::vector<uint64_t> times(4 * count);
+    vkGetQueryPoolResults(vkdata.logical_device, this->timestamp_pool, 2 * first, 2 * count,
+                          times.size() * sizeof(uint64_t), times.data(), 2 * sizeof(uint64_t),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    std::vector<uint64_t> statistics;
+    if (this->statistics_pool != VK_NULL_HANDLE) {
+        statistics.resize((STATISTIC_COUNT + 1) * count);
+        vkGetQueryPoolResults(vkdata.logical_device, this->statistics_pool, first, count,
+                              statistics.size() * sizeof(uint64_t), statistics.data(), (STATISTIC_COUNT + 1) * sizeof(uint64_t),
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    }
+
+    // a region left open or a frame that never got submitted
+    for (uint32_t r = 0; r < count; r++) {
+        if (times[4 * r + 1] == 0 || times[4 * r + 3] == 0) {
+            this->dropped_frames++;
+            return;
+        }
+    }
+
+    for (uint32_t r = 0; r < count; r++) {
+        auto& record = slot.regions[r];
+        uint64_t begin = times[4 * r] & this->valid_mask;
+        uint64_t end = times[4 * r + 2] & this->valid_mask;
+        double ms = static_cast<double>((end - begin) & this->valid_mask) * this->tick_ns / 1000000.0;
+
+        auto it = this->history_index.find(record.name);
+        if (it == this->history_index.end()) {
+            it = this->history_index.emplace(record.name, static_cast<uint32_t>(this->history.size())).first;
+            this->history.emplace_back();
+            this->history.back().name = record.name;
+        }
+        auto& entry = this->history[it->second];
+        entry.times.push_back(ms);
+        entry.sum += ms;
+        while (entry.times.size() > std::max(this->average_window, 1u)) {
+            entry.sum -= entry.times.front();
+            entry.times.pop_front();
+        }
+        entry.last_ms = ms;
+
+        gpu_pipeline_stats stats;
+        bool has_stats = false;
+        if (record.statistics && statistics[(STATISTIC_COUNT + 1) * r + STATISTIC_COUNT] != 0) {
+            const uint64_t* values = &statistics[(STATISTIC_COUNT + 1) * r];
+            stats = {values[0], values[1], values[2], values[3], values[4], values[5]};
+            entry.last_stats = stats;
+            has_stats = true;
+        }
+
+        if (this->trace && this->events.size() < this->max_trace_events) {
+            if (this->trace_origin == UINT64_MAX) {
+                this->trace_origin = begin;
+            }
+            double start_ticks = static_cast<double>(static_cast<int64_t>(begin - this->trace_origin));
+            this->events.push_back({it->second, slot.frame, start_ticks * this->tick_ns / 1000.0, ms * 1000.0, stats, has_stats});
+        }
+    }
+}
+
+void gpu_profiler::begin_frame(vulkan_data& vkdata, VkCommandBuffer cmd)
+{
+    if (!this->is_supported()) {
+        return;
+    }
+    // every swapchain image's command buffer is recorded, whichever is submitted leaves its regions
+    uint32_t index = this->get_slot(vkdata);
+    this->slots[index].regions.clear();
+    this->open_regions.clear();
+    this->statistics_open = false;
+
+    vkCmdResetQueryPool(cmd, this->timestamp_pool, 2 * this->max_regions * index, 2 * this->max_regions);
+    if (this->statistics_pool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(cmd, this->statistics_pool, this->max_regions * index, this->max_regions);
+    }
+}
+
+uint32_t gpu_profiler::begin_region(vulkan_data& vkdata, VkCommandBuffer cmd, const std::string& name, bool statistics)
+{
+    if (!this->is_supported()) {
+        return UINT32_MAX;
+    }
+    uint32_t index = this->get_slot(vkdata);
+    auto& slot = this->slots[index];
+    if (slot.regions.size() >= this->max_regions) {
+        return UINT32_MAX;
+    }
+
+    statistics = statistics && this->statistics_pool != VK_NULL_HANDLE;
+    if (statistics && this->statistics_open) {
+        throw std::logic_error("gpu profiler region " + name + " gathers statistics inside another region that does!");
+    }
+    uint32_t region = static_cast<uint32_t>(slot.regions.size());
+    slot.regions.push_back({name, statistics});
+    this->open_regions.push_back(region);
+
+    uint32_t query = index * this->max_regions + region;
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->timestamp_pool, 2 * query);
+    if (statistics) {
+        vkCmdBeginQuery(cmd, this->statistics_pool, query, 0);
+        this->statistics_open = true;
+    }
+    return region;
+}
+
+void gpu_profiler::end_region(vulkan_data& vkdata, VkCommandBuffer cmd, uint32_t region)
+{
+    if (!this->is_supported() || region == UINT32_MAX) {
+        return;
+    }
+    if (this->open_regions.empty() || this->open_regions.back() != region) {
+        throw std::logic_error("gpu profiler regions have to be closed in the order they were opened!");
+    }
+    this->open_regions.pop_back();
+
+    uint32_t index = this->get_slot(vkdata);
+    uint32_t query = index * this->max_regions + region;
+    if (this->slots[index].regions[region].statistics) {
+        vkCmdEndQuery(cmd, this->statistics_pool, query);
+        this->statistics_open = false;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->timestamp_pool, 2 * query + 1);
+}
+
+std::vector<gpu_region_stats> gpu_profiler::get_region_stats() const
+{
+    std::vector<gpu_region_stats> stats;
+    for (auto& entry : this->history) {
+        gpu_region_stats region;
+        region.name = entry.name;
+        region.average_ms = entry.times.empty() ? 0.0 : entry.sum / static_cast<double>(entry.times.size());
+        region.last_ms = entry.last_ms;
+        region.last_stats = entry.last_stats;
+        stats.push_back(region);
+    }
+    return stats;
+}
+
+uint64_t gpu_profiler::get_dropped_frames() const
+{
+    return this->dropped_frames;
+}
+
+static std::string json_escape(const std::string& text)
+{
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char code[8];
+            snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned>(c));
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// complete events on a single gpu track, nested regions show up stacked since they share it
+void gpu_profiler::write_chrome_trace(const std::string& path) const
+{
+    std::ofstream file(path, std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to open gpu trace " + path + "!");
+    }
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"gpu\"}}";
+    for (auto& event : this->events) {
+        file << ",\n{\"name\":\"" << json_escape(this->history[event.region].name) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+             << ",\"ts\":" << event.start_us << ",\"dur\":" << event.duration_us
+             << ",\"args\":{\"frame\":" << event.frame;
+        if (event.has_stats) {
+            file << ",\"input_vertices\":" << event.stats.input_vertices
+                 << ",\"input_primitives\":" << event.stats.input_primitives
+                 << ",\"vertex_invocations\":" << event.stats.vertex_invocations
+                 << ",\"clipping_primitives\":" << event.stats.clipping_primitives
+                 << ",\"fragment_invocations\":" << event.stats.fragment_invocations
+                 << ",\"compute_invocations\":" << event.stats.compute_invocations;
+        }
+        file << "}}";
+    }
+    file << "\n]}\n";
+    if (!file) {
+        throw std::runtime_error("failed to write gpu trace " + path + "!");
+    }
+}
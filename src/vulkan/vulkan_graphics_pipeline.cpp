@@ -106,10 +106,27 @@ std::vector<VkDynamicState> graphics_pipeline::gen_dynamic_state_info(vulkan_dat
     return dynamicStates;
 }
 
-std::vector<VkPipelineShaderStageCreateInfo> graphics_pipeline::load_shader_stage_infos(vulkan_data& data)
+VkPipelineDepthStencilStateCreateInfo graphics_pipeline::gen_depth_stencil_state_info(vulkan_data& data)
+{
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = VK_TRUE; // @TODO: out of order transparency?
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.minDepthBounds = 0.0f; // Optional
+    depthStencil.maxDepthBounds = 1.0f; // Optional
+    depthStencil.stencilTestEnable = VK_FALSE;
+    depthStencil.front = {};
+    depthStencil.back = {};
+
+    return depthStencil;
+}
+
+std::vector<shader_stage_decl> graphics_pipeline::get_shader_stage_declarations()
 {
     throw std::logic_error("Have not passed any shader stages and no default shader loading has been set!");
-    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    std::vector<shader_stage_decl> stages;
     return stages;
 }
 
@@ -122,26 +139,28 @@ void graphics_pipeline::initialise(vulkan_data& vkdata, VkRenderPass input_rende
     register_pipeline(vkdata, this);
 }
 
-void graphics_pipeline::clear_shader_stages(vulkan_data& data)
-{
-    // destroy all generated shader modules
-    for (VkPipelineShaderStageCreateInfo stage : this->shader_stages) {
-        vkDestroyShaderModule(data.logical_device, stage.module, nullptr);
-    }
-    this->shader_stages.clear();
-}
-
 void graphics_pipeline::terminate(vulkan_data& data)
 {
     unregister_pipeline(data, this);
     terminate_routine(data);
 }
 
-VkPipeline &graphics_pipeline::get_pipeline(vulkan_data& vkdata) {
+VkPipeline graphics_pipeline::get_pipeline(vulkan_data& vkdata) {
+    if (this->pipeline == VK_NULL_HANDLE) {
+        if (this->fallback == nullptr) {
+            // nothing else to draw with, wait for it
+            this->pipeline = vkdata.pipelines->get(vkdata, this->state);
+        } else {
+            this->pipeline = vkdata.pipelines->get_async(vkdata, this->state);
+            if (this->pipeline == VK_NULL_HANDLE) {
+                return this->fallback->get_pipeline(vkdata);
+            }
+        }
+    }
     return this->pipeline;
 }
 
-VkPipelineLayout &graphics_pipeline::get_pipeline_layout() {
+VkPipelineLayout graphics_pipeline::get_pipeline_layout() {
     return this->layout;
 }
 
@@ -159,147 +178,87 @@ std::vector<uniform_buffer_decl> graphics_pipeline::get_uniform_buffer_declarati
     return {};
 }
 
-void graphics_pipeline::initialise_routine(vulkan_data &vkdata, VkRenderPass input_render_pass) {
-    std::vector<VkVertexInputBindingDescription> binding_descriptions; std::vector<VkVertexInputAttributeDescription> attrib_descriptions;
-    this->gen_vertex_input_info(vkdata, &binding_descriptions, &attrib_descriptions);
-
-    VkPipelineVertexInputStateCreateInfo vertex_input_state_info = {};
-    vertex_input_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_state_info.vertexBindingDescriptionCount = (uint32_t)binding_descriptions.size();
-    vertex_input_state_info.pVertexBindingDescriptions = binding_descriptions.data();
-    vertex_input_state_info.vertexAttributeDescriptionCount = (uint32_t)attrib_descriptions.size();
-    vertex_input_state_info.pVertexAttributeDescriptions = attrib_descriptions.data();
-
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_info = this->gen_input_assembly_info(vkdata);
-    std::vector<VkViewport> viewports = this->gen_viewport(vkdata);
-    std::vector<VkRect2D> scissors = this->gen_scissor(vkdata);
-    VkPipelineRasterizationStateCreateInfo rasterization_state_info = this->gen_rasterization_state_info(vkdata);
-    VkPipelineMultisampleStateCreateInfo multisample_state_info = this->gen_multisampling_state_info(vkdata);
-    std::vector<VkPipelineColorBlendAttachmentState> attachment_states;
-    VkPipelineColorBlendStateCreateInfo color_blend_state_info = this->gen_color_blend_state(vkdata, attachment_states);
-    std::vector<VkDynamicState> dynamic_states = this->gen_dynamic_state_info(vkdata);
-
-    if (this->shader_stages.empty()) {
-        this->shader_stages = this->load_shader_stage_infos(vkdata);
-    }
+std::vector<specialization_constant> graphics_pipeline::get_specialization_constants() {
+    return {};
+}
 
-    // create the descriptor set layout
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-    if (!this->uniformBufferDecls.empty()) {
-        /* sort decls so that result is in order set 0..n with binding 0..m */
-        std::sort(this->uniformBufferDecls.begin(), this->uniformBufferDecls.end(), [](uniform_buffer_decl& a, uniform_buffer_decl& b){
-            if (a.set != b.set) {
-                return a.set < b.set;
-            } else {
-                return a.binding < b.binding;
-            }
-        });
-
-        // create layout bindings
-        for (size_t i = 0; i < this->uniformBufferDecls.size(); i++) {
-            uint32_t this_set = this->uniformBufferDecls[i].set;
-
-            // combine declarations of the same set into a descriptor set layout
-            std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
-            while (i < this->uniformBufferDecls.size()) {
-                auto& decl = this->uniformBufferDecls[i];
-                if (decl.set != this_set) {
-                    i--;
-                    break;
-                }
-                layout_bindings.push_back(create_descriptor_set_binding(decl.binding, decl.type, decl.shaderFlags));
-                i++;
-            }
+pipeline_state graphics_pipeline::get_specialized_state(const std::vector<specialization_constant>& constants,
+                                                       const VkPipelineDepthStencilStateCreateInfo* depth_stencil) const {
+    pipeline_state specialized_state = this->state;
+    specialized_state.specialization_constants = constants;
+    if (depth_stencil != nullptr) {
+        specialized_state.depth_stencil = *depth_stencil;
+    }
+    return specialized_state;
+}
 
-            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            layoutInfo.bindingCount = static_cast<uint32_t>(layout_bindings.size());
-            layoutInfo.pBindings = layout_bindings.data();
-            this->descriptor_set_layouts.push_back({});
-            if (vkCreateDescriptorSetLayout(vkdata.logical_device, &layoutInfo, nullptr, &this->descriptor_set_layouts.back()) !=
-                VK_SUCCESS) {
-                throw std::runtime_error("failed to create descriptor set layout!");
-            }
-        }
+VkPipeline graphics_pipeline::get_specialized_pipeline(vulkan_data& vkdata, uint64_t key, const std::vector<specialization_constant>& constants,
+                                                       const VkPipelineDepthStencilStateCreateInfo* depth_stencil) {
+    auto it = this->specialized_pipelines.find(key);
+    if (it != this->specialized_pipelines.end()) {
+        return it->second;
+    }
 
-        // generate pipeline layout
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(this->descriptor_set_layouts.size());
-        pipelineLayoutInfo.pSetLayouts = this->descriptor_set_layouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-        pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+    VkPipeline specialized = VK_NULL_HANDLE;
+    if (depth_stencil != nullptr) {
+        // get_pipeline() tests depth differently, it could hide everything this draws until it's ready
+        specialized = vkdata.pipelines->get(vkdata, this->get_specialized_state(constants, depth_stencil));
     } else {
-        // generate pipeline layout
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-        pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-        pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+        specialized = vkdata.pipelines->get_async(vkdata, this->get_specialized_state(constants));
     }
-
-    if (vkCreatePipelineLayout(vkdata.logical_device, &pipelineLayoutInfo, nullptr, &this->layout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+    if (specialized == VK_NULL_HANDLE) {
+        return this->get_pipeline(vkdata);
     }
+    this->specialized_pipelines.emplace(key, specialized);
+    return specialized;
+}
 
-    this->render_pass = input_render_pass;
+pipeline_state graphics_pipeline::describe(vulkan_data& vkdata, VkRenderPass input_render_pass) {
+    pipeline_state state;
+    state.shader_stages = this->get_shader_stage_declarations();
+    this->gen_vertex_input_info(vkdata, &state.vertex_bindings, &state.vertex_attributes);
+    state.input_assembly = this->gen_input_assembly_info(vkdata);
+    state.viewports = this->gen_viewport(vkdata);
+    state.scissors = this->gen_scissor(vkdata);
+    state.rasterization = this->gen_rasterization_state_info(vkdata);
+    state.multisample = this->gen_multisampling_state_info(vkdata);
+    state.color_blend = this->gen_color_blend_state(vkdata, state.blend_attachments);
+    state.depth_stencil = this->gen_depth_stencil_state_info(vkdata);
+    if (this->after_depth_prepass) {
+        // the pre-pass already kept the closest fragment, matching it shades each pixel once
+        state.depth_stencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        state.depth_stencil.depthWriteEnable = VK_FALSE;
+    }
+    state.dynamic_states = this->gen_dynamic_state_info(vkdata);
+    state.descriptor_decls = this->get_uniform_buffer_declarations();
+    state.specialization_constants = this->get_specialization_constants();
+    state.render_pass = input_render_pass;
+    state.subpass = 0;
+    return state;
+}
 
-    VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
-    dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamic_state_info.dynamicStateCount = (uint32_t)dynamic_states.size();
-    dynamic_state_info.pDynamicStates = dynamic_states.data();
+void graphics_pipeline::initialise_routine(vulkan_data &vkdata, VkRenderPass input_render_pass) {
+    this->state = this->describe(vkdata, input_render_pass);
 
-    VkPipelineViewportStateCreateInfo viewportState = {};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = (uint32_t)viewports.size();
-    viewportState.pViewports = viewports.data();
-    viewportState.scissorCount = (uint32_t)scissors.size();
-    viewportState.pScissors = scissors.data();
+    // layouts are created right away so descriptor sets can be allocated while the pipeline compiles
+    auto layout_entry = vkdata.pipelines->get_layout(vkdata, this->state.descriptor_decls);
+    this->layout = layout_entry.layout;
+    this->descriptor_set_layouts = layout_entry.set_layouts;
 
-    VkPipelineDepthStencilStateCreateInfo depthStencil{};
-    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE; // @TODO: out of order transparency?
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStencil.depthBoundsTestEnable = VK_FALSE;
-    depthStencil.minDepthBounds = 0.0f; // Optional
-    depthStencil.maxDepthBounds = 1.0f; // Optional
-    depthStencil.stencilTestEnable = VK_FALSE;
-    depthStencil.front = {};
-    depthStencil.back = {};
-
-    VkGraphicsPipelineCreateInfo pipelineInfo = {};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = (uint32_t)this->shader_stages.size();
-    pipelineInfo.pStages = this->shader_stages.data();
-    pipelineInfo.pVertexInputState = &vertex_input_state_info;
-    pipelineInfo.pInputAssemblyState = &input_assembly_info;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterization_state_info;
-    pipelineInfo.pMultisampleState = &multisample_state_info;
-    pipelineInfo.pDepthStencilState = &depthStencil; // Optional @TODO
-    pipelineInfo.pColorBlendState = &color_blend_state_info;
-    if (dynamic_states.empty()) {
-        pipelineInfo.pDynamicState = nullptr;
+    // shared with every other pipeline built from the same state
+    if (this->compile_async) {
+        this->pipeline = vkdata.pipelines->get_async(vkdata, this->state);
     } else {
-        pipelineInfo.pDynamicState = &dynamic_state_info;
-    }
-    pipelineInfo.layout = this->layout;
-    pipelineInfo.renderPass = input_render_pass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-    pipelineInfo.basePipelineIndex = -1; // Optional
-
-    auto err = vkCreateGraphicsPipelines(vkdata.logical_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &this->pipeline);
-    if (err != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
+        this->pipeline = vkdata.pipelines->get(vkdata, this->state);
     }
 }
 
 void graphics_pipeline::terminate_routine(vulkan_data &vkdata) {
-    vkDestroyPipeline(vkdata.logical_device, this->pipeline, nullptr);
-    vkDestroyPipelineLayout(vkdata.logical_device, this->layout, nullptr);
-
-    this->clear_shader_stages(vkdata);
+    // the registry owns the vulkan objects, they are released with the render pass
+    this->pipeline = VK_NULL_HANDLE;
+    this->layout = VK_NULL_HANDLE;
+    this->descriptor_set_layouts.clear();
+    this->specialized_pipelines.clear();
 }
 
 void graphics_pipeline::reinitialise(vulkan_data &vkdata, VkRenderPass input_render_pass) {
@@ -314,6 +273,10 @@ VkDescriptorSetLayout graphics_pipeline::get_descriptor_set_layout(size_t set) {
     return this->descriptor_set_layouts[set];
 }
 
+VkRenderPass graphics_pipeline::get_render_pass() const {
+    return this->state.render_pass;
+}
+
 VkPipelineShaderStageCreateInfo gen_shader_stage_info_from_spirv(vulkan_data& data, std::string abs_path, shader_type type, const char* entry_point)
 {
     auto vert_data = read_data_from_binary_file(std::move(abs_path));
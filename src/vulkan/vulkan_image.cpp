@@ -3,7 +3,7 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
-void transition_image_layout(vulkan_data& vkdata, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout) {
+void transition_image_layout(vulkan_data& vkdata, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mip_levels = 1) {
     // begin the transition command buffer
     VkCommandBufferAllocateInfo allocInfo = {};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -30,7 +30,7 @@ void transition_image_layout(vulkan_data& vkdata, VkImage image, VkImageLayout o
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.levelCount = mip_levels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
@@ -76,6 +76,21 @@ void transition_image_layout(vulkan_data& vkdata, VkImage image, VkImageLayout o
     vkFreeCommandBuffers(vkdata.logical_device, vkdata.command_pool_graphics, 1, &commandBuffer);
 }
 
+image_mip_level single_mip_level(uint32_t width, uint32_t height, size_t byte_size) {
+    image_mip_level level;
+    level.offset = 0;
+    level.byte_size = byte_size;
+    level.width = width;
+    level.height = height;
+    return level;
+}
+
+bool is_format_sampleable(vulkan_data& vkdata, VkFormat format) {
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(vkdata.physical_device, format, &props);
+    return (props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
 void vulkan_image::initialise(vulkan_data& vkdata, const unsigned char* data, size_t data_length) {
     int texWidth, texHeight, texChannels;
     stbi_uc* pixels = stbi_load_from_memory(data, static_cast<int>(data_length), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
@@ -89,7 +104,7 @@ void vulkan_image::initialise(vulkan_data& vkdata, const unsigned char* data, si
     ::fill_buffer(vkdata, stagingBufferAlloc, (size_t)imageSize, pixels);
     stbi_image_free(pixels);
 
-    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, texWidth, texHeight);
+    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, {single_mip_level(texWidth, texHeight, imageSize)});
 
     // cleanup
     vmaDestroyBuffer(vkdata.mem_allocator, stagingBuffer, stagingBufferAlloc);
@@ -108,13 +123,28 @@ void vulkan_image::initialise(vulkan_data& vkdata, std::string abs_file_path) {
     ::fill_buffer(vkdata, stagingBufferAlloc, (size_t)imageSize, pixels);
     stbi_image_free(pixels);
 
-    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, texWidth, texHeight);
+    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, {single_mip_level(texWidth, texHeight, imageSize)});
+
+    // cleanup
+    vmaDestroyBuffer(vkdata.mem_allocator, stagingBuffer, stagingBufferAlloc);
+}
+
+void vulkan_image::initialise_mips(vulkan_data& vkdata, const unsigned char* data, size_t data_length, const std::vector<image_mip_level>& levels) {
+    VkBuffer stagingBuffer;
+    VmaAllocation stagingBufferAlloc;
+    ::create_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, data_length, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    ::fill_buffer(vkdata, stagingBufferAlloc, data_length, const_cast<unsigned char*>(data));
+
+    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, levels);
 
     // cleanup
     vmaDestroyBuffer(vkdata.mem_allocator, stagingBuffer, stagingBufferAlloc);
 }
 
 void vulkan_image::terminate(vulkan_data &vkdata) {
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->forget(capture_object_type::IMAGE, this->image);
+    }
     vmaDestroyImage(vkdata.mem_allocator, this->image, this->allocation);
 }
 
@@ -127,25 +157,29 @@ void vulkan_image::initialise_default(vulkan_data &vkdata) {
     create_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
     fill_buffer(vkdata, stagingBufferAlloc, (size_t)4, &pixels);
 
-    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, 1, 1);
+    this->initialise_with_staging_buffer(vkdata, &stagingBuffer, &stagingBufferAlloc, {single_mip_level(1, 1, 4)});
 
     // cleanup
     vmaDestroyBuffer(vkdata.mem_allocator, stagingBuffer, stagingBufferAlloc);
 }
 
-void vulkan_image::initialise_with_staging_buffer(vulkan_data &vkdata, VkBuffer *stagingBuffer,
-                                                  VmaAllocation *stagingAllocation, uint32_t texWidth, uint32_t texHeight) {
+void vulkan_image::create_image(vulkan_data& vkdata, const std::vector<image_mip_level>& levels) {
+    if (levels.empty()) {
+        throw std::runtime_error("attempted to create an image with no mip levels!");
+    }
+    this->mip_levels = static_cast<uint32_t>(levels.size());
+
     VkImageCreateInfo imageInfo = {};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = static_cast<uint32_t>(texWidth);
-    imageInfo.extent.height = static_cast<uint32_t>(texHeight);
+    imageInfo.extent.width = levels[0].width;
+    imageInfo.extent.height = levels[0].height;
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = this->mip_levels;
     imageInfo.arrayLayers = 1;
     imageInfo.format = this->format;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -157,6 +191,20 @@ void vulkan_image::initialise_with_staging_buffer(vulkan_data &vkdata, VkBuffer
     if (vmaCreateImage(vkdata.mem_allocator, &imageInfo, &allocationCreateInfo, &this->image, &this->allocation, nullptr) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create vulkan image!");
     }
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->track_image(this->image, imageInfo);
+    }
+}
+
+void vulkan_image::initialise_deferred(vulkan_data& vkdata, upload_batch& batch, const staging_region& src, const std::vector<image_mip_level>& levels) {
+    this->create_image(vkdata, levels);
+    batch.copy_to_image(src, this->image, levels);
+}
+
+void vulkan_image::initialise_with_staging_buffer(vulkan_data &vkdata, VkBuffer *stagingBuffer,
+                                                  VmaAllocation *stagingAllocation, const std::vector<image_mip_level>& levels) {
+    this->create_image(vkdata, levels);
+    transition_image_layout(vkdata, this->image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, this->mip_levels);
 
     // begin the copy command buffer
     VkCommandBufferAllocateInfo allocInfo = {};
@@ -174,31 +222,34 @@ void vulkan_image::initialise_with_staging_buffer(vulkan_data &vkdata, VkBuffer
 
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-    // do copy command buffer stuff
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {
-            (uint32_t)texWidth,
-            (uint32_t)texHeight,
-            1
-    };
+    // do copy command buffer stuff, one region per mip level
+    std::vector<VkBufferImageCopy> regions(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+        VkBufferImageCopy& region = regions[i];
+        region.bufferOffset = levels[i].offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {
+                levels[i].width,
+                levels[i].height,
+                1
+        };
+    }
 
     vkCmdCopyBufferToImage(
             commandBuffer,
             *stagingBuffer,
             this->image,
             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region
+            static_cast<uint32_t>(regions.size()),
+            regions.data()
     );
 
     // end the copy command buffer
@@ -215,7 +266,7 @@ void vulkan_image::initialise_with_staging_buffer(vulkan_data &vkdata, VkBuffer
     vkFreeCommandBuffers(vkdata.logical_device, vkdata.command_pool_graphics, 1, &commandBuffer);
 
     // transition image layout to shader optimal
-    transition_image_layout(vkdata, this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    transition_image_layout(vkdata, this->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, this->mip_levels);
 }
 
 
@@ -227,28 +278,34 @@ void vulkan_image_view::initialise(vulkan_data &vkdata, const vulkan_image &imag
     viewInfo.format = image.format;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = image.mip_levels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
     if (vkCreateImageView(vkdata.logical_device, &viewInfo, nullptr, &this->imageView) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture image view!");
     }
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->track_image_view(this->imageView, viewInfo);
+    }
 }
 
 void vulkan_image_view::terminate(vulkan_data &vkdata) {
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->forget(capture_object_type::IMAGE_VIEW, this->imageView);
+    }
     vkDestroyImageView(vkdata.logical_device, this->imageView, nullptr);
 }
 
-void vulkan_sampler::initialise(vulkan_data &vkdata) {
+void vulkan_sampler::initialise(vulkan_data &vkdata, VkSamplerAddressMode address_mode) {
     VkSamplerCreateInfo samplerInfo = {};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
     samplerInfo.magFilter = VK_FILTER_LINEAR;
     samplerInfo.minFilter = VK_FILTER_LINEAR;
 
-    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+    samplerInfo.addressModeU = address_mode;
+    samplerInfo.addressModeV = address_mode;
+    samplerInfo.addressModeW = address_mode;
 
     auto features = get_device_features(vkdata);
     if (features.samplerAnisotropy) {
@@ -268,13 +325,19 @@ void vulkan_sampler::initialise(vulkan_data &vkdata) {
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     if (vkCreateSampler(vkdata.logical_device, &samplerInfo, nullptr, &this->sampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
     }
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->track_sampler(this->sampler, samplerInfo);
+    }
 }
 
 void vulkan_sampler::terminate(vulkan_data &vkdata) {
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->forget(capture_object_type::SAMPLER, this->sampler);
+    }
     vkDestroySampler(vkdata.logical_device, this->sampler, nullptr);
 }
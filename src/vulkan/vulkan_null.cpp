@@ -0,0 +1,1083 @@
+#include "vulkan_null.h"
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+/* call counts */
+
+// one per stub, registered on its first call
+struct null_vulkan_counter {
+    const char* name;
+    std::atomic<uint64_t> calls{0};
+
+    explicit null_vulkan_counter(const char* function_name);
+};
+
+static std::mutex& get_counters_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<null_vulkan_counter*>& get_counters()
+{
+    static std::vector<null_vulkan_counter*> counters;
+    return counters;
+}
+
+null_vulkan_counter::null_vulkan_counter(const char* function_name) : name(function_name)
+{
+    std::lock_guard<std::mutex> lock(get_counters_mutex());
+    get_counters().push_back(this);
+}
+
+bool null_vulkan_enabled()
+{
+#ifdef DISCOVERY_NULL_VULKAN
+    return true;
+#else
+    return false;
+#endif
+}
+
+std::vector<null_vulkan_call_count> null_vulkan_get_calls()
+{
+    std::vector<null_vulkan_call_count> calls;
+    {
+        std::lock_guard<std::mutex> lock(get_counters_mutex());
+        for (auto counter : get_counters()) {
+            uint64_t count = counter->calls.load(std::memory_order_relaxed);
+            if (count != 0) {
+                calls.push_back({counter->name, count});
+            }
+        }
+    }
+    std::sort(calls.begin(), calls.end(), [](const null_vulkan_call_count& a, const null_vulkan_call_count& b) {
+        return a.calls != b.calls ? a.calls > b.calls : a.name < b.name;
+    });
+    return calls;
+}
+
+void null_vulkan_reset_calls()
+{
+    std::lock_guard<std::mutex> lock(get_counters_mutex());
+    for (auto counter : get_counters()) {
+        counter->calls.store(0, std::memory_order_relaxed);
+    }
+}
+
+#ifdef DISCOVERY_NULL_VULKAN
+
+#define NULL_VK_CALL() \
+    static null_vulkan_counter null_vk_counter(__func__); \
+    null_vk_counter.calls.fetch_add(1, std::memory_order_relaxed)
+
+/* fake handles */
+
+// objects that need to remember something are heap allocated and their handle points at them
+struct null_memory {
+    VkDeviceSize size = 0;
+    void* data = nullptr;       // host memory, allocated on the first map
+};
+
+struct null_resource {
+    VkDeviceSize size = 0;      // what vma is told to allocate for the buffer or image
+};
+
+struct null_query_pool {
+    uint32_t values_per_query = 1;
+};
+
+struct null_swapchain {
+    std::vector<VkImage> images;
+    uint32_t next_image = 0;
+};
+
+static std::atomic<uint64_t> next_handle{1};
+
+// handles that stand for nothing, unique so the engine can still key maps by them
+template <typename T>
+static T new_handle()
+{
+    uint64_t id = next_handle.fetch_add(1, std::memory_order_relaxed);
+    if constexpr (std::is_pointer<T>::value) {
+        return reinterpret_cast<T>(static_cast<uintptr_t>(id));
+    } else {
+        return static_cast<T>(id);
+    }
+}
+
+// non-dispatchable handles are 64 bit integers on 32 bit platforms
+template <typename T, typename S>
+static T to_handle(S* state)
+{
+    if constexpr (std::is_pointer<T>::value) {
+        return reinterpret_cast<T>(state);
+    } else {
+        return static_cast<T>(reinterpret_cast<uintptr_t>(state));
+    }
+}
+
+template <typename S, typename T>
+static S* from_handle(T handle)
+{
+    if constexpr (std::is_pointer<T>::value) {
+        return reinterpret_cast<S*>(handle);
+    } else {
+        return reinterpret_cast<S*>(static_cast<uintptr_t>(handle));
+    }
+}
+
+// the count then fill pattern of vkEnumerate* and friends
+template <typename T>
+static VkResult enumerate(const std::vector<T>& values, uint32_t* count, T* out)
+{
+    if (out == nullptr) {
+        *count = static_cast<uint32_t>(values.size());
+        return VK_SUCCESS;
+    }
+    uint32_t written = std::min(*count, static_cast<uint32_t>(values.size()));
+    std::copy(values.begin(), values.begin() + written, out);
+    *count = written;
+    return written < values.size() ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+/* the device, a desktop gpu with separate device local and host memory */
+
+static VkPhysicalDeviceProperties get_properties()
+{
+    VkPhysicalDeviceProperties properties = {};
+    properties.apiVersion = VK_API_VERSION_1_1;
+    properties.driverVersion = 1;
+    properties.deviceType = VK_PHYSICAL_DEVICE_TYPE_CPU;
+    std::strncpy(properties.deviceName, "discovery null device", VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+
+    auto& limits = properties.limits;
+    limits.maxImageDimension1D = 16384;
+    limits.maxImageDimension2D = 16384;
+    limits.maxImageDimension3D = 2048;
+    limits.maxImageDimensionCube = 16384;
+    limits.maxImageArrayLayers = 2048;
+    limits.maxUniformBufferRange = 65536;
+    limits.maxStorageBufferRange = UINT32_MAX;
+    limits.maxPushConstantsSize = 256;
+    limits.maxMemoryAllocationCount = 4096;
+    limits.maxSamplerAllocationCount = 4000;
+    limits.bufferImageGranularity = 1024;
+    limits.maxBoundDescriptorSets = 8;
+    limits.maxSamplerAnisotropy = 16.0f;
+    limits.maxViewports = 16;
+    limits.maxViewportDimensions[0] = 16384;
+    limits.maxViewportDimensions[1] = 16384;
+    limits.maxFramebufferWidth = 16384;
+    limits.maxFramebufferHeight = 16384;
+    limits.maxFramebufferLayers = 2048;
+    limits.maxColorAttachments = 8;
+    limits.maxComputeWorkGroupCount[0] = 65535;
+    limits.maxComputeWorkGroupCount[1] = 65535;
+    limits.maxComputeWorkGroupCount[2] = 65535;
+    limits.maxComputeWorkGroupInvocations = 1024;
+    limits.maxComputeWorkGroupSize[0] = 1024;
+    limits.maxComputeWorkGroupSize[1] = 1024;
+    limits.maxComputeWorkGroupSize[2] = 64;
+    limits.minMemoryMapAlignment = 64;
+    limits.minTexelBufferOffsetAlignment = 16;
+    limits.minUniformBufferOffsetAlignment = 256;
+    limits.minStorageBufferOffsetAlignment = 256;
+    VkSampleCountFlags samples = VK_SAMPLE_COUNT_1_BIT | VK_SAMPLE_COUNT_2_BIT | VK_SAMPLE_COUNT_4_BIT | VK_SAMPLE_COUNT_8_BIT;
+    limits.framebufferColorSampleCounts = samples;
+    limits.framebufferDepthSampleCounts = samples;
+    limits.framebufferStencilSampleCounts = samples;
+    limits.framebufferNoAttachmentsSampleCounts = samples;
+    limits.sampledImageColorSampleCounts = samples;
+    limits.sampledImageDepthSampleCounts = samples;
+    limits.timestampComputeAndGraphics = VK_TRUE;
+    limits.timestampPeriod = 1.0f;
+    limits.optimalBufferCopyOffsetAlignment = 1;
+    limits.optimalBufferCopyRowPitchAlignment = 1;
+    limits.nonCoherentAtomSize = 64;
+    return properties;
+}
+
+static VkPhysicalDeviceMemoryProperties get_memory_properties()
+{
+    VkPhysicalDeviceMemoryProperties memory = {};
+    memory.memoryHeapCount = 2;
+    memory.memoryHeaps[0] = {8ull << 30, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+    memory.memoryHeaps[1] = {16ull << 30, 0};
+    memory.memoryTypeCount = 3;
+    memory.memoryTypes[0] = {VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0};
+    memory.memoryTypes[1] = {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 1};
+    memory.memoryTypes[2] = {VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 1};
+    return memory;
+}
+
+static const uint32_t ALL_MEMORY_TYPES = 0x7;
+
+// roughly, only vma's choice of memory block depends on it
+static uint32_t get_texel_bits(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+        case VK_FORMAT_BC4_SNORM_BLOCK:
+            return 4;
+        case VK_FORMAT_BC2_UNORM_BLOCK:
+        case VK_FORMAT_BC2_SRGB_BLOCK:
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC5_SNORM_BLOCK:
+        case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+        case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+        case VK_FORMAT_R8_UNORM:
+        case VK_FORMAT_R8_SRGB:
+            return 8;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+        case VK_FORMAT_R32G32_SFLOAT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return 64;
+        case VK_FORMAT_R32G32B32A32_SFLOAT:
+            return 128;
+        default:
+            return 32;
+    }
+}
+
+static VkDeviceSize get_image_size(const VkImageCreateInfo& info)
+{
+    VkDeviceSize texels = 0;
+    for (uint32_t level = 0; level < std::max(1u, info.mipLevels); level++) {
+        VkDeviceSize width = std::max(1u, info.extent.width >> level);
+        VkDeviceSize height = std::max(1u, info.extent.height >> level);
+        VkDeviceSize depth = std::max(1u, info.extent.depth >> level);
+        texels += width * height * depth;
+    }
+    texels *= std::max(1u, info.arrayLayers) * static_cast<uint32_t>(info.samples);
+    return std::max<VkDeviceSize>(1, texels * get_texel_bits(info.format) / 8);
+}
+
+static void get_requirements(VkDeviceSize size, VkDeviceSize alignment, VkMemoryRequirements* requirements)
+{
+    requirements->alignment = alignment;
+    requirements->size = (size + alignment - 1) / alignment * alignment;
+    requirements->memoryTypeBits = ALL_MEMORY_TYPES;
+}
+
+/* instance and device */
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance(const VkInstanceCreateInfo*, const VkAllocationCallbacks*, VkInstance* pInstance)
+{
+    NULL_VK_CALL();
+    *pInstance = new_handle<VkInstance>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance(VkInstance, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+// debug builds insist on the validation layer
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties(uint32_t* pPropertyCount, VkLayerProperties* pProperties)
+{
+    NULL_VK_CALL();
+    VkLayerProperties layer = {};
+    std::strncpy(layer.layerName, "VK_LAYER_LUNARG_standard_validation", VK_MAX_EXTENSION_NAME_SIZE - 1);
+    layer.specVersion = VK_API_VERSION_1_1;
+    return enumerate(std::vector<VkLayerProperties>{layer}, pPropertyCount, pProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices(VkInstance, uint32_t* pPhysicalDeviceCount, VkPhysicalDevice* pPhysicalDevices)
+{
+    NULL_VK_CALL();
+    static const VkPhysicalDevice device = new_handle<VkPhysicalDevice>();
+    return enumerate(std::vector<VkPhysicalDevice>{device}, pPhysicalDeviceCount, pPhysicalDevices);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceQueueFamilyProperties(VkPhysicalDevice, uint32_t* pQueueFamilyPropertyCount,
+                                                                    VkQueueFamilyProperties* pQueueFamilyProperties)
+{
+    NULL_VK_CALL();
+    VkQueueFamilyProperties family = {};
+    family.queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+    family.queueCount = 1;
+    family.timestampValidBits = 64;
+    family.minImageTransferGranularity = {1, 1, 1};
+    enumerate(std::vector<VkQueueFamilyProperties>{family}, pQueueFamilyPropertyCount, pQueueFamilyProperties);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties(VkPhysicalDevice, const char*, uint32_t* pPropertyCount,
+                                                                    VkExtensionProperties* pProperties)
+{
+    NULL_VK_CALL();
+    VkExtensionProperties swapchain = {};
+    std::strncpy(swapchain.extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_MAX_EXTENSION_NAME_SIZE - 1);
+    swapchain.specVersion = VK_KHR_SWAPCHAIN_SPEC_VERSION;
+    return enumerate(std::vector<VkExtensionProperties>{swapchain}, pPropertyCount, pProperties);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures(VkPhysicalDevice, VkPhysicalDeviceFeatures* pFeatures)
+{
+    NULL_VK_CALL();
+    *pFeatures = {};
+    pFeatures->samplerAnisotropy = VK_TRUE;
+    pFeatures->textureCompressionBC = VK_TRUE;
+    pFeatures->pipelineStatisticsQuery = VK_TRUE;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties* pProperties)
+{
+    NULL_VK_CALL();
+    *pProperties = get_properties();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties* pMemoryProperties)
+{
+    NULL_VK_CALL();
+    *pMemoryProperties = get_memory_properties();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties2* pMemoryProperties)
+{
+    NULL_VK_CALL();
+    pMemoryProperties->memoryProperties = get_memory_properties();
+}
+
+// every format does everything
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties(VkPhysicalDevice, VkFormat, VkFormatProperties* pFormatProperties)
+{
+    NULL_VK_CALL();
+    VkFormatFeatureFlags image_features = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                                        | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+                                        | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT | VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+                                        | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT
+                                        | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    pFormatProperties->linearTilingFeatures = image_features;
+    pFormatProperties->optimalTilingFeatures = image_features;
+    pFormatProperties->bufferFeatures = VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT | VK_FORMAT_FEATURE_UNIFORM_TEXEL_BUFFER_BIT;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice(VkPhysicalDevice, const VkDeviceCreateInfo*, const VkAllocationCallbacks*, VkDevice* pDevice)
+{
+    NULL_VK_CALL();
+    *pDevice = new_handle<VkDevice>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice(VkDevice, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue(VkDevice, uint32_t, uint32_t, VkQueue* pQueue)
+{
+    NULL_VK_CALL();
+    static const VkQueue queue = new_handle<VkQueue>();
+    *pQueue = queue;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle(VkDevice)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+/* surface and swapchain, there to link, glfw can't create a surface without a real loader */
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySurfaceKHR(VkInstance, VkSurfaceKHR, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR(VkPhysicalDevice, uint32_t, VkSurfaceKHR, VkBool32* pSupported)
+{
+    NULL_VK_CALL();
+    *pSupported = VK_TRUE;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VkPhysicalDevice, VkSurfaceKHR,
+                                                                         VkSurfaceCapabilitiesKHR* pSurfaceCapabilities)
+{
+    NULL_VK_CALL();
+    *pSurfaceCapabilities = {};
+    pSurfaceCapabilities->minImageCount = 2;
+    pSurfaceCapabilities->maxImageCount = 3;
+    pSurfaceCapabilities->currentExtent = {UINT32_MAX, UINT32_MAX};
+    pSurfaceCapabilities->minImageExtent = {1, 1};
+    pSurfaceCapabilities->maxImageExtent = {16384, 16384};
+    pSurfaceCapabilities->maxImageArrayLayers = 1;
+    pSurfaceCapabilities->supportedTransforms = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    pSurfaceCapabilities->currentTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+    pSurfaceCapabilities->supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    pSurfaceCapabilities->supportedUsageFlags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR(VkPhysicalDevice, VkSurfaceKHR, uint32_t* pSurfaceFormatCount,
+                                                                    VkSurfaceFormatKHR* pSurfaceFormats)
+{
+    NULL_VK_CALL();
+    VkSurfaceFormatKHR format = {VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+    return enumerate(std::vector<VkSurfaceFormatKHR>{format}, pSurfaceFormatCount, pSurfaceFormats);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfacePresentModesKHR(VkPhysicalDevice, VkSurfaceKHR, uint32_t* pPresentModeCount,
+                                                                         VkPresentModeKHR* pPresentModes)
+{
+    NULL_VK_CALL();
+    return enumerate(std::vector<VkPresentModeKHR>{VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_MAILBOX_KHR}, pPresentModeCount, pPresentModes);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR(VkDevice, const VkSwapchainCreateInfoKHR* pCreateInfo, const VkAllocationCallbacks*,
+                                                    VkSwapchainKHR* pSwapchain)
+{
+    NULL_VK_CALL();
+    auto swapchain = new null_swapchain;
+    for (uint32_t i = 0; i < std::max(1u, pCreateInfo->minImageCount); i++) {
+        swapchain->images.push_back(new_handle<VkImage>());
+    }
+    *pSwapchain = to_handle<VkSwapchainKHR>(swapchain);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR(VkDevice, VkSwapchainKHR swapchain, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+    delete from_handle<null_swapchain>(swapchain);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR(VkDevice, VkSwapchainKHR swapchain, uint32_t* pSwapchainImageCount,
+                                                       VkImage* pSwapchainImages)
+{
+    NULL_VK_CALL();
+    return enumerate(from_handle<null_swapchain>(swapchain)->images, pSwapchainImageCount, pSwapchainImages);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR(VkDevice, VkSwapchainKHR swapchain, uint64_t, VkSemaphore, VkFence, uint32_t* pImageIndex)
+{
+    NULL_VK_CALL();
+    auto state = from_handle<null_swapchain>(swapchain);
+    *pImageIndex = state->next_image;
+    state->next_image = (state->next_image + 1) % static_cast<uint32_t>(state->images.size());
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR(VkQueue, const VkPresentInfoKHR*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+/* memory, buffers and images */
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory(VkDevice, const VkMemoryAllocateInfo* pAllocateInfo, const VkAllocationCallbacks*,
+                                                VkDeviceMemory* pMemory)
+{
+    NULL_VK_CALL();
+    auto memory = new null_memory;
+    memory->size = pAllocateInfo->allocationSize;
+    *pMemory = to_handle<VkDeviceMemory>(memory);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+    auto state = from_handle<null_memory>(memory);
+    if (state != nullptr) {
+        std::free(state->data);
+        delete state;
+    }
+}
+
+// zeroed, and only touched pages take up any host memory
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void** ppData)
+{
+    NULL_VK_CALL();
+    auto state = from_handle<null_memory>(memory);
+    if (state->data == nullptr) {
+        state->data = std::calloc(1, static_cast<size_t>(state->size));
+        if (state->data == nullptr) {
+            return VK_ERROR_MEMORY_MAP_FAILED;
+        }
+    }
+    *ppData = static_cast<uint8_t*>(state->data) + offset;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory(VkDevice, VkDeviceMemory)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkInvalidateMappedMemoryRanges(VkDevice, uint32_t, const VkMappedMemoryRange*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer(VkDevice, const VkBufferCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkBuffer* pBuffer)
+{
+    NULL_VK_CALL();
+    auto buffer = new null_resource;
+    buffer->size = std::max<VkDeviceSize>(1, pCreateInfo->size);
+    *pBuffer = to_handle<VkBuffer>(buffer);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer(VkDevice, VkBuffer buffer, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+    delete from_handle<null_resource>(buffer);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage(VkDevice, const VkImageCreateInfo* pCreateInfo, const VkAllocationCallbacks*, VkImage* pImage)
+{
+    NULL_VK_CALL();
+    auto image = new null_resource;
+    image->size = get_image_size(*pCreateInfo);
+    *pImage = to_handle<VkImage>(image);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage(VkDevice, VkImage image, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+    delete from_handle<null_resource>(image);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements(VkDevice, VkBuffer buffer, VkMemoryRequirements* pMemoryRequirements)
+{
+    NULL_VK_CALL();
+    get_requirements(from_handle<null_resource>(buffer)->size, 256, pMemoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements(VkDevice, VkImage image, VkMemoryRequirements* pMemoryRequirements)
+{
+    NULL_VK_CALL();
+    get_requirements(from_handle<null_resource>(image)->size, 4096, pMemoryRequirements);
+}
+
+// vma's vulkan 1.1 paths, it looks these up by name
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements2(VkDevice, const VkBufferMemoryRequirementsInfo2* pInfo,
+                                                          VkMemoryRequirements2* pMemoryRequirements)
+{
+    NULL_VK_CALL();
+    get_requirements(from_handle<null_resource>(pInfo->buffer)->size, 256, &pMemoryRequirements->memoryRequirements);
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements2(VkDevice, const VkImageMemoryRequirementsInfo2* pInfo,
+                                                         VkMemoryRequirements2* pMemoryRequirements)
+{
+    NULL_VK_CALL();
+    get_requirements(from_handle<null_resource>(pInfo->image)->size, 4096, &pMemoryRequirements->memoryRequirements);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory(VkDevice, VkBuffer, VkDeviceMemory, VkDeviceSize)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory(VkDevice, VkImage, VkDeviceMemory, VkDeviceSize)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory2(VkDevice, uint32_t, const VkBindBufferMemoryInfo*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory2(VkDevice, uint32_t, const VkBindImageMemoryInfo*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+/* objects that only need a handle */
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView(VkDevice, const VkImageViewCreateInfo*, const VkAllocationCallbacks*, VkImageView* pView)
+{
+    NULL_VK_CALL();
+    *pView = new_handle<VkImageView>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView(VkDevice, VkImageView, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler(VkDevice, const VkSamplerCreateInfo*, const VkAllocationCallbacks*, VkSampler* pSampler)
+{
+    NULL_VK_CALL();
+    *pSampler = new_handle<VkSampler>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler(VkDevice, VkSampler, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass(VkDevice, const VkRenderPassCreateInfo*, const VkAllocationCallbacks*, VkRenderPass* pRenderPass)
+{
+    NULL_VK_CALL();
+    *pRenderPass = new_handle<VkRenderPass>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass(VkDevice, VkRenderPass, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer(VkDevice, const VkFramebufferCreateInfo*, const VkAllocationCallbacks*,
+                                                   VkFramebuffer* pFramebuffer)
+{
+    NULL_VK_CALL();
+    *pFramebuffer = new_handle<VkFramebuffer>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer(VkDevice, VkFramebuffer, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule(VkDevice, const VkShaderModuleCreateInfo*, const VkAllocationCallbacks*,
+                                                    VkShaderModule* pShaderModule)
+{
+    NULL_VK_CALL();
+    *pShaderModule = new_handle<VkShaderModule>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule(VkDevice, VkShaderModule, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo*, const VkAllocationCallbacks*,
+                                                           VkDescriptorSetLayout* pSetLayout)
+{
+    NULL_VK_CALL();
+    *pSetLayout = new_handle<VkDescriptorSetLayout>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout(VkDevice, const VkPipelineLayoutCreateInfo*, const VkAllocationCallbacks*,
+                                                      VkPipelineLayout* pPipelineLayout)
+{
+    NULL_VK_CALL();
+    *pPipelineLayout = new_handle<VkPipelineLayout>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout(VkDevice, VkPipelineLayout, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineCache(VkDevice, const VkPipelineCacheCreateInfo*, const VkAllocationCallbacks*,
+                                                     VkPipelineCache* pPipelineCache)
+{
+    NULL_VK_CALL();
+    *pPipelineCache = new_handle<VkPipelineCache>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineCache(VkDevice, VkPipelineCache, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+// always empty, so a real device's cache on disk is left alone
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPipelineCacheData(VkDevice, VkPipelineCache, size_t* pDataSize, void*)
+{
+    NULL_VK_CALL();
+    *pDataSize = 0;
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount, const VkGraphicsPipelineCreateInfo*,
+                                                         const VkAllocationCallbacks*, VkPipeline* pPipelines)
+{
+    NULL_VK_CALL();
+    for (uint32_t i = 0; i < createInfoCount; i++) {
+        pPipelines[i] = new_handle<VkPipeline>();
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines(VkDevice, VkPipelineCache, uint32_t createInfoCount, const VkComputePipelineCreateInfo*,
+                                                        const VkAllocationCallbacks*, VkPipeline* pPipelines)
+{
+    NULL_VK_CALL();
+    for (uint32_t i = 0; i < createInfoCount; i++) {
+        pPipelines[i] = new_handle<VkPipeline>();
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline(VkDevice, VkPipeline, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo*, const VkAllocationCallbacks*,
+                                                      VkDescriptorPool* pDescriptorPool)
+{
+    NULL_VK_CALL();
+    *pDescriptorPool = new_handle<VkDescriptorPool>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool(VkDevice, VkDescriptorPool, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetDescriptorPool(VkDevice, VkDescriptorPool, VkDescriptorPoolResetFlags)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets(VkDevice, const VkDescriptorSetAllocateInfo* pAllocateInfo, VkDescriptorSet* pDescriptorSets)
+{
+    NULL_VK_CALL();
+    for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+        pDescriptorSets[i] = new_handle<VkDescriptorSet>();
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets(VkDevice, uint32_t, const VkWriteDescriptorSet*, uint32_t, const VkCopyDescriptorSet*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool(VkDevice, const VkCommandPoolCreateInfo*, const VkAllocationCallbacks*,
+                                                   VkCommandPool* pCommandPool)
+{
+    NULL_VK_CALL();
+    *pCommandPool = new_handle<VkCommandPool>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool(VkDevice, VkCommandPool, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers(VkDevice, const VkCommandBufferAllocateInfo* pAllocateInfo, VkCommandBuffer* pCommandBuffers)
+{
+    NULL_VK_CALL();
+    for (uint32_t i = 0; i < pAllocateInfo->commandBufferCount; i++) {
+        pCommandBuffers[i] = new_handle<VkCommandBuffer>();
+    }
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers(VkDevice, VkCommandPool, uint32_t, const VkCommandBuffer*)
+{
+    NULL_VK_CALL();
+}
+
+/* synchronisation, the gpu is always done */
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence(VkDevice, const VkFenceCreateInfo*, const VkAllocationCallbacks*, VkFence* pFence)
+{
+    NULL_VK_CALL();
+    *pFence = new_handle<VkFence>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence(VkDevice, VkFence, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences(VkDevice, uint32_t, const VkFence*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences(VkDevice, uint32_t, const VkFence*, VkBool32, uint64_t)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus(VkDevice, VkFence)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore(VkDevice, const VkSemaphoreCreateInfo*, const VkAllocationCallbacks*, VkSemaphore* pSemaphore)
+{
+    NULL_VK_CALL();
+    *pSemaphore = new_handle<VkSemaphore>();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore(VkDevice, VkSemaphore, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit(VkQueue, uint32_t, const VkSubmitInfo*, VkFence)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle(VkQueue)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+/* queries, every result is available and zero */
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool(VkDevice, const VkQueryPoolCreateInfo* pCreateInfo, const VkAllocationCallbacks*,
+                                                 VkQueryPool* pQueryPool)
+{
+    NULL_VK_CALL();
+    auto pool = new null_query_pool;
+    if (pCreateInfo->queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS) {
+        pool->values_per_query = 0;
+        for (VkQueryPipelineStatisticFlags bits = pCreateInfo->pipelineStatistics; bits != 0; bits &= bits - 1) {
+            pool->values_per_query++;
+        }
+    }
+    *pQueryPool = to_handle<VkQueryPool>(pool);
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool(VkDevice, VkQueryPool queryPool, const VkAllocationCallbacks*)
+{
+    NULL_VK_CALL();
+    delete from_handle<null_query_pool>(queryPool);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults(VkDevice, VkQueryPool queryPool, uint32_t, uint32_t queryCount, size_t dataSize, void* pData,
+                                                     VkDeviceSize stride, VkQueryResultFlags flags)
+{
+    NULL_VK_CALL();
+    auto pool = from_handle<null_query_pool>(queryPool);
+    size_t value_size = (flags & VK_QUERY_RESULT_64_BIT) ? sizeof(uint64_t) : sizeof(uint32_t);
+    bool availability = (flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) != 0;
+    size_t query_size = value_size * (pool->values_per_query + (availability ? 1 : 0));
+    auto out = static_cast<uint8_t*>(pData);
+    for (uint32_t i = 0; i < queryCount; i++) {
+        size_t offset = static_cast<size_t>(i * stride);
+        if (offset + query_size > dataSize) {
+            break;
+        }
+        std::memset(out + offset, 0, query_size);
+        if (availability) {
+            out[offset + value_size * pool->values_per_query] = 1;
+        }
+    }
+    return VK_SUCCESS;
+}
+
+/* commands, recorded nowhere */
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer(VkCommandBuffer, const VkCommandBufferBeginInfo*)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer(VkCommandBuffer)
+{
+    NULL_VK_CALL();
+    return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass(VkCommandBuffer, const VkRenderPassBeginInfo*, VkSubpassContents)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass(VkCommandBuffer)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline(VkCommandBuffer, VkPipelineBindPoint, VkPipeline)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets(VkCommandBuffer, VkPipelineBindPoint, VkPipelineLayout, uint32_t, uint32_t,
+                                                   const VkDescriptorSet*, uint32_t, const uint32_t*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers(VkCommandBuffer, uint32_t, uint32_t, const VkBuffer*, const VkDeviceSize*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkIndexType)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport(VkCommandBuffer, uint32_t, uint32_t, const VkViewport*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor(VkCommandBuffer, uint32_t, uint32_t, const VkRect2D*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw(VkCommandBuffer, uint32_t, uint32_t, uint32_t, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed(VkCommandBuffer, uint32_t, uint32_t, uint32_t, int32_t, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatch(VkCommandBuffer, uint32_t, uint32_t, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier(VkCommandBuffer, VkPipelineStageFlags, VkPipelineStageFlags, VkDependencyFlags,
+                                                uint32_t, const VkMemoryBarrier*, uint32_t, const VkBufferMemoryBarrier*,
+                                                uint32_t, const VkImageMemoryBarrier*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer(VkCommandBuffer, VkBuffer, VkBuffer, uint32_t, const VkBufferCopy*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage(VkCommandBuffer, VkBuffer, VkImage, VkImageLayout, uint32_t, const VkBufferImageCopy*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImageToBuffer(VkCommandBuffer, VkImage, VkImageLayout, VkBuffer, uint32_t, const VkBufferImageCopy*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyImage(VkCommandBuffer, VkImage, VkImageLayout, VkImage, VkImageLayout, uint32_t, const VkImageCopy*)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBlitImage(VkCommandBuffer, VkImage, VkImageLayout, VkImage, VkImageLayout, uint32_t, const VkImageBlit*, VkFilter)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdFillBuffer(VkCommandBuffer, VkBuffer, VkDeviceSize, VkDeviceSize, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool(VkCommandBuffer, VkQueryPool, uint32_t, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginQuery(VkCommandBuffer, VkQueryPool, uint32_t, VkQueryControlFlags)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndQuery(VkCommandBuffer, VkQueryPool, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp(VkCommandBuffer, VkPipelineStageFlagBits, VkQueryPool, uint32_t)
+{
+    NULL_VK_CALL();
+}
+
+/* lookups, only what vma asks for by name */
+
+static PFN_vkVoidFunction get_proc_addr(const char* name)
+{
+    struct named_function {
+        const char* name;
+        PFN_vkVoidFunction function;
+    };
+    static const named_function functions[] = {
+        {"vkGetBufferMemoryRequirements2", reinterpret_cast<PFN_vkVoidFunction>(&vkGetBufferMemoryRequirements2)},
+        {"vkGetBufferMemoryRequirements2KHR", reinterpret_cast<PFN_vkVoidFunction>(&vkGetBufferMemoryRequirements2)},
+        {"vkGetImageMemoryRequirements2", reinterpret_cast<PFN_vkVoidFunction>(&vkGetImageMemoryRequirements2)},
+        {"vkGetImageMemoryRequirements2KHR", reinterpret_cast<PFN_vkVoidFunction>(&vkGetImageMemoryRequirements2)},
+        {"vkBindBufferMemory2", reinterpret_cast<PFN_vkVoidFunction>(&vkBindBufferMemory2)},
+        {"vkBindBufferMemory2KHR", reinterpret_cast<PFN_vkVoidFunction>(&vkBindBufferMemory2)},
+        {"vkBindImageMemory2", reinterpret_cast<PFN_vkVoidFunction>(&vkBindImageMemory2)},
+        {"vkBindImageMemory2KHR", reinterpret_cast<PFN_vkVoidFunction>(&vkBindImageMemory2)},
+        {"vkGetPhysicalDeviceMemoryProperties2", reinterpret_cast<PFN_vkVoidFunction>(&vkGetPhysicalDeviceMemoryProperties2)},
+        {"vkGetPhysicalDeviceMemoryProperties2KHR", reinterpret_cast<PFN_vkVoidFunction>(&vkGetPhysicalDeviceMemoryProperties2)},
+    };
+    for (auto& function : functions) {
+        if (std::strcmp(function.name, name) == 0) {
+            return function.function;
+        }
+    }
+    return nullptr;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr(VkInstance, const char* pName)
+{
+    NULL_VK_CALL();
+    return get_proc_addr(pName);
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetDeviceProcAddr(VkDevice, const char* pName)
+{
+    NULL_VK_CALL();
+    return get_proc_addr(pName);
+}
+
+#endif
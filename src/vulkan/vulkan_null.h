@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * with DISCOVERY_NULL_VULKAN (a cmake option) the engine links against stubs of every vulkan
+ * function it calls instead of the vulkan loader, so it runs on machines without a gpu or driver.
+ * the stubs hand out fake handles and count their calls, and do no gpu work. the engine's own cpu
+ * work (command recording, descriptor updates, the loader) all still runs, as does vma on top of
+ * stubbed device memory that is only backed by host memory once mapped. there is no window
+ * surface, so only headless runs work. without the option the functions below report nothing
+ */
+
+struct null_vulkan_call_count {
+    std::string name;       // of the vk* function
+    uint64_t calls = 0;
+};
+
+// whether this build uses the stubs
+bool null_vulkan_enabled();
+
+// calls per vk* function since startup or the last reset, most called first. thread safe,
+// calls made while this runs may be left out
+std::vector<null_vulkan_call_count> null_vulkan_get_calls();
+void null_vulkan_reset_calls();
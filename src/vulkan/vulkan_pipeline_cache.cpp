@@ -0,0 +1,120 @@
+#include "vulkan_base.h"
+
+#include "../platform.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+// the header every VkPipelineCache blob starts with, see VkPipelineCacheHeaderVersionOne
+struct pipeline_cache_header {
+    uint32_t header_length;
+    uint32_t header_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint8_t cache_uuid[VK_UUID_SIZE];
+};
+
+/*
+ * drivers are meant to reject foreign cache data themselves but not all of them do, so the
+ * header is checked against this device before the data is handed over
+ */
+static bool is_pipeline_cache_compatible(vulkan_data& data, const std::vector<char>& cache_data)
+{
+    if (cache_data.size() < sizeof(pipeline_cache_header)) {
+        return false;
+    }
+    pipeline_cache_header header;
+    std::memcpy(&header, cache_data.data(), sizeof(header));
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(data.physical_device, &properties);
+
+    return header.header_length >= sizeof(pipeline_cache_header)
+        && header.header_length <= cache_data.size()
+        && header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendor_id == properties.vendorID
+        && header.device_id == properties.deviceID
+        && std::memcmp(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+void create_pipeline_cache(vulkan_data* data)
+{
+    /* load the previous run's cache, anything missing or stale starts empty */
+    std::vector<char> cache_data;
+    if (!data->pipeline_cache_path.empty()) {
+        std::string abs_path = to_absolute_path(data->pipeline_cache_path);
+        if (std::filesystem::exists(abs_path)) {
+            try {
+                cache_data = read_data_from_binary_file(abs_path);
+            } catch (const std::exception&) {
+            }
+            if (!is_pipeline_cache_compatible(*data, cache_data)) {
+                cache_data.clear();
+            }
+        }
+    }
+
+    VkPipelineCacheCreateInfo create_info{};
+    create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.initialDataSize = cache_data.size();
+    create_info.pInitialData = cache_data.empty() ? nullptr : cache_data.data();
+
+    if (vkCreatePipelineCache(data->logical_device, &create_info, nullptr, &data->pipeline_cache) != VK_SUCCESS) {
+        // the driver refused the data after all, an empty cache still works
+        create_info.initialDataSize = 0;
+        create_info.pInitialData = nullptr;
+        if (vkCreatePipelineCache(data->logical_device, &create_info, nullptr, &data->pipeline_cache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+}
+
+void save_pipeline_cache(vulkan_data& data)
+{
+    if (data.pipeline_cache == VK_NULL_HANDLE || data.pipeline_cache_path.empty()) {
+        return;
+    }
+
+    size_t size = 0;
+    if (vkGetPipelineCacheData(data.logical_device, data.pipeline_cache, &size, nullptr) != VK_SUCCESS || size == 0) {
+        return;
+    }
+    std::vector<char> cache_data(size);
+    if (vkGetPipelineCacheData(data.logical_device, data.pipeline_cache, &size, cache_data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    /* failing to write the cache is not fatal, the next run just compiles again */
+    try {
+        std::filesystem::path abs_path = to_absolute_path(data.pipeline_cache_path);
+        if (abs_path.has_parent_path()) {
+            std::filesystem::create_directories(abs_path.parent_path());
+        }
+        // write to a temporary file first so a partially written cache is never read back
+        std::filesystem::path temp_path = abs_path.string() + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                return;
+            }
+            file.write(cache_data.data(), static_cast<std::streamsize>(size));
+            file.close();
+            if (!file) {
+                // a short write, e.g. a full disk, must not be renamed into place
+                std::error_code ec;
+                std::filesystem::remove(temp_path, ec);
+                return;
+            }
+        }
+        std::filesystem::rename(temp_path, abs_path);
+    } catch (const std::exception&) {
+    }
+}
+
+void destroy_pipeline_cache(vulkan_data& data)
+{
+    save_pipeline_cache(data);
+    vkDestroyPipelineCache(data.logical_device, data.pipeline_cache, nullptr);
+    data.pipeline_cache = VK_NULL_HANDLE;
+}
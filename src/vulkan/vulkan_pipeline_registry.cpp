@@ -0,0 +1,500 @@
+#include "vulkan_base.h"
+
+#include "../platform.h"
+
+#include <algorithm>
+
+// the bytes of the fields that affect the created object, pointers and sTypes are skipped. maps are
+// keyed by the whole thing rather than a hash of it, so equal keys always mean identical objects
+struct state_key {
+    std::string bytes;
+
+    void add_bytes(const void* data, size_t size) {
+        bytes.append(static_cast<const char*>(data), size);
+    }
+
+    template <typename T>
+    void add(const T& v) {
+        add_bytes(&v, sizeof(T));
+    }
+
+    void add(const std::string& s) {
+        add(s.size());
+        add_bytes(s.data(), s.size());
+    }
+
+    // only for element types without padding
+    template <typename T>
+    void add_vector(const std::vector<T>& v) {
+        add(v.size());
+        if (!v.empty()) {
+            add_bytes(v.data(), v.size() * sizeof(T));
+        }
+    }
+};
+
+static void sort_decls(std::vector<uniform_buffer_decl>& decls)
+{
+    /* sort decls so that result is in order set 0..n with binding 0..m */
+    std::sort(decls.begin(), decls.end(), [](const uniform_buffer_decl& a, const uniform_buffer_decl& b){
+        if (a.set != b.set) {
+            return a.set < b.set;
+        } else {
+            return a.binding < b.binding;
+        }
+    });
+}
+
+std::string get_pipeline_state_key(const pipeline_state& state)
+{
+    state_key h;
+
+    h.add(state.shader_stages.size());
+    for (auto& stage : state.shader_stages) {
+        h.add(stage.path);
+        h.add(stage.type);
+        h.add(stage.entry_point);
+    }
+    h.add_vector(state.vertex_bindings);
+    h.add_vector(state.vertex_attributes);
+
+    h.add(state.input_assembly.topology);
+    h.add(state.input_assembly.primitiveRestartEnable);
+    // dynamic viewports and scissors only count, or every resize would make new pipelines
+    auto is_dynamic = [&](VkDynamicState dynamic_state) {
+        return std::find(state.dynamic_states.begin(), state.dynamic_states.end(), dynamic_state) != state.dynamic_states.end();
+    };
+    if (is_dynamic(VK_DYNAMIC_STATE_VIEWPORT)) {
+        h.add(state.viewports.size());
+    } else {
+        h.add_vector(state.viewports);
+    }
+    if (is_dynamic(VK_DYNAMIC_STATE_SCISSOR)) {
+        h.add(state.scissors.size());
+    } else {
+        h.add_vector(state.scissors);
+    }
+
+    auto& r = state.rasterization;
+    h.add(r.depthClampEnable);
+    h.add(r.rasterizerDiscardEnable);
+    h.add(r.polygonMode);
+    h.add(r.cullMode);
+    h.add(r.frontFace);
+    h.add(r.depthBiasEnable);
+    h.add(r.depthBiasConstantFactor);
+    h.add(r.depthBiasClamp);
+    h.add(r.depthBiasSlopeFactor);
+    h.add(r.lineWidth);
+
+    // pSampleMask isn't followed, pipelines using one must differ in some other field
+    auto& m = state.multisample;
+    h.add(m.rasterizationSamples);
+    h.add(m.sampleShadingEnable);
+    h.add(m.minSampleShading);
+    h.add(m.alphaToCoverageEnable);
+    h.add(m.alphaToOneEnable);
+
+    h.add(state.color_blend.logicOpEnable);
+    h.add(state.color_blend.logicOp);
+    h.add(state.color_blend.blendConstants);
+    h.add_vector(state.blend_attachments);
+
+    auto& d = state.depth_stencil;
+    h.add(d.depthTestEnable);
+    h.add(d.depthWriteEnable);
+    h.add(d.depthCompareOp);
+    h.add(d.depthBoundsTestEnable);
+    h.add(d.stencilTestEnable);
+    h.add(d.front);
+    h.add(d.back);
+    h.add(d.minDepthBounds);
+    h.add(d.maxDepthBounds);
+
+    h.add_vector(state.dynamic_states);
+    auto decls = state.descriptor_decls;
+    sort_decls(decls);
+    h.add_vector(decls);
+    h.add_vector(state.specialization_constants);
+
+    h.add(state.render_pass);
+    h.add(state.subpass);
+    return h.bytes;
+}
+
+std::string get_compute_pipeline_state_key(const compute_pipeline_state& state)
+{
+    state_key h;
+    h.add(state.shader_stage.path);
+    h.add(state.shader_stage.type);
+    h.add(state.shader_stage.entry_point);
+    auto decls = state.descriptor_decls;
+    sort_decls(decls);
+    h.add_vector(decls);
+    h.add_vector(state.specialization_constants);
+    return h.bytes;
+}
+
+void pipeline_registry::initialise(vulkan_data& vkdata, uint32_t thread_count)
+{
+    this->pool.initialise(thread_count);
+}
+
+void pipeline_registry::terminate(vulkan_data& vkdata)
+{
+    this->pool.wait_idle();
+    this->pool.terminate();
+
+    for (auto& pipeline : this->pipelines) {
+        if (pipeline.second->pipeline != VK_NULL_HANDLE) {
+            if (vkdata.capture != nullptr) {
+                vkdata.capture->forget(capture_object_type::PIPELINE, pipeline.second->pipeline);
+            }
+            vkDestroyPipeline(vkdata.logical_device, pipeline.second->pipeline, nullptr);
+        }
+    }
+    this->pipelines.clear();
+    for (auto& pipeline : this->compute_pipelines) {
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->forget(capture_object_type::PIPELINE, pipeline.second);
+        }
+        vkDestroyPipeline(vkdata.logical_device, pipeline.second, nullptr);
+    }
+    this->compute_pipelines.clear();
+    for (auto& layout : this->layouts) {
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->forget(capture_object_type::PIPELINE_LAYOUT, layout.second.layout);
+        }
+        vkDestroyPipelineLayout(vkdata.logical_device, layout.second.layout, nullptr);
+    }
+    this->layouts.clear();
+    for (auto& set_layout : this->set_layouts) {
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->forget(capture_object_type::DESCRIPTOR_SET_LAYOUT, set_layout.second);
+        }
+        vkDestroyDescriptorSetLayout(vkdata.logical_device, set_layout.second, nullptr);
+    }
+    this->set_layouts.clear();
+    for (auto& module : this->shader_modules) {
+        vkDestroyShaderModule(vkdata.logical_device, module.second, nullptr);
+    }
+    this->shader_modules.clear();
+}
+
+VkShaderModule pipeline_registry::get_shader_module(vulkan_data& vkdata, const std::string& path)
+{
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        auto it = this->shader_modules.find(path);
+        if (it != this->shader_modules.end()) {
+            return it->second;
+        }
+    }
+
+    // loaded without the lock held, if another thread got there first its module is kept
+    auto code = read_data_from_binary_file(to_absolute_path(path));
+    VkShaderModule module = create_shader_module_from_spirv(vkdata, code);
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto inserted = this->shader_modules.emplace(path, module);
+    if (!inserted.second) {
+        vkDestroyShaderModule(vkdata.logical_device, module, nullptr);
+    }
+    return inserted.first->second;
+}
+
+pipeline_layout_entry pipeline_registry::get_layout(vulkan_data& vkdata, std::vector<uniform_buffer_decl> decls)
+{
+    sort_decls(decls);
+    std::unique_lock<std::mutex> lock(this->mutex);
+
+    // combine declarations of the same set into a descriptor set layout, shared between layouts
+    std::vector<VkDescriptorSetLayout> layouts_for_sets;
+    for (size_t first = 0; first < decls.size();) {
+        std::vector<VkDescriptorSetLayoutBinding> layout_bindings;
+        state_key set_key;
+        size_t i = first;
+        for (; i < decls.size() && decls[i].set == decls[first].set; i++) {
+            VkDescriptorSetLayoutBinding binding = {};
+            binding.binding = decls[i].binding;
+            binding.descriptorType = decls[i].type;
+            binding.descriptorCount = 1;
+            binding.stageFlags = decls[i].shaderFlags;
+            binding.pImmutableSamplers = nullptr;
+            layout_bindings.push_back(binding);
+
+            set_key.add(decls[i].binding);
+            set_key.add(decls[i].type);
+            set_key.add(decls[i].shaderFlags);
+        }
+        first = i;
+
+        auto it = this->set_layouts.find(set_key.bytes);
+        if (it == this->set_layouts.end()) {
+            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = static_cast<uint32_t>(layout_bindings.size());
+            layoutInfo.pBindings = layout_bindings.data();
+            VkDescriptorSetLayout set_layout;
+            if (vkCreateDescriptorSetLayout(vkdata.logical_device, &layoutInfo, nullptr, &set_layout) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create descriptor set layout!");
+            }
+            if (vkdata.capture != nullptr) {
+                vkdata.capture->track_descriptor_set_layout(set_layout, layoutInfo);
+            }
+            it = this->set_layouts.emplace(set_key.bytes, set_layout).first;
+        }
+        layouts_for_sets.push_back(it->second);
+    }
+
+    state_key layout_key;
+    layout_key.add_vector(layouts_for_sets);
+    auto it = this->layouts.find(layout_key.bytes);
+    if (it == this->layouts.end()) {
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(layouts_for_sets.size());
+        pipelineLayoutInfo.pSetLayouts = layouts_for_sets.empty() ? nullptr : layouts_for_sets.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
+        pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+
+        pipeline_layout_entry entry;
+        entry.set_layouts = layouts_for_sets;
+        if (vkCreatePipelineLayout(vkdata.logical_device, &pipelineLayoutInfo, nullptr, &entry.layout) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline layout!");
+        }
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->track_pipeline_layout(entry.layout, pipelineLayoutInfo);
+        }
+        it = this->layouts.emplace(layout_key.bytes, entry).first;
+    }
+    return it->second;
+}
+
+pipeline_registry::pipeline_entry* pipeline_registry::find_or_insert(const pipeline_state& state)
+{
+    std::string key = get_pipeline_state_key(state);
+    auto it = this->pipelines.find(key);
+    if (it == this->pipelines.end()) {
+        auto entry = std::make_unique<pipeline_entry>();
+        entry->state = state;
+        it = this->pipelines.emplace(key, std::move(entry)).first;
+    }
+    return it->second.get();
+}
+
+void pipeline_registry::compile(vulkan_data& vkdata, pipeline_entry& entry)
+{
+    // entry.state doesn't change once inserted, only the results need the lock
+    const auto& state = entry.state;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    std::exception_ptr error = nullptr;
+    try {
+        auto layout = this->get_layout(vkdata, state.descriptor_decls);
+
+        // every constant is 32 bits, packed in declaration order
+        std::vector<VkSpecializationMapEntry> map_entries;
+        std::vector<uint32_t> constant_data;
+        for (auto& constant : state.specialization_constants) {
+            map_entries.push_back({constant.id, static_cast<uint32_t>(constant_data.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+            constant_data.push_back(constant.value);
+        }
+        VkSpecializationInfo specialization_info = {};
+        specialization_info.mapEntryCount = static_cast<uint32_t>(map_entries.size());
+        specialization_info.pMapEntries = map_entries.data();
+        specialization_info.dataSize = constant_data.size() * sizeof(uint32_t);
+        specialization_info.pData = constant_data.data();
+
+        std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
+        for (auto& stage : state.shader_stages) {
+            shader_stages.push_back(gen_shader_stage_create_info(this->get_shader_module(vkdata, stage.path), stage.type, stage.entry_point.c_str(),
+                                                                 map_entries.empty() ? nullptr : &specialization_info));
+        }
+
+        VkPipelineVertexInputStateCreateInfo vertex_input_state_info = {};
+        vertex_input_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertex_input_state_info.vertexBindingDescriptionCount = (uint32_t)state.vertex_bindings.size();
+        vertex_input_state_info.pVertexBindingDescriptions = state.vertex_bindings.data();
+        vertex_input_state_info.vertexAttributeDescriptionCount = (uint32_t)state.vertex_attributes.size();
+        vertex_input_state_info.pVertexAttributeDescriptions = state.vertex_attributes.data();
+
+        VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
+        dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state_info.dynamicStateCount = (uint32_t)state.dynamic_states.size();
+        dynamic_state_info.pDynamicStates = state.dynamic_states.data();
+
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = (uint32_t)state.viewports.size();
+        viewportState.pViewports = state.viewports.data();
+        viewportState.scissorCount = (uint32_t)state.scissors.size();
+        viewportState.pScissors = state.scissors.data();
+
+        VkPipelineColorBlendStateCreateInfo color_blend_state_info = state.color_blend;
+        color_blend_state_info.attachmentCount = (uint32_t)state.blend_attachments.size();
+        color_blend_state_info.pAttachments = state.blend_attachments.data();
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = (uint32_t)shader_stages.size();
+        pipelineInfo.pStages = shader_stages.data();
+        pipelineInfo.pVertexInputState = &vertex_input_state_info;
+        pipelineInfo.pInputAssemblyState = &state.input_assembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &state.rasterization;
+        pipelineInfo.pMultisampleState = &state.multisample;
+        pipelineInfo.pDepthStencilState = &state.depth_stencil;
+        pipelineInfo.pColorBlendState = &color_blend_state_info;
+        pipelineInfo.pDynamicState = state.dynamic_states.empty() ? nullptr : &dynamic_state_info;
+        pipelineInfo.layout = layout.layout;
+        pipelineInfo.renderPass = state.render_pass;
+        pipelineInfo.subpass = state.subpass;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
+        pipelineInfo.basePipelineIndex = -1; // Optional
+
+        // the pipeline cache is internally synchronised, compiles run in parallel
+        if (vkCreateGraphicsPipelines(vkdata.logical_device, vkdata.pipeline_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline!");
+        }
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->track_pipeline(pipeline, state);
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        entry.pipeline = pipeline;
+        entry.error = error;
+        entry.ready = (error == nullptr);
+        entry.compiling = false;
+    }
+    this->compiled.notify_all();
+}
+
+void pipeline_registry::wait_for(std::unique_lock<std::mutex>& lock, pipeline_entry& entry)
+{
+    this->compiled.wait(lock, [&]{ return !entry.compiling; });
+    if (entry.error) {
+        std::rethrow_exception(entry.error);
+    }
+}
+
+VkPipeline pipeline_registry::get(vulkan_data& vkdata, const pipeline_state& state)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto entry = this->find_or_insert(state);
+    if (!entry->ready && !entry->compiling && !entry->error) {
+        entry->compiling = true;
+        lock.unlock();
+        this->compile(vkdata, *entry);
+        lock.lock();
+    }
+    this->wait_for(lock, *entry);
+    return entry->pipeline;
+}
+
+VkPipeline pipeline_registry::get_async(vulkan_data& vkdata, const pipeline_state& state)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto entry = this->find_or_insert(state);
+    if (entry->ready) {
+        return entry->pipeline;
+    }
+    if (entry->error) {
+        std::rethrow_exception(entry->error);
+    }
+    if (!entry->compiling) {
+        entry->compiling = true;
+        this->pool.submit([this, &vkdata, entry]{ this->compile(vkdata, *entry); });
+    }
+    return VK_NULL_HANDLE;
+}
+
+void pipeline_registry::warm_up(vulkan_data& vkdata, const std::vector<pipeline_state>& states)
+{
+    std::unique_lock<std::mutex> lock(this->mutex);
+    std::vector<pipeline_entry*> entries;
+    for (auto& state : states) {
+        auto entry = this->find_or_insert(state);
+        if (!entry->ready && !entry->compiling && !entry->error) {
+            entry->compiling = true;
+            this->pool.submit([this, &vkdata, entry]{ this->compile(vkdata, *entry); });
+        }
+        entries.push_back(entry);
+    }
+    for (auto entry : entries) {
+        this->wait_for(lock, *entry);
+    }
+}
+
+VkPipeline pipeline_registry::get_compute(vulkan_data& vkdata, const compute_pipeline_state& state)
+{
+    std::string key = get_compute_pipeline_state_key(state);
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        auto it = this->compute_pipelines.find(key);
+        if (it != this->compute_pipelines.end()) {
+            return it->second;
+        }
+    }
+
+    auto layout = this->get_layout(vkdata, state.descriptor_decls);
+
+    std::vector<VkSpecializationMapEntry> map_entries;
+    std::vector<uint32_t> constant_data;
+    for (auto& constant : state.specialization_constants) {
+        map_entries.push_back({constant.id, static_cast<uint32_t>(constant_data.size() * sizeof(uint32_t)), sizeof(uint32_t)});
+        constant_data.push_back(constant.value);
+    }
+    VkSpecializationInfo specialization_info = {};
+    specialization_info.mapEntryCount = static_cast<uint32_t>(map_entries.size());
+    specialization_info.pMapEntries = map_entries.data();
+    specialization_info.dataSize = constant_data.size() * sizeof(uint32_t);
+    specialization_info.pData = constant_data.data();
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = gen_shader_stage_create_info(this->get_shader_module(vkdata, state.shader_stage.path), state.shader_stage.type,
+                                                      state.shader_stage.entry_point.c_str(), map_entries.empty() ? nullptr : &specialization_info);
+    pipelineInfo.layout = layout.layout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(vkdata.logical_device, vkdata.pipeline_cache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline!");
+    }
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    auto inserted = this->compute_pipelines.emplace(key, pipeline);
+    if (!inserted.second) {
+        // created by another thread in the meantime
+        vkDestroyPipeline(vkdata.logical_device, pipeline, nullptr);
+    } else if (vkdata.capture != nullptr) {
+        vkdata.capture->track_pipeline(pipeline, state);
+    }
+    return inserted.first->second;
+}
+
+void pipeline_registry::release_render_pass(vulkan_data& vkdata, VkRenderPass render_pass)
+{
+    // compiles never throw out of the pool, their errors are kept in the entries
+    this->pool.wait_idle();
+
+    std::unique_lock<std::mutex> lock(this->mutex);
+    for (auto it = this->pipelines.begin(); it != this->pipelines.end();) {
+        if (it->second->state.render_pass == render_pass) {
+            if (it->second->pipeline != VK_NULL_HANDLE) {
+                if (vkdata.capture != nullptr) {
+                    vkdata.capture->forget(capture_object_type::PIPELINE, it->second->pipeline);
+                }
+                vkDestroyPipeline(vkdata.logical_device, it->second->pipeline, nullptr);
+            }
+            it = this->pipelines.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
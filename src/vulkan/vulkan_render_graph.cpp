@@ -0,0 +1,952 @@
+#include "vulkan_base.h"
+
+#include <algorithm>
+#include <cmath>
+
+/* render graph */
+
+struct usage_info {
+    VkImageLayout layout;
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkImageUsageFlags image_usage;
+    bool write;
+    bool attachment;
+};
+
+static usage_info get_usage_info(render_graph_usage usage, render_graph_pass_type type)
+{
+    VkPipelineStageFlags shader_stage = (type == render_graph_pass_type::COMPUTE) ?
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+    switch (usage) {
+        case render_graph_usage::COLOR_ATTACHMENT:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true};
+        case render_graph_usage::DEPTH_ATTACHMENT:
+            return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, depth_stages,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true, true};
+        case render_graph_usage::DEPTH_READ:
+            return {VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, depth_stages,
+                    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, false, true};
+        case render_graph_usage::RESOLVE_ATTACHMENT:
+            return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true, true};
+        case render_graph_usage::SAMPLED:
+            return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, shader_stage, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_USAGE_SAMPLED_BIT, false, false};
+        case render_graph_usage::STORAGE_READ:
+            return {VK_IMAGE_LAYOUT_GENERAL, shader_stage, VK_ACCESS_SHADER_READ_BIT,
+                    VK_IMAGE_USAGE_STORAGE_BIT, false, false};
+        case render_graph_usage::STORAGE_WRITE:
+            return {VK_IMAGE_LAYOUT_GENERAL, shader_stage, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+                    VK_IMAGE_USAGE_STORAGE_BIT, true, false};
+        case render_graph_usage::TRANSFER_SRC:
+            return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT, false, false};
+        case render_graph_usage::TRANSFER_DST:
+            return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT, true, false};
+    }
+    throw std::logic_error("unknown render graph usage!");
+}
+
+static bool is_depth_format(VkFormat format)
+{
+    switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool has_stencil(VkFormat format)
+{
+    return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+// views only ever see depth, barriers have to cover stencil too
+static VkImageAspectFlags get_aspect_mask(VkFormat format, bool include_stencil)
+{
+    if (!is_depth_format(format)) {
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+    if (include_stencil && has_stencil(format)) {
+        aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    }
+    return aspect;
+}
+
+static bool is_transfer_usage(render_graph_usage usage)
+{
+    return usage == render_graph_usage::TRANSFER_SRC || usage == render_graph_usage::TRANSFER_DST;
+}
+
+// previous contents are gone after these, so earlier writers aren't needed
+static bool overwrites(bool clear, render_graph_usage usage)
+{
+    return clear || usage == render_graph_usage::RESOLVE_ATTACHMENT;
+}
+
+void render_graph::check_declarable() const
+{
+    if (this->planned) {
+        throw std::logic_error("render graph declarations are fixed once it has been compiled!");
+    }
+}
+
+render_graph_resource render_graph::create_image(const std::string& name, const render_graph_image_desc& desc)
+{
+    this->check_declarable();
+    if (desc.format == VK_FORMAT_UNDEFINED) {
+        throw std::logic_error("render graph image " + name + " has no format!");
+    }
+    resource_entry resource;
+    resource.name = name;
+    resource.desc = desc;
+    this->resources.push_back(resource);
+    return static_cast<render_graph_resource>(this->resources.size() - 1);
+}
+
+render_graph_resource render_graph::get_backbuffer()
+{
+    if (this->backbuffer == UINT32_MAX) {
+        this->check_declarable();
+        resource_entry resource;
+        resource.name = "backbuffer";
+        resource.backbuffer = true;
+        this->resources.push_back(resource);
+        this->backbuffer = static_cast<render_graph_resource>(this->resources.size() - 1);
+    }
+    return this->backbuffer;
+}
+
+void render_graph::set_output(render_graph_resource resource)
+{
+    this->check_declarable();
+    this->resources.at(resource).output = true;
+}
+
+render_graph_pass render_graph::add_pass(const std::string& name, render_graph_pass_type type, record_function record)
+{
+    this->check_declarable();
+    pass_entry pass;
+    pass.name = name;
+    pass.type = type;
+    pass.record = std::move(record);
+    this->passes.push_back(std::move(pass));
+    return static_cast<render_graph_pass>(this->passes.size() - 1);
+}
+
+void render_graph::add_use(render_graph_pass pass, render_graph_resource resource, render_graph_usage usage, bool write)
+{
+    this->check_declarable();
+    auto& entry = this->passes.at(pass);
+    auto& res = this->resources.at(resource);
+    auto info = get_usage_info(usage, entry.type);
+
+    if (info.write != write) {
+        throw std::logic_error("render graph pass " + entry.name + " declares " + res.name + (write ? " as a write with a read usage!" : " as a read with a write usage!"));
+    }
+    if (info.attachment && entry.type != render_graph_pass_type::GRAPHICS) {
+        throw std::logic_error("render graph pass " + entry.name + " uses " + res.name + " as an attachment but is not a graphics pass!");
+    }
+    if (is_transfer_usage(usage) != (entry.type == render_graph_pass_type::TRANSFER)) {
+        throw std::logic_error("render graph pass " + entry.name + " uses " + res.name + (is_transfer_usage(usage) ?
+                               " for a transfer but is not a transfer pass!" : " in a shader or attachment but is a transfer pass!"));
+    }
+    if (res.backbuffer && usage != render_graph_usage::COLOR_ATTACHMENT && usage != render_graph_usage::RESOLVE_ATTACHMENT &&
+            usage != render_graph_usage::TRANSFER_DST) {
+        throw std::logic_error("the backbuffer can only be a color or resolve attachment or a transfer destination!");
+    }
+    for (auto& use : entry.uses) {
+        if (use.resource == resource) {
+            throw std::logic_error("render graph pass " + entry.name + " uses " + res.name + " twice!");
+        }
+    }
+
+    image_use use;
+    use.resource = resource;
+    use.usage = usage;
+    entry.uses.push_back(use);
+}
+
+void render_graph::read(render_graph_pass pass, render_graph_resource resource, render_graph_usage usage)
+{
+    this->add_use(pass, resource, usage, false);
+}
+
+void render_graph::write(render_graph_pass pass, render_graph_resource resource, render_graph_usage usage)
+{
+    this->add_use(pass, resource, usage, true);
+}
+
+void render_graph::clear(render_graph_pass pass, render_graph_resource resource, VkClearValue value)
+{
+    this->check_declarable();
+    auto& entry = this->passes.at(pass);
+    for (auto& use : entry.uses) {
+        if (use.resource != resource) {
+            continue;
+        }
+        if (use.usage != render_graph_usage::COLOR_ATTACHMENT && use.usage != render_graph_usage::DEPTH_ATTACHMENT) {
+            throw std::logic_error("render graph pass " + entry.name + " can only clear color and depth attachments it writes!");
+        }
+        use.clear = true;
+        use.clear_value = value;
+        return;
+    }
+    throw std::logic_error("render graph pass " + entry.name + " clears " + this->resources.at(resource).name + " without writing it!");
+}
+
+void render_graph::plan(vulkan_data& vkdata)
+{
+    /*
+     * cull, walking back from the outputs. a pass is live when it writes something needed, what it
+     * reads is needed from then on and so is what it writes without overwriting. persistent images
+     * are read by the next frame so they count as outputs
+     */
+    std::vector<bool> needed(this->resources.size());
+    for (size_t r = 0; r < this->resources.size(); r++) {
+        auto& res = this->resources[r];
+        needed[r] = res.output || res.backbuffer || res.desc.persistent;
+    }
+    for (size_t p = this->passes.size(); p-- > 0;) {
+        auto& pass = this->passes[p];
+        pass.live = false;
+        for (auto& use : pass.uses) {
+            if (get_usage_info(use.usage, pass.type).write && needed[use.resource]) {
+                pass.live = true;
+            }
+        }
+        if (!pass.live) {
+            continue;
+        }
+        for (auto& use : pass.uses) {
+            if (overwrites(use.clear, use.usage)) {
+                needed[use.resource] = false;
+            }
+        }
+        for (auto& use : pass.uses) {
+            if (!overwrites(use.clear, use.usage)) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+
+    /* lifetimes and load ops in execution order */
+    std::vector<bool> written(this->resources.size(), false);
+    std::vector<bool> keeps_contents(this->resources.size(), false);
+    this->stats = {};
+    for (uint32_t p = 0; p < this->passes.size(); p++) {
+        auto& pass = this->passes[p];
+        if (!pass.live) {
+            this->stats.culled_pass_count++;
+            continue;
+        }
+        this->stats.pass_count++;
+
+        for (auto& use : pass.uses) {
+            auto& res = this->resources[use.resource];
+            auto info = get_usage_info(use.usage, pass.type);
+            if (!info.write && !written[use.resource] && !res.desc.persistent) {
+                throw std::runtime_error("render graph pass " + pass.name + " reads " + res.name + " before anything writes it!");
+            }
+            res.first_pass = std::min(res.first_pass, p);
+            res.last_pass = std::max(res.last_pass, p);
+            res.usage |= info.image_usage;
+
+            if (info.attachment) {
+                if (use.clear) {
+                    use.load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                } else if (use.usage == render_graph_usage::RESOLVE_ATTACHMENT || (!written[use.resource] && !res.desc.persistent)) {
+                    use.load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                } else {
+                    use.load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+                    keeps_contents[use.resource] = true;
+                }
+            }
+        }
+        for (auto& use : pass.uses) {
+            if (get_usage_info(use.usage, pass.type).write) {
+                written[use.resource] = true;
+            }
+        }
+    }
+
+    /* store ops, attachments only need storing when a later pass uses them */
+    for (uint32_t p = 0; p < this->passes.size(); p++) {
+        auto& pass = this->passes[p];
+        if (!pass.live) {
+            continue;
+        }
+        for (auto& use : pass.uses) {
+            auto& res = this->resources[use.resource];
+            if (res.output || res.backbuffer || res.desc.persistent || res.last_pass > p) {
+                use.store_op = VK_ATTACHMENT_STORE_OP_STORE;
+                keeps_contents[use.resource] = true;
+            }
+        }
+    }
+
+    // attachments that never leave their pass can live in tile memory
+    VkImageUsageFlags attachment_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    for (size_t r = 0; r < this->resources.size(); r++) {
+        auto& res = this->resources[r];
+        if (!res.backbuffer && res.usage != 0 && (res.usage & ~attachment_usage) == 0 && !keeps_contents[r]) {
+            res.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+    }
+
+    for (auto& pass : this->passes) {
+        if (pass.live && pass.type == render_graph_pass_type::GRAPHICS) {
+            this->create_render_pass(vkdata, pass);
+        }
+    }
+}
+
+void render_graph::create_render_pass(vulkan_data& vkdata, pass_entry& pass)
+{
+    std::vector<VkAttachmentDescription> attachments;
+    std::vector<VkAttachmentReference> color_refs;
+    std::vector<VkAttachmentReference> resolve_refs;
+    VkAttachmentReference depth_ref = {};
+    bool has_depth = false;
+
+    pass.clear_values.clear();
+    for (auto& use : pass.uses) {
+        auto info = get_usage_info(use.usage, pass.type);
+        if (!info.attachment) {
+            continue;
+        }
+        auto& res = this->resources[use.resource];
+
+        // layouts are transitioned by the graph's barriers, not the render pass
+        VkAttachmentDescription attachment = {};
+        attachment.format = res.backbuffer ? vkdata.swap_chain_data.image_format : res.desc.format;
+        attachment.samples = res.backbuffer ? VK_SAMPLE_COUNT_1_BIT : res.desc.samples;
+        attachment.loadOp = use.load_op;
+        attachment.storeOp = use.store_op;
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachment.initialLayout = info.layout;
+        attachment.finalLayout = info.layout;
+
+        VkAttachmentReference ref = {};
+        ref.attachment = static_cast<uint32_t>(attachments.size());
+        ref.layout = info.layout;
+
+        switch (use.usage) {
+            case render_graph_usage::COLOR_ATTACHMENT:
+                color_refs.push_back(ref);
+                break;
+            case render_graph_usage::RESOLVE_ATTACHMENT:
+                resolve_refs.push_back(ref);
+                break;
+            default:
+                if (has_depth) {
+                    throw std::logic_error("render graph pass " + pass.name + " has more than one depth attachment!");
+                }
+                depth_ref = ref;
+                has_depth = true;
+                break;
+        }
+        attachments.push_back(attachment);
+        pass.clear_values.push_back(use.clear_value);
+    }
+
+    if (attachments.empty()) {
+        throw std::logic_error("render graph pass " + pass.name + " is a graphics pass without attachments!");
+    }
+    if (!resolve_refs.empty() && resolve_refs.size() != color_refs.size()) {
+        throw std::logic_error("render graph pass " + pass.name + " needs one resolve attachment per color attachment!");
+    }
+
+    VkSubpassDescription subpass = {};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = static_cast<uint32_t>(color_refs.size());
+    subpass.pColorAttachments = color_refs.data();
+    subpass.pResolveAttachments = resolve_refs.empty() ? nullptr : resolve_refs.data();
+    subpass.pDepthStencilAttachment = has_depth ? &depth_ref : nullptr;
+
+    VkRenderPassCreateInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+    renderPassInfo.pAttachments = attachments.data();
+    renderPassInfo.subpassCount = 1;
+    renderPassInfo.pSubpasses = &subpass;
+
+    if (vkCreateRenderPass(vkdata.logical_device, &renderPassInfo, nullptr, &pass.render_pass) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render pass for render graph pass " + pass.name + "!");
+    }
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->track_render_pass(pass.render_pass, renderPassInfo);
+    }
+}
+
+void render_graph::create_images(vulkan_data& vkdata)
+{
+    VkExtent2D swap_extent = vkdata.swap_chain_data.extent;
+    for (auto& res : this->resources) {
+        if (res.backbuffer) {
+            // only color attachment use is guaranteed, the rest depends on the surface
+            if ((res.usage & ~vkdata.swap_chain_data.image_usage) != 0) {
+                throw std::runtime_error("the swapchain images don't support how the render graph uses the backbuffer!");
+            }
+            res.extent = swap_extent;
+            continue;
+        }
+        if (res.usage == 0) {
+            continue;   // only used by culled passes
+        }
+
+        if (res.desc.width != 0 && res.desc.height != 0) {
+            res.extent = {res.desc.width, res.desc.height};
+        } else {
+            res.extent.width = static_cast<uint32_t>(std::max(1.0f, std::floor(swap_extent.width * res.desc.scale)));
+            res.extent.height = static_cast<uint32_t>(std::max(1.0f, std::floor(swap_extent.height * res.desc.scale)));
+        }
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = res.extent.width;
+        imageInfo.extent.height = res.extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = res.desc.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = res.usage;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageInfo.samples = res.desc.samples;
+
+        // memory is bound once the aliasing is worked out
+        if (vkCreateImage(vkdata.logical_device, &imageInfo, nullptr, &res.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image " + res.name + "!");
+        }
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->track_image(res.image, imageInfo);
+        }
+        vkGetImageMemoryRequirements(vkdata.logical_device, res.image, &res.requirements);
+    }
+}
+
+void render_graph::alias_memory(vulkan_data& vkdata)
+{
+    /*
+     * biggest first, each image goes into the first slot whose images are all dead before it
+     * starts or born after it ends. images in a slot share memory from offset 0 so the slot takes
+     * the largest size and alignment and only memory types all of them accept. persistent images
+     * are alive across frames so they get a slot to themselves
+     */
+    std::vector<render_graph_resource> order;
+    for (size_t r = 0; r < this->resources.size(); r++) {
+        if (this->resources[r].image != VK_NULL_HANDLE) {
+            order.push_back(static_cast<render_graph_resource>(r));
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](render_graph_resource a, render_graph_resource b) {
+        return this->resources[a].requirements.size > this->resources[b].requirements.size;
+    });
+
+    for (auto r : order) {
+        auto& res = this->resources[r];
+        this->stats.transient_bytes += res.requirements.size;
+
+        size_t s = res.desc.persistent ? this->slots.size() : 0;
+        for (; s < this->slots.size(); s++) {
+            auto& slot = this->slots[s];
+            if (slot.persistent || (slot.requirements.memoryTypeBits & res.requirements.memoryTypeBits) == 0) {
+                continue;
+            }
+            bool overlaps = false;
+            for (auto other : slot.resources) {
+                auto& o = this->resources[other];
+                if (!(res.last_pass < o.first_pass || o.last_pass < res.first_pass)) {
+                    overlaps = true;
+                    break;
+                }
+            }
+            if (!overlaps) {
+                break;
+            }
+        }
+        if (s == this->slots.size()) {
+            this->slots.emplace_back();
+            this->slots[s].requirements = res.requirements;
+            this->slots[s].persistent = res.desc.persistent;
+        }
+
+        auto& slot = this->slots[s];
+        slot.requirements.size = std::max(slot.requirements.size, res.requirements.size);
+        slot.requirements.alignment = std::max(slot.requirements.alignment, res.requirements.alignment);
+        slot.requirements.memoryTypeBits &= res.requirements.memoryTypeBits;
+        slot.resources.push_back(r);
+        res.slot = static_cast<uint32_t>(s);
+    }
+
+    VmaAllocationCreateInfo allocationCreateInfo = {};
+    allocationCreateInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    for (auto& slot : this->slots) {
+        if (vmaAllocateMemory(vkdata.mem_allocator, &slot.requirements, &allocationCreateInfo, &slot.allocation, nullptr) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate render graph memory!");
+        }
+        for (auto r : slot.resources) {
+            if (vmaBindImageMemory(vkdata.mem_allocator, slot.allocation, this->resources[r].image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to bind render graph image " + this->resources[r].name + "!");
+            }
+        }
+        this->stats.allocated_bytes += slot.requirements.size;
+    }
+
+    // whatever touches a slot's memory, this frame or the last, has to finish before it is reused
+    for (auto& pass : this->passes) {
+        if (!pass.live) {
+            continue;
+        }
+        for (auto& use : pass.uses) {
+            auto& res = this->resources[use.resource];
+            if (res.slot == UINT32_MAX) {
+                continue;
+            }
+            auto info = get_usage_info(use.usage, pass.type);
+            this->slots[res.slot].stages |= info.stages;
+            if (info.write) {
+                this->slots[res.slot].write_access |= info.access;
+            }
+        }
+    }
+
+    for (auto& res : this->resources) {
+        if (res.image == VK_NULL_HANDLE) {
+            continue;
+        }
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = res.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = res.desc.format;
+        viewInfo.subresourceRange.aspectMask = get_aspect_mask(res.desc.format, false);
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(vkdata.logical_device, &viewInfo, nullptr, &res.image_view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image view " + res.name + "!");
+        }
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->track_image_view(res.image_view, viewInfo);
+        }
+    }
+}
+
+void render_graph::create_frame_buffers(vulkan_data& vkdata)
+{
+    for (auto& pass : this->passes) {
+        if (!pass.live || pass.type != render_graph_pass_type::GRAPHICS) {
+            continue;
+        }
+
+        bool per_image = false;
+        bool has_extent = false;
+        for (auto& use : pass.uses) {
+            if (!get_usage_info(use.usage, pass.type).attachment) {
+                continue;
+            }
+            auto& res = this->resources[use.resource];
+            per_image |= res.backbuffer;
+            if (!has_extent) {
+                pass.extent = res.extent;
+                has_extent = true;
+            } else if (res.extent.width != pass.extent.width || res.extent.height != pass.extent.height) {
+                throw std::runtime_error("render graph pass " + pass.name + " has attachments of different sizes!");
+            }
+        }
+
+        size_t count = per_image ? vkdata.swap_chain_data.image_views.size() : 1;
+        pass.frame_buffers.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            std::vector<VkImageView> views;
+            for (auto& use : pass.uses) {
+                if (!get_usage_info(use.usage, pass.type).attachment) {
+                    continue;
+                }
+                auto& res = this->resources[use.resource];
+                views.push_back(res.backbuffer ? vkdata.swap_chain_data.image_views[i] : res.image_view);
+            }
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = pass.render_pass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+            framebufferInfo.pAttachments = views.data();
+            framebufferInfo.width = pass.extent.width;
+            framebufferInfo.height = pass.extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(vkdata.logical_device, &framebufferInfo, nullptr, &pass.frame_buffers[i]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create framebuffer for render graph pass " + pass.name + "!");
+            }
+            if (vkdata.capture != nullptr) {
+                vkdata.capture->track_framebuffer(pass.frame_buffers[i], framebufferInfo);
+            }
+        }
+    }
+}
+
+void render_graph::build_barriers(vulkan_data& vkdata)
+{
+    /*
+     * per image: its layout, the last write and the stages it has been made visible to, and the
+     * reads since. a use only gets a barrier when it changes the layout, reads a write it can't
+     * see yet or writes over a write. writing over reads is an execution dependency only.
+     * persistent images start out how the end of the frame leaves them
+     */
+    struct image_state {
+        bool touched = false;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags write_stages = 0;
+        VkAccessFlags write_access = 0;
+        VkPipelineStageFlags visible_stages = 0;
+        VkPipelineStageFlags read_stages = 0;
+    };
+    std::vector<image_state> states(this->resources.size());
+    std::vector<bool> used(this->resources.size(), false);
+    this->stats.barrier_count = 0;
+
+    auto advance = [](image_state& state, const usage_info& info, bool barrier) {
+        state.touched = true;
+        state.layout = info.layout;
+        if (info.write) {
+            state.write_stages = info.stages;
+            state.write_access = info.access;
+            state.visible_stages = info.stages;
+            state.read_stages = 0;
+        } else {
+            state.read_stages |= info.stages;
+            if (barrier) {
+                state.visible_stages |= info.stages;
+            }
+        }
+    };
+
+    for (auto& pass : this->passes) {
+        if (!pass.live) {
+            continue;
+        }
+        for (auto& use : pass.uses) {
+            if (this->resources[use.resource].desc.persistent) {
+                advance(states[use.resource], get_usage_info(use.usage, pass.type), true);
+            }
+        }
+    }
+
+    for (auto& pass : this->passes) {
+        pass.before = {};
+        if (!pass.live) {
+            continue;
+        }
+        for (auto& use : pass.uses) {
+            auto& res = this->resources[use.resource];
+            auto& state = states[use.resource];
+            auto info = get_usage_info(use.usage, pass.type);
+
+            bool barrier = false;
+            bool history = false;
+            VkPipelineStageFlags src_stages = 0;
+            VkAccessFlags src_access = 0;
+            if (res.desc.persistent && !used[use.resource]) {
+                // always a barrier, on the first frame after a compile it transitions from UNDEFINED
+                barrier = true;
+                history = true;
+                src_stages = state.write_stages | state.read_stages;
+                src_access = state.write_access;
+            } else if (!state.touched) {
+                // contents are discarded, only whatever used the memory before has to be done
+                barrier = true;
+                if (res.backbuffer) {
+                    src_stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;  // where the acquire semaphore is waited on
+                } else {
+                    src_stages = this->slots[res.slot].stages;
+                    src_access = this->slots[res.slot].write_access;
+                }
+            } else if (state.layout != info.layout) {
+                barrier = true;
+                src_stages = state.write_stages | state.read_stages;
+                src_access = state.write_access;
+            } else if (info.write && state.read_stages != 0) {
+                pass.before.src_stages |= state.read_stages;
+                pass.before.dst_stages |= info.stages;
+            } else if (info.write || (info.stages & ~state.visible_stages) != 0) {
+                barrier = true;
+                src_stages = state.write_stages;
+                src_access = state.write_access;
+            }
+
+            if (barrier) {
+                pass.before.barriers.push_back({use.resource, state.touched ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+                                                info.layout, src_access, info.access, history});
+                pass.before.src_stages |= src_stages;
+                pass.before.dst_stages |= info.stages;
+                this->stats.barrier_count++;
+            }
+
+            advance(state, info, barrier);
+            used[use.resource] = true;
+        }
+    }
+
+    this->present = {};
+    if (this->backbuffer != UINT32_MAX) {
+        auto& state = states[this->backbuffer];
+        if (!state.touched) {
+            throw std::runtime_error("nothing in the render graph writes the backbuffer!");
+        }
+        if (vkdata.headless) {
+            // nothing presents headless frames, they are left ready for read_headless_frame to copy out
+            this->present.barriers.push_back({this->backbuffer, state.layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, state.write_access, VK_ACCESS_TRANSFER_READ_BIT});
+            this->present.dst_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        } else {
+            this->present.barriers.push_back({this->backbuffer, state.layout, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, state.write_access, 0});
+            this->present.dst_stages = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        }
+        this->present.src_stages = state.write_stages | state.read_stages;
+        this->stats.barrier_count++;
+    }
+}
+
+void render_graph::compile(vulkan_data& vkdata)
+{
+    if (this->compiled) {
+        this->release(vkdata);
+    }
+    if (!this->planned) {
+        this->plan(vkdata);
+        this->planned = true;
+    }
+    this->stats.transient_bytes = 0;
+    this->stats.allocated_bytes = 0;
+
+    this->create_images(vkdata);
+    this->alias_memory(vkdata);
+    this->create_frame_buffers(vkdata);
+    this->build_barriers(vkdata);
+    this->compiled = true;
+    this->generation++;
+    this->history_frame = UINT64_MAX;
+}
+
+void render_graph::release(vulkan_data& vkdata)
+{
+    for (auto& pass : this->passes) {
+        for (auto frame_buffer : pass.frame_buffers) {
+            if (vkdata.capture != nullptr) {
+                vkdata.capture->forget(capture_object_type::FRAMEBUFFER, frame_buffer);
+            }
+            vkDestroyFramebuffer(vkdata.logical_device, frame_buffer, nullptr);
+        }
+        pass.frame_buffers.clear();
+    }
+    for (auto& res : this->resources) {
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->forget(capture_object_type::IMAGE_VIEW, res.image_view);
+            vkdata.capture->forget(capture_object_type::IMAGE, res.image);
+        }
+        if (res.image_view != VK_NULL_HANDLE) {
+            vkDestroyImageView(vkdata.logical_device, res.image_view, nullptr);
+        }
+        if (res.image != VK_NULL_HANDLE) {
+            vkDestroyImage(vkdata.logical_device, res.image, nullptr);
+        }
+        res.image_view = VK_NULL_HANDLE;
+        res.image = VK_NULL_HANDLE;
+        res.slot = UINT32_MAX;
+        res.requirements = {};
+    }
+    for (auto& slot : this->slots) {
+        vmaFreeMemory(vkdata.mem_allocator, slot.allocation);
+    }
+    this->slots.clear();
+    this->compiled = false;
+}
+
+void render_graph::terminate(vulkan_data& vkdata)
+{
+    this->release(vkdata);
+    for (auto& pass : this->passes) {
+        if (pass.render_pass != VK_NULL_HANDLE) {
+            if (vkdata.capture != nullptr) {
+                vkdata.capture->forget(capture_object_type::RENDER_PASS, pass.render_pass);
+            }
+            vkDestroyRenderPass(vkdata.logical_device, pass.render_pass, nullptr);
+        }
+    }
+    this->passes.clear();
+    this->resources.clear();
+    this->present = {};
+    this->backbuffer = UINT32_MAX;
+    this->planned = false;
+    this->stats = {};
+}
+
+bool render_graph::is_compiled() const
+{
+    return this->compiled;
+}
+
+uint32_t render_graph::get_generation() const
+{
+    return this->generation;
+}
+
+bool render_graph::has_history(const vulkan_data& vkdata) const
+{
+    return this->history_frame != UINT64_MAX && vkdata.frame_number > this->history_frame;
+}
+
+void render_graph::record_barriers(vulkan_data& vkdata, VkCommandBuffer cmd, uint32_t image_index, const barrier_batch& batch, bool first_frame) const
+{
+    if (batch.dst_stages == 0) {
+        return;
+    }
+
+    std::vector<VkImageMemoryBarrier> barriers(batch.barriers.size());
+    for (size_t i = 0; i < batch.barriers.size(); i++) {
+        auto& b = batch.barriers[i];
+        auto& res = this->resources[b.resource];
+        barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[i].srcAccessMask = b.src_access;
+        barriers[i].dstAccessMask = b.dst_access;
+        barriers[i].oldLayout = (b.history && first_frame) ? VK_IMAGE_LAYOUT_UNDEFINED : b.old_layout;
+        barriers[i].newLayout = b.new_layout;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].image = this->get_image(vkdata, b.resource, image_index);
+        barriers[i].subresourceRange.aspectMask = res.backbuffer ? VK_IMAGE_ASPECT_COLOR_BIT : get_aspect_mask(res.desc.format, true);
+        barriers[i].subresourceRange.baseMipLevel = 0;
+        barriers[i].subresourceRange.levelCount = 1;
+        barriers[i].subresourceRange.baseArrayLayer = 0;
+        barriers[i].subresourceRange.layerCount = 1;
+    }
+
+    VkPipelineStageFlags src_stages = (batch.src_stages != 0) ? batch.src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    CAPTURED(vkdata.capture, vkCmdPipelineBarrier, cmd, src_stages, batch.dst_stages, 0,
+             0, nullptr, 0, nullptr,
+             static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void render_graph::execute(vulkan_data& vkdata, VkCommandBuffer cmd, uint32_t image_index, gpu_profiler* profiler) const
+{
+    if (!this->compiled) {
+        throw std::logic_error("render graph executed before it was compiled!");
+    }
+    if (this->history_frame == UINT64_MAX) {
+        this->history_frame = vkdata.frame_number;
+    }
+    bool first_frame = vkdata.frame_number == this->history_frame;
+
+    for (auto& pass : this->passes) {
+        if (!pass.live) {
+            continue;
+        }
+        // the pass's barriers count towards it
+        uint32_t region = (profiler != nullptr) ? profiler->begin_region(vkdata, cmd, pass.name, true) : UINT32_MAX;
+        this->record_barriers(vkdata, cmd, image_index, pass.before, first_frame);
+
+        render_graph_context context = {cmd, image_index, pass.render_pass, pass.extent};
+        if (pass.type == render_graph_pass_type::GRAPHICS) {
+            if (pass.render_area.width != 0 && pass.render_area.height != 0) {
+                context.extent.width = std::min(pass.render_area.width, pass.extent.width);
+                context.extent.height = std::min(pass.render_area.height, pass.extent.height);
+            }
+
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = pass.render_pass;
+            renderPassInfo.framebuffer = pass.frame_buffers[(pass.frame_buffers.size() == 1) ? 0 : image_index];
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = context.extent;
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(pass.clear_values.size());
+            renderPassInfo.pClearValues = pass.clear_values.data();
+
+            CAPTURED(vkdata.capture, vkCmdBeginRenderPass, cmd, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            pass.record(vkdata, context);
+            CAPTURED(vkdata.capture, vkCmdEndRenderPass, cmd);
+        } else {
+            pass.record(vkdata, context);
+        }
+        if (profiler != nullptr) {
+            profiler->end_region(vkdata, cmd, region);
+        }
+    }
+
+    this->record_barriers(vkdata, cmd, image_index, this->present, first_frame);
+}
+
+void render_graph::set_render_area(render_graph_pass pass, VkExtent2D extent)
+{
+    this->passes.at(pass).render_area = extent;
+}
+
+VkRenderPass render_graph::get_render_pass(render_graph_pass pass) const
+{
+    return this->passes.at(pass).render_pass;
+}
+
+std::vector<VkRenderPass> render_graph::get_render_passes() const
+{
+    std::vector<VkRenderPass> render_passes;
+    for (auto& pass : this->passes) {
+        if (pass.render_pass != VK_NULL_HANDLE) {
+            render_passes.push_back(pass.render_pass);
+        }
+    }
+    return render_passes;
+}
+
+bool render_graph::is_pass_live(render_graph_pass pass) const
+{
+    return this->passes.at(pass).live;
+}
+
+VkImage render_graph::get_image(render_graph_resource resource) const
+{
+    if (this->resources.at(resource).backbuffer) {
+        throw std::logic_error("the backbuffer changes every frame, it has no single image!");
+    }
+    return this->resources[resource].image;
+}
+
+VkImage render_graph::get_image(vulkan_data& vkdata, render_graph_resource resource, uint32_t image_index) const
+{
+    auto& res = this->resources.at(resource);
+    return res.backbuffer ? vkdata.swap_chain_data.images[image_index] : res.image;
+}
+
+VkImageView render_graph::get_image_view(render_graph_resource resource) const
+{
+    if (this->resources.at(resource).backbuffer) {
+        throw std::logic_error("the backbuffer changes every frame, it has no single image view!");
+    }
+    return this->resources[resource].image_view;
+}
+
+render_graph_stats render_graph::get_stats() const
+{
+    return this->stats;
+}
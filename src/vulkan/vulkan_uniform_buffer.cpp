@@ -9,6 +9,9 @@ void uniform_buffer_base::initialise(vulkan_data &vkdata, uint32_t binding, VkDe
 void uniform_buffer_base::terminate(vulkan_data &vkdata) {
     vkDeviceWaitIdle(vkdata.logical_device);
     this->virtual_terminate(vkdata);
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->forget_descriptor_pool(this->descriptor_pool);
+    }
     vkDestroyDescriptorPool(vkdata.logical_device, this->descriptor_pool, nullptr);
 }
 
@@ -16,6 +19,9 @@ void uniform_buffer_base::rebuild_descriptor_sets(vulkan_data& vkdata, VkDescrip
 {
     // clear descriptor pool if it already exists
     if (!this->descriptor_sets.empty()) {
+        if (vkdata.capture != nullptr) {
+            vkdata.capture->forget_descriptor_pool(this->descriptor_pool);
+        }
         vkDestroyDescriptorPool(vkdata.logical_device, this->descriptor_pool, nullptr);
     }
 
@@ -49,6 +55,9 @@ void uniform_buffer_base::rebuild_descriptor_sets(vulkan_data& vkdata, VkDescrip
     if (vkAllocateDescriptorSets(vkdata.logical_device, &allocInfo, this->descriptor_sets.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
+    if (vkdata.capture != nullptr) {
+        vkdata.capture->track_descriptor_sets(allocInfo, this->descriptor_sets.data());
+    }
 
     this->update_descriptor_sets(vkdata);
 }
@@ -69,7 +78,7 @@ void uniform_buffer_base::update_descriptor_sets(vulkan_data& vkdata) {
         descriptorWrite.pBufferInfo = &info.bufferInfo;
         descriptorWrite.pImageInfo = &info.imageInfo;
 
-        vkUpdateDescriptorSets(vkdata.logical_device, 1, &descriptorWrite, 0, nullptr);
+        CAPTURED(vkdata.capture, vkUpdateDescriptorSets, vkdata.logical_device, 1, &descriptorWrite, 0, nullptr);
     }
 }
 
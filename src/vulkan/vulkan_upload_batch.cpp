@@ -0,0 +1,235 @@
+#include "vulkan_base.h"
+
+#include <algorithm>
+
+void upload_batch::initialise(vulkan_data& vkdata, VkDeviceSize chunk_byte_size)
+{
+    this->chunk_byte_size = chunk_byte_size;
+    this->staged_bytes = 0;
+}
+
+void upload_batch::terminate(vulkan_data& vkdata)
+{
+    this->wait(vkdata);
+    for (auto& chunk : this->chunks) {
+        vmaUnmapMemory(vkdata.mem_allocator, chunk.allocation);
+        vmaDestroyBuffer(vkdata.mem_allocator, chunk.buffer, chunk.allocation);
+    }
+    this->chunks.clear();
+    this->buffer_copies.clear();
+    this->image_copies.clear();
+}
+
+staging_region upload_batch::reserve(vulkan_data& vkdata, VkDeviceSize byte_size, VkDeviceSize alignment)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+
+    // find a chunk with enough space left
+    staging_chunk* chunk = nullptr;
+    VkDeviceSize offset = 0;
+    for (auto& c : this->chunks) {
+        offset = (c.used + alignment - 1) / alignment * alignment;
+        if (offset + byte_size <= c.byte_size) {
+            chunk = &c;
+            break;
+        }
+    }
+
+    // otherwise allocate a new one, large uploads get a chunk to themselves
+    if (chunk == nullptr) {
+        staging_chunk c{};
+        c.byte_size = std::max(this->chunk_byte_size, byte_size);
+        ::create_buffer(vkdata, &c.buffer, &c.allocation, c.byte_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+        void* mapped;
+        if (vmaMapMemory(vkdata.mem_allocator, c.allocation, &mapped) != VK_SUCCESS) {
+            vmaDestroyBuffer(vkdata.mem_allocator, c.buffer, c.allocation);
+            throw std::runtime_error("failed to map staging buffer!");
+        }
+        c.mapped = static_cast<unsigned char*>(mapped);
+        this->chunks.push_back(c);
+        chunk = &this->chunks.back();
+        offset = 0;
+    }
+
+    chunk->used = offset + byte_size;
+    this->staged_bytes += byte_size;
+
+    staging_region region;
+    region.data = chunk->mapped + offset;
+    region.buffer = chunk->buffer;
+    region.offset = offset;
+    return region;
+}
+
+void upload_batch::copy_to_buffer(const staging_region& src, VkBuffer dst, VkDeviceSize byte_size)
+{
+    buffer_copy copy{};
+    copy.src = src.buffer;
+    copy.dst = dst;
+    copy.region.srcOffset = src.offset;
+    copy.region.dstOffset = 0;
+    copy.region.size = byte_size;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->buffer_copies.push_back(copy);
+}
+
+void upload_batch::copy_to_image(const staging_region& src, VkImage dst, const std::vector<image_mip_level>& levels)
+{
+    image_copy copy{};
+    copy.src = src.buffer;
+    copy.dst = dst;
+    copy.mip_levels = static_cast<uint32_t>(levels.size());
+    copy.regions.resize(levels.size());
+    for (size_t i = 0; i < levels.size(); i++) {
+        VkBufferImageCopy& region = copy.regions[i];
+        region.bufferOffset = src.offset + levels[i].offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {levels[i].width, levels[i].height, 1};
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->image_copies.push_back(std::move(copy));
+}
+
+void upload_batch::submit(vulkan_data& vkdata)
+{
+    this->submit_async(vkdata);
+    this->wait(vkdata);
+}
+
+void upload_batch::submit_async(vulkan_data& vkdata)
+{
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->buffer_copies.empty() && this->image_copies.empty()) {
+        return;
+    }
+    if (this->submitted_fence != VK_NULL_HANDLE) {
+        throw std::runtime_error("upload batch was submitted again before the previous submission completed!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = vkdata.command_pool_graphics;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer cmd;
+    vkAllocateCommandBuffers(vkdata.logical_device, &allocInfo, &cmd);
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &beginInfo);
+
+    /* move every image into transfer dst in one barrier */
+    std::vector<VkImageMemoryBarrier> barriers(this->image_copies.size());
+    for (size_t i = 0; i < this->image_copies.size(); i++) {
+        VkImageMemoryBarrier& barrier = barriers[i];
+        barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = this->image_copies[i].dst;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = this->image_copies[i].mip_levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
+    if (!barriers.empty()) {
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+    }
+
+    /* copies */
+    for (auto& copy : this->buffer_copies) {
+        vkCmdCopyBuffer(cmd, copy.src, copy.dst, 1, &copy.region);
+    }
+    for (auto& copy : this->image_copies) {
+        vkCmdCopyBufferToImage(cmd, copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               static_cast<uint32_t>(copy.regions.size()), copy.regions.data());
+    }
+
+    /* make the results visible to vertex input and shader reads */
+    for (auto& barrier : barriers) {
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    }
+    VkMemoryBarrier memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         1, &memory_barrier, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+    vkEndCommandBuffer(cmd);
+
+    /* submit once and track completion with a fence rather than idling the whole queue */
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    vkCreateFence(vkdata.logical_device, &fenceInfo, nullptr, &fence);
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+
+    if (vkQueueSubmit(vkdata.graphics_queue, 1, &submitInfo, fence) != VK_SUCCESS) {
+        vkDestroyFence(vkdata.logical_device, fence, nullptr);
+        vkFreeCommandBuffers(vkdata.logical_device, vkdata.command_pool_graphics, 1, &cmd);
+        throw std::runtime_error("failed to submit upload batch!");
+    }
+    this->submitted_cmd = cmd;
+    this->submitted_fence = fence;
+
+    this->buffer_copies.clear();
+    this->image_copies.clear();
+}
+
+bool upload_batch::is_complete(vulkan_data& vkdata)
+{
+    if (this->submitted_fence == VK_NULL_HANDLE) {
+        return true;
+    }
+    if (vkGetFenceStatus(vkdata.logical_device, this->submitted_fence) != VK_SUCCESS) {
+        return false;
+    }
+    this->release_submission(vkdata);
+    return true;
+}
+
+void upload_batch::wait(vulkan_data& vkdata)
+{
+    if (this->submitted_fence != VK_NULL_HANDLE) {
+        vkWaitForFences(vkdata.logical_device, 1, &this->submitted_fence, VK_TRUE, UINT64_MAX);
+        this->release_submission(vkdata);
+    }
+}
+
+void upload_batch::release_submission(vulkan_data& vkdata)
+{
+    vkDestroyFence(vkdata.logical_device, this->submitted_fence, nullptr);
+    vkFreeCommandBuffers(vkdata.logical_device, vkdata.command_pool_graphics, 1, &this->submitted_cmd);
+    this->submitted_fence = VK_NULL_HANDLE;
+    this->submitted_cmd = VK_NULL_HANDLE;
+}
+
+VkDeviceSize upload_batch::staged_byte_size() const
+{
+    return this->staged_bytes;
+}
@@ -0,0 +1,336 @@
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "src/vulkan/vulkan_base.h"
+#include "src/basic_pipeline.h"
+#include "src/basic_command_buffer.h"
+#include "src/platform.h"
+#include "model/gltf_model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <sstream>
+
+/*
+ * time to first frame, broken down by startup step. every run is a fresh process (this same
+ * executable started with --child) rendering one headless frame, so nothing stays warm in the
+ * process between runs. cold runs drop the os page cache first, or where that isn't permitted
+ * evict res/ and the model's directory file by file, warm runs follow an untimed warm up run.
+ *
+ * image_decode_ms and geometry_convert_ms are cpu time summed over the loader's threads, the
+ * other steps are wall clock time. time_to_first_frame_ms starts at main, so process creation,
+ * dynamic linking and static initialisers aren't in it
+ */
+
+static void print_usage()
+{
+    std::cout << "usage: discovery_startup_bench <model.gltf/.glb/.dbake> [--runs N] [--mode cold/warm/both] [--size WxH]"
+                 " [--no-pipeline-cache]\n"
+                 "the model path is relative to the executable, like res/models/viking/scene.gltf. prints json" << std::endl;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+typedef std::vector<std::pair<std::string, double>> startup_times;
+
+/* child, a single startup */
+
+static int run_startup(const std::string& model_path, uint32_t width, uint32_t height, bool use_pipeline_cache)
+{
+    auto start = std::chrono::steady_clock::now();
+    vulkan_data vkdata;
+    if (!use_pipeline_cache) {
+        vkdata.pipeline_cache_path.clear();
+    }
+    try {
+        initialise_vulkan_headless(&vkdata, width, height);
+    } catch (const std::exception& e) {
+        std::cout << "error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    gltf_model gmodel;
+    gmodel.initialise(model_path);
+    if (!gmodel.is_valid()) {
+        std::cout << "error: failed to open " << model_path << " " << gmodel.err << std::endl;
+        terminate_vulkan(vkdata);
+        return EXIT_FAILURE;
+    }
+
+    auto pipeline_start = std::chrono::steady_clock::now();
+    triangle_cmd cmd;
+    cmd.add_passes(vkdata, *vkdata.graph);
+    vkdata.graph->compile(vkdata);
+    basic_pipeline pipeline;
+    pipeline.initialise(vkdata, vkdata.graph->get_render_pass(cmd.forward_pass));
+    double pipeline_ms = elapsed_ms(pipeline_start);
+
+    gmodel.load_model(vkdata);
+
+    /* the first frame, framed like the viewer frames the model on startup */
+    auto frame_start = std::chrono::steady_clock::now();
+    cmd.model = &gmodel;
+    cmd.pipeline = &pipeline;
+    cmd.initialise(vkdata);
+
+    auto bounds = gmodel.get_model_bounds();
+    double zoom = -1.0 * (double)std::max({bounds.max.x - bounds.min.x, bounds.max.y - bounds.min.y, bounds.max.z - bounds.min.z});
+    glm::mat4 v = glm::translate(glm::mat4(1.0), {0.0, 0.0, zoom});
+    v = glm::rotate(v, glm::radians(180.0f), {0, 0, 1}); // flip y
+    cmd.frame_ubo.proj = glm::perspective(45.0, (double)width / (double)height, 0.1, 10000.0);
+    cmd.frame_ubo.view = v;
+    cmd.frame_ubo.cameraPos = glm::vec4(v[3].x, v[3].y, v[3].z, 1.0) * v;
+
+    cmd.reterminate(vkdata);
+    cmd.reinitialise(vkdata);
+    submit_command_buffers_graphics(vkdata, cmd.cmd_buffers());
+    present_frame(vkdata);
+    vkDeviceWaitIdle(vkdata.logical_device);
+    double first_frame_ms = elapsed_ms(frame_start);
+    double total_ms = elapsed_ms(start);
+
+    auto& stats = gmodel.load_stats();
+    startup_times times = {
+        {"instance_ms", vkdata.startup_times.instance_ms},
+        {"device_ms", vkdata.startup_times.device_ms},
+        {"swap_chain_ms", vkdata.startup_times.swap_chain_ms},
+        {"pipeline_ms", pipeline_ms},
+        {"parse_ms", stats.parse_ms},
+        {"image_decode_ms", stats.image_decode_ms},
+        {"geometry_convert_ms", stats.vertex_convert_ms + stats.index_convert_ms},
+        {"load_cpu_ms", stats.cpu_stage_ms},
+        {"upload_ms", stats.upload_ms},
+        {"load_ms", stats.total_ms},
+        {"first_frame_ms", first_frame_ms},
+        {"time_to_first_frame_ms", total_ms},
+    };
+    // one line the parent picks out of whatever else ends up on stdout
+    std::cout << "{";
+    for (size_t i = 0; i < times.size(); i++) {
+        std::cout << (i == 0 ? "" : ",") << "\"" << times[i].first << "\":" << times[i].second;
+    }
+    std::cout << "}" << std::endl;
+
+    gmodel.terminate(vkdata);
+    cmd.terminate(vkdata);
+    pipeline.terminate(vkdata);
+    terminate_vulkan(vkdata);
+    return 0;
+}
+
+/* parent, starts and collects the runs */
+
+// "key":number pairs of the child's flat json line
+static startup_times parse_startup_times(const std::string& line)
+{
+    startup_times times;
+    size_t pos = 0;
+    while ((pos = line.find('"', pos)) != std::string::npos) {
+        size_t end = line.find('"', pos + 1);
+        if (end == std::string::npos || end + 1 >= line.size() || line[end + 1] != ':') {
+            break;
+        }
+        times.push_back({line.substr(pos + 1, end - pos - 1), std::strtod(line.c_str() + end + 2, nullptr)});
+        pos = line.find_first_of(",}", end);
+    }
+    return times;
+}
+
+static bool run_child(const std::string& path, const std::vector<std::string>& args, startup_times* times, std::string* error)
+{
+    std::string output;
+    int status = 0;
+    if (!run_process(path, args, &output, &status)) {
+        *error = "failed to start " + path;
+        return false;
+    }
+
+    std::istringstream lines(output);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line[0] == '{') {
+            *times = parse_startup_times(line);
+        } else if (line.compare(0, 6, "error:") == 0) {
+            *error = line.substr(7);
+        }
+    }
+    if (status != 0 || times->empty()) {
+        if (error->empty()) {
+            *error = "the run exited with " + std::to_string(status);
+        }
+        return false;
+    }
+    return true;
+}
+
+// the method used, "none" when nothing could be evicted
+static const char* evict_caches(const std::string& model_path)
+{
+    if (drop_page_cache()) {
+        return "drop_caches";
+    }
+    // just the files a run reads that we know of, shaders, the pipeline cache and the model
+    std::filesystem::path res = to_absolute_path("res");
+    std::filesystem::path model_dir = std::filesystem::path(to_absolute_path(model_path)).parent_path();
+    bool evicted = false;
+    for (auto& dir : {res, model_dir}) {
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(dir, std::filesystem::directory_options::skip_permission_denied, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            if (it->is_regular_file(ec)) {
+                evicted |= evict_file_from_page_cache(it->path().string());
+            }
+        }
+    }
+    return evicted ? "fadvise" : "none";
+}
+
+static std::string json_escape(const std::string& s)
+{
+    std::string out;
+    for (char c : s) {
+        if (static_cast<unsigned char>(c) < 0x20) {
+            // error messages from the os can carry line breaks
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+            continue;
+        }
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    return out;
+}
+
+static void write_times(std::ostream& out, const startup_times& times)
+{
+    out << "{";
+    for (size_t i = 0; i < times.size(); i++) {
+        out << (i == 0 ? "" : ",") << "\"" << times[i].first << "\":" << times[i].second;
+    }
+    out << "}";
+}
+
+// stdout stays valid json when a run fails
+static int fail(const std::string& error)
+{
+    std::cout << "{\"error\":\"" << json_escape(error) << "\"}" << std::endl;
+    return EXIT_FAILURE;
+}
+
+// per step over the runs, every run reports the same steps in the same order
+static startup_times get_median(const std::vector<startup_times>& runs)
+{
+    startup_times median = runs.front();
+    for (size_t step = 0; step < median.size(); step++) {
+        std::vector<double> values;
+        for (auto& run : runs) {
+            values.push_back(run[step].second);
+        }
+        std::sort(values.begin(), values.end());
+        median[step].second = values[values.size() / 2];
+    }
+    return median;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc >= 6 && std::strcmp(argv[1], "--child") == 0) {
+        return run_startup(argv[2], static_cast<uint32_t>(std::atoi(argv[3])), static_cast<uint32_t>(std::atoi(argv[4])),
+                           std::strcmp(argv[5], "1") == 0);
+    }
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+
+    std::string model_path = argv[1];
+    uint32_t run_count = 5;
+    bool cold = true, warm = true;
+    uint32_t width = 1280, height = 720;
+    bool use_pipeline_cache = true;
+    for (int i = 2; i < argc; i++) {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) {
+            run_count = static_cast<uint32_t>(std::max(1, std::atoi(argv[++i])));
+        } else if (std::strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            std::string mode = argv[++i];
+            cold = mode == "cold" || mode == "both";
+            warm = mode == "warm" || mode == "both";
+            if (!cold && !warm) {
+                print_usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            if (std::sscanf(argv[++i], "%ux%u", &width, &height) != 2 || width == 0 || height == 0) {
+                print_usage();
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--no-pipeline-cache") == 0) {
+            use_pipeline_cache = false;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    std::vector<std::string> child_args = {"--child", model_path, std::to_string(width), std::to_string(height),
+                                           use_pipeline_cache ? "1" : "0"};
+
+    // printed once every run is in, so a failed run never leaves half a document behind
+    std::ostringstream json;
+    json << "{\"model\":\"" << json_escape(model_path) << "\",\"width\":" << width << ",\"height\":" << height
+         << ",\"pipeline_cache\":" << (use_pipeline_cache ? "true" : "false") << ",\"modes\":[";
+    bool first_mode = true;
+    for (bool is_cold : {true, false}) {
+        if ((is_cold && !cold) || (!is_cold && !warm)) {
+            continue;
+        }
+        std::vector<startup_times> runs;
+        std::string error;
+        const char* cache_drop = "";
+        if (!is_cold) {
+            startup_times ignored;
+            if (!run_child(argv[0], child_args, &ignored, &error)) {
+                return fail("warm up run failed: " + error);
+            }
+        }
+        for (uint32_t run = 0; run < run_count; run++) {
+            if (is_cold) {
+                cache_drop = evict_caches(model_path);
+            }
+            startup_times times;
+            if (!run_child(argv[0], child_args, &times, &error)) {
+                return fail("run " + std::to_string(run) + " failed: " + error);
+            }
+            runs.push_back(times);
+        }
+
+        json << (first_mode ? "\n" : ",\n") << "{\"mode\":\"" << (is_cold ? "cold" : "warm") << "\"";
+        if (is_cold) {
+            json << ",\"cache_drop\":\"" << cache_drop << "\"";
+        }
+        json << ",\"median\":";
+        write_times(json, get_median(runs));
+        json << ",\"runs\":[";
+        for (size_t i = 0; i < runs.size(); i++) {
+            json << (i == 0 ? "\n" : ",\n");
+            write_times(json, runs[i]);
+        }
+        json << "]}";
+        first_mode = false;
+    }
+    json << "\n]}";
+    std::cout << json.str() << std::endl;
+    return 0;
+}
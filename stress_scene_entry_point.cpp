@@ -0,0 +1,101 @@
+#include "model/stress_scene.h"
+#include "model/baked_model.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+static void print_usage()
+{
+    std::cout << "usage: discovery_stress_scene <output.gltf/" BAKED_MODEL_EXTENSION "> [--nodes N] [--depth N] [--mesh-reuse 0..1]"
+                 " [--materials N] [--textures N] [--texture-size N] [--triangles N] [--distribution uniform/clustered/grid]"
+                 " [--extent F] [--seed N] [--compress]\n"
+                 "baked output also keeps the glTF it was baked from next to it" << std::endl;
+}
+
+// std::stoul takes "-1" and wraps it, and unsigned long is wider than a count on most platforms
+static uint32_t parse_count(const char* text)
+{
+    if (std::strchr(text, '-') != nullptr) {
+        throw std::invalid_argument(text);
+    }
+    unsigned long value = std::stoul(text);
+    if (value > UINT32_MAX) {
+        throw std::out_of_range(text);
+    }
+    return static_cast<uint32_t>(value);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        print_usage();
+        return 1;
+    }
+
+    std::string output = argv[1];
+    stress_scene_params params;
+    bake_options options = {};
+    try {
+        for (int i = 2; i < argc; i++) {
+            bool has_value = i + 1 < argc;
+            if (std::strcmp(argv[i], "--nodes") == 0 && has_value) {
+                params.node_count = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--depth") == 0 && has_value) {
+                params.depth = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--mesh-reuse") == 0 && has_value) {
+                params.mesh_reuse = std::stof(argv[++i]);
+            } else if (std::strcmp(argv[i], "--materials") == 0 && has_value) {
+                params.material_count = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--textures") == 0 && has_value) {
+                params.texture_count = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--texture-size") == 0 && has_value) {
+                params.texture_size = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--triangles") == 0 && has_value) {
+                params.triangles_per_mesh = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--distribution") == 0 && has_value) {
+                if (!parse_stress_distribution(argv[++i], &params.distribution)) {
+                    print_usage();
+                    return 1;
+                }
+            } else if (std::strcmp(argv[i], "--extent") == 0 && has_value) {
+                params.extent = std::stof(argv[++i]);
+            } else if (std::strcmp(argv[i], "--seed") == 0 && has_value) {
+                params.seed = parse_count(argv[++i]);
+            } else if (std::strcmp(argv[i], "--compress") == 0) {
+                options.compress_textures = true;
+            } else {
+                print_usage();
+                return 1;
+            }
+        }
+    } catch (const std::logic_error&) {
+        // std::stoul and std::stof throw invalid_argument or out_of_range for a bad number
+        print_usage();
+        return 1;
+    }
+
+    bool baked = is_baked_model_path(output);
+    std::string gltf_path = baked ? std::filesystem::path(output).replace_extension(".gltf").string() : output;
+
+    auto start = std::chrono::steady_clock::now();
+    stress_scene_stats stats;
+    try {
+        stats = write_stress_scene(gltf_path, params);
+        if (baked) {
+            bake_gltf_model(std::filesystem::absolute(gltf_path).string(), std::filesystem::absolute(output).string(), options);
+        }
+    } catch (const std::exception& e) {
+        std::cout << "stress scene failed: " << e.what() << std::endl;
+        return 1;
+    }
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "wrote " << output << " in " << ms << "ms: " << params.node_count << " nodes (" << stats.root_count << " roots), "
+              << stats.mesh_count << " meshes of " << stats.triangles_per_mesh << " triangles, " << stats.triangle_count
+              << " triangles drawn, " << params.material_count << " materials, " << params.texture_count << " textures, "
+              << stats.buffer_bytes / (1024 * 1024) << "MB of geometry" << std::endl;
+    return 0;
+}